@@ -0,0 +1,63 @@
+#include "LibavProcessExecutor.h"
+#include "render/libav_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+void LibavProcessExecutor::render(const Render::RenderPlan& plan, double totalDurationSeconds) {
+    std::cout << "\nRendering in-process with libav (equivalent FFmpeg command):\n"
+              << Render::buildCommand(plan) << std::endl << std::endl;
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto lastReport = startTime;
+    double lastPercent = 0.0;
+
+    Render::LibavEngine::ProgressCallback onProgress;
+    if (plan.emitProgress || cancelRequested_) {
+        if (plan.emitProgress) {
+            Progress::emit(progressSink_, "encoding", "running", 0.0, 0.0, -1.0, "Encoder started");
+        }
+        onProgress = [&](double outSeconds) {
+            // The engine releases its contexts while unwinding, so stopping
+            // from inside the callback is safe.
+            if (cancelled()) throw Render::Cancelled();
+            if (!plan.emitProgress) return;
+            auto now = std::chrono::steady_clock::now();
+            // Match the roughly twice-per-second cadence of `ffmpeg -progress`.
+            if (now - lastReport < std::chrono::milliseconds(500)) return;
+            lastReport = now;
+            double elapsed = std::chrono::duration<double>(now - startTime).count();
+            double percent = (totalDurationSeconds > 0.0)
+                ? std::clamp((outSeconds / totalDurationSeconds) * 100.0, 0.0, 100.0)
+                : -1.0;
+            lastPercent = percent >= 0.0 ? percent : lastPercent;
+            double eta = -1.0;
+            if (percent > 0.0 && percent < 100.0) {
+                double ratio = percent / 100.0;
+                eta = elapsed * ((1.0 - ratio) / ratio);
+            }
+            Progress::emit(progressSink_, "encoding", "running", percent, elapsed, eta, "Encoding in progress");
+        };
+    }
+
+    try {
+        Render::LibavEngine engine;
+        engine.run(plan, onProgress);
+    } catch (const Render::Cancelled&) {
+        if (plan.emitProgress) {
+            Progress::emit(progressSink_, "encoding", "cancelled", lastPercent, -1.0, -1.0, "Render cancelled");
+        }
+        throw;
+    } catch (const std::exception& e) {
+        if (plan.emitProgress) {
+            Progress::emit(progressSink_, "encoding", "failed", lastPercent, -1.0, -1.0, "libav render failed");
+        }
+        throw std::runtime_error(std::string("FFmpeg execution failed: ") + e.what());
+    }
+
+    if (plan.emitProgress) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        Progress::emit(progressSink_, "encoding", "completed", 100.0, elapsed, 0.0, "Encoding complete");
+    }
+}
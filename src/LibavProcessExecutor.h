@@ -0,0 +1,12 @@
+#pragma once
+#include "SystemProcessExecutor.h"
+
+// Executor that renders RenderPlans in-process through libav* instead of
+// spawning the ffmpeg CLI. Ad-hoc commands (thumbnails, probes) still go
+// through the shell via SystemProcessExecutor.
+class LibavProcessExecutor : public SystemProcessExecutor {
+public:
+    using SystemProcessExecutor::SystemProcessExecutor;
+
+    void render(const Render::RenderPlan& plan, double totalDurationSeconds) override;
+};
@@ -4,10 +4,15 @@
 #include "cache_utils.h"
 #include "recitation_utils.h"
 #include "audio/custom_audio_processor.h"
+#include "audio/duration_manifest.h"
+#include "audio/mp3_slice.h"
+#include "data/verse_keys.h"
+#include "data/verse_text_index.h"
+#include "net/download_manager.h"
+#include "parallel_for.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <future>
 #include <nlohmann/json.hpp>
 #include <filesystem>
 #include <iomanip>
@@ -16,15 +21,20 @@
 #include <optional>
 #include <cstdlib>
 #include <limits>
+#include <cmath>
 #include <cctype>
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
+    fs::path gapped_cache_path(const std::string& verseKey, const AppConfig& config) {
+        return CacheUtils::getCacheRoot() / (verseKey + "_r" + std::to_string(config.reciterId) + "_t" + std::to_string(config.translationId) + "_gapped.json");
+    }
+
     // GAPPED MODE: Fetch individual ayah data
     VerseData fetch_single_verse_gapped(int surah, int verseNum, const AppConfig& config, bool useCache, const fs::path& audioDir) {
         std::string verseKey = std::to_string(surah) + ":" + std::to_string(verseNum);
-        fs::path cachePath = CacheUtils::getCacheRoot() / (verseKey + "_r" + std::to_string(config.reciterId) + "_t" + std::to_string(config.translationId) + "_gapped.json");
+        fs::path cachePath = gapped_cache_path(verseKey, config);
 
         if (useCache && fs::exists(cachePath)) {
             try {
@@ -53,13 +63,11 @@ using json = nlohmann::json;
             result.translation.clear();
         }
 
-        const json& audioData = CacheUtils::getReciterAudioData(config.reciterId);
-        auto verseAudioIt = audioData.find(verseKey);
-        if (verseAudioIt == audioData.end() || !verseAudioIt->is_object()) {
+        CacheUtils::ReciterAudioEntry verseAudio = CacheUtils::getReciterAudio(config.reciterId, verseKey);
+        if (!verseAudio.found) {
             throw std::runtime_error("Verse not found in audio JSON: " + verseKey);
         }
-        const auto& verseAudio = *verseAudioIt;
-        result.audioUrl = verseAudio.value("audio_url", "");
+        result.audioUrl = verseAudio.audioUrl;
         if (result.audioUrl.empty()) {
             throw std::runtime_error("Audio URL missing for verse " + verseKey);
         }
@@ -75,12 +83,8 @@ using json = nlohmann::json;
         result.localAudioPath = audioPath.string();
 
         result.durationInSeconds = Audio::CustomAudioProcessor::probeDuration(result.localAudioPath);
-        if (result.durationInSeconds <= 0.0 && verseAudio.contains("duration") && !verseAudio["duration"].is_null()) {
-            try {
-                result.durationInSeconds = verseAudio["duration"].get<double>();
-            } catch (...) {
-                // ignore if unparsable
-            }
+        if (result.durationInSeconds <= 0.0 && verseAudio.durationSeconds >= 0.0) {
+            result.durationInSeconds = verseAudio.durationSeconds;
         }
         if (result.durationInSeconds <= 0.0) {
             std::cerr << "\nWarning: Could not determine duration for " << verseKey << ".\n";
@@ -106,6 +110,30 @@ using json = nlohmann::json;
         return result;
     }
 
+    // GAPPED MODE: An ayah as the reciter metadata describes it, before its
+    // audio is fetched; empty when the metadata has no duration for it
+    std::optional<VerseData> plan_single_verse_gapped(int surah, int verseNum, const AppConfig& config) {
+        std::string verseKey = std::to_string(surah) + ":" + std::to_string(verseNum);
+        CacheUtils::ReciterAudioEntry verseAudio = CacheUtils::getReciterAudio(config.reciterId, verseKey);
+        if (!verseAudio.found || verseAudio.audioUrl.empty() || verseAudio.durationSeconds <= 0.0) {
+            return std::nullopt;
+        }
+
+        VerseData result;
+        result.verseKey = verseKey;
+        try {
+            result.translation = CacheUtils::getTranslationText(config.translationId, verseKey);
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: Could not load translation for " << verseKey << ": " << e.what() << std::endl;
+            result.translation.clear();
+        }
+        result.audioUrl = verseAudio.audioUrl;
+        result.durationInSeconds = verseAudio.durationSeconds;
+        result.timestampFromMs = 0;
+        result.timestampToMs = 0;
+        return result;
+    }
+
     // GAPLESS MODE: Fetch verse data with timing from surah audio or custom source
     std::vector<VerseData> fetch_verses_gapless(int surah,
                                                 int from,
@@ -198,18 +226,6 @@ using json = nlohmann::json;
                 throw std::runtime_error("Surah " + surahKey + " not found in surah.json");
 
             std::string audioUrl = surahData[surahKey]["audio_url"].get<std::string>();
-            
-            // Download the full surah audio
-            localAudioPath = (audioDir / ("surah_" + std::to_string(surah) + "_r" + std::to_string(config.reciterId) + ".mp3")).string();
-            
-            if (!useCache || !fs::exists(localAudioPath)) {
-                std::cout << "  - Downloading full surah audio from " << audioUrl << std::endl;
-                if (!CacheUtils::downloadFileWithRetry(audioUrl, localAudioPath)) {
-                    throw std::runtime_error("Failed to download surah audio from " + audioUrl);
-                }
-            } else {
-                std::cout << "  - Using cached surah audio" << std::endl;
-            }
 
             // Load segments (timing information)
             std::ifstream segmentsFile(segmentsJsonPath);
@@ -227,6 +243,43 @@ using json = nlohmann::json;
                     timings[verseKey] = entry;
                 }
             }
+
+            std::string surahLabel = "surah_" + std::to_string(surah) + "_r" + std::to_string(config.reciterId);
+            localAudioPath = (audioDir / (surahLabel + ".mp3")).string();
+            bool haveAudio = useCache && fs::exists(localAudioPath);
+            if (haveAudio) {
+                std::cout << "  - Using cached surah audio" << std::endl;
+            }
+
+            // Fetch only the frames covering the requested verses when the file allows it
+            if (!haveAudio && !timings.empty()) {
+                int windowStartMs = std::numeric_limits<int>::max();
+                int windowEndMs = 0;
+                for (const auto& [key, entry] : timings) {
+                    windowStartMs = std::min(windowStartMs, entry.startMs);
+                    windowEndMs = std::max(windowEndMs, entry.endMs);
+                }
+                // The seek index and slices are kept across renders unless caching is off
+                const fs::path sliceDir = useCache ? CacheUtils::getCacheRoot() / "audio" / "slices" : audioDir;
+                auto slice = Audio::fetchMp3Slice(audioUrl, sliceDir, surahLabel,
+                                                  windowStartMs / 1000.0, windowEndMs / 1000.0);
+                if (slice) {
+                    localAudioPath = slice->path;
+                    int shiftMs = static_cast<int>(std::lround(slice->startSeconds * 1000.0));
+                    for (auto& [key, entry] : timings) {
+                        entry.startMs -= shiftMs;
+                        entry.endMs -= shiftMs;
+                    }
+                    haveAudio = true;
+                }
+            }
+
+            if (!haveAudio) {
+                std::cout << "  - Downloading full surah audio from " << audioUrl << std::endl;
+                if (!CacheUtils::downloadFileWithRetry(audioUrl, localAudioPath)) {
+                    throw std::runtime_error("Failed to download surah audio from " + audioUrl);
+                }
+            }
         }
 
         // Align sequential timings with requested starting verse if possible
@@ -241,8 +294,6 @@ using json = nlohmann::json;
             }
         }
 
-        const json& translations = CacheUtils::getTranslationData(config.translationId);
-
         auto buildVerseFromTiming = [&](const TimingEntry& timing) {
             VerseData verse;
             std::string normalizedKey = timing.verseKey.rfind("SURAH:", 0) == 0
@@ -259,15 +310,7 @@ using json = nlohmann::json;
             verse.fromCustomAudio = !options.customAudioPath.empty();
             verse.sourceAudioPath = localAudioPath;
 
-            auto transIt = translations.find(normalizedKey);
-            if (transIt != translations.end() && transIt->is_object()) {
-                auto textIt = transIt->find("t");
-                verse.translation = (textIt != transIt->end() && textIt->is_string())
-                    ? textIt->get<std::string>()
-                    : "";
-            } else {
-                verse.translation = "";
-            }
+            verse.translation = CacheUtils::getTranslationText(config.translationId, normalizedKey);
             verse.text = "";
             return verse;
         };
@@ -354,11 +397,58 @@ void trim_last_word(std::string& s) {
     }
 }
 
+// Fill in the QPC Arabic text; a Bismillah opening another surah loses its
+// last word
+void fill_verse_text(std::vector<VerseData>& verses, const Data::VerseTextIndex& textIndex, const CLIOptions& options) {
+    for (auto& verse : verses) {
+        int surah = 0;
+        int verseNumber = 0;
+        if (!Data::parseVerseKey(verse.verseKey, surah, verseNumber)) continue;
+        std::string text = textIndex.verseText(surah, verseNumber);
+        if (!text.empty())
+            verse.text = text;
+    }
+
+    if (options.surah != 1 && options.surah != 9) {
+        if (!verses.empty() && !verses[0].text.empty()) {
+            trim_last_word(verses[0].text);
+        }
+    }
+}
+
+std::vector<VerseData> LiveApiClient::planQuranData(const CLIOptions& options, const AppConfig& config) {
+    // Gapless and custom audio take their timing from the audio they fetch
+    if (config.recitationMode == RecitationMode::GAPLESS || !options.customAudioPath.empty()) return {};
+
+    std::vector<VerseData> results;
+    bool downloads = options.noCache;
+    auto plan = [&](int surah, int verseNum) {
+        auto verse = plan_single_verse_gapped(surah, verseNum, config);
+        if (!verse) return false;
+        downloads = downloads || !fs::exists(gapped_cache_path(verse->verseKey, config));
+        results.push_back(std::move(*verse));
+        return true;
+    };
+    if (options.surah != 1 && options.surah != 9 && !plan(1, 1)) return {};
+    for (int verseNum = options.from; verseNum <= options.to; ++verseNum) {
+        if (!plan(options.surah, verseNum)) return {};
+    }
+    // Nothing to overlap when every verse is already cached
+    if (!downloads) return {};
+
+    try {
+        fill_verse_text(results, *Data::VerseTextIndex::forSource(config.quranWordByWordPath), options);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Could not load " << config.quranWordByWordPath << ": " << e.what() << "\n";
+        return {};
+    }
+    return results;
+}
+
 std::vector<VerseData> LiveApiClient::fetchQuranData(const CLIOptions& options, const AppConfig& config) {
     std::cout << "Fetching data for Surah " << options.surah << ", verses " << options.from << "-" << options.to << "..." << std::endl;
     
-    auto uniqueSuffix = std::chrono::steady_clock::now().time_since_epoch().count();
-    fs::path audioDir = fs::temp_directory_path() / ("quran_video_audio_" + std::to_string(uniqueSuffix));
+    fs::path audioDir = CacheUtils::uniqueTempPath("quran_video_audio_");
     std::error_code ec;
     fs::create_directories(audioDir, ec);
 
@@ -369,32 +459,31 @@ std::vector<VerseData> LiveApiClient::fetchQuranData(const CLIOptions& options,
     if (config.recitationMode == RecitationMode::GAPLESS) {
         results = fetch_verses_gapless(options.surah, options.from, options.to, config, !options.noCache, audioDir, options, &customBismillahTiming);
     } else {
-        // GAPPED mode - parallel fetch
-        std::vector<std::future<VerseData>> futures;
-        for (int i = options.from; i <= options.to; ++i) {
-            futures.push_back(std::async(std::launch::async, fetch_single_verse_gapped, options.surah, i, config, !options.noCache, audioDir));
+        // GAPPED mode - a bounded set of workers pulls verses in order; their
+        // downloads share the download manager's connection pool and host limits
+        const int verseCount = options.to - options.from + 1;
+        std::vector<std::optional<VerseData>> fetched(static_cast<size_t>(std::max(0, verseCount)));
+        Parallel::forEach(fetched.size(), static_cast<size_t>(std::max(1, Net::DownloadManager::shared().options().workers)),
+                          [&](size_t i) {
+                              const int verse = options.from + static_cast<int>(i);
+                              fetched[i] = fetch_single_verse_gapped(options.surah, verse, config, !options.noCache, audioDir);
+                          });
+        Audio::DurationManifest::shared().flush();
+
+        results.reserve(fetched.size());
+        for (auto& verse : fetched) {
+            results.push_back(std::move(*verse));
         }
-
-        results.reserve(futures.size());
-        for (auto& fut : futures) {
-            results.push_back(fut.get());
-        }
-        
-        std::sort(results.begin(), results.end(), [](const VerseData& a, const VerseData& b) {
-            int verseA = std::stoi(a.verseKey.substr(a.verseKey.find(':') + 1));
-            int verseB = std::stoi(b.verseKey.substr(b.verseKey.find(':') + 1));
-            return verseA < verseB;
-        });
     }
 
     // Load QPC Uthmani text for all verses
-    std::ifstream file(config.quranWordByWordPath);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open " << config.quranWordByWordPath << "\n";
+    std::shared_ptr<const Data::VerseTextIndex> textIndex;
+    try {
+        textIndex = Data::VerseTextIndex::forSource(config.quranWordByWordPath);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Could not load " << config.quranWordByWordPath << ": " << e.what() << "\n";
         return results;
     }
-    json quranData;
-    file >> quranData;
 
     // Add Bismillah if needed
     if (options.surah != 1 && options.surah != 9) {
@@ -412,34 +501,7 @@ std::vector<VerseData> LiveApiClient::fetchQuranData(const CLIOptions& options,
         }
     }
 
-    // Fill in QPC Arabic text
-    for (auto& verse : results) {
-        std::string keyPrefix = verse.verseKey + ":";
-        std::vector<std::pair<int, std::string>> words;
-        for (auto it = quranData.begin(); it != quranData.end(); ++it) {
-            if (it.key().rfind(keyPrefix, 0) == 0) {
-                auto parts = it.key().substr(keyPrefix.size());
-                int wordIndex = std::stoi(parts);
-                words.emplace_back(wordIndex, it.value().value("text", ""));
-            }
-        }
-        std::sort(words.begin(), words.end(),
-                [](auto& a, auto& b) { return a.first < b.first; });
-
-        std::string text;
-        for (auto& w : words)
-            text += w.second + " ";
-
-        if (!text.empty())
-            verse.text = text;
-    }
-
-    // Remove last word from Bismillah if it's not Surah 1 or 9
-    if (options.surah != 1 && options.surah != 9) {
-        if (!results.empty() && !results[0].text.empty()) {
-            trim_last_word(results[0].text);
-        }
-    }
+    fill_verse_text(results, *textIndex, options);
 
     bool hasCustomRange = config.recitationMode == RecitationMode::GAPLESS &&
                           !options.customAudioPath.empty();
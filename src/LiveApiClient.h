@@ -4,4 +4,5 @@
 class LiveApiClient : public Interfaces::IApiClient {
 public:
     std::vector<VerseData> fetchQuranData(const CLIOptions& options, const AppConfig& config) override;
+    std::vector<VerseData> planQuranData(const CLIOptions& options, const AppConfig& config) override;
 };
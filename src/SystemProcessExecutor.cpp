@@ -7,13 +7,21 @@
 #include <iomanip>
 #include <algorithm>
 #include <cctype>
+#include <functional>
+#include <utility>
 
 #if defined(_WIN32)
 #define QVM_POPEN _popen
 #define QVM_PCLOSE _pclose
 #else
-#define QVM_POPEN popen
-#define QVM_PCLOSE pclose
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
 #endif
 
 namespace {
@@ -31,24 +39,6 @@ std::string trim(const std::string& input) {
     return input.substr(start, end - start + 1);
 }
 
-void emitProgressEvent(const std::string& stage,
-                       const std::string& status,
-                       double percent = -1.0,
-                       double elapsedSeconds = -1.0,
-                       double etaSeconds = -1.0,
-                       const std::string& message = "") {
-    std::ostringstream oss;
-    oss.setf(std::ios::fixed);
-    oss << std::setprecision(2);
-    oss << "PROGRESS {\"stage\":\"" << stage << "\",\"status\":\"" << status << "\"";
-    if (percent >= 0.0) oss << ",\"percent\":" << percent;
-    if (elapsedSeconds >= 0.0) oss << ",\"elapsedSeconds\":" << elapsedSeconds;
-    if (etaSeconds >= 0.0) oss << ",\"etaSeconds\":" << etaSeconds;
-    if (!message.empty()) oss << ",\"message\":\"" << message << "\"";
-    oss << "}";
-    std::cout << oss.str() << std::endl;
-}
-
 double parseOutTimeValue(const std::string& value) {
     try {
         return std::stod(value) / 1000000.0;
@@ -57,40 +47,107 @@ double parseOutTimeValue(const std::string& value) {
     }
 }
 
+#if !defined(_WIN32)
+// Runs `command` through /bin/sh with its stdout split into lines for
+// `onLine`. The cancel flag is polled while waiting; raising it terminates
+// the command (exec'd in place of the shell, so the signal reaches it).
+int runShell(const std::string& command,
+             const std::function<void(const std::string&)>& onLine,
+             const std::atomic<bool>* cancel) {
+    // Close-on-exec, so the ffmpeg of a concurrent job does not hold this
+    // pipe open; adddup2 clears the flag on the child's stdout
+    int fds[2];
+#if defined(__linux__)
+    if (pipe2(fds, O_CLOEXEC) != 0) throw std::runtime_error("Failed to create pipe for FFmpeg");
+#else
+    if (pipe(fds) != 0) throw std::runtime_error("Failed to create pipe for FFmpeg");
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+    std::string script = "exec " + command;
+    char* argv[] = {const_cast<char*>("sh"), const_cast<char*>("-c"), const_cast<char*>(script.c_str()), nullptr};
+    pid_t pid = 0;
+    int spawnError = posix_spawn(&pid, "/bin/sh", &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (spawnError != 0) {
+        close(fds[0]);
+        throw std::runtime_error("Failed to start FFmpeg process");
+    }
+
+    bool cancelled = false;
+    std::string pending;
+    char buffer[512];
+    while (true) {
+        if (cancel && *cancel) {
+            kill(pid, SIGTERM);
+            cancelled = true;
+            break;
+        }
+        pollfd descriptor{fds[0], POLLIN, 0};
+        int ready = poll(&descriptor, 1, 200);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) break;
+        if (ready == 0) continue;
+        ssize_t count = read(fds[0], buffer, sizeof(buffer));
+        if (count <= 0) break;
+        pending.append(buffer, static_cast<size_t>(count));
+        size_t newline;
+        while ((newline = pending.find('\n')) != std::string::npos) {
+            onLine(pending.substr(0, newline));
+            pending.erase(0, newline + 1);
+        }
+    }
+    close(fds[0]);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    if (cancelled) throw Render::Cancelled();
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+#endif
+
 } // namespace
 
+SystemProcessExecutor::SystemProcessExecutor(Progress::Sink progressSink,
+                                             std::shared_ptr<const std::atomic<bool>> cancelRequested)
+    : progressSink_(std::move(progressSink)), cancelRequested_(std::move(cancelRequested)) {}
+
 int SystemProcessExecutor::execute(const std::string& command) {
+#if !defined(_WIN32)
+    if (cancelRequested_) {
+        return runShell(command, [](const std::string& line) { std::cout << line << '\n'; }, cancelRequested_.get());
+    }
+#endif
     return system(command.c_str());
 }
 
 void SystemProcessExecutor::executeWithProgress(const std::string& command, double totalDurationSeconds) {
     auto startTime = std::chrono::steady_clock::now();
-    emitProgressEvent("encoding", "running", 0.0, 0.0, -1.0, "FFmpeg started");
+    Progress::emit(progressSink_, "encoding", "running", 0.0, 0.0, -1.0, "FFmpeg started");
 
-    FILE* pipe = QVM_POPEN(command.c_str(), "r");
-    if (!pipe) {
-        emitProgressEvent("encoding", "failed", 0.0, 0.0, -1.0, "Failed to start FFmpeg");
-        throw std::runtime_error("Failed to start FFmpeg process");
-    }
-
-    char buffer[512];
     double lastOutSeconds = 0.0;
     double lastPercent = 0.0;
     bool sawProgress = false;
+    bool finished = false;
 
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-        std::string line = trim(buffer);
-        if (line.empty()) continue;
+    auto onLine = [&](const std::string& raw) {
+        if (finished) return;
+        std::string line = trim(raw);
+        if (line.empty()) return;
         auto delimiter = line.find('=');
-        if (delimiter == std::string::npos) continue;
+        if (delimiter == std::string::npos) return;
         std::string key = trim(line.substr(0, delimiter));
         std::string value = trim(line.substr(delimiter + 1));
 
         if (key == "out_time_ms") {
             lastOutSeconds = parseOutTimeValue(value);
-        } else if (key == "speed") {
-            // Parse speed for informational purposes if we want to expose it later.
-            continue;
         } else if (key == "progress") {
             sawProgress = true;
             auto now = std::chrono::steady_clock::now();
@@ -107,25 +164,47 @@ void SystemProcessExecutor::executeWithProgress(const std::string& command, doub
                 eta = 0.0;
             }
 
-            const bool finished = (value == "end");
-            emitProgressEvent("encoding",
-                              finished ? "completed" : "running",
-                              percent,
-                              elapsed,
-                              eta,
-                              finished ? "Encoding complete" : "Encoding in progress");
-            if (finished) break;
+            finished = (value == "end");
+            Progress::emit(progressSink_,
+                           "encoding",
+                           finished ? "completed" : "running",
+                           percent,
+                           elapsed,
+                           eta,
+                           finished ? "Encoding complete" : "Encoding in progress");
         }
-    }
+    };
 
-    int exitCode = QVM_PCLOSE(pipe);
+    int exitCode = 0;
+#if defined(_WIN32)
+    FILE* pipe = QVM_POPEN(command.c_str(), "r");
+    if (!pipe) {
+        Progress::emit(progressSink_, "encoding", "failed", 0.0, 0.0, -1.0, "Failed to start FFmpeg");
+        throw std::runtime_error("Failed to start FFmpeg process");
+    }
+    char buffer[512];
+    while (!finished && fgets(buffer, sizeof(buffer), pipe)) {
+        onLine(buffer);
+    }
+    exitCode = QVM_PCLOSE(pipe);
+#else
+    try {
+        exitCode = runShell(command, onLine, cancelRequested_.get());
+    } catch (const Render::Cancelled&) {
+        Progress::emit(progressSink_, "encoding", "cancelled", lastPercent, -1.0, -1.0, "Render cancelled");
+        throw;
+    } catch (const std::exception&) {
+        Progress::emit(progressSink_, "encoding", "failed", 0.0, 0.0, -1.0, "Failed to start FFmpeg");
+        throw;
+    }
+#endif
     if (exitCode != 0) {
-        emitProgressEvent("encoding", "failed", lastPercent, -1.0, -1.0, "FFmpeg exited with error");
+        Progress::emit(progressSink_, "encoding", "failed", lastPercent, -1.0, -1.0, "FFmpeg exited with error");
         throw std::runtime_error("FFmpeg execution failed");
     }
 
     if (!sawProgress) {
         double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
-        emitProgressEvent("encoding", "completed", 100.0, elapsed, 0.0, "Encoding complete");
+        Progress::emit(progressSink_, "encoding", "completed", 100.0, elapsed, 0.0, "Encoding complete");
     }
 }
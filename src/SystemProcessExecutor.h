@@ -1,8 +1,22 @@
 #pragma once
 #include "interfaces/IProcessExecutor.h"
+#include "progress.h"
+#include <atomic>
+#include <memory>
 
 class SystemProcessExecutor : public Interfaces::IProcessExecutor {
 public:
+    // Progress goes to `progressSink` (stdout when empty). Raising `cancelRequested`
+    // terminates the running command, which then throws Render::Cancelled.
+    explicit SystemProcessExecutor(Progress::Sink progressSink = {},
+                                   std::shared_ptr<const std::atomic<bool>> cancelRequested = {});
+
     int execute(const std::string& command) override;
     void executeWithProgress(const std::string& command, double totalDurationSeconds) override;
+
+protected:
+    bool cancelled() const { return cancelRequested_ && *cancelRequested_; }
+
+    Progress::Sink progressSink_;
+    std::shared_ptr<const std::atomic<bool>> cancelRequested_;
 };
@@ -1,4 +1,5 @@
 #include "audio/custom_audio_processor.h"
+#include "audio/duration_manifest.h"
 
 #include <algorithm>
 #include <chrono>
@@ -9,10 +10,6 @@
 #include <iostream>
 #include <sstream>
 
-extern "C" {
-#include <libavformat/avformat.h>
-}
-
 namespace fs = std::filesystem;
 
 namespace {
@@ -79,18 +76,10 @@ fs::path concat_audio_segments(const std::vector<std::string>& segments,
 namespace Audio {
 
 double CustomAudioProcessor::probeDuration(const std::string& filepath) {
-    AVFormatContext* format_context = nullptr;
-    if (avformat_open_input(&format_context, filepath.c_str(), nullptr, nullptr) != 0) {
-        std::cerr << "Warning: Could not open audio file " << filepath << " to get duration." << std::endl;
-        return 0.0;
-    }
-    if (avformat_find_stream_info(format_context, nullptr) < 0) {
-        std::cerr << "Warning: Could not find stream info for " << filepath << " to get duration." << std::endl;
-        avformat_close_input(&format_context);
-        return 0.0;
+    double duration = DurationManifest::shared().duration(filepath);
+    if (duration <= 0.0) {
+        std::cerr << "Warning: Could not determine the duration of " << filepath << "." << std::endl;
     }
-    double duration = static_cast<double>(format_context->duration) / AV_TIME_BASE;
-    avformat_close_input(&format_context);
     return duration;
 }
 
@@ -0,0 +1,157 @@
+#include "audio/duration_manifest.h"
+#include "audio/media_duration.h"
+#include "cache_utils.h"
+#include "data/pack_io.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+constexpr int kVersion = 1;
+
+std::string manifestKey(const fs::path& media) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(media, ec);
+    return (ec ? media : absolute).lexically_normal().string();
+}
+
+bool isUnder(const std::string& key, const fs::path& root) {
+    std::string prefix = manifestKey(root);
+    if (prefix.empty()) return false;
+    const char separator = static_cast<char>(fs::path::preferred_separator);
+    if (prefix.back() != separator) prefix += separator;
+    return key.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Per-run files (temp audio of --no-cache renders, custom audio splits) would
+// only grow the manifest; the cache itself may live in the temp directory.
+bool worthRecording(const std::string& key) {
+    std::error_code ec;
+    fs::path temp = fs::temp_directory_path(ec);
+    if (ec || !isUnder(key, temp)) return true;
+    return isUnder(key, CacheUtils::getCacheRoot());
+}
+
+// Entries from the manifest file; empty when it is missing, unreadable or from
+// another version.
+json readEntries(const fs::path& manifestPath) {
+    std::ifstream file(manifestPath);
+    if (!file.is_open()) return json::object();
+    json data = json::parse(file, nullptr, false);
+    if (data.is_discarded() || !data.is_object() || data.value("version", 0) != kVersion) {
+        return json::object();
+    }
+    auto entries = data.find("entries");
+    return entries != data.end() && entries->is_object() ? *entries : json::object();
+}
+
+} // namespace
+
+namespace Audio {
+
+DurationManifest::DurationManifest(fs::path manifestPath)
+    : manifestPath_(std::move(manifestPath)) {}
+
+DurationManifest& DurationManifest::shared() {
+    static DurationManifest manifest(CacheUtils::getCacheRoot() / "index" / "durations.json");
+    return manifest;
+}
+
+void DurationManifest::loadLocked() {
+    if (loaded_) return;
+    loaded_ = true;
+    const json stored = readEntries(manifestPath_);
+    for (const auto& [key, value] : stored.items()) {
+        if (!value.is_object()) continue;
+        Entry entry;
+        entry.size = value.value("size", std::uint64_t{0});
+        entry.mtime = value.value("mtime", std::int64_t{0});
+        entry.duration = value.value("duration", 0.0);
+        if (entry.duration > 0.0) entries_.emplace(key, entry);
+    }
+}
+
+double DurationManifest::duration(const fs::path& media) {
+    const std::string key = manifestKey(media);
+    Data::SourceStamp stamp;
+    try {
+        stamp = Data::stampOf(media);
+    } catch (const fs::filesystem_error&) {
+        return 0.0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loadLocked();
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.size == stamp.size && it->second.mtime == stamp.mtime) {
+            return it->second.duration;
+        }
+    }
+
+    double seconds = probeMediaDuration(media);
+    if (seconds > 0.0 && worthRecording(key)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[key] = Entry{stamp.size, stamp.mtime, seconds};
+        dirty_ = true;
+    }
+    return seconds;
+}
+
+std::vector<double> DurationManifest::durations(const std::vector<fs::path>& media, unsigned maxParallel) {
+    std::vector<double> results(media.size(), 0.0);
+    if (maxParallel == 0) maxParallel = std::max(1u, std::thread::hardware_concurrency());
+    const auto workerCount = static_cast<unsigned>(std::min<size_t>(maxParallel, media.size()));
+
+    std::atomic<size_t> nextIndex{0};
+    auto work = [&]() {
+        for (size_t i = nextIndex++; i < media.size(); i = nextIndex++) {
+            results[i] = duration(media[i]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < workerCount; ++w) workers.emplace_back(work);
+    work();
+    for (auto& worker : workers) worker.join();
+
+    flush();
+    return results;
+}
+
+void DurationManifest::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!dirty_) return;
+
+    // Merge with whatever other processes recorded since we loaded, dropping
+    // files that have been deleted since
+    json entries = readEntries(manifestPath_);
+    for (const auto& [key, entry] : entries_) {
+        entries[key] = {{"size", entry.size}, {"mtime", entry.mtime}, {"duration", entry.duration}};
+    }
+    for (auto it = entries.begin(); it != entries.end();) {
+        std::error_code ec;
+        if (fs::exists(it.key(), ec) || ec) {
+            ++it;
+        } else {
+            entries_.erase(it.key());
+            it = entries.erase(it);
+        }
+    }
+    json data = {{"version", kVersion}, {"entries", std::move(entries)}};
+    try {
+        Data::writeFileAtomically(manifestPath_, data.dump());
+        dirty_ = false;
+    } catch (const std::exception& e) {
+        std::cerr << "  ! Could not save duration manifest: " << e.what() << std::endl;
+    }
+}
+
+} // namespace Audio
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Audio {
+
+// Persistent record of media durations, stored as JSON in the cache:
+//
+//   {"version": 1, "entries": {"<absolute path>": {"size": ..., "mtime": ...,
+//                                                   "duration": ...}}}
+//
+// An entry is trusted only while the file's size and mtime still match, so
+// repeat renders get every duration without opening the media. Misses are
+// filled by probeMediaDuration() (container headers first, then libav).
+// Files in the system temp directory (outside the cache root) belong to one
+// run and are probed without being recorded; entries for files that no
+// longer exist are dropped on flush. Thread-safe; probing happens outside
+// the lock.
+class DurationManifest {
+public:
+    explicit DurationManifest(std::filesystem::path manifestPath);
+
+    // Process-wide manifest at <cache root>/index/durations.json.
+    static DurationManifest& shared();
+
+    // Duration in seconds, or 0.0 when it cannot be determined. New entries
+    // are kept in memory until flush().
+    double duration(const std::filesystem::path& media);
+
+    // Resolves every path, probing the misses on up to `maxParallel` threads
+    // (0 = hardware concurrency), then flushes. Results follow input order.
+    std::vector<double> durations(const std::vector<std::filesystem::path>& media, unsigned maxParallel = 0);
+
+    // Writes pending entries to disk (atomically), leaving out files that have
+    // gone. Failures are reported and otherwise ignored; the manifest is only
+    // a cache.
+    void flush();
+
+    const std::filesystem::path& path() const { return manifestPath_; }
+
+private:
+    struct Entry {
+        std::uint64_t size = 0;
+        std::int64_t mtime = 0;
+        double duration = 0.0;
+    };
+
+    void loadLocked();
+
+    std::filesystem::path manifestPath_;
+    std::mutex mutex_;
+    bool loaded_ = false;
+    bool dirty_ = false;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+} // namespace Audio
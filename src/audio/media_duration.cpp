@@ -0,0 +1,156 @@
+#include "audio/media_duration.h"
+#include "audio/mp3_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::size_t kMp3HeadBytes = 64 * 1024;
+
+std::uint64_t readBigEndian(const unsigned char* p, int bytes) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) value = (value << 8) | p[i];
+    return value;
+}
+
+struct BoxHeader {
+    char type[4];
+    std::uint64_t payload = 0;   // offset of the box contents
+    std::uint64_t end = 0;
+};
+
+// Reads the box header at `offset`; false at the end of `limit` or on a
+// malformed size.
+bool readBox(std::istream& in, std::uint64_t offset, std::uint64_t limit, BoxHeader& box) {
+    if (offset + 8 > limit) return false;
+    unsigned char raw[16];
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(offset));
+    if (!in.read(reinterpret_cast<char*>(raw), 8)) return false;
+    std::uint64_t size = readBigEndian(raw, 4);
+    std::memcpy(box.type, raw + 4, 4);
+    box.payload = offset + 8;
+    if (size == 1) {
+        if (!in.read(reinterpret_cast<char*>(raw + 8), 8)) return false;
+        size = readBigEndian(raw + 8, 8);
+        box.payload += 8;
+    } else if (size == 0) {
+        size = limit - offset;
+    }
+    if (size < box.payload - offset || offset + size > limit) return false;
+    box.end = offset + size;
+    return true;
+}
+
+bool looksLikeMp4(const unsigned char* head, std::size_t size) {
+    if (size < 8) return false;
+    for (const char* type : {"ftyp", "moov", "mdat", "free", "wide", "skip"}) {
+        if (std::memcmp(head + 4, type, 4) == 0) return true;
+    }
+    return false;
+}
+
+std::optional<double> mp3Duration(std::ifstream& in, std::uint64_t fileSize) {
+    std::string head(static_cast<std::size_t>(std::min<std::uint64_t>(fileSize, kMp3HeadBytes)), '\0');
+    in.clear();
+    in.seekg(0);
+    if (!in.read(&head[0], static_cast<std::streamsize>(head.size()))) return std::nullopt;
+
+    // A trailing ID3v1 tag is not audio.
+    std::uint64_t audioBytes = fileSize;
+    if (fileSize >= 128) {
+        char tag[3];
+        in.seekg(static_cast<std::streamoff>(fileSize - 128));
+        if (in.read(tag, 3) && std::memcmp(tag, "TAG", 3) == 0) audioBytes -= 128;
+    }
+    return Audio::mp3DurationFromHead(head, audioBytes);
+}
+
+double libavDuration(const fs::path& path) {
+    AVFormatContext* formatContext = nullptr;
+    if (avformat_open_input(&formatContext, path.string().c_str(), nullptr, nullptr) != 0) {
+        return 0.0;
+    }
+    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+        avformat_close_input(&formatContext);
+        return 0.0;
+    }
+    double duration = formatContext->duration == AV_NOPTS_VALUE
+        ? 0.0
+        : static_cast<double>(formatContext->duration) / AV_TIME_BASE;
+    avformat_close_input(&formatContext);
+    return duration;
+}
+
+} // namespace
+
+namespace Audio {
+
+std::optional<double> mp4Duration(std::istream& in, std::uint64_t fileSize) {
+    BoxHeader box;
+    for (std::uint64_t offset = 0; readBox(in, offset, fileSize, box); offset = box.end) {
+        if (std::memcmp(box.type, "moov", 4) != 0) continue;
+
+        const std::uint64_t moovEnd = box.end;
+        for (std::uint64_t child = box.payload; readBox(in, child, moovEnd, box); child = box.end) {
+            if (std::memcmp(box.type, "mvhd", 4) != 0) continue;
+
+            unsigned char body[32];
+            in.clear();
+            in.seekg(static_cast<std::streamoff>(box.payload));
+            if (!in.read(reinterpret_cast<char*>(body), 4)) return std::nullopt;
+            const bool wide = body[0] == 1;
+            const std::size_t bodyBytes = wide ? 28 : 16;  // times, timescale, duration
+            if (box.payload + 4 + bodyBytes > box.end ||
+                !in.read(reinterpret_cast<char*>(body + 4), static_cast<std::streamsize>(bodyBytes))) {
+                return std::nullopt;
+            }
+            const std::uint64_t timescale = readBigEndian(body + 4 + (wide ? 16 : 8), 4);
+            const std::uint64_t duration = wide ? readBigEndian(body + 24, 8) : readBigEndian(body + 16, 4);
+            const bool unknown = wide ? duration == ~0ULL : duration == 0xFFFFFFFFULL;
+            if (timescale == 0 || duration == 0 || unknown) return std::nullopt;
+            return static_cast<double>(duration) / static_cast<double>(timescale);
+        }
+        return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+std::optional<double> headerDuration(const fs::path& path) {
+    std::error_code ec;
+    const std::uint64_t fileSize = fs::file_size(path, ec);
+    if (ec || fileSize < 8) return std::nullopt;
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return std::nullopt;
+
+    unsigned char head[10] = {};
+    if (!in.read(reinterpret_cast<char*>(head), std::min<std::uint64_t>(fileSize, sizeof(head)))) {
+        return std::nullopt;
+    }
+    if (looksLikeMp4(head, sizeof(head))) {
+        return mp4Duration(in, fileSize);
+    }
+    if (std::memcmp(head, "ID3", 3) == 0 || parseMp3FrameHeader(head, sizeof(head))) {
+        return mp3Duration(in, fileSize);
+    }
+    return std::nullopt;
+}
+
+double probeMediaDuration(const fs::path& path) {
+    if (auto duration = headerDuration(path)) {
+        return *duration;
+    }
+    return libavDuration(path);
+}
+
+} // namespace Audio
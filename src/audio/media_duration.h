@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <optional>
+
+namespace Audio {
+
+// Duration from the movie header (`moov/mvhd`) of an ISO BMFF file (MP4, MOV,
+// M4A). Walks box headers only, so a `moov` placed after `mdat` costs a few
+// seeks. Returns nullopt when there is no usable header, e.g. fragmented files.
+std::optional<double> mp4Duration(std::istream& in, std::uint64_t fileSize);
+
+// Duration read from container headers alone: MP4 `mvhd`, or the MP3 frame
+// header with its Xing/Info, VBRI and LAME tags. No packets are decoded.
+std::optional<double> headerDuration(const std::filesystem::path& path);
+
+// headerDuration(), falling back to libavformat probing for other formats.
+// Returns 0.0 when the duration cannot be determined.
+double probeMediaDuration(const std::filesystem::path& path);
+
+} // namespace Audio
@@ -0,0 +1,239 @@
+#include "audio/mp3_index.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Bitrates in kbps by [version row][layer][index]; row 0 = MPEG-1, row 1 = MPEG-2/2.5.
+constexpr int kBitrates[2][3][15] = {
+    {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},  // Layer I
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},     // Layer II
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},      // Layer III
+    },
+    {
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+    },
+};
+
+constexpr int kSampleRates[3][3] = {
+    {44100, 48000, 32000},  // MPEG-1
+    {22050, 24000, 16000},  // MPEG-2
+    {11025, 12000, 8000},   // MPEG-2.5
+};
+
+constexpr int kDecoderDelay = 529;
+
+std::uint32_t readBigEndian32(const unsigned char* p) {
+    return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) |
+           (static_cast<std::uint32_t>(p[2]) << 8) | static_cast<std::uint32_t>(p[3]);
+}
+
+std::size_t id3v2Size(const unsigned char* data, std::size_t size) {
+    if (size < 10 || std::memcmp(data, "ID3", 3) != 0) return 0;
+    std::size_t tagSize = (static_cast<std::size_t>(data[6] & 0x7F) << 21) |
+                          (static_cast<std::size_t>(data[7] & 0x7F) << 14) |
+                          (static_cast<std::size_t>(data[8] & 0x7F) << 7) |
+                          static_cast<std::size_t>(data[9] & 0x7F);
+    const bool hasFooter = (data[5] & 0x10) != 0;
+    return 10 + tagSize + (hasFooter ? 10 : 0);
+}
+
+// First frame header after the ID3v2 tag that is followed by another frame,
+// skipping stray bytes in between; sets `pos` to its offset.
+std::optional<Audio::Mp3FrameHeader> findFirstFrame(const unsigned char* data, std::size_t size, std::size_t& pos) {
+    for (pos = id3v2Size(data, size); pos + 4 <= size; ++pos) {
+        auto header = Audio::parseMp3FrameHeader(data + pos, size - pos);
+        if (header && pos + header->frameBytes + 4 <= size &&
+            Audio::parseMp3FrameHeader(data + pos + header->frameBytes, size - pos - header->frameBytes)) {
+            return header;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+namespace Audio {
+
+std::optional<Mp3FrameHeader> parseMp3FrameHeader(const unsigned char* data, std::size_t size) {
+    if (size < 4 || data[0] != 0xFF || (data[1] & 0xE0) != 0xE0) return std::nullopt;
+    const int versionBits = (data[1] >> 3) & 0x03;
+    const int layerBits = (data[1] >> 1) & 0x03;
+    const int bitrateIndex = (data[2] >> 4) & 0x0F;
+    const int sampleRateIndex = (data[2] >> 2) & 0x03;
+    if (versionBits == 1 || layerBits == 0 || bitrateIndex == 0 || bitrateIndex == 15 || sampleRateIndex == 3) {
+        return std::nullopt;
+    }
+
+    const bool mpeg1 = versionBits == 3;
+    const int layer = 4 - layerBits;  // 1, 2 or 3
+    const int rateRow = mpeg1 ? 0 : (versionBits == 2 ? 1 : 2);
+    const bool mono = ((data[3] >> 6) & 0x03) == 3;
+
+    Mp3FrameHeader header;
+    header.bitrateKbps = kBitrates[mpeg1 ? 0 : 1][layer - 1][bitrateIndex];
+    header.sampleRate = kSampleRates[rateRow][sampleRateIndex];
+    header.padding = ((data[2] >> 1) & 0x01) != 0;
+    if (layer == 1) {
+        header.samplesPerFrame = 384;
+        header.frameBytes = (12 * header.bitrateKbps * 1000 / header.sampleRate + (header.padding ? 1 : 0)) * 4;
+    } else {
+        header.samplesPerFrame = (layer == 3 && !mpeg1) ? 576 : 1152;
+        header.frameBytes = header.samplesPerFrame / 8 * header.bitrateKbps * 1000 / header.sampleRate +
+                            (header.padding ? 1 : 0);
+    }
+    if (layer == 3) {
+        header.sideInfoBytes = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    }
+    return header.frameBytes > 4 ? std::optional<Mp3FrameHeader>(header) : std::nullopt;
+}
+
+std::int64_t Mp3SeekIndex::frameAt(double seconds) const {
+    double samples = seconds * sampleRate + skipSamples;
+    if (samples <= 0.0) return 0;
+    return static_cast<std::int64_t>(std::floor(samples / samplesPerFrame));
+}
+
+std::int64_t Mp3SeekIndex::frameOffset(std::int64_t frame) const {
+    return audioStart + static_cast<std::int64_t>(std::floor(frame * frameBytes));
+}
+
+double Mp3SeekIndex::frameStartSeconds(std::int64_t frame) const {
+    return (static_cast<double>(frame) * samplesPerFrame - skipSamples) / sampleRate;
+}
+
+nlohmann::json Mp3SeekIndex::toJson() const {
+    return {
+        {"audioStart", audioStart},
+        {"sampleRate", sampleRate},
+        {"samplesPerFrame", samplesPerFrame},
+        {"bitrateKbps", bitrateKbps},
+        {"frameBytes", frameBytes},
+        {"skipSamples", skipSamples},
+    };
+}
+
+std::optional<Mp3SeekIndex> Mp3SeekIndex::fromJson(const nlohmann::json& data) {
+    try {
+        Mp3SeekIndex index;
+        index.audioStart = data.at("audioStart").get<std::int64_t>();
+        index.sampleRate = data.at("sampleRate").get<int>();
+        index.samplesPerFrame = data.at("samplesPerFrame").get<int>();
+        index.bitrateKbps = data.at("bitrateKbps").get<int>();
+        index.frameBytes = data.at("frameBytes").get<double>();
+        index.skipSamples = data.value("skipSamples", 0);
+        if (index.sampleRate <= 0 || index.samplesPerFrame <= 0 || index.frameBytes <= 0.0) return std::nullopt;
+        return index;
+    } catch (const nlohmann::json::exception&) {
+        return std::nullopt;
+    }
+}
+
+std::optional<Mp3SeekIndex> buildMp3SeekIndex(const std::string& head) {
+    const auto* data = reinterpret_cast<const unsigned char*>(head.data());
+    const std::size_t size = head.size();
+    std::size_t pos = 0;
+    std::optional<Mp3FrameHeader> first = findFirstFrame(data, size, pos);
+    if (!first) return std::nullopt;
+
+    Mp3SeekIndex index;
+    index.audioStart = static_cast<std::int64_t>(pos);
+    index.sampleRate = first->sampleRate;
+    index.samplesPerFrame = first->samplesPerFrame;
+    index.bitrateKbps = first->bitrateKbps;
+
+    // A Xing/Info tag lives in the side-info gap of a silent first frame.
+    const std::size_t tagPos = pos + 4 + static_cast<std::size_t>(first->sideInfoBytes);
+    if (first->sideInfoBytes > 0 && tagPos + 8 <= size) {
+        const bool vbrTag = std::memcmp(data + tagPos, "Xing", 4) == 0;
+        const bool cbrTag = std::memcmp(data + tagPos, "Info", 4) == 0;
+        if (vbrTag) return std::nullopt;
+        if (cbrTag) {
+            const std::uint32_t flags = readBigEndian32(data + tagPos + 4);
+            std::size_t lamePos = tagPos + 8;
+            if (flags & 0x1) lamePos += 4;    // frame count
+            if (flags & 0x2) lamePos += 4;    // byte count
+            if (flags & 0x4) lamePos += 100;  // TOC
+            if (flags & 0x8) lamePos += 4;    // quality
+            if (lamePos + 24 <= size &&
+                (std::memcmp(data + lamePos, "LAME", 4) == 0 || std::memcmp(data + lamePos, "Lavc", 4) == 0)) {
+                const int encoderDelay = (data[lamePos + 21] << 4) | (data[lamePos + 22] >> 4);
+                index.skipSamples = encoderDelay + kDecoderDelay;
+            }
+            index.audioStart = static_cast<std::int64_t>(pos + first->frameBytes);
+        }
+    }
+    if (pos + 40 <= size && std::memcmp(data + pos + 36, "VBRI", 4) == 0) {
+        return std::nullopt;
+    }
+
+    // Without an Info tag the bitrate must hold across every frame we can see.
+    std::size_t cursor = static_cast<std::size_t>(index.audioStart);
+    int checked = 0;
+    while (cursor + 4 <= size) {
+        auto header = parseMp3FrameHeader(data + cursor, size - cursor);
+        if (!header) break;
+        if (header->bitrateKbps != index.bitrateKbps || header->sampleRate != index.sampleRate) {
+            return std::nullopt;
+        }
+        cursor += static_cast<std::size_t>(header->frameBytes);
+        ++checked;
+    }
+    if (checked == 0) return std::nullopt;
+
+    index.frameBytes = index.samplesPerFrame == 384
+        ? 48.0 * index.bitrateKbps * 1000.0 / index.sampleRate
+        : index.samplesPerFrame / 8.0 * index.bitrateKbps * 1000.0 / index.sampleRate;
+    return index;
+}
+
+std::optional<double> mp3DurationFromHead(const std::string& head, std::uint64_t audioBytes) {
+    const auto* data = reinterpret_cast<const unsigned char*>(head.data());
+    const std::size_t size = head.size();
+    std::size_t pos = 0;
+    std::optional<Mp3FrameHeader> first = findFirstFrame(data, size, pos);
+    if (!first) return std::nullopt;
+    const double secondsPerFrame = static_cast<double>(first->samplesPerFrame) / first->sampleRate;
+
+    const std::size_t tagPos = pos + 4 + static_cast<std::size_t>(first->sideInfoBytes);
+    if (first->sideInfoBytes > 0 && tagPos + 12 <= size &&
+        (std::memcmp(data + tagPos, "Xing", 4) == 0 || std::memcmp(data + tagPos, "Info", 4) == 0)) {
+        const std::uint32_t flags = readBigEndian32(data + tagPos + 4);
+        if (flags & 0x1) {
+            const std::uint32_t frames = readBigEndian32(data + tagPos + 8);
+            if (frames > 0) return frames * secondsPerFrame;
+        }
+    }
+    if (pos + 36 + 18 <= size && std::memcmp(data + pos + 36, "VBRI", 4) == 0) {
+        const std::uint32_t frames = readBigEndian32(data + pos + 36 + 14);
+        if (frames > 0) return frames * secondsPerFrame;
+    }
+
+    if (audioBytes <= pos) return std::nullopt;
+    return static_cast<double>(audioBytes - pos) * 8.0 / (first->bitrateKbps * 1000.0);
+}
+
+std::size_t findMp3FrameSync(const std::string& bytes, std::size_t from, const Mp3SeekIndex& index) {
+    const auto* data = reinterpret_cast<const unsigned char*>(bytes.data());
+    const std::size_t size = bytes.size();
+    auto matches = [&](std::size_t at) -> std::optional<Mp3FrameHeader> {
+        auto header = parseMp3FrameHeader(data + at, size - at);
+        if (!header || header->sampleRate != index.sampleRate || header->bitrateKbps != index.bitrateKbps) {
+            return std::nullopt;
+        }
+        return header;
+    };
+    for (std::size_t pos = from; pos + 4 <= size; ++pos) {
+        auto header = matches(pos);
+        if (!header) continue;
+        const std::size_t next = pos + static_cast<std::size_t>(header->frameBytes);
+        if (next + 4 > size || matches(next)) return pos;
+    }
+    return std::string::npos;
+}
+
+} // namespace Audio
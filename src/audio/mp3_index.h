@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace Audio {
+
+struct Mp3FrameHeader {
+    int bitrateKbps = 0;
+    int sampleRate = 0;
+    int samplesPerFrame = 0;
+    int sideInfoBytes = 0;   // Layer III side info, locates Xing/Info tags
+    bool padding = false;
+    int frameBytes = 0;
+};
+
+// Decodes the 4-byte MPEG audio frame header at `data`, rejecting free-format
+// and reserved values.
+std::optional<Mp3FrameHeader> parseMp3FrameHeader(const unsigned char* data, std::size_t size);
+
+// Seek index for a constant-bitrate MP3, derived from its first few KB.
+// With a constant bitrate, frame k starts within one byte of
+// audioStart + k * frameBytes, so a time maps to an exact frame and byte
+// offset without reading the rest of the file.
+struct Mp3SeekIndex {
+    std::int64_t audioStart = 0;  // first audio frame, after ID3v2 and any Info frame
+    int sampleRate = 0;
+    int samplesPerFrame = 0;
+    int bitrateKbps = 0;
+    double frameBytes = 0.0;      // average frame size including padding
+    int skipSamples = 0;          // samples decoders drop at the start (LAME/Lavc delay + 529)
+
+    std::int64_t frameAt(double seconds) const;
+    std::int64_t frameOffset(std::int64_t frame) const;
+    // Position of the frame's first sample on the timeline of the full decoded file.
+    double frameStartSeconds(std::int64_t frame) const;
+
+    nlohmann::json toJson() const;
+    static std::optional<Mp3SeekIndex> fromJson(const nlohmann::json& data);
+};
+
+// Builds an index from the head of a file (ID3v2, first frame, Xing/Info and
+// LAME tags, and the frames that follow). Returns nullopt for VBR files and
+// anything else whose frame positions cannot be computed.
+std::optional<Mp3SeekIndex> buildMp3SeekIndex(const std::string& head);
+
+// Duration of a whole MP3 given its head and the size of everything from the
+// start of the file up to any trailing ID3v1 tag: exact from a Xing/Info or
+// VBRI frame count, otherwise estimated from the first frame's bitrate (as
+// libavformat does). Returns nullopt when no frame is found.
+std::optional<double> mp3DurationFromHead(const std::string& head, std::uint64_t audioBytes);
+
+// Offset of the first frame header at or after `from` whose sample rate and
+// bitrate match the index and which is followed by another such header (or by
+// the end of the buffer). Returns std::string::npos when none is found.
+std::size_t findMp3FrameSync(const std::string& bytes, std::size_t from, const Mp3SeekIndex& index);
+
+} // namespace Audio
@@ -0,0 +1,149 @@
+#include "audio/mp3_slice.h"
+#include "audio/mp3_index.h"
+#include "data/pack_io.h"
+#include "net/download_manager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <system_error>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+constexpr std::int64_t kHeadBytes = 64 * 1024;
+
+std::optional<std::string> readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return std::nullopt;
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+std::optional<json> readJson(const fs::path& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) return std::nullopt;
+    try {
+        return json::parse(in);
+    } catch (const json::exception&) {
+        return std::nullopt;
+    }
+}
+
+// Cached seek index for url; a cached "seekable": false avoids re-probing
+// files we already know cannot be sliced.
+std::optional<Audio::Mp3SeekIndex> loadSeekIndex(const std::string& url, const fs::path& workDir, const std::string& label) {
+    const fs::path indexPath = workDir / (label + ".mp3index.json");
+    if (auto cached = readJson(indexPath); cached && cached->value("url", "") == url) {
+        if (!cached->value("seekable", false)) return std::nullopt;
+        return Audio::Mp3SeekIndex::fromJson(cached->value("index", json::object()));
+    }
+
+    const fs::path headPath = workDir / (label + ".head");
+    bool fetched = Net::DownloadManager::shared()
+        .enqueueRange(url, headPath, 0, kHeadBytes - 1, Net::Priority::High)
+        .get();
+    std::optional<Audio::Mp3SeekIndex> index;
+    if (fetched) {
+        if (auto head = readFile(headPath)) index = Audio::buildMp3SeekIndex(*head);
+    }
+    std::error_code ec;
+    fs::remove(headPath, ec);
+
+    json record = {{"url", url}, {"seekable", index.has_value()}};
+    if (index) record["index"] = index->toJson();
+    try {
+        Data::writeFileAtomically(indexPath, record.dump(2));
+    } catch (const std::exception&) {
+        // Caching the index is an optimisation only.
+    }
+    return index;
+}
+
+} // namespace
+
+namespace Audio {
+
+std::optional<AudioSlice> fetchMp3Slice(const std::string& url,
+                                        const fs::path& workDir,
+                                        const std::string& label,
+                                        double startSeconds,
+                                        double endSeconds,
+                                        double marginSeconds) {
+    if (endSeconds <= startSeconds) return std::nullopt;
+    std::error_code ec;
+    fs::create_directories(workDir, ec);
+
+    const std::string sliceName = label + "_" + std::to_string(static_cast<long long>(std::llround(startSeconds * 1000))) +
+                                  "-" + std::to_string(static_cast<long long>(std::llround(endSeconds * 1000)));
+    const fs::path slicePath = workDir / (sliceName + ".mp3");
+    const fs::path sliceInfoPath = workDir / (sliceName + ".json");
+    if (auto info = readJson(sliceInfoPath); info && info->value("url", "") == url && fs::exists(slicePath, ec)) {
+        return AudioSlice{slicePath.string(), info->value("startSeconds", 0.0)};
+    }
+
+    auto index = loadSeekIndex(url, workDir, label);
+    if (!index) return std::nullopt;
+
+    const std::int64_t firstFrame = index->frameAt(std::max(0.0, startSeconds - marginSeconds));
+    const std::int64_t lastFrame = index->frameAt(endSeconds + marginSeconds) + 1;
+    // A couple of bytes of slack either side absorbs the padding-bit jitter in
+    // CBR frame positions; the frame sync below finds the true boundary.
+    const std::int64_t slack = static_cast<std::int64_t>(std::ceil(index->frameBytes)) + 2;
+    const std::int64_t firstByte = firstFrame == 0 ? index->audioStart
+                                                   : std::max(index->audioStart, index->frameOffset(firstFrame) - slack);
+    const std::int64_t lastByte = index->frameOffset(lastFrame + 1) + slack;
+
+    const fs::path rangePath = workDir / (sliceName + ".range");
+    if (!Net::DownloadManager::shared().enqueueRange(url, rangePath, firstByte, lastByte, Net::Priority::High).get()) {
+        return std::nullopt;
+    }
+    auto bytes = readFile(rangePath);
+    fs::remove(rangePath, ec);
+    if (!bytes) return std::nullopt;
+
+    const std::size_t sync = findMp3FrameSync(*bytes, 0, *index);
+    if (sync == std::string::npos) return std::nullopt;
+    const double framePosition = (static_cast<double>(firstByte + static_cast<std::int64_t>(sync)) - index->audioStart) /
+                                 index->frameBytes;
+    const std::int64_t syncFrame = std::llround(framePosition);
+    if (std::abs(framePosition - static_cast<double>(syncFrame)) > 0.05) {
+        // Frame positions do not follow the CBR grid; the index cannot be trusted.
+        return std::nullopt;
+    }
+
+    // Keep whole frames only, up to the last one covering the window.
+    const auto* data = reinterpret_cast<const unsigned char*>(bytes->data());
+    std::size_t cursor = sync;
+    std::int64_t frame = syncFrame;
+    while (cursor + 4 <= bytes->size() && frame <= lastFrame) {
+        auto header = parseMp3FrameHeader(data + cursor, bytes->size() - cursor);
+        if (!header || header->bitrateKbps != index->bitrateKbps || header->sampleRate != index->sampleRate) break;
+        if (cursor + static_cast<std::size_t>(header->frameBytes) > bytes->size()) break;
+        cursor += static_cast<std::size_t>(header->frameBytes);
+        ++frame;
+    }
+    const double sliceStart = index->frameStartSeconds(syncFrame);
+    const double sliceEnd = index->frameStartSeconds(frame);
+    if (sliceStart > startSeconds || sliceEnd < endSeconds) {
+        // The server ended the range early or the stream changed format.
+        return std::nullopt;
+    }
+
+    try {
+        Data::writeFileAtomically(slicePath, bytes->substr(sync, cursor - sync));
+        Data::writeFileAtomically(sliceInfoPath, json{{"url", url}, {"startSeconds", sliceStart}}.dump(2));
+    } catch (const std::exception& e) {
+        std::cerr << "  ! Could not store audio slice: " << e.what() << std::endl;
+        return std::nullopt;
+    }
+    std::cout << "  - Fetched " << (cursor - sync) / 1024 << " KB audio slice ("
+              << sliceStart << "s-" << sliceEnd << "s) instead of the full file" << std::endl;
+    return AudioSlice{slicePath.string(), sliceStart};
+}
+
+} // namespace Audio
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace Audio {
+
+struct AudioSlice {
+    std::string path;
+    // Where the slice's first decoded sample sits on the timeline of the full
+    // file; subtract it from full-file timestamps to address the slice.
+    double startSeconds = 0.0;
+};
+
+// Produces a standalone MP3 holding only the frames of a remote file that
+// cover [startSeconds - marginSeconds, endSeconds + marginSeconds], fetched
+// with HTTP Range requests. The file's seek index (built from its first 64 KB)
+// and the slice are cached in workDir under `label`. Returns nullopt when the
+// file is not a constant-bitrate MP3 or the server does not honour ranges;
+// callers then download the whole file.
+std::optional<AudioSlice> fetchMp3Slice(const std::string& url,
+                                        const std::filesystem::path& workDir,
+                                        const std::string& label,
+                                        double startSeconds,
+                                        double endSeconds,
+                                        double marginSeconds = 1.0);
+
+} // namespace Audio
@@ -0,0 +1,140 @@
+#include "background_plate.h"
+#include "audio/custom_audio_processor.h"
+#include "cache_utils.h"
+#include "data/file_digests.h"
+#include "data/sha256.h"
+#include "interfaces/IProcessExecutor.h"
+#include "render/render_plan.h"
+#include "render_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+// Bump when plate encoding changes in a way the key inputs do not capture.
+constexpr int kFormatVersion = 1;
+
+// Plates are decoded by every render that uses them, so they are kept close
+// to lossless and are never the visible generation loss.
+constexpr int kPlateCrf = 12;
+
+double plateFps(const AppConfig& config) {
+    return config.fps > 0 ? config.fps : 30.0;
+}
+
+// One lock per plate key, so concurrent renders of a batch encode it once
+std::shared_ptr<std::mutex> plateLock(const std::string& key) {
+    static std::mutex registryMutex;
+    static std::map<std::string, std::shared_ptr<std::mutex>> locks;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& entry = locks[key];
+    if (!entry) entry = std::make_shared<std::mutex>();
+    return entry;
+}
+
+} // namespace
+
+namespace BackgroundPlate {
+
+std::string overlayFilter(const AppConfig& config) {
+    size_t atPos = config.overlayColor.find('@');
+    if (atPos != std::string::npos) {
+        try {
+            if (std::stod(config.overlayColor.substr(atPos + 1)) <= 0.0) return "";
+        } catch (...) {}
+    }
+    return ",drawbox=x=0:y=0:w=iw:h=ih:color=" + config.overlayColor + ":t=fill";
+}
+
+std::string plateKey(const AppConfig& config) {
+    std::string source = Data::FileDigests::shared().digest(config.assetBgVideo);
+    if (source.empty()) throw std::runtime_error("Background video not found: " + config.assetBgVideo);
+
+    json inputs;
+    inputs["format"] = kFormatVersion;
+    inputs["ffmpeg"] = RenderCache::describeBinaries().value("ffmpeg", json());
+    inputs["source"] = source;
+    inputs["width"] = config.width;
+    inputs["height"] = config.height;
+    inputs["fps"] = plateFps(config);
+    inputs["pixelFormat"] = config.pixelFormat;
+    inputs["overlay"] = overlayFilter(config);
+    inputs["crf"] = kPlateCrf;
+    return Data::sha256Hex(inputs.dump());
+}
+
+fs::path platePath(const std::string& key) {
+    return CacheUtils::getCacheRoot() / "plates" / key.substr(0, 2) / (key + ".mp4");
+}
+
+fs::path ensurePlate(const CLIOptions& options,
+                     const AppConfig& config,
+                     Interfaces::IProcessExecutor& processExecutor) {
+    const std::string key = plateKey(config);
+    Data::FileDigests::shared().flush();
+    const fs::path path = platePath(key);
+
+    auto keyLock = plateLock(key);
+    std::lock_guard<std::mutex> lock(*keyLock);
+    std::error_code ec;
+    if (fs::is_regular_file(path, ec)) return path;
+
+    double duration = Audio::CustomAudioProcessor::probeDuration(config.assetBgVideo);
+    if (duration <= 0.0) throw std::runtime_error("Could not read the duration of " + config.assetBgVideo);
+
+    const double fps = plateFps(config);
+    std::cout << "Building background plate " << config.width << "x" << config.height << " @ " << fps
+              << " fps (" << key.substr(0, 12) << ")" << std::endl;
+
+    Render::RenderPlan plan;
+    plan.filterThreads = options.resources.filterThreads;
+    Render::InputSpec input;
+    input.path = config.assetBgVideo;
+    plan.inputs.push_back(input);
+    std::ostringstream filter;
+    filter << "[0:v]setpts=PTS-STARTPTS,fps=" << fps << ",scale=" << config.width << ":" << config.height
+           << overlayFilter(config) << "[v]";
+    plan.filterComplex = filter.str();
+
+    // Short closed GOPs keep the seeks into the looped plate cheap
+    fs::create_directories(path.parent_path());
+    auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    fs::path partial = path.parent_path() / (key + ".partial-" + std::to_string(stamp) + ".mp4");
+    Render::OutputSpec output;
+    output.path = partial.string();
+    output.maps = {"[v]"};
+    output.durationSeconds = duration;
+    output.encoder.preset = "medium";
+    output.encoder.crf = kPlateCrf;
+    output.encoder.closedGop = true;
+    output.encoder.keyframeInterval = std::max(1, static_cast<int>(std::lround(fps)));
+    output.encoder.audioCodec.clear();
+    output.encoder.pixelFormat = config.pixelFormat;
+    output.encoder.threads = options.resources.encoderThreads;
+    plan.outputs.push_back(output);
+
+    // Encode next to the final name and rename, so the cache never holds a partial plate
+    try {
+        processExecutor.render(plan, duration);
+        fs::rename(partial, path);
+    } catch (...) {
+        fs::remove(partial, ec);
+        throw;
+    }
+    return path;
+}
+
+} // namespace BackgroundPlate
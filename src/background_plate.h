@@ -0,0 +1,38 @@
+#pragma once
+
+#include "types.h"
+
+#include <filesystem>
+#include <string>
+
+namespace Interfaces {
+    class IProcessExecutor;
+}
+
+// Cached copy of the static background video already at the output size,
+// frame rate and pixel format, with the dimming overlay drawn in. Renders
+// that loop the plate only decode it and burn in subtitles, instead of
+// scaling and dimming every frame of the source again; every job of a batch
+// or server at the same resolution shares one plate.
+//
+// Plates live under <cache root>/plates/<key[0..2]>/<key>.mp4.
+namespace BackgroundPlate {
+
+// The drawbox filter (with its leading comma) dimming the frame with
+// config.overlayColor, or "" when the colour is fully transparent.
+std::string overlayFilter(const AppConfig& config);
+
+// Key of the plate for config.assetBgVideo: the source's contents, the
+// output size, frame rate, pixel format and overlay, and the ffmpeg binary.
+// Throws std::runtime_error when the background video cannot be read.
+std::string plateKey(const AppConfig& config);
+
+std::filesystem::path platePath(const std::string& key);
+
+// Path of the plate, encoding it first when the cache does not hold it yet.
+// Callers asking for the same plate at once wait for a single encode.
+std::filesystem::path ensurePlate(const CLIOptions& options,
+                                  const AppConfig& config,
+                                  Interfaces::IProcessExecutor& processExecutor);
+
+} // namespace BackgroundPlate
@@ -1,40 +1,112 @@
 #include "background_video_manager.h"
 #include "r2_client.h"
 #include "cache_utils.h"
+#include "audio/duration_manifest.h"
+#include "net/download_manager.h"
+#include "parallel_for.h"
 #include <iostream>
 #include <chrono>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <cmath>
+#include <iomanip>
+#include <mutex>
 
-extern "C" {
-#include <libavformat/avformat.h>
+namespace fs = std::filesystem;
+
+namespace {
+
+struct SharedR2 {
+    std::shared_ptr<R2::Client> client;
+    std::map<std::string, std::vector<std::string>> themeListings;
+};
+
+std::mutex sharedR2Mutex;
+std::map<std::string, SharedR2> sharedR2;
+
+std::string r2ClientKey(const VideoSelectionConfig& selection) {
+    return selection.r2Endpoint + "\n" + selection.r2Bucket + "\n" + selection.r2AccessKey + "\n" +
+           (selection.usePublicBucket ? "public" : "private");
 }
 
-namespace fs = std::filesystem;
+// Listings are remembered with their client: videos are added to the bucket
+// between runs, not during one. Empty (possibly failed) listings are retried.
+std::vector<std::string> listR2Theme(R2::Client* client, const std::string& theme) {
+    {
+        std::lock_guard<std::mutex> lock(sharedR2Mutex);
+        for (const auto& [key, shared] : sharedR2) {
+            if (shared.client.get() != client) continue;
+            auto it = shared.themeListings.find(theme);
+            if (it != shared.themeListings.end()) return it->second;
+        }
+    }
+    std::vector<std::string> videos = client->listVideosInTheme(theme);
+    if (!videos.empty()) {
+        std::lock_guard<std::mutex> lock(sharedR2Mutex);
+        for (auto& [key, shared] : sharedR2) {
+            if (shared.client.get() == client) shared.themeListings[theme] = videos;
+        }
+    }
+    return videos;
+}
+
+} // namespace
 
 namespace BackgroundVideo {
 
+void releaseR2Clients() {
+    std::lock_guard<std::mutex> lock(sharedR2Mutex);
+    sharedR2.clear();
+}
+
+std::vector<std::string> planDownloads(VideoSelector::Selector& selector,
+                                       const std::vector<VideoSelector::VerseRangeSegment>& ranges,
+                                       const std::map<std::string, double>& rangeEndTimes,
+                                       double totalDurationSeconds,
+                                       VideoSelector::SelectionState state,
+                                       const std::function<double(const std::string&)>& cachedDuration,
+                                       double estimate) {
+    std::vector<std::string> keys;
+    std::set<std::string> planned;
+    double currentTime = 0.0;
+    int maxSegments = std::max(500, static_cast<int>(totalDurationSeconds / 5.0));
+    for (int segmentCount = 0; currentTime < totalDurationSeconds && segmentCount < maxSegments; ++segmentCount) {
+        const auto* range = selector.getRangeForTimePosition(ranges, currentTime / totalDurationSeconds);
+        if (!range) break;
+        const auto& playlist = state.rangePlaylists[range->rangeKey];
+        if (playlist.empty()) break;
+        size_t& index = state.rangePlaylistIndices[range->rangeKey];
+        const std::string key = playlist[index].videoKey;
+        index = (index + 1) % playlist.size();
+
+        double duration = cachedDuration(key);
+        if (duration < 0) {
+            duration = estimate;
+            if (planned.insert(key).second) keys.push_back(key);
+        } else if (duration == 0) {
+            continue;
+        }
+
+        // Trimmed like the segments of the walk itself
+        double rangeEndTime = rangeEndTimes.at(range->rangeKey);
+        double trimmed = duration;
+        if (currentTime + duration > rangeEndTime && rangeEndTime - currentTime > 0.5) {
+            trimmed = rangeEndTime - currentTime;
+        }
+        currentTime += std::min(trimmed, totalDurationSeconds - currentTime);
+    }
+    return keys;
+}
+
 Manager::Manager(const AppConfig& config, const CLIOptions& options)
     : config_(config), options_(options) {
-    auto timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
-    tempDir_ = fs::temp_directory_path() / ("qvm_bg_" + std::to_string(timestamp));
+    tempDir_ = CacheUtils::uniqueTempPath("qvm_bg_");
     fs::create_directories(tempDir_);
 }
 
 double Manager::getVideoDuration(const std::string& path) {
-    AVFormatContext* formatContext = nullptr;
-    if (avformat_open_input(&formatContext, path.c_str(), nullptr, nullptr) != 0) {
-        return 0.0;
-    }
-    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
-        avformat_close_input(&formatContext);
-        return 0.0;
-    }
-    double duration = static_cast<double>(formatContext->duration) / AV_TIME_BASE;
-    avformat_close_input(&formatContext);
-    return duration;
+    return Audio::DurationManifest::shared().duration(path);
 }
 
 std::string Manager::getCachedVideoPath(const std::string& remoteKey) {
@@ -54,7 +126,11 @@ bool Manager::isVideoCached(const std::string& remoteKey) {
 void Manager::cacheVideo(const std::string& remoteKey, const std::string& localPath) {
     std::string cachePath = getCachedVideoPath(remoteKey);
     if (localPath != cachePath) {
-        fs::copy_file(localPath, cachePath, fs::copy_options::overwrite_existing);
+        // Copied under a private name and renamed, so a render reading the
+        // cache concurrently never sees a partial file
+        fs::path staging = cachePath + ".part-" + tempDir_.filename().string();
+        fs::copy_file(localPath, staging, fs::copy_options::overwrite_existing);
+        fs::rename(staging, cachePath);
     }
 }
 
@@ -82,6 +158,152 @@ std::vector<std::string> Manager::listLocalVideos(const std::string& theme) {
     return videos;
 }
 
+std::shared_ptr<R2::Client> Manager::makeR2Client() const {
+    if (config_.videoSelection.useLocalDirectory) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(sharedR2Mutex);
+    auto& shared = sharedR2[r2ClientKey(config_.videoSelection)];
+    if (!shared.client) {
+        R2::R2Config r2Config{
+            config_.videoSelection.r2Endpoint,
+            config_.videoSelection.r2AccessKey,
+            config_.videoSelection.r2SecretKey,
+            config_.videoSelection.r2Bucket,
+            config_.videoSelection.usePublicBucket
+        };
+        shared.client = std::make_shared<R2::Client>(r2Config);
+    }
+    return shared.client;
+}
+
+std::map<std::string, std::vector<std::string>> Manager::listThemeVideos(const std::set<std::string>& themes,
+                                                                         R2::Client* r2Client) {
+    std::map<std::string, std::vector<std::string>> themeVideos;
+    for (const auto& theme : themes) {
+        try {
+            if (config_.videoSelection.useLocalDirectory) {
+                themeVideos[theme] = listLocalVideos(theme);
+            } else {
+                themeVideos[theme] = listR2Theme(r2Client, theme);
+            }
+            
+            if (themeVideos[theme].empty()) {
+                std::cout << "  Warning: No videos found for theme '" << theme << "'" << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "  Error listing videos for theme '" << theme << "': " << e.what() << std::endl;
+            themeVideos[theme] = {};
+        }
+    }
+    return themeVideos;
+}
+
+std::vector<std::string> Manager::plannedDownloads(VideoSelector::Selector& selector,
+                                                   const std::vector<VideoSelector::VerseRangeSegment>& ranges,
+                                                   const std::map<std::string, double>& rangeEndTimes,
+                                                   double totalDurationSeconds,
+                                                   const std::map<std::string, std::vector<std::string>>& themeVideos) {
+    double knownSeconds = 0.0;
+    int knownCount = 0;
+    for (const auto& [theme, videos] : themeVideos) {
+        for (const auto& video : videos) {
+            if (!isVideoCached(video)) continue;
+            double duration = getVideoDuration(getCachedVideoPath(video));
+            if (duration <= 0) continue;
+            knownSeconds += duration;
+            ++knownCount;
+        }
+    }
+    const double estimate = knownCount > 0 ? knownSeconds / knownCount : 10.0;
+    return planDownloads(selector, ranges, rangeEndTimes, totalDurationSeconds, selectionState_,
+                         [this](const std::string& key) {
+                             return isVideoCached(key) ? std::max(0.0, getVideoDuration(getCachedVideoPath(key))) : -1.0;
+                         },
+                         estimate);
+}
+
+std::vector<std::string> Manager::prefetchVideos(const std::vector<std::string>& keys, const Fetch& fetch) {
+    std::vector<std::string> failed;
+    if (keys.empty() || !fetch) return failed;
+    const int workerCount = std::max(1, std::min(static_cast<int>(keys.size()),
+                                                 Net::DownloadManager::shared().options().perHostLimit));
+    std::cout << "  Downloading " << keys.size() << " background videos, " << workerCount << " at a time" << std::endl;
+
+    std::mutex cacheMutex;
+    Parallel::forEach(keys.size(), static_cast<size_t>(workerCount), [&](size_t i) {
+        // Named after the whole key: videos of different themes may share a file name
+        std::string safeFilename = keys[i];
+        std::replace(safeFilename.begin(), safeFilename.end(), '/', '_');
+        fs::path tempPath = tempDir_ / safeFilename;
+        try {
+            fetch(keys[i], tempPath);
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            cacheVideo(keys[i], tempPath.string());
+            tempFiles_.push_back(tempPath);
+        } catch (const std::exception& e) {
+            // A partial body must not be mistaken for the video later on
+            std::error_code ec;
+            fs::remove(tempPath, ec);
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            failed.push_back(keys[i]);
+            std::cerr << "  Warning: Could not download background video '" << keys[i] << "': " << e.what() << std::endl;
+        }
+    });
+
+    // Probe the new videos in one parallel pass, as for the cached ones
+    std::vector<fs::path> fetched;
+    for (const auto& key : keys) {
+        if (isVideoCached(key)) fetched.push_back(getCachedVideoPath(key));
+    }
+    Audio::DurationManifest::shared().durations(fetched);
+    return failed;
+}
+
+nlohmann::json Manager::selectionInputs() {
+    if (!config_.videoSelection.enableDynamicBackgrounds) {
+        return nullptr;
+    }
+
+    VideoSelector::Selector selector(config_.videoSelection.themeMetadataPath, config_.videoSelection.seed);
+    std::set<std::string> themes;
+    for (const auto& seg : selector.getVerseRangeSegments(options_.surah, options_.from, options_.to)) {
+        themes.insert(seg.themes.begin(), seg.themes.end());
+    }
+
+    nlohmann::json inputs;
+    inputs["seed"] = config_.videoSelection.seed;
+    if (config_.videoSelection.useLocalDirectory) {
+        inputs["source"] = fs::absolute(config_.videoSelection.localVideoDirectory).lexically_normal().string();
+    } else {
+        inputs["source"] = config_.videoSelection.r2Endpoint + "/" + config_.videoSelection.r2Bucket;
+    }
+
+    // Local files are identified by size and mtime; R2 keys name immutable objects
+    nlohmann::json candidates = nlohmann::json::object();
+    auto r2Client = makeR2Client();
+    for (const auto& [theme, videos] : listThemeVideos(themes, r2Client.get())) {
+        nlohmann::json entries = nlohmann::json::array();
+        for (const auto& video : videos) {
+            if (!config_.videoSelection.useLocalDirectory) {
+                entries.push_back(video);
+                continue;
+            }
+            fs::path path = fs::path(config_.videoSelection.localVideoDirectory) / video;
+            std::error_code sizeEc;
+            std::error_code timeEc;
+            auto size = fs::file_size(path, sizeEc);
+            auto mtime = fs::last_write_time(path, timeEc).time_since_epoch().count();
+            entries.push_back({video,
+                               sizeEc ? 0 : static_cast<std::uint64_t>(size),
+                               timeEc ? 0 : static_cast<std::int64_t>(mtime)});
+        }
+        candidates[theme] = std::move(entries);
+    }
+    inputs["candidates"] = std::move(candidates);
+    return inputs;
+}
+
 std::string Manager::buildFilterComplex(double totalDurationSeconds, 
                                         std::vector<std::string>& outputInputFiles) {
     if (!config_.videoSelection.enableDynamicBackgrounds) {
@@ -146,36 +368,24 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
         }
         
         // Initialize R2 client if using R2
-        std::unique_ptr<R2::Client> r2Client;
-        if (!config_.videoSelection.useLocalDirectory) {
-            R2::R2Config r2Config{
-                config_.videoSelection.r2Endpoint,
-                config_.videoSelection.r2AccessKey,
-                config_.videoSelection.r2SecretKey,
-                config_.videoSelection.r2Bucket,
-                config_.videoSelection.usePublicBucket
-            };
-            r2Client = std::make_unique<R2::Client>(r2Config);
-        }
+        std::shared_ptr<R2::Client> r2Client = makeR2Client();
         
         // Build video cache for all themes
-        std::map<std::string, std::vector<std::string>> themeVideosCache;
-        for (const auto& theme : allThemes) {
-            try {
+        std::map<std::string, std::vector<std::string>> themeVideosCache = listThemeVideos(allThemes, r2Client.get());
+        
+        // Resolve durations of every candidate already on disk in one parallel
+        // pass; warm runs are served from the duration manifest without probing
+        std::vector<fs::path> knownVideos;
+        for (const auto& [theme, videos] : themeVideosCache) {
+            for (const auto& video : videos) {
                 if (config_.videoSelection.useLocalDirectory) {
-                    themeVideosCache[theme] = listLocalVideos(theme);
-                } else {
-                    themeVideosCache[theme] = r2Client->listVideosInTheme(theme);
-                }
-                
-                if (themeVideosCache[theme].empty()) {
-                    std::cout << "  Warning: No videos found for theme '" << theme << "'" << std::endl;
+                    knownVideos.push_back(fs::path(config_.videoSelection.localVideoDirectory) / video);
+                } else if (isVideoCached(video)) {
+                    knownVideos.push_back(getCachedVideoPath(video));
                 }
-            } catch (const std::exception& e) {
-                std::cerr << "  Error listing videos for theme '" << theme << "': " << e.what() << std::endl;
-                themeVideosCache[theme] = {};
             }
         }
+        Audio::DurationManifest::shared().durations(knownVideos);
         
         // Build playlists for all ranges
         std::cout << "  Building playlists:" << std::endl;
@@ -183,6 +393,16 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
             selector.getOrBuildPlaylist(seg, themeVideosCache, selectionState_);
         }
         
+        // Fetch every video the walk below will reach up front, side by side,
+        // instead of one request per segment
+        if (!config_.videoSelection.useLocalDirectory) {
+            prefetchVideos(plannedDownloads(selector, verseRangeSegments, rangeEndTimes, totalDurationSeconds,
+                                            themeVideosCache),
+                           [&r2Client](const std::string& key, const fs::path& destination) {
+                               r2Client->downloadVideo(key, destination);
+                           });
+        }
+        
         // Collect video segments
         std::vector<VideoSegment> segments;
         double currentTime = 0.0;
@@ -305,6 +525,7 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
         
         std::cout << "  Collected " << segments.size() << " segments, total duration: " 
                   << currentTime << " seconds" << std::endl;
+        segments_ = segments;
         
         // Build concat filter
         std::ostringstream filter;
@@ -341,6 +562,39 @@ std::string Manager::buildFilterComplex(double totalDurationSeconds,
     }
 }
 
+std::string Manager::buildWindowFilterComplex(double startSeconds,
+                                              double endSeconds,
+                                              std::vector<std::string>& outputInputFiles) const {
+    std::ostringstream filter;
+    filter << std::fixed << std::setprecision(6);
+    size_t inputCount = 0;
+    double segmentStart = 0.0;
+    for (const auto& segment : segments_) {
+        double segmentEnd = segmentStart + segment.trimmedDuration;
+        if (segmentEnd > startSeconds && segmentStart < endSeconds) {
+            double localStart = std::max(0.0, startSeconds - segmentStart);
+            double localEnd = std::min(segment.trimmedDuration, endSeconds - segmentStart);
+            filter << "[" << inputCount << ":v]"
+                   << "trim=start=" << localStart << ":end=" << localEnd << ",setpts=PTS-STARTPTS,"
+                   << "scale=" << config_.width << ":" << config_.height
+                   << ",fps=" << config_.fps
+                   << ",format=" << config_.pixelFormat
+                   << ",setsar=1[v" << inputCount << "]; ";
+            outputInputFiles.push_back(segment.path);
+            ++inputCount;
+        }
+        segmentStart = segmentEnd;
+    }
+    if (inputCount == 0) return "";
+
+    for (size_t i = 0; i < inputCount; ++i) {
+        filter << "[v" << i << "]";
+    }
+    filter << "concat=n=" << inputCount << ":v=1:a=0[bg]; ";
+    filter << "[bg]setpts=PTS-STARTPTS+" << startSeconds << "/TB";
+    return filter.str();
+}
+
 void Manager::cleanup() {
     for (const auto& file : tempFiles_) {
         std::error_code ec;
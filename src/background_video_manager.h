@@ -4,6 +4,13 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <nlohmann/json.hpp>
+
+namespace R2 { class Client; }
 
 namespace BackgroundVideo {
 
@@ -16,14 +23,47 @@ struct VideoSegment {
     bool needsTrim;
 };
 
+// Uncached videos a timeline walk over `ranges` reaches, in the order it
+// reaches them and once each. The walk advances its own copy of the playlist
+// positions. `cachedDuration` gives the length of a cached video: negative
+// when it is not downloaded yet (it then counts as `estimate` seconds), 0 when
+// it cannot be read (the walk skips it).
+std::vector<std::string> planDownloads(VideoSelector::Selector& selector,
+                                       const std::vector<VideoSelector::VerseRangeSegment>& ranges,
+                                       const std::map<std::string, double>& rangeEndTimes,
+                                       double totalDurationSeconds,
+                                       VideoSelector::SelectionState state,
+                                       const std::function<double(const std::string&)>& cachedDuration,
+                                       double estimate);
+
 class Manager {
 public:
     explicit Manager(const AppConfig& config, const CLIOptions& options);
+
+    // Writes one remote video to a local path; throws when it cannot.
+    using Fetch = std::function<void(const std::string& key, const std::filesystem::path& destination)>;
+    // Downloads into the cache side by side, up to the download host limit at
+    // once. A failed download is reported and leaves no file behind; its key
+    // is returned and left to the walk, which retries it.
+    std::vector<std::string> prefetchVideos(const std::vector<std::string>& keys, const Fetch& fetch);
     
     // Build filter complex for dynamic backgrounds (no pre-stitching)
     std::string buildFilterComplex(double totalDurationSeconds, 
                                    std::vector<std::string>& outputInputFiles);
     
+    // Filter graph covering only [startSeconds, endSeconds) of the timeline
+    // chosen by the last buildFilterComplex() call. Inputs are the segments
+    // overlapping the window; output timestamps stay on the absolute timeline
+    // and the chain ends unlabeled, like buildFilterComplex().
+    std::string buildWindowFilterComplex(double startSeconds,
+                                         double endSeconds,
+                                         std::vector<std::string>& outputInputFiles) const;
+    
+    // Everything the background selection depends on (seed, source and the
+    // candidate videos of each theme in the range), for render fingerprints.
+    // Null when dynamic backgrounds are disabled.
+    nlohmann::json selectionInputs();
+    
     // Cleanup temporary files
     void cleanup();
 
@@ -34,8 +74,9 @@ private:
     std::filesystem::path cacheDir_;
     std::vector<std::filesystem::path> tempFiles_;
     VideoSelector::SelectionState selectionState_;
+    std::vector<VideoSegment> segments_;
     
-    // Get video duration using libav
+    // Video duration from the shared duration manifest
     double getVideoDuration(const std::string& path);
     
     // Cache management for R2 videos
@@ -43,8 +84,27 @@ private:
     bool isVideoCached(const std::string& remoteKey);
     void cacheVideo(const std::string& remoteKey, const std::string& localPath);
     
+    // Shared per bucket for the life of the process, see releaseR2Clients()
+    std::shared_ptr<R2::Client> makeR2Client() const;
+    std::map<std::string, std::vector<std::string>> listThemeVideos(const std::set<std::string>& themes,
+                                                                    R2::Client* r2Client);
+    
+    // Uncached videos the timeline walk of buildFilterComplex() will reach,
+    // in order (see planDownloads); videos not downloaded yet count with the
+    // mean duration of the cached candidates.
+    std::vector<std::string> plannedDownloads(VideoSelector::Selector& selector,
+                                              const std::vector<VideoSelector::VerseRangeSegment>& ranges,
+                                              const std::map<std::string, double>& rangeEndTimes,
+                                              double totalDurationSeconds,
+                                              const std::map<std::string, std::vector<std::string>>& themeVideos);
+    
     // Local directory support
     std::vector<std::string> listLocalVideos(const std::string& theme);
 };
 
+// R2 clients (and their theme listings) are kept for the whole process so
+// later renders, such as batch jobs, skip AWS SDK setup and listing requests.
+// Releases them; call before exiting so the SDK shuts down in order.
+void releaseR2Clients();
+
 } // namespace BackgroundVideo
\ No newline at end of file
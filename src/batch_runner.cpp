@@ -0,0 +1,214 @@
+#include "batch_runner.h"
+#include "command_line.h"
+#include "cache_utils.h"
+#include "render_job.h"
+#include "background_video_manager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+// Serializes status lines from concurrently finishing jobs.
+class StatusWriter {
+public:
+    explicit StatusWriter(const fs::path& path) : file_(path, std::ios::trunc) {
+        if (!file_.is_open()) {
+            std::cerr << "  ! Could not open batch status file " << path.string() << std::endl;
+        }
+    }
+
+    void write(const json& status) {
+        std::string line = status.dump();
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::cout << "JOB " << line << std::endl;
+        if (file_.is_open()) file_ << line << std::endl;
+    }
+
+private:
+    std::ofstream file_;
+    std::mutex mutex_;
+};
+
+json statusLine(size_t line, const std::string& id) {
+    return {{"line", line}, {"id", id}};
+}
+
+std::string jobId(const json& line, const std::string& fallback) {
+    if (!line.is_object() || !line.contains("id")) return fallback;
+    return line["id"].is_string() ? line["id"].get<std::string>() : line["id"].dump();
+}
+
+std::string argumentFor(const std::string& flag, const std::string& value) {
+    return flag.size() == 1 ? "-" + flag + value : "--" + flag + "=" + value;
+}
+
+} // namespace
+
+namespace BatchRunner {
+
+std::vector<std::string> jobArguments(const json& job) {
+    if (!job.is_object()) {
+        throw std::invalid_argument("job must be a JSON object of flags");
+    }
+    std::vector<std::string> args;
+    for (const auto& [key, value] : job.items()) {
+        if (key == "id" || value.is_null()) continue;
+        if (key == "args") {
+            if (!value.is_array()) throw std::invalid_argument("\"args\" must be an array of strings");
+            for (const auto& arg : value) {
+                if (!arg.is_string()) throw std::invalid_argument("\"args\" must be an array of strings");
+                args.push_back(arg.get<std::string>());
+            }
+        } else if (value.is_boolean()) {
+            // Written out so a job can also switch off a flag given to the whole batch
+            args.push_back(argumentFor(key, value.get<bool>() ? "true" : "false"));
+        } else if (value.is_string()) {
+            args.push_back(argumentFor(key, value.get<std::string>()));
+        } else if (value.is_number()) {
+            args.push_back(argumentFor(key, value.dump()));
+        } else {
+            throw std::invalid_argument("unsupported value for \"" + key + "\"");
+        }
+    }
+    return args;
+}
+
+Job parseJob(const json& line, const std::vector<std::string>& baseArgs, const std::string& defaultId) {
+    Job job;
+    job.id = jobId(line, defaultId);
+    job.args = {"qvm"};
+    job.args.insert(job.args.end(), baseArgs.begin(), baseArgs.end());
+    auto own = jobArguments(line);
+    job.args.insert(job.args.end(), own.begin(), own.end());
+
+    std::vector<const char*> argv;
+    for (const auto& arg : job.args) argv.push_back(arg.c_str());
+    auto parser = CommandLine::buildParser();
+    auto parsed = parser.parse(static_cast<int>(argv.size()), argv.data());
+    job.options = CommandLine::toOptions(parsed);
+    if (job.options.clearCache) {
+        throw std::invalid_argument("--clear-cache is not supported per job; pass it to the batch or server");
+    }
+    // Without an explicit output every job gets its own directory, so
+    // thumbnails (written next to the video) do not collide
+    bool ownOutput = std::any_of(own.begin(), own.end(), [](const std::string& arg) {
+        return arg == "--output" || arg.rfind("--output=", 0) == 0 || arg.rfind("-o", 0) == 0;
+    });
+    if (!ownOutput) {
+        fs::path output = job.options.output;
+        job.options.output = (output.parent_path() / CacheUtils::sanitizeLabel(job.id) / output.filename()).string();
+    }
+    return job;
+}
+
+int run(const Settings& settings) {
+    std::ifstream jobsFile(settings.jobsFile);
+    if (!jobsFile.is_open()) {
+        throw std::runtime_error("Could not open batch file: " + settings.jobsFile.string());
+    }
+    fs::path statusPath = settings.statusFile;
+    if (statusPath.empty()) {
+        statusPath = settings.jobsFile;
+        statusPath.replace_extension(".status.jsonl");
+    }
+    StatusWriter status(statusPath);
+
+    // Jobs are parsed and their configs loaded up front on this thread: loading
+    // a config sets the process-wide data root, which running jobs read.
+    std::vector<Job> jobs;
+    std::map<std::string, size_t> outputOwners;
+    std::map<std::string, size_t> thumbnailOwners;
+    fs::path dataRoot;
+    int failed = 0;
+    std::string text;
+    for (size_t lineNumber = 1; std::getline(jobsFile, text); ++lineNumber) {
+        auto first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos || text[first] == '#') continue;
+
+        std::string id = "line-" + std::to_string(lineNumber);
+        try {
+            json parsed = json::parse(text);
+            id = jobId(parsed, id);
+            Job job = parseJob(parsed, settings.baseArgs, id);
+            job.line = lineNumber;
+
+            std::string outputKey = fs::absolute(job.options.output).lexically_normal().string();
+            auto owner = outputOwners.find(outputKey);
+            if (owner != outputOwners.end()) {
+                throw std::invalid_argument("output " + job.options.output + " is already written by line " +
+                                            std::to_string(owner->second));
+            }
+            std::string thumbnailKey = fs::absolute(job.options.output).parent_path().lexically_normal().string();
+            auto thumbnailOwner = thumbnailOwners.find(thumbnailKey);
+            if (thumbnailOwner != thumbnailOwners.end()) {
+                std::cerr << "  ! Line " << lineNumber << " shares its output directory with line "
+                          << thumbnailOwner->second << "; the later thumbnail.jpeg wins" << std::endl;
+            }
+
+            job.config = RenderJob::loadJobConfig(job.options);
+            if (dataRoot.empty()) {
+                dataRoot = CacheUtils::getDataRoot();
+            } else if (CacheUtils::getDataRoot() != dataRoot) {
+                CacheUtils::setDataRoot(dataRoot);
+                throw std::invalid_argument("config " + job.options.configPath +
+                                            " is in a different directory than the batch's first config");
+            }
+            outputOwners.emplace(outputKey, lineNumber);
+            thumbnailOwners.emplace(thumbnailKey, lineNumber);
+            jobs.push_back(std::move(job));
+        } catch (const std::exception& e) {
+            json line = statusLine(lineNumber, id);
+            line["status"] = "failed";
+            line["error"] = e.what();
+            status.write(line);
+            ++failed;
+        }
+    }
+
+    size_t workers = std::min(jobs.size(), static_cast<size_t>(std::max(1, settings.parallel)));
+    std::cout << "Batch: " << jobs.size() << " jobs, " << workers << " at a time" << std::endl;
+
+    std::atomic<size_t> next{0};
+    std::atomic<int> jobFailures{0};
+    std::vector<std::future<void>> runners;
+    for (size_t w = 0; w < workers; ++w) {
+        runners.push_back(std::async(std::launch::async, [&]() {
+            for (size_t i = next++; i < jobs.size(); i = next++) {
+                const Job& job = jobs[i];
+                auto start = std::chrono::steady_clock::now();
+                RenderJob::Result result = RenderJob::render(job.options, job.config, job.args);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                json line = statusLine(job.line, job.id);
+                line["status"] = !result.succeeded ? "failed" : result.servedFromCache ? "cached" : "rendered";
+                line["output"] = job.options.output;
+                line["seconds"] = std::round(seconds * 100.0) / 100.0;
+                if (!result.fingerprint.empty()) line["fingerprint"] = result.fingerprint;
+                if (!result.error.empty()) line["error"] = result.error;
+                status.write(line);
+                if (!result.succeeded) ++jobFailures;
+            }
+        }));
+    }
+    for (auto& runner : runners) runner.get();
+    failed += jobFailures;
+
+    BackgroundVideo::releaseR2Clients();
+    std::cout << "Batch complete: " << (jobs.size() - static_cast<size_t>(jobFailures)) << " succeeded, "
+              << failed << " failed. Status: " << statusPath.string() << std::endl;
+    return failed;
+}
+
+} // namespace BatchRunner
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "types.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Renders many jobs in one process. Each line of the jobs file is a JSON
+// object of command-line flags ({"surah": 2, "from": 1, "to": 5, "reciter": 7})
+// parsed exactly like a single run, so jobs share the loaded data packs,
+// indexes, fonts, download queue and background clients instead of paying
+// for them per video. Lines may also carry "id" (used in status lines) and
+// "args" (raw extra arguments).
+namespace BatchRunner {
+
+struct Settings {
+    std::filesystem::path jobsFile;
+    std::filesystem::path statusFile;  // empty: <jobs file>.status.jsonl
+    int parallel = 1;                  // jobs rendered at once
+    std::vector<std::string> baseArgs; // flags applied to every job, before the job's own
+};
+
+struct Job {
+    size_t line = 0;
+    std::string id;
+    std::vector<std::string> args;  // full command line, program name first
+    CLIOptions options;
+    AppConfig config{};             // filled by the caller (RenderJob::loadJobConfig)
+};
+
+// Command-line arguments equivalent to one job line (without the program name).
+// Throws std::invalid_argument when the line is not a JSON object of flags.
+std::vector<std::string> jobArguments(const nlohmann::json& job);
+
+// Parses a job line on top of `baseArgs`. The job is named by its "id" or
+// `defaultId`, and without an explicit output writes into a directory named
+// after it. Throws when the flags do not parse or are not allowed per job.
+Job parseJob(const nlohmann::json& line, const std::vector<std::string>& baseArgs, const std::string& defaultId);
+
+// Runs every job and writes one status line per job to stdout (prefixed with
+// "JOB ") and to the status file. Returns the number of failed jobs.
+int run(const Settings& settings);
+
+} // namespace BatchRunner
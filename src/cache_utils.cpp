@@ -1,19 +1,20 @@
 #include "cache_utils.h"
 #include "quran_data.h"
-#include <fstream>
+#include "data/pack_io.h"
+#include "data/verse_pack.h"
+#include "net/download_manager.h"
+#include <atomic>
+#include <chrono>
 #include <unordered_map>
+#include <memory>
+#include <vector>
 #include <mutex>
 #include <cctype>
 #include <stdexcept>
 #include <system_error>
 #include <cstdlib>
-#include <chrono>
-#include <thread>
-#include <iostream>
-#include <cpr/cpr.h>
 
 namespace fs = std::filesystem;
-using json = nlohmann::json;
 
 namespace {
     fs::path initialDataRoot() {
@@ -61,17 +62,49 @@ namespace {
 
     fs::path cacheRoot = determineDefaultCacheRoot();
 
-    std::mutex translationCacheMutex;
-    std::unordered_map<int, json> translationCache;
-    std::mutex reciterCacheMutex;
-    std::unordered_map<int, json> reciterAudioCache;
+    const std::vector<std::string> translationPackFields = {"t"};
+    const std::vector<std::string> reciterPackFields = {"audio_url", "duration"};
+
+    std::mutex packCacheMutex;
+    std::unordered_map<std::string, std::shared_ptr<const Data::VersePack>> packCache;
+
+    fs::path packPathFor(const std::string& label, const fs::path& source) {
+        return cacheRoot / "packs" / (label + "-" + Data::pathDigest(source) + ".bin");
+    }
+
+    // Opens (building first if missing or stale) the pack for a source file and
+    // keeps it mapped for the rest of the process.
+    std::shared_ptr<const Data::VersePack> loadPack(const std::string& label,
+                                                    const fs::path& source,
+                                                    const std::vector<std::string>& fields) {
+        fs::path packPath = packPathFor(label, source);
+        std::lock_guard<std::mutex> lock(packCacheMutex);
+        auto it = packCache.find(packPath.string());
+        if (it != packCache.end() && it->second->builtFrom(source)) {
+            return it->second;
+        }
+        if (!Data::VersePack::isCurrent(packPath, source, fields)) {
+            Data::VersePack::build(source, fields, packPath);
+        }
+        auto pack = std::make_shared<const Data::VersePack>(packPath);
+        packCache[packPath.string()] = pack;
+        return pack;
+    }
+
+    std::shared_ptr<const Data::VersePack> translationPack(int translationId) {
+        fs::path source = CacheUtils::translationSourcePath(translationId);
+        if (!CacheUtils::fileIsValid(source)) {
+            throw std::runtime_error("Failed to open translation file: " + source.string());
+        }
+        return loadPack("translation-" + std::to_string(translationId), source, translationPackFields);
+    }
 
-    void ensure_parent(const fs::path& path) {
-        const auto parent = path.parent_path();
-        if (!parent.empty()) {
-            std::error_code ec;
-            fs::create_directories(parent, ec);
+    std::shared_ptr<const Data::VersePack> reciterPack(int reciterId) {
+        fs::path source = CacheUtils::reciterSourcePath(reciterId);
+        if (!CacheUtils::fileIsValid(source)) {
+            throw std::runtime_error("Failed to open reciter metadata file: " + source.string());
         }
+        return loadPack("reciter-" + std::to_string(reciterId), source, reciterPackFields);
     }
 }
 
@@ -82,7 +115,9 @@ void CacheUtils::setDataRoot(const fs::path& root) {
     if (ec) {
         resolved = fs::absolute(root, ec);
     }
-    if (!resolved.empty()) {
+    // Re-setting the same root is a no-op, so loading another job's config
+    // does not write to the path while running renders read it
+    if (!resolved.empty() && resolved != dataRoot) {
         dataRoot = resolved;
     }
 }
@@ -110,54 +145,53 @@ fs::path CacheUtils::getCacheRoot() {
     return cacheRoot;
 }
 
-const json& CacheUtils::getTranslationData(int translationId) {
-    std::lock_guard<std::mutex> lock(translationCacheMutex);
-    auto it = translationCache.find(translationId);
-    if (it == translationCache.end()) {
-        auto fileIt = QuranData::translationFiles.find(translationId);
-        if (fileIt == QuranData::translationFiles.end()) {
-            throw std::runtime_error("Unknown translationId: " + std::to_string(translationId));
-        }
-        fs::path translationPath = resolveDataPath(fileIt->second);
-        std::ifstream file(translationPath);
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open translation file: " + translationPath.string());
-        }
-        json data = json::parse(file, nullptr, true, true);
-        it = translationCache.emplace(translationId, std::move(data)).first;
+std::string CacheUtils::getTranslationText(int translationId, const std::string& verseKey) {
+    return std::string(translationPack(translationId)->value(verseKey, 0));
+}
+
+CacheUtils::ReciterAudioEntry CacheUtils::getReciterAudio(int reciterId, const std::string& verseKey) {
+    auto pack = reciterPack(reciterId);
+    ReciterAudioEntry entry;
+    entry.found = pack->contains(verseKey);
+    if (!entry.found) return entry;
+    entry.audioUrl = std::string(pack->value(verseKey, 0));
+    std::string duration(pack->value(verseKey, 1));
+    if (!duration.empty()) {
+        char* end = nullptr;
+        double value = std::strtod(duration.c_str(), &end);
+        if (end && *end == '\0') entry.durationSeconds = value;
     }
-    return it->second;
+    return entry;
 }
 
-std::string CacheUtils::getTranslationText(int translationId, const std::string& verseKey) {
-    const json& translations = getTranslationData(translationId);
-    auto it = translations.find(verseKey);
-    if (it != translations.end() && it->is_object()) {
-        auto textIt = it->find("t");
-        if (textIt != it->end() && textIt->is_string()) {
-            return textIt->get<std::string>();
-        }
+fs::path CacheUtils::translationSourcePath(int translationId) {
+    auto fileIt = QuranData::translationFiles.find(translationId);
+    if (fileIt == QuranData::translationFiles.end()) {
+        throw std::runtime_error("Unknown translationId: " + std::to_string(translationId));
     }
-    return "";
+    return resolveDataPath(fileIt->second);
 }
 
-const json& CacheUtils::getReciterAudioData(int reciterId) {
-    std::lock_guard<std::mutex> lock(reciterCacheMutex);
-    auto it = reciterAudioCache.find(reciterId);
-    if (it == reciterAudioCache.end()) {
-        auto recIt = QuranData::reciterFiles.find(reciterId);
-        if (recIt == QuranData::reciterFiles.end()) {
-            throw std::runtime_error("Unknown reciterId for gapped mode: " + std::to_string(reciterId));
-        }
-        fs::path metadataPath = resolveDataPath(recIt->second);
-        std::ifstream file(metadataPath);
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open reciter metadata file: " + metadataPath.string());
-        }
-        json data = json::parse(file, nullptr, true, true);
-        it = reciterAudioCache.emplace(reciterId, std::move(data)).first;
+fs::path CacheUtils::reciterSourcePath(int reciterId) {
+    auto recIt = QuranData::reciterFiles.find(reciterId);
+    if (recIt == QuranData::reciterFiles.end()) {
+        throw std::runtime_error("Unknown reciterId for gapped mode: " + std::to_string(reciterId));
     }
-    return it->second;
+    return resolveDataPath(recIt->second);
+}
+
+fs::path CacheUtils::buildTranslationPack(int translationId) {
+    fs::path source = translationSourcePath(translationId);
+    fs::path packPath = packPathFor("translation-" + std::to_string(translationId), source);
+    Data::VersePack::build(source, translationPackFields, packPath);
+    return packPath;
+}
+
+fs::path CacheUtils::buildReciterPack(int reciterId) {
+    fs::path source = reciterSourcePath(reciterId);
+    fs::path packPath = packPathFor("reciter-" + std::to_string(reciterId), source);
+    Data::VersePack::build(source, reciterPackFields, packPath);
+    return packPath;
 }
 
 fs::path CacheUtils::buildCachedAudioPath(const std::string& label) {
@@ -172,6 +206,13 @@ bool CacheUtils::fileIsValid(const fs::path& path) {
     return fs::exists(path, ec) && fs::file_size(path, ec) > 0;
 }
 
+fs::path CacheUtils::uniqueTempPath(const std::string& prefix, const std::string& extension) {
+    static std::atomic<unsigned> counter{0};
+    auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    return fs::temp_directory_path() /
+        (prefix + std::to_string(stamp) + "_" + std::to_string(counter++) + extension);
+}
+
 std::string CacheUtils::sanitizeLabel(std::string value) {
     for (char& ch : value) {
         if (!std::isalnum(static_cast<unsigned char>(ch))) {
@@ -182,39 +223,5 @@ std::string CacheUtils::sanitizeLabel(std::string value) {
 }
 
 bool CacheUtils::downloadFileWithRetry(const std::string& url, const fs::path& destination, int maxRetries) {
-    ensure_parent(destination);
-    for (int attempt = 1; attempt <= maxRetries; ++attempt) {
-        std::ofstream out(destination, std::ios::binary | std::ios::trunc);
-        if (!out.is_open()) {
-            throw std::runtime_error("Unable to open destination for download: " + destination.string());
-        }
-
-        cpr::Session session;
-        session.SetUrl(cpr::Url{url});
-        session.SetTimeout(cpr::Timeout{60000});
-        session.SetVerifySsl(cpr::VerifySsl{true});
-        session.SetRedirect(cpr::Redirect{true});
-        session.SetHeader(cpr::Header{{"User-Agent", "quran-video-maker/1.0"}});
-        auto response = session.Download(out);
-        out.close();
-
-        const bool ok = response.error.code == cpr::ErrorCode::OK &&
-                        response.status_code >= 200 && response.status_code < 400 &&
-                        fileIsValid(destination);
-        if (ok) {
-            return true;
-        }
-
-        if (attempt == maxRetries) {
-            std::cerr << "  ! Download failed for " << url
-                      << " (HTTP " << response.status_code
-                      << ", cpr error=" << static_cast<int>(response.error.code)
-                      << " - " << response.error.message << ")" << std::endl;
-        }
-
-        std::error_code ec;
-        fs::remove(destination, ec);
-        std::this_thread::sleep_for(std::chrono::milliseconds(250 * attempt));
-    }
-    return false;
+    return Net::DownloadManager::shared().download(url, destination, Net::Priority::Normal, maxRetries);
 }
@@ -14,10 +14,26 @@ namespace CacheUtils {
     void setCacheRoot(const std::filesystem::path& root);
     std::filesystem::path getCacheRoot();
 
-    const nlohmann::json& getTranslationData(int translationId);
-    const nlohmann::json& getReciterAudioData(int reciterId);
+    // Per-verse lookups served from memory-mapped binary packs compiled from the
+    // same JSON files; packs live under the cache root and are rebuilt whenever
+    // their source file changes.
+    struct ReciterAudioEntry {
+        bool found = false;
+        std::string audioUrl;
+        double durationSeconds = -1.0;  // -1 when the metadata has no duration
+    };
     std::string getTranslationText(int translationId, const std::string& verseKey);
+    ReciterAudioEntry getReciterAudio(int reciterId, const std::string& verseKey);
+    std::filesystem::path buildTranslationPack(int translationId);
+    // JSON files the packs are compiled from; throw for unknown ids
+    std::filesystem::path translationSourcePath(int translationId);
+    std::filesystem::path reciterSourcePath(int reciterId);
+    std::filesystem::path buildReciterPack(int reciterId);
+
     std::filesystem::path buildCachedAudioPath(const std::string& label);
+    // Fresh path in the system temp directory, distinct for every call so
+    // renders running side by side never share scratch files
+    std::filesystem::path uniqueTempPath(const std::string& prefix, const std::string& extension = "");
     bool fileIsValid(const std::filesystem::path& path);
     std::string sanitizeLabel(std::string value);
     bool downloadFileWithRetry(const std::string& url, const std::filesystem::path& destination, int maxRetries = 4);
@@ -0,0 +1,160 @@
+#include "clip_library.h"
+#include "cache_utils.h"
+#include "render_cache.h"
+#include "subtitle_builder.h"
+#include "data/file_digests.h"
+#include "data/sha256.h"
+
+#include <algorithm>
+#include <cmath>
+#include <system_error>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+// Bump when clip encoding changes in a way the key inputs do not capture.
+constexpr int kFormatVersion = 1;
+
+int ayahNumber(const std::string& verseKey) {
+    auto colon = verseKey.find(':');
+    if (colon == std::string::npos) return 0;
+    try {
+        return std::stoi(verseKey.substr(colon + 1));
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+// Position of the verse on the surah's own timeline. Anchoring the background
+// there keeps a verse's slice the same whichever range it is rendered in, and
+// lets consecutive verses continue the background where the previous one stopped.
+double surahAnchorSeconds(const AppConfig& config, const VerseData& verse) {
+    if (config.recitationMode == RecitationMode::GAPLESS) {
+        return verse.timestampFromMs / 1000.0;
+    }
+    const int ayah = ayahNumber(verse.verseKey);
+    const std::string prefix = verse.verseKey.substr(0, verse.verseKey.find(':') + 1);
+    double anchor = 0.0;
+    for (int i = 1; i < ayah; ++i) {
+        auto entry = CacheUtils::getReciterAudio(config.reciterId, prefix + std::to_string(i));
+        if (entry.durationSeconds > 0.0) anchor += entry.durationSeconds;
+    }
+    return anchor;
+}
+
+json encoderInputs(const CLIOptions& options) {
+    return {
+        {"encoder", options.encoder},
+        {"preset", options.preset},
+        {"renderBackend", options.renderBackend},
+    };
+}
+
+json verseInputs(const VerseData& verse, const VerseSegmentation::Manager* segmentManager) {
+    json inputs = {
+        {"key", verse.verseKey},
+        {"text", verse.text},
+        {"translation", verse.translation},
+        {"duration", verse.durationInSeconds},
+    };
+    if (segmentManager && segmentManager->isEnabled() && segmentManager->shouldSegmentVerse(verse.verseKey)) {
+        json segments = json::array();
+        for (const auto& segment : segmentManager->getSegments(verse.verseKey)) {
+            segments.push_back({segment.startSeconds, segment.endSeconds, segment.arabic, segment.translation});
+        }
+        inputs["from"] = verse.timestampFromMs;
+        inputs["segments"] = std::move(segments);
+    }
+    return inputs;
+}
+
+} // namespace
+
+namespace ClipLibrary {
+
+long long frameCountFor(double seconds, double fps) {
+    return seconds > 0.0 ? std::llround(seconds * fps) : 0;
+}
+
+std::vector<Clip> planClips(const CLIOptions& options,
+                            const AppConfig& config,
+                            const std::vector<VerseData>& verses,
+                            double backgroundLoopSeconds,
+                            const VerseSegmentation::Manager* segmentManager) {
+    const double fps = config.fps > 0 ? config.fps : 30.0;
+    json base;
+    base["format"] = kFormatVersion;
+    base["binaries"] = RenderCache::describeBinaries();
+    base["config"] = RenderCache::describeConfig(config);
+    base["encoder"] = encoderInputs(options);
+    base["fps"] = fps;
+    base["backgroundPlate"] = options.backgroundPlate;
+    base["subtitleSprites"] = options.subtitleSprites;
+    base["variableFrameRate"] = options.variableFrameRate;
+    if (!SubtitleBuilder::burnsTranslation(options)) base["burnIn"] = options.burnArabic ? "arabic" : "none";
+
+    auto makeClip = [&](json inputs, int verseIndex, double seconds, double anchor) {
+        Clip clip;
+        clip.verseIndex = verseIndex;
+        clip.frameCount = std::max(1LL, frameCountFor(seconds, fps));  // a clip never drops its verse
+        clip.backgroundSeekSeconds = backgroundLoopSeconds > 0.0 ? std::fmod(anchor, backgroundLoopSeconds) : 0.0;
+        inputs["frames"] = clip.frameCount;
+        inputs["backgroundSeekMs"] = std::llround(clip.backgroundSeekSeconds * 1000.0);
+        clip.key = Data::sha256Hex(inputs.dump());
+        clip.path = clipPath(clip.key);
+        return clip;
+    };
+
+    std::vector<Clip> clips;
+    const double leadIn = config.introDuration + config.pauseAfterIntroDuration;
+    if (leadIn > 0.0) {
+        // The intro card names the requested range, so it is specific to it
+        json inputs = base;
+        inputs["kind"] = "intro";
+        inputs["intro"] = {
+            {"surah", options.surah},
+            {"from", options.from},
+            {"to", options.to},
+            {"duration", config.introDuration},
+            {"pause", config.pauseAfterIntroDuration},
+        };
+        inputs["localization"] = RenderCache::describeLocalization(config);
+        clips.push_back(makeClip(std::move(inputs), -1, leadIn, 0.0));
+    }
+    for (size_t i = 0; i < verses.size(); ++i) {
+        const auto& verse = verses[i];
+        json inputs = base;
+        inputs["kind"] = "verse";
+        inputs["verse"] = verseInputs(verse, segmentManager);
+        clips.push_back(makeClip(std::move(inputs), static_cast<int>(i), verse.durationInSeconds,
+                                 surahAnchorSeconds(config, verse)));
+    }
+    Data::FileDigests::shared().flush();
+    return clips;
+}
+
+std::vector<VerseData> clipTimeline(const std::vector<Clip>& clips, const std::vector<VerseData>& verses, double fps) {
+    std::vector<VerseData> timeline = verses;
+    for (const auto& clip : clips) {
+        if (clip.verseIndex >= 0) timeline[clip.verseIndex].durationInSeconds = static_cast<double>(clip.frameCount) / fps;
+    }
+    return timeline;
+}
+
+double clipLeadIn(const std::vector<Clip>& clips, double fps) {
+    return !clips.empty() && clips.front().verseIndex < 0 ? static_cast<double>(clips.front().frameCount) / fps : 0.0;
+}
+
+fs::path clipPath(const std::string& key) {
+    return CacheUtils::getCacheRoot() / "clips" / key.substr(0, 2) / (key + ".mp4");
+}
+
+bool isStored(const Clip& clip) {
+    std::error_code ec;
+    return fs::is_regular_file(clip.path, ec) && fs::file_size(clip.path, ec) > 0;
+}
+
+} // namespace ClipLibrary
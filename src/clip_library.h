@@ -0,0 +1,55 @@
+#pragma once
+
+#include "types.h"
+#include "verse_segmentation.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Library of pre-encoded, closed-GOP video clips: one per verse plus one for
+// the intro card. A clip's key covers everything that shapes its pixels (the
+// verse text and timing, the style, the background slice it starts from and
+// the encoder), so overlapping ranges of the same surah share their clips and
+// a render only encodes the verses it has not seen before. The clips of a
+// range are joined by stream copy and the recitation is muxed once on top.
+//
+// Clips live under <cache root>/clips/<key[0..2]>/<key>.mp4.
+namespace ClipLibrary {
+
+struct Clip {
+    std::string key;
+    int verseIndex = -1;                 // index into the rendered verses, -1 for the intro card
+    long long frameCount = 0;
+    double backgroundSeekSeconds = 0.0;  // where the looped background starts in this clip
+    std::filesystem::path path;
+};
+
+// Frames a clip of `seconds` occupies. Each clip is rounded on its own so its
+// key does not depend on where the verse falls in the requested range; the
+// recitation is pinned to the clips (see clipTimeline) so the rounding cannot
+// add up along the range.
+long long frameCountFor(double seconds, double fps);
+
+// Clips covering the render in playback order: the intro card (when there is
+// a lead-in) followed by one clip per verse, at least a frame long even when
+// the verse is shorter.
+// `backgroundLoopSeconds` is the length of the looped background video.
+std::vector<Clip> planClips(const CLIOptions& options,
+                            const AppConfig& config,
+                            const std::vector<VerseData>& verses,
+                            double backgroundLoopSeconds,
+                            const VerseSegmentation::Manager* segmentManager = nullptr);
+
+// The verses on the clips' frame grid: each lasts exactly as long as its clip.
+std::vector<VerseData> clipTimeline(const std::vector<Clip>& clips, const std::vector<VerseData>& verses, double fps);
+
+// Length of the intro clip, 0 without one.
+double clipLeadIn(const std::vector<Clip>& clips, double fps);
+
+std::filesystem::path clipPath(const std::string& key);
+
+// True when the clip has been encoded and stored.
+bool isStored(const Clip& clip);
+
+} // namespace ClipLibrary
@@ -0,0 +1,277 @@
+#include "command_line.h"
+#include "quran_data.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* kGaplessDisabled =
+    "Gapless mode is temporarily disabled because it's too buggy and the gapless data needs to be cleaned first.";
+
+} // namespace
+
+namespace CommandLine {
+
+cxxopts::Options buildParser() {
+    cxxopts::Options cli_parser("QuranVideoMaker", "Generates Quran videos using FFmpeg");
+    // TODO: fix so default values removed and values read from config instead
+    cli_parser.add_options()
+        ("surah", "Surah number", cxxopts::value<int>())
+        ("from", "Starting verse", cxxopts::value<int>())
+        ("to", "Ending verse", cxxopts::value<int>())
+        ("c,config", "Path to config file", cxxopts::value<std::string>()->default_value("./config.json"))
+        ("r,reciter", "Reciter ID", cxxopts::value<int>())
+        ("t,translation", "Translation ID", cxxopts::value<int>())
+        ("m,mode", "Recitation mode: 'gapped' (ayah-by-ayah) or 'gapless' (surah-by-surah)", cxxopts::value<std::string>())
+        ("o,output", "Output filename", cxxopts::value<std::string>())
+        ("width", "Video width", cxxopts::value<int>())
+        ("height", "Video height", cxxopts::value<int>())
+        ("fps", "Frames per second", cxxopts::value<int>())
+        ("arabic-font-size", "Override Arabic font size", cxxopts::value<int>())
+        ("translation-font-size", "Override translation font size", cxxopts::value<int>())
+        ("text-padding", "Horizontal padding fraction (0-0.45) for subtitles", cxxopts::value<double>())
+        ("e,encoder", "Choose encoder: 'software' (default) or 'hardware'", cxxopts::value<std::string>()->default_value("software"))
+        ("p,preset", "Software encoder preset for speed/quality (ultrafast, fast, medium)", cxxopts::value<std::string>()->default_value("fast"))
+        ("render-backend", "Render backend: 'cli' (spawn ffmpeg, default) or 'libav' (in-process)", cxxopts::value<std::string>()->default_value("cli"))
+        ("parallel-chunks", "Encode the video as N verse-aligned chunks in parallel, then join them by stream copy", cxxopts::value<int>())
+        ("clip-library", "Assemble the video from cached per-verse clips, encoding only the missing ones", cxxopts::value<bool>()->default_value("false"))
+        ("background-plate", "Loop a cached copy of the static background already scaled, resampled and dimmed for the output", cxxopts::value<bool>()->default_value("false"))
+        ("subtitle-sprites", "Blend subtitles from cached pre-rasterized sprites instead of running libass per frame (libav backend)", cxxopts::value<bool>()->default_value("false"))
+        ("extra-output", "Also render WIDTHxHEIGHT[@FPS]=PATH from the same decode, e.g. 1080x1920=short.mp4 (repeatable)", cxxopts::value<std::vector<std::string>>())
+        ("soft-translations", "Mux these translation IDs as timed-text tracks (and .vtt sidecars) instead of burning one in, e.g. 1,3,4", cxxopts::value<std::vector<int>>())
+        ("burn-in", "Text burned into the picture with --soft-translations: 'arabic' (default) or 'none'", cxxopts::value<std::string>()->default_value("arabic"))
+        ("verse-clips", "Also write one S_V.mp4 clip per verse and a manifest.json into DIR, cut from the same encode", cxxopts::value<std::string>())
+        ("no-verse-chapters", "Leave out the keyframe and MP4 chapter that otherwise start every verse", cxxopts::value<bool>()->default_value("false"))
+        ("pipeline", "Start encoding from the reciter metadata timeline while verse audio downloads, and mux the recitation once fetched (gapped mode)", cxxopts::value<bool>()->default_value("false"))
+        ("vfr", "Variable frame rate: encode only frames that differ from the previous one, at their exact timestamps (static backgrounds)", cxxopts::value<bool>()->default_value("false"))
+        ("download-workers", "Maximum concurrent downloads (default: 2 per usable core, up to 8)", cxxopts::value<int>())
+        ("download-host-limit", "Maximum concurrent downloads from one host (default: 4)", cxxopts::value<int>())
+        ("cpus", "Cores qvm may use, split between concurrent renders (default: all the host and its cgroup allow)", cxxopts::value<int>())
+        ("pin-cores", "Pin each render to its own set of cores, NUMA node by node (Linux)", cxxopts::value<bool>()->default_value("false"))
+        ("quality-profile", "Quality profile: speed | balanced | max", cxxopts::value<std::string>())
+        ("crf", "Constant Rate Factor (0-51). Lower improves quality.", cxxopts::value<int>())
+        ("pix-fmt", "Pixel format (e.g. yuv420p, yuv420p10le)", cxxopts::value<std::string>())
+        ("video-bitrate", "Target video bitrate (e.g. 6000k)", cxxopts::value<std::string>())
+        ("maxrate", "Maximum encoder bitrate (e.g. 8000k)", cxxopts::value<std::string>())
+        ("bufsize", "Encoder buffer size (e.g. 12000k)", cxxopts::value<std::string>())
+        ("no-cache", "Disable caching", cxxopts::value<bool>()->default_value("false"))
+        ("clear-cache", "Clear all cached data", cxxopts::value<bool>()->default_value("false"))
+        ("no-growth", "Disable text growth animations", cxxopts::value<bool>()->default_value("false"))
+        ("progress", "Emit structured progress logs (PROGRESS ...)", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))
+        ("bg-theme", "Background video theme (space, nature, abstract, minimal)", cxxopts::value<std::string>())
+        ("custom-audio", "Custom audio file path or URL (gapless mode only)", cxxopts::value<std::string>())
+        ("custom-timing", "Custom timing file (VTT or SRT format)", cxxopts::value<std::string>())
+        ("batch", "Render every job of a JSONL file (one object of flags per line) in one process", cxxopts::value<std::string>())
+        ("batch-parallel", "Number of batch jobs rendered at once (default: 1)", cxxopts::value<int>()->default_value("1"))
+        ("batch-status", "File receiving one status line per batch job (default: <jobs>.status.jsonl)", cxxopts::value<std::string>())
+        ("socket", "Unix socket `qvm serve` listens on", cxxopts::value<std::string>()->default_value("/tmp/qvm.sock"))
+        ("serve-parallel", "Number of `qvm serve` jobs rendered at once (default: 1)", cxxopts::value<int>()->default_value("1"))
+        ("generate-backend-metadata,gbm", "Generate metadata for backend server and exit")
+        ("build-text-index", "Rebuild the verse text index from the configured word-by-word JSON and exit")
+        ("build-data-packs", "Convert the translation and reciter JSON files into binary data packs and exit")
+        ("seed", "Deterministic value for reproducible results", cxxopts::value<unsigned int>()->default_value("99"))
+        ("enable-dynamic-bg", "Enable dynamic background video selection based on themes", cxxopts::value<bool>()->default_value("false"))
+        ("local-video-dir", "Use local directory for dynamic backgrounds instead of R2", cxxopts::value<std::string>())
+        ("r2-endpoint", "R2 endpoint URL (e.g., https://pub-xxx.r2.dev)", cxxopts::value<std::string>())
+        ("r2-access-key", "R2 access key (for private buckets)", cxxopts::value<std::string>())
+        ("r2-secret-key", "R2 secret key (for private buckets)", cxxopts::value<std::string>())
+        ("r2-bucket", "R2 bucket name", cxxopts::value<std::string>()->default_value("quran-background-videos"))
+        ("standardize-local", "Standardize all videos in a local directory", cxxopts::value<std::string>())
+        ("standardize-r2", "Standardize videos in R2 bucket (requires credentials)", cxxopts::value<std::string>())
+        ("segment-long-verses", "Enable segmentation of long verses into timed parts", cxxopts::value<bool>()->default_value("false"))
+        ("segment-data", "Path to reciter-specific segment timing JSON file", cxxopts::value<std::string>())
+        ("long-verses", "Path to list of long verses (default: metadata/long-verses.json)", cxxopts::value<std::string>()->default_value("metadata/long-verses.json"))
+        ("h,help", "Print usage");
+
+    cli_parser.parse_positional({"surah", "from", "to"});
+    return cli_parser;
+}
+
+bool hasRange(const cxxopts::ParseResult& result) {
+    return result.count("surah") && result.count("from") && result.count("to");
+}
+
+CLIOptions toOptions(const cxxopts::ParseResult& result) {
+    if (!hasRange(result)) {
+        throw std::invalid_argument("surah, from and to are required.");
+    }
+
+    CLIOptions options;
+    options.surah = result["surah"].as<int>();
+    options.from = result["from"].as<int>();
+    options.to = result["to"].as<int>();
+    options.configPath = result["config"].as<std::string>();
+    options.configPathProvided = result.count("config") > 0;
+    if (result.count("reciter")) options.reciterId = result["reciter"].as<int>();
+    if (result.count("translation")) options.translationId = result["translation"].as<int>();
+    if (result.count("mode")) options.recitationMode = result["mode"].as<std::string>();
+    if (result.count("width")) options.width = result["width"].as<int>();
+    if (result.count("height")) options.height = result["height"].as<int>();
+    if (result.count("fps")) options.fps = result["fps"].as<int>();
+    if (result.count("arabic-font-size")) options.arabicFontSize = result["arabic-font-size"].as<int>();
+    if (result.count("translation-font-size")) options.translationFontSize = result["translation-font-size"].as<int>();
+    options.noCache = result["no-cache"].as<bool>();
+    options.clearCache = result["clear-cache"].as<bool>();
+    options.preset = result["preset"].as<std::string>();
+    options.presetProvided = result.count("preset");
+    options.encoder = result["encoder"].as<std::string>();
+    options.renderBackend = result["render-backend"].as<std::string>();
+    if (options.renderBackend != "cli" && options.renderBackend != "libav") {
+        throw std::invalid_argument("--render-backend must be 'cli' or 'libav'.");
+    }
+    options.enableTextGrowth = !result["no-growth"].as<bool>();
+    options.emitProgress = result["progress"].as<bool>();
+    if (result.count("parallel-chunks")) options.parallelChunks = result["parallel-chunks"].as<int>();
+    options.clipLibrary = result["clip-library"].as<bool>();
+    options.backgroundPlate = result["background-plate"].as<bool>();
+    options.subtitleSprites = result["subtitle-sprites"].as<bool>();
+    options.variableFrameRate = result["vfr"].as<bool>();
+    options.verseChapters = !result["no-verse-chapters"].as<bool>();
+    options.pipelineFetch = result["pipeline"].as<bool>();
+    if (result.count("extra-output")) {
+        for (const auto& spec : result["extra-output"].as<std::vector<std::string>>()) {
+            options.extraOutputs.push_back(parseOutputProfile(spec));
+        }
+    }
+    if (result.count("soft-translations")) {
+        for (int id : result["soft-translations"].as<std::vector<int>>()) {
+            if (!QuranData::translationFiles.count(id)) {
+                throw std::invalid_argument("--soft-translations: unknown translation ID " + std::to_string(id) + ".");
+            }
+            if (std::find(options.softTranslations.begin(), options.softTranslations.end(), id) == options.softTranslations.end()) {
+                options.softTranslations.push_back(id);
+            }
+        }
+    }
+    std::string burnIn = result["burn-in"].as<std::string>();
+    if (burnIn != "arabic" && burnIn != "none") {
+        throw std::invalid_argument("--burn-in must be 'arabic' or 'none'.");
+    }
+    if (burnIn == "none" && options.softTranslations.empty()) {
+        throw std::invalid_argument("--burn-in none needs --soft-translations.");
+    }
+    options.burnArabic = burnIn == "arabic";
+    if (result.count("verse-clips")) options.verseClipsDir = result["verse-clips"].as<std::string>();
+    if (result.count("download-workers")) options.downloadWorkers = result["download-workers"].as<int>();
+    if (result.count("download-host-limit")) options.downloadsPerHost = result["download-host-limit"].as<int>();
+    if (result.count("text-padding")) options.textPaddingOverride = result["text-padding"].as<double>();
+    if (result.count("quality-profile")) options.qualityProfile = result["quality-profile"].as<std::string>();
+    if (result.count("crf")) options.customCRF = result["crf"].as<int>();
+    if (result.count("pix-fmt")) options.pixelFormatOverride = result["pix-fmt"].as<std::string>();
+    if (result.count("video-bitrate")) options.videoBitrateOverride = result["video-bitrate"].as<std::string>();
+    if (result.count("maxrate")) options.videoMaxRateOverride = result["maxrate"].as<std::string>();
+    if (result.count("bufsize")) options.videoBufSizeOverride = result["bufsize"].as<std::string>();
+    if (result.count("bg-theme")) options.backgroundTheme = result["bg-theme"].as<std::string>();
+
+    // Dynamic background video options
+    options.videoSelection.seed = result["seed"].as<unsigned int>();
+    options.videoSelection.enableDynamicBackgrounds = result["enable-dynamic-bg"].as<bool>();
+    if (result.count("local-video-dir")) {
+        options.videoSelection.localVideoDirectory = result["local-video-dir"].as<std::string>();
+    }
+    if (result.count("r2-endpoint")) options.videoSelection.r2Endpoint = result["r2-endpoint"].as<std::string>();
+    if (result.count("r2-access-key")) {
+        options.videoSelection.r2AccessKey = result["r2-access-key"].as<std::string>();
+        options.videoSelection.usePublicBucket = false;
+    }
+    if (result.count("r2-secret-key")) {
+        options.videoSelection.r2SecretKey = result["r2-secret-key"].as<std::string>();
+        options.videoSelection.usePublicBucket = false;
+    }
+    if (result.count("r2-bucket")) options.videoSelection.r2Bucket = result["r2-bucket"].as<std::string>();
+
+    // Verse segmentation options
+    options.segmentLongVerses = result["segment-long-verses"].as<bool>();
+    if (result.count("segment-data")) {
+        options.segmentDataPath = result["segment-data"].as<std::string>();
+    }
+    options.longVersesPath = result["long-verses"].as<std::string>();
+
+    // Validate segmentation options
+    if (options.segmentLongVerses && options.segmentDataPath.empty()) {
+        throw std::invalid_argument("--segment-long-verses requires --segment-data to specify the segment timing file.");
+    }
+
+    // Custom recitation options
+    if (result.count("custom-audio")) options.customAudioPath = result["custom-audio"].as<std::string>();
+    if (result.count("custom-timing")) options.customTimingFile = result["custom-timing"].as<std::string>();
+
+    // Validate custom recitation usage
+    if (!options.customAudioPath.empty() || !options.customTimingFile.empty()) {
+        if (options.customAudioPath.empty() || options.customTimingFile.empty()) {
+            throw std::invalid_argument("Both --custom-audio and --custom-timing must be specified together.");
+        }
+        // Custom recitations only work in gapless mode
+        if (options.recitationMode.empty()) {
+            options.recitationMode = "gapless";
+        } else if (options.recitationMode != "gapless") {
+            throw std::invalid_argument("Custom recitations only work in gapless mode.");
+        }
+    }
+
+    // We want to allow gapless mode for custom audio
+    if (options.recitationMode == "gapless" && options.customAudioPath.empty()) {
+        throw std::invalid_argument(kGaplessDisabled);
+    }
+
+    if (result.count("output")) {
+        options.output = result["output"].as<std::string>();
+    } else {
+        options.output = "out/surah-" + std::to_string(options.surah) + "_" + std::to_string(options.from) + "-" + std::to_string(options.to) + ".mp4";
+    }
+    return options;
+}
+
+OutputProfile parseOutputProfile(const std::string& spec) {
+    auto malformed = [&]() {
+        return std::invalid_argument("--extra-output expects WIDTHxHEIGHT[@FPS]=PATH, got '" + spec + "'.");
+    };
+    size_t equals = spec.find('=');
+    if (equals == std::string::npos || equals + 1 == spec.size()) throw malformed();
+    std::string format = spec.substr(0, equals);
+
+    OutputProfile profile;
+    profile.path = spec.substr(equals + 1);
+    int width = 0, height = 0, fps = 0;
+    char trailing = 0;
+    int matched = format.find('@') == std::string::npos
+        ? std::sscanf(format.c_str(), "%dx%d%c", &width, &height, &trailing)
+        : std::sscanf(format.c_str(), "%dx%d@%d%c", &width, &height, &fps, &trailing);
+    int expected = format.find('@') == std::string::npos ? 2 : 3;
+    if (matched != expected || width <= 0 || height <= 0 || (expected == 3 && fps <= 0)) throw malformed();
+    // 4:2:0 chroma needs even dimensions
+    if (width % 2 != 0 || height % 2 != 0) {
+        throw std::invalid_argument("--extra-output sizes must be even, got '" + format + "'.");
+    }
+    profile.width = width;
+    profile.height = height;
+    profile.fps = fps;
+    return profile;
+}
+
+std::string usageNotes() {
+    return "\nRecitation Modes:\n"
+           "  gapped  - Ayah-by-ayah with pauses between verses (default)\n"
+           "  gapless - Continuous surah recitation with precise timing\n\n"
+           "Custom Recitation (gapless mode only):\n"
+           "  Use --custom-audio and --custom-timing together to specify:\n"
+           "    --custom-audio <path|url>  - Path or URL to audio file\n"
+           "    --custom-timing <file>     - VTT or SRT file with verse timings\n"
+           "  Example:\n"
+           "    --custom-audio ./my_recitation.mp3 --custom-timing ./timings.vtt\n\n"
+           "Batch Mode:\n"
+           "  --batch jobs.jsonl renders one job per line, e.g.\n"
+           "    {\"id\": \"fatiha\", \"surah\": 1, \"from\": 1, \"to\": 7, \"reciter\": 2}\n"
+           "  Keys are flag names; flags given on the command line apply to every job.\n\n"
+           "Render Server:\n"
+           "  qvm serve --socket /tmp/qvm.sock keeps data warm between jobs. Write one\n"
+           "  job line per connection to receive ACCEPTED, PROGRESS and JOB lines;\n"
+           "  {\"cancel\": \"<id>\"} cancels a job and {\"status\": true} lists them.\n\n";
+}
+
+} // namespace CommandLine
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "types.h"
+#include "cxxopts.hpp"
+
+// Command-line surface of qvm. Batch jobs are parsed with the same parser,
+// so a job line accepts exactly the flags a single render does.
+namespace CommandLine {
+
+cxxopts::Options buildParser();
+
+// Whether the parsed flags name a render (surah, from and to).
+bool hasRange(const cxxopts::ParseResult& result);
+
+// Render options from parsed flags, with the default output path filled in.
+// Throws std::invalid_argument with a user-facing message when the flags do
+// not describe a valid render.
+CLIOptions toOptions(const cxxopts::ParseResult& result);
+
+// "WIDTHxHEIGHT[@FPS]=PATH" of --extra-output. Throws std::invalid_argument
+// for malformed specs.
+OutputProfile parseOutputProfile(const std::string& spec);
+
+// Extra usage text printed after the generated help.
+std::string usageNotes();
+
+} // namespace CommandLine
@@ -151,11 +151,11 @@ void applyQualityProfile(AppConfig& cfg,
 }
 }
 
-AppConfig loadConfig(const std::string& path, CLIOptions& options) {
+std::filesystem::path resolveConfigPath(const std::string& path, bool pathProvided) {
     fs::path configPath = path;
     
     // Auto-discovery logic
-    if (!options.configPathProvided && !fs::exists(configPath)) {
+    if (!pathProvided && !fs::exists(configPath)) {
         fs::path exeDir = getExecutablePath().parent_path();
         
         // 1. Try executable directory
@@ -171,10 +171,13 @@ AppConfig loadConfig(const std::string& path, CLIOptions& options) {
             }
         }
     }
+    return fs::absolute(configPath);
+}
 
+AppConfig loadConfig(const std::string& path, CLIOptions& options) {
     // Normalize and store the resolved config path so downstream consumers (e.g. metadata)
     // report the actual file that was loaded, including auto-discovery fallbacks.
-    configPath = fs::absolute(configPath);
+    fs::path configPath = resolveConfigPath(path, options.configPathProvided);
     options.configPath = configPath.string();
 
     // Resolve assets relative to config file location
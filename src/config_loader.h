@@ -1,7 +1,10 @@
 #pragma once
 
+#include <filesystem>
 #include <string>
 #include "types.h"
 
+// The config file loadConfig would read for these options, after auto-discovery.
+std::filesystem::path resolveConfigPath(const std::string& path, bool pathProvided);
 AppConfig loadConfig(const std::string& path, CLIOptions& options);
 void validateAssets(const AppConfig& config);
@@ -0,0 +1,117 @@
+#include "data/file_digests.h"
+#include "data/pack_io.h"
+#include "data/sha256.h"
+#include "cache_utils.h"
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+constexpr int kVersion = 1;
+
+std::string storeKey(const fs::path& file) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(file, ec);
+    return (ec ? file : absolute).lexically_normal().string();
+}
+
+json readEntries(const fs::path& storePath) {
+    std::ifstream file(storePath);
+    if (!file.is_open()) return json::object();
+    json data = json::parse(file, nullptr, false);
+    if (data.is_discarded() || !data.is_object() || data.value("version", 0) != kVersion) {
+        return json::object();
+    }
+    auto entries = data.find("entries");
+    return entries != data.end() && entries->is_object() ? *entries : json::object();
+}
+
+std::string hashFile(const fs::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) return "";
+    Data::Sha256 hasher;
+    std::vector<char> buffer(1 << 20);
+    while (in) {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        hasher.update(buffer.data(), static_cast<std::size_t>(in.gcount()));
+    }
+    return in.bad() ? "" : hasher.finishHex();
+}
+
+} // namespace
+
+namespace Data {
+
+FileDigests::FileDigests(fs::path storePath)
+    : storePath_(std::move(storePath)) {}
+
+FileDigests& FileDigests::shared() {
+    static FileDigests digests(CacheUtils::getCacheRoot() / "index" / "digests.json");
+    return digests;
+}
+
+void FileDigests::loadLocked() {
+    if (loaded_) return;
+    loaded_ = true;
+    const json stored = readEntries(storePath_);
+    for (const auto& [key, value] : stored.items()) {
+        if (!value.is_object()) continue;
+        Entry entry;
+        entry.size = value.value("size", std::uint64_t{0});
+        entry.mtime = value.value("mtime", std::int64_t{0});
+        entry.digest = value.value("sha256", "");
+        if (!entry.digest.empty()) entries_.emplace(key, std::move(entry));
+    }
+}
+
+std::string FileDigests::digest(const fs::path& file) {
+    const std::string key = storeKey(file);
+    SourceStamp stamp;
+    try {
+        stamp = stampOf(file);
+    } catch (const fs::filesystem_error&) {
+        return "";
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loadLocked();
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.size == stamp.size && it->second.mtime == stamp.mtime) {
+            return it->second.digest;
+        }
+    }
+
+    std::string hex = hashFile(file);
+    if (!hex.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[key] = Entry{stamp.size, stamp.mtime, hex};
+        dirty_ = true;
+    }
+    return hex;
+}
+
+void FileDigests::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!dirty_) return;
+
+    json entries = readEntries(storePath_);
+    for (const auto& [key, entry] : entries_) {
+        entries[key] = {{"size", entry.size}, {"mtime", entry.mtime}, {"sha256", entry.digest}};
+    }
+    json data = {{"version", kVersion}, {"entries", std::move(entries)}};
+    try {
+        writeFileAtomically(storePath_, data.dump());
+        dirty_ = false;
+    } catch (const std::exception& e) {
+        std::cerr << "  ! Could not save file digests: " << e.what() << std::endl;
+    }
+}
+
+} // namespace Data
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Data {
+
+// SHA-256 digests of files, remembered in a JSON file in the cache and
+// trusted while the file's size and mtime are unchanged, so large inputs are
+// read once rather than on every render. Thread-safe.
+class FileDigests {
+public:
+    explicit FileDigests(std::filesystem::path storePath);
+
+    // Process-wide store at <cache root>/index/digests.json.
+    static FileDigests& shared();
+
+    // Hex SHA-256 of the file's contents, or "" when it cannot be read.
+    std::string digest(const std::filesystem::path& file);
+
+    // Writes new digests to disk (atomically); failures are reported only.
+    void flush();
+
+private:
+    struct Entry {
+        std::uint64_t size = 0;
+        std::int64_t mtime = 0;
+        std::string digest;
+    };
+
+    void loadLocked();
+
+    std::filesystem::path storePath_;
+    std::mutex mutex_;
+    bool loaded_ = false;
+    bool dirty_ = false;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+} // namespace Data
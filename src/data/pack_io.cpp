@@ -0,0 +1,70 @@
+#include "data/pack_io.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace Data {
+
+SourceStamp stampOf(const fs::path& source) {
+    SourceStamp stamp;
+    stamp.size = static_cast<std::uint64_t>(fs::file_size(source));
+    stamp.mtime = static_cast<std::int64_t>(fs::last_write_time(source).time_since_epoch().count());
+    return stamp;
+}
+
+bool stampMatches(std::uint64_t size, std::int64_t mtime, const fs::path& source) {
+    std::error_code ec;
+    if (!fs::exists(source, ec)) return false;
+    SourceStamp stamp = stampOf(source);
+    return stamp.size == size && stamp.mtime == mtime;
+}
+
+std::string pathDigest(const fs::path& path) {
+    // FNV-1a; stable across runs and platforms, unlike std::hash.
+    std::uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char ch : fs::absolute(path).lexically_normal().string()) {
+        hash ^= ch;
+        hash *= 1099511628211ULL;
+    }
+    std::ostringstream out;
+    out << std::hex << hash;
+    return out.str();
+}
+
+void writeFileAtomically(const fs::path& path, const std::string& bytes) {
+    std::error_code ec;
+    if (path.has_parent_path()) {
+        fs::create_directories(path.parent_path(), ec);
+    }
+    // Concurrent writers each use their own temp file; the last rename wins.
+    std::ostringstream suffix;
+    suffix << ".tmp-" << std::hash<std::thread::id>{}(std::this_thread::get_id()) << "-"
+           << std::chrono::steady_clock::now().time_since_epoch().count();
+    fs::path tempPath = path;
+    tempPath += suffix.str();
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Unable to write " + tempPath.string());
+        }
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!out) {
+            out.close();
+            fs::remove(tempPath, ec);
+            throw std::runtime_error("Failed while writing " + tempPath.string());
+        }
+    }
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        fs::remove(tempPath, ec);
+        throw std::runtime_error("Unable to install " + path.string() + ": " + ec.message());
+    }
+}
+
+} // namespace Data
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace Data {
+
+// Identity of a source file as recorded in a compiled index header. Size and
+// mtime are enough to notice edits without hashing the contents.
+struct SourceStamp {
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+};
+
+// Throws std::filesystem::filesystem_error when the file is missing.
+SourceStamp stampOf(const std::filesystem::path& source);
+
+// False when the source is missing or its stamp differs.
+bool stampMatches(std::uint64_t size, std::int64_t mtime, const std::filesystem::path& source);
+
+// Short stable digest of a path, for naming derived files in the cache.
+std::string pathDigest(const std::filesystem::path& path);
+
+// Writes bytes to a sibling temp file and renames it over `path`, so readers
+// (including ones that have the old file mapped) never see a partial write.
+void writeFileAtomically(const std::filesystem::path& path, const std::string& bytes);
+
+} // namespace Data
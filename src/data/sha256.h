@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Data {
+
+// Incremental SHA-256 (FIPS 180-4), for content addressing.
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const void* data, std::size_t size);
+    void update(std::string_view text) { update(text.data(), text.size()); }
+
+    // Lowercase hex digest. The hasher must not be updated afterwards.
+    std::string finishHex();
+
+private:
+    void compress(const unsigned char* block);
+
+    std::array<std::uint32_t, 8> state_;
+    std::array<unsigned char, 64> buffer_{};
+    std::size_t buffered_ = 0;
+    std::uint64_t totalBytes_ = 0;
+};
+
+std::string sha256Hex(std::string_view data);
+
+} // namespace Data
@@ -0,0 +1,58 @@
+#include "data/verse_keys.h"
+#include "quran_data.h"
+
+#include <array>
+#include <charconv>
+
+namespace {
+
+// firstOrdinal[s] is the ordinal of s:1; index 115 holds the total.
+const std::array<int, 116>& surahOffsets() {
+    static const std::array<int, 116> offsets = [] {
+        std::array<int, 116> table{};
+        int running = 0;
+        for (int surah = 1; surah <= 114; ++surah) {
+            table[surah] = running;
+            auto it = QuranData::verseCounts.find(surah);
+            running += (it != QuranData::verseCounts.end()) ? it->second : 0;
+        }
+        table[115] = running;
+        return table;
+    }();
+    return offsets;
+}
+
+bool parseInt(std::string_view text, int& value) {
+    if (text.empty()) return false;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+} // namespace
+
+namespace Data {
+
+int verseOrdinal(int surah, int verse) {
+    if (surah < 1 || surah > 114 || verse < 1) return -1;
+    const auto& offsets = surahOffsets();
+    int ordinal = offsets[surah] + verse - 1;
+    return ordinal < offsets[surah + 1] ? ordinal : -1;
+}
+
+bool parseVerseKey(std::string_view key, int& surah, int& verse) {
+    size_t colon = key.find(':');
+    if (colon == std::string_view::npos) return false;
+    std::string_view rest = key.substr(colon + 1);
+    size_t next = rest.find(':');
+    if (next != std::string_view::npos) rest = rest.substr(0, next);
+    return parseInt(key.substr(0, colon), surah) && parseInt(rest, verse);
+}
+
+int verseOrdinal(std::string_view key) {
+    int surah = 0;
+    int verse = 0;
+    if (!parseVerseKey(key, surah, verse)) return -1;
+    return verseOrdinal(surah, verse);
+}
+
+} // namespace Data
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string_view>
+
+namespace Data {
+
+// Number of verses in the Quran; binary indexes keep one slot per verse.
+constexpr int kTotalVerses = 6236;
+
+// Zero-based position of surah:verse in mushaf order, or -1 when the pair is
+// out of range.
+int verseOrdinal(int surah, int verse);
+
+// Parses "S:V" (trailing ":W" and anything after it is ignored). Returns false
+// on malformed input.
+bool parseVerseKey(std::string_view key, int& surah, int& verse);
+
+// Ordinal of a "S:V" key, or -1 when it is malformed or out of range.
+int verseOrdinal(std::string_view key);
+
+} // namespace Data
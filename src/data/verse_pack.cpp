@@ -0,0 +1,167 @@
+#include "data/verse_pack.h"
+#include "data/verse_keys.h"
+#include "data/pack_io.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+constexpr char kMagic[8] = {'Q', 'V', 'M', 'P', 'A', 'C', 'K', '\0'};
+constexpr std::uint32_t kVersion = 1;
+
+size_t cellCount(std::uint32_t fieldCount) {
+    return static_cast<size_t>(fieldCount) * (Data::kTotalVerses + 1) + 1;
+}
+
+std::string scalarText(const json& value) {
+    if (value.is_string()) return value.get<std::string>();
+    if (value.is_null()) return "";
+    return value.dump();
+}
+
+} // namespace
+
+namespace Data {
+
+VersePack::VersePack(const fs::path& packPath)
+    : file_(packPath) {
+    const size_t size = file_.size();
+    if (size < sizeof(Header)) {
+        throw std::runtime_error("Data pack is truncated: " + packPath.string());
+    }
+    header_ = reinterpret_cast<const Header*>(file_.data());
+    if (std::memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0 || header_->version != kVersion ||
+        header_->verseCount != static_cast<std::uint32_t>(kTotalVerses)) {
+        throw std::runtime_error("Unrecognized data pack format: " + packPath.string());
+    }
+
+    const size_t cellBytes = sizeof(std::uint32_t) * cellCount(header_->fieldCount);
+    const size_t presentBytes = static_cast<size_t>(header_->verseCount);
+    if (size != sizeof(Header) + cellBytes + presentBytes + header_->arenaSize) {
+        throw std::runtime_error("Data pack is truncated: " + packPath.string());
+    }
+
+    const unsigned char* cursor = file_.data() + sizeof(Header);
+    cells_ = reinterpret_cast<const std::uint32_t*>(cursor);
+    cursor += cellBytes;
+    present_ = reinterpret_cast<const std::uint8_t*>(cursor);
+    cursor += presentBytes;
+    arena_ = reinterpret_cast<const char*>(cursor);
+}
+
+void VersePack::build(const fs::path& sourceJson,
+                      const std::vector<std::string>& fields,
+                      const fs::path& packPath) {
+    std::ifstream file(sourceJson);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open data file: " + sourceJson.string());
+    }
+    SourceStamp stamp = stampOf(sourceJson);
+    json data = json::parse(file, nullptr, true, true);
+
+    std::vector<const json*> rows(kTotalVerses, nullptr);
+    for (auto it = data.begin(); it != data.end(); ++it) {
+        int ordinal = verseOrdinal(it.key());
+        if (ordinal >= 0 && it.value().is_object()) {
+            rows[ordinal] = &it.value();
+        }
+    }
+
+    const auto fieldCount = static_cast<std::uint32_t>(fields.size());
+    std::vector<std::uint32_t> cells;
+    cells.reserve(cellCount(fieldCount));
+    std::string present(kTotalVerses, '\0');
+    std::string arena;
+    auto appendCell = [&](const std::string& text) {
+        cells.push_back(static_cast<std::uint32_t>(arena.size()));
+        arena += text;
+    };
+
+    for (const auto& field : fields) appendCell(field);
+    for (int ordinal = 0; ordinal < kTotalVerses; ++ordinal) {
+        const json* row = rows[ordinal];
+        present[ordinal] = row ? 1 : 0;
+        for (const auto& field : fields) {
+            std::string text;
+            if (row) {
+                auto valueIt = row->find(field);
+                if (valueIt != row->end()) text = scalarText(*valueIt);
+            }
+            appendCell(text);
+        }
+    }
+    cells.push_back(static_cast<std::uint32_t>(arena.size()));
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.verseCount = static_cast<std::uint32_t>(kTotalVerses);
+    header.fieldCount = fieldCount;
+    header.arenaSize = static_cast<std::uint32_t>(arena.size());
+    header.sourceSize = stamp.size;
+    header.sourceMtime = stamp.mtime;
+
+    std::string bytes;
+    bytes.reserve(sizeof(header) + sizeof(std::uint32_t) * cells.size() + present.size() + arena.size());
+    bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytes.append(reinterpret_cast<const char*>(cells.data()), sizeof(std::uint32_t) * cells.size());
+    bytes += present;
+    bytes += arena;
+    writeFileAtomically(packPath, bytes);
+}
+
+bool VersePack::isCurrent(const fs::path& packPath,
+                          const fs::path& sourceJson,
+                          const std::vector<std::string>& fields) {
+    std::error_code ec;
+    if (!fs::exists(packPath, ec)) return false;
+    try {
+        VersePack pack(packPath);
+        if (!pack.builtFrom(sourceJson) || pack.header_->fieldCount != fields.size()) return false;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (pack.cell(i) != fields[i]) return false;
+        }
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool VersePack::builtFrom(const fs::path& sourceJson) const {
+    return stampMatches(header_->sourceSize, header_->sourceMtime, sourceJson);
+}
+
+int VersePack::fieldIndex(std::string_view name) const {
+    for (std::uint32_t i = 0; i < header_->fieldCount; ++i) {
+        if (cell(i) == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+bool VersePack::contains(std::string_view verseKey) const {
+    int ordinal = verseOrdinal(verseKey);
+    return ordinal >= 0 && present_[ordinal] != 0;
+}
+
+std::string_view VersePack::value(std::string_view verseKey, int field) const {
+    int ordinal = verseOrdinal(verseKey);
+    if (ordinal < 0 || field < 0 || static_cast<std::uint32_t>(field) >= header_->fieldCount) return {};
+    const size_t fieldCount = header_->fieldCount;
+    return cell(fieldCount * (static_cast<size_t>(ordinal) + 1) + static_cast<size_t>(field));
+}
+
+std::string_view VersePack::value(std::string_view verseKey, std::string_view fieldName) const {
+    return value(verseKey, fieldIndex(fieldName));
+}
+
+std::string_view VersePack::cell(size_t index) const {
+    return std::string_view(arena_ + cells_[index], cells_[index + 1] - cells_[index]);
+}
+
+} // namespace Data
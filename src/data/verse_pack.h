@@ -0,0 +1,72 @@
+#pragma once
+
+#include "data/mapped_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Data {
+
+// Memory-mapped, per-verse record store compiled from a JSON object keyed by
+// "S:V" (translation and ayah-by-ayah reciter files). Only the requested
+// fields are kept, each as a string: JSON strings verbatim, other scalars in
+// their JSON text form, null or missing as empty. Layout, host-endian:
+//
+//   Header
+//   uint32 cells[fieldCount * (kTotalVerses + 1) + 1]   arena offsets; the
+//          first fieldCount cells are field names, then one row per verse
+//   uint8  present[kTotalVerses]                        verse had an entry
+//   char   arena[arenaSize]
+//
+// Nothing is parsed when a pack is opened; a lookup touches one row of the
+// cell table and the bytes of the value.
+class VersePack {
+public:
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t verseCount;
+        std::uint32_t fieldCount;
+        std::uint32_t arenaSize;
+        std::uint64_t sourceSize;
+        std::int64_t sourceMtime;
+    };
+
+    explicit VersePack(const std::filesystem::path& packPath);
+
+    static void build(const std::filesystem::path& sourceJson,
+                      const std::vector<std::string>& fields,
+                      const std::filesystem::path& packPath);
+
+    // True when packPath exists, holds exactly `fields` and was built from the
+    // current sourceJson.
+    static bool isCurrent(const std::filesystem::path& packPath,
+                          const std::filesystem::path& sourceJson,
+                          const std::vector<std::string>& fields);
+
+    bool builtFrom(const std::filesystem::path& sourceJson) const;
+
+    // Column of a field name, or -1.
+    int fieldIndex(std::string_view name) const;
+
+    // Whether the source had an entry for the verse key.
+    bool contains(std::string_view verseKey) const;
+
+    // Empty when the verse, the field or the value is missing.
+    std::string_view value(std::string_view verseKey, int field) const;
+    std::string_view value(std::string_view verseKey, std::string_view fieldName) const;
+
+private:
+    std::string_view cell(std::size_t index) const;
+
+    MappedFile file_;
+    const Header* header_ = nullptr;
+    const std::uint32_t* cells_ = nullptr;
+    const std::uint8_t* present_ = nullptr;
+    const char* arena_ = nullptr;
+};
+
+} // namespace Data
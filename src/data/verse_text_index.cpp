@@ -0,0 +1,178 @@
+#include "data/verse_text_index.h"
+#include "data/verse_keys.h"
+#include "data/pack_io.h"
+#include "cache_utils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+constexpr char kMagic[8] = {'Q', 'V', 'M', 'T', 'E', 'X', 'T', '\0'};
+constexpr std::uint32_t kVersion = 1;
+
+bool headerMatches(const Data::VerseTextIndex::Header& header, const fs::path& source) {
+    return Data::stampMatches(header.sourceSize, header.sourceMtime, source);
+}
+
+template <typename T>
+void appendRaw(std::string& out, const T* values, size_t count) {
+    out.append(reinterpret_cast<const char*>(values), sizeof(T) * count);
+}
+
+} // namespace
+
+namespace Data {
+
+VerseTextIndex::VerseTextIndex(const fs::path& indexPath)
+    : file_(indexPath) {
+    const size_t size = file_.size();
+    if (size < sizeof(Header)) {
+        throw std::runtime_error("Verse text index is truncated: " + indexPath.string());
+    }
+    header_ = reinterpret_cast<const Header*>(file_.data());
+    if (std::memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0 || header_->version != kVersion ||
+        header_->verseCount != static_cast<std::uint32_t>(kTotalVerses)) {
+        throw std::runtime_error("Unrecognized verse text index format: " + indexPath.string());
+    }
+
+    const size_t verseTableBytes = sizeof(std::uint32_t) * (static_cast<size_t>(header_->verseCount) + 1);
+    const size_t wordTableBytes = sizeof(std::uint32_t) * (static_cast<size_t>(header_->wordCount) + 1);
+    if (size != sizeof(Header) + verseTableBytes + wordTableBytes + header_->arenaSize) {
+        throw std::runtime_error("Verse text index is truncated: " + indexPath.string());
+    }
+
+    const unsigned char* cursor = file_.data() + sizeof(Header);
+    verseWords_ = reinterpret_cast<const std::uint32_t*>(cursor);
+    cursor += verseTableBytes;
+    wordOffsets_ = reinterpret_cast<const std::uint32_t*>(cursor);
+    cursor += wordTableBytes;
+    arena_ = reinterpret_cast<const char*>(cursor);
+}
+
+void VerseTextIndex::build(const fs::path& sourceJson, const fs::path& indexPath) {
+    std::ifstream file(sourceJson);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open word-by-word data: " + sourceJson.string());
+    }
+    // Take the stamp before parsing so an edit made mid-build leaves the
+    // index looking stale rather than current.
+    SourceStamp stamp = stampOf(sourceJson);
+    json data = json::parse(file);
+
+    std::vector<std::vector<std::pair<int, std::string>>> verses(kTotalVerses);
+    for (auto it = data.begin(); it != data.end(); ++it) {
+        const std::string& key = it.key();
+        size_t lastColon = key.rfind(':');
+        int ordinal = verseOrdinal(key);
+        if (ordinal < 0 || lastColon == std::string::npos || key.find(':') == lastColon) {
+            continue;
+        }
+        int wordIndex = std::atoi(key.c_str() + lastColon + 1);
+        std::string text = it.value().is_object() ? it.value().value("text", "") : std::string();
+        verses[ordinal].emplace_back(wordIndex, std::move(text));
+    }
+
+    std::vector<std::uint32_t> verseWords;
+    std::vector<std::uint32_t> wordOffsets;
+    std::string arena;
+    verseWords.reserve(kTotalVerses + 1);
+    for (auto& words : verses) {
+        std::sort(words.begin(), words.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        verseWords.push_back(static_cast<std::uint32_t>(wordOffsets.size()));
+        for (const auto& word : words) {
+            wordOffsets.push_back(static_cast<std::uint32_t>(arena.size()));
+            arena += word.second;
+        }
+    }
+    verseWords.push_back(static_cast<std::uint32_t>(wordOffsets.size()));
+    const std::uint32_t wordCount = static_cast<std::uint32_t>(wordOffsets.size());
+    wordOffsets.push_back(static_cast<std::uint32_t>(arena.size()));
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.verseCount = static_cast<std::uint32_t>(kTotalVerses);
+    header.wordCount = wordCount;
+    header.arenaSize = static_cast<std::uint32_t>(arena.size());
+    header.sourceSize = stamp.size;
+    header.sourceMtime = stamp.mtime;
+
+    std::string bytes;
+    bytes.reserve(sizeof(header) + sizeof(std::uint32_t) * (verseWords.size() + wordOffsets.size()) + arena.size());
+    appendRaw(bytes, &header, 1);
+    appendRaw(bytes, verseWords.data(), verseWords.size());
+    appendRaw(bytes, wordOffsets.data(), wordOffsets.size());
+    bytes += arena;
+    writeFileAtomically(indexPath, bytes);
+}
+
+fs::path VerseTextIndex::defaultIndexPath(const fs::path& sourceJson) {
+    return CacheUtils::getCacheRoot() / "index" / ("verse-text-" + pathDigest(sourceJson) + ".bin");
+}
+
+bool VerseTextIndex::isCurrent(const fs::path& indexPath, const fs::path& sourceJson) {
+    std::ifstream in(indexPath, std::ios::binary);
+    Header header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) return false;
+    return headerMatches(header, sourceJson);
+}
+
+std::shared_ptr<const VerseTextIndex> VerseTextIndex::forSource(const fs::path& sourceJson) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const VerseTextIndex>> loaded;
+
+    fs::path indexPath = defaultIndexPath(sourceJson);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = loaded.find(indexPath.string());
+    if (it != loaded.end() && it->second->builtFrom(sourceJson)) {
+        return it->second;
+    }
+
+    if (!isCurrent(indexPath, sourceJson)) {
+        build(sourceJson, indexPath);
+    }
+    auto index = std::make_shared<const VerseTextIndex>(indexPath);
+    loaded[indexPath.string()] = index;
+    return index;
+}
+
+std::vector<std::string_view> VerseTextIndex::words(int surah, int verse) const {
+    std::vector<std::string_view> result;
+    int ordinal = verseOrdinal(surah, verse);
+    if (ordinal < 0) return result;
+    const std::uint32_t first = verseWords_[ordinal];
+    const std::uint32_t last = verseWords_[ordinal + 1];
+    result.reserve(last - first);
+    for (std::uint32_t w = first; w < last; ++w) {
+        result.emplace_back(arena_ + wordOffsets_[w], wordOffsets_[w + 1] - wordOffsets_[w]);
+    }
+    return result;
+}
+
+std::string VerseTextIndex::verseText(int surah, int verse) const {
+    std::string text;
+    for (std::string_view word : words(surah, verse)) {
+        text.append(word);
+        text.push_back(' ');
+    }
+    return text;
+}
+
+bool VerseTextIndex::builtFrom(const fs::path& sourceJson) const {
+    return headerMatches(*header_, sourceJson);
+}
+
+} // namespace Data
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "data/mapped_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Data {
+
+// Compiled, memory-mapped form of the QPC word-by-word JSON
+// ({"S:V:W": {"text": ...}}). Layout, all integers host-endian:
+//
+//   Header
+//   uint32 verseWords[kTotalVerses + 1]   first word index of each verse
+//   uint32 wordOffsets[wordCount + 1]     byte offset of each word in arena
+//   char   arena[arenaSize]               UTF-8 word text, back to back
+//
+// The header records the size and mtime of the source JSON so a stale index
+// is detected and rebuilt without reading the source.
+class VerseTextIndex {
+public:
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t verseCount;
+        std::uint32_t wordCount;
+        std::uint32_t arenaSize;
+        std::uint64_t sourceSize;
+        std::int64_t sourceMtime;
+    };
+
+    explicit VerseTextIndex(const std::filesystem::path& indexPath);
+
+    // Compiles sourceJson into indexPath (written to a temp file, then renamed).
+    static void build(const std::filesystem::path& sourceJson, const std::filesystem::path& indexPath);
+
+    // Location of the index for sourceJson under the cache root.
+    static std::filesystem::path defaultIndexPath(const std::filesystem::path& sourceJson);
+
+    // True when indexPath exists and was built from the current sourceJson.
+    static bool isCurrent(const std::filesystem::path& indexPath, const std::filesystem::path& sourceJson);
+
+    // Shared, process-wide index for sourceJson; built on first use and
+    // rebuilt whenever the source changes.
+    static std::shared_ptr<const VerseTextIndex> forSource(const std::filesystem::path& sourceJson);
+
+    // Words of surah:verse in order; views stay valid while the index lives.
+    std::vector<std::string_view> words(int surah, int verse) const;
+
+    // Words joined with a space after each one, as rendered in subtitles.
+    // Empty when the verse is unknown.
+    std::string verseText(int surah, int verse) const;
+
+    std::size_t wordCount() const { return header_->wordCount; }
+    bool builtFrom(const std::filesystem::path& sourceJson) const;
+
+private:
+    MappedFile file_;
+    const Header* header_ = nullptr;
+    const std::uint32_t* verseWords_ = nullptr;
+    const std::uint32_t* wordOffsets_ = nullptr;
+    const char* arena_ = nullptr;
+};
+
+} // namespace Data
@@ -8,5 +8,9 @@ namespace Interfaces {
     public:
         virtual ~IApiClient() = default;
         virtual std::vector<VerseData> fetchQuranData(const CLIOptions& options, const AppConfig& config) = 0;
+        // The verses fetchQuranData will return, timed from metadata alone, so
+        // encoding can start while their audio downloads. Empty when the
+        // timeline is only known from the audio or nothing needs downloading.
+        virtual std::vector<VerseData> planQuranData(const CLIOptions&, const AppConfig&) { return {}; }
     };
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include "render/render_plan.h"
 
 namespace Interfaces {
     class IProcessExecutor {
@@ -7,5 +8,11 @@ namespace Interfaces {
         virtual ~IProcessExecutor() = default;
         virtual int execute(const std::string& command) = 0;
         virtual void executeWithProgress(const std::string& command, double totalDurationSeconds) = 0;
+
+        // Run a structured render job. The default shells out to the ffmpeg CLI;
+        // in-process backends override this.
+        virtual void render(const Render::RenderPlan& plan, double totalDurationSeconds) {
+            Render::runCommandLine(*this, plan, totalDurationSeconds);
+        }
     };
 }
@@ -5,19 +5,31 @@
 #include <fstream>
 #include <nlohmann/json.hpp>
 #include <algorithm>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
 namespace {
-json load_json_file(const fs::path& path) {
+// Name tables are small and asked for on every render, so each file is
+// parsed once per process and shared by later renders (batch jobs).
+const json& load_json_file(const fs::path& path) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, json> loaded;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = loaded.find(path.string());
+    if (it != loaded.end()) return it->second;
+
+    json data;
     std::ifstream f(path);
-    if (!f.is_open()) return json();
-    json data = json::parse(f, nullptr, false);
-    if (data.is_discarded()) return json();
-    return data;
+    if (f.is_open()) {
+        data = json::parse(f, nullptr, false);
+        if (data.is_discarded()) data = json();
+    }
+    return loaded.emplace(path.string(), std::move(data)).first->second;
 }
 }
 
@@ -29,7 +41,7 @@ std::string getLanguageCode(const AppConfig& config) {
 
 std::string getLocalizedSurahName(int surah, const std::string& lang_code) {
     fs::path path = CacheUtils::resolveDataPath(fs::path("data/surah-names") / (lang_code + ".json"));
-    json data = load_json_file(path);
+    const json& data = load_json_file(path);
     std::string key = std::to_string(surah);
     if (data.is_object()) {
         auto it = data.find(key);
@@ -42,7 +54,7 @@ std::string getLocalizedSurahName(int surah, const std::string& lang_code) {
 
 std::string getLocalizedReciterName(int reciterId, const std::string& lang_code) {
     fs::path path = CacheUtils::resolveDataPath(fs::path("data/reciter-names") / (lang_code + ".json"));
-    json data = load_json_file(path);
+    const json& data = load_json_file(path);
     std::string key = std::to_string(reciterId);
     if (data.is_object()) {
         auto it = data.find(key);
@@ -54,7 +66,7 @@ std::string getLocalizedReciterName(int reciterId, const std::string& lang_code)
 }
 
 std::string getLocalizedSurahLabel(const std::string& lang_code) {
-    json data = load_json_file(CacheUtils::resolveDataPath("data/misc/surah.json"));
+    const json& data = load_json_file(CacheUtils::resolveDataPath("data/misc/surah.json"));
     if (data.is_object()) {
         auto it = data.find(lang_code);
         if (it != data.end() && it->is_string()) {
@@ -69,7 +81,7 @@ std::string getLocalizedSurahLabel(const std::string& lang_code) {
 }
 
 std::string getLocalizedNumber(int value, const std::string& lang_code) {
-    json data = load_json_file(CacheUtils::resolveDataPath("data/misc/numbers.json"));
+    const json& data = load_json_file(CacheUtils::resolveDataPath("data/misc/numbers.json"));
     auto lookup_for_lang = [&](const std::string& code) -> std::string {
         if (!data.is_object()) return "";
         auto lang_it = data.find(code);
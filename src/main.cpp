@@ -5,69 +5,78 @@
 #include "cxxopts.hpp"
 #include "video_standardizer.h"
 #include "types.h"
-#include "LiveApiClient.h"
-#include "video_generator.h"
 #include "quran_data.h"
 #include "config_loader.h"
-#include "SystemProcessExecutor.h"
-#include <memory>
 #include "metadata_writer.h"
 #include "cache_utils.h"
-#include "verse_segmentation.h"
+#include "command_line.h"
+#include "render_job.h"
+#include "batch_runner.h"
+#include "render_server.h"
+#include "data/verse_text_index.h"
+#include "background_video_manager.h"
+#include "net/download_manager.h"
+#include "resource_governor.h"
 
 namespace fs = std::filesystem;
 
+namespace {
+
+// Flags of the batch or server itself, removed before the remaining ones are applied to each job
+std::vector<std::string> jobBaseArgs(const std::vector<std::string>& invocationArgs) {
+    const std::vector<std::string> valueFlags = {"--batch", "--batch-parallel", "--batch-status",
+                                                 "--socket", "--serve-parallel"};
+    std::vector<std::string> args;
+    for (size_t i = 1; i < invocationArgs.size(); ++i) {
+        const std::string& arg = invocationArgs[i];
+        if (arg.rfind("--clear-cache", 0) == 0) continue;
+        bool skipped = false;
+        for (const auto& flag : valueFlags) {
+            if (arg == flag) {
+                ++i;
+                skipped = true;
+            } else if (arg.rfind(flag + "=", 0) == 0) {
+                skipped = true;
+            }
+        }
+        if (!skipped) args.push_back(arg);
+    }
+    return args;
+}
+
+// Splits the host between `concurrentRenders` renders and sizes the shared
+// download queue, unless flags say otherwise
+void configureResources(const cxxopts::ParseResult& result, int concurrentRenders) {
+    Resources::Governor::Settings governed;
+    if (result.count("cpus")) governed.cpus = result["cpus"].as<int>();
+    governed.concurrentRenders = concurrentRenders;
+    governed.pinCores = result["pin-cores"].as<bool>();
+    Resources::Governor::shared().configure(governed);
+
+    Net::DownloadManager::Options downloadOptions;
+    downloadOptions.workers = Resources::Governor::shared().downloadWorkers();
+    if (result.count("download-workers") && result["download-workers"].as<int>() > 0) {
+        downloadOptions.workers = result["download-workers"].as<int>();
+    }
+    if (result.count("download-host-limit") && result["download-host-limit"].as<int>() > 0) {
+        downloadOptions.perHostLimit = result["download-host-limit"].as<int>();
+    }
+    Net::DownloadManager::configureShared(downloadOptions);
+}
+
+} // namespace
+
 int main(int argc, char* argv[]) {
+    // `qvm serve [flags]` is parsed like any other invocation without its subcommand
+    bool serveMode = argc > 1 && std::string(argv[1]) == "serve";
     std::vector<std::string> invocationArgs(argv, argv + argc);
-    cxxopts::Options cli_parser("QuranVideoMaker", "Generates Quran videos using FFmpeg");
-    // TODO: fix so default values removed and values read from config instead
-    cli_parser.add_options()
-        ("surah", "Surah number", cxxopts::value<int>())
-        ("from", "Starting verse", cxxopts::value<int>())
-        ("to", "Ending verse", cxxopts::value<int>())
-        ("c,config", "Path to config file", cxxopts::value<std::string>()->default_value("./config.json"))
-        ("r,reciter", "Reciter ID", cxxopts::value<int>())
-        ("t,translation", "Translation ID", cxxopts::value<int>())
-        ("m,mode", "Recitation mode: 'gapped' (ayah-by-ayah) or 'gapless' (surah-by-surah)", cxxopts::value<std::string>())
-        ("o,output", "Output filename", cxxopts::value<std::string>())
-        ("width", "Video width", cxxopts::value<int>())
-        ("height", "Video height", cxxopts::value<int>())
-        ("fps", "Frames per second", cxxopts::value<int>())
-        ("arabic-font-size", "Override Arabic font size", cxxopts::value<int>())
-        ("translation-font-size", "Override translation font size", cxxopts::value<int>())
-        ("text-padding", "Horizontal padding fraction (0-0.45) for subtitles", cxxopts::value<double>())
-        ("e,encoder", "Choose encoder: 'software' (default) or 'hardware'", cxxopts::value<std::string>()->default_value("software"))
-        ("p,preset", "Software encoder preset for speed/quality (ultrafast, fast, medium)", cxxopts::value<std::string>()->default_value("fast"))
-        ("quality-profile", "Quality profile: speed | balanced | max", cxxopts::value<std::string>())
-        ("crf", "Constant Rate Factor (0-51). Lower improves quality.", cxxopts::value<int>())
-        ("pix-fmt", "Pixel format (e.g. yuv420p, yuv420p10le)", cxxopts::value<std::string>())
-        ("video-bitrate", "Target video bitrate (e.g. 6000k)", cxxopts::value<std::string>())
-        ("maxrate", "Maximum encoder bitrate (e.g. 8000k)", cxxopts::value<std::string>())
-        ("bufsize", "Encoder buffer size (e.g. 12000k)", cxxopts::value<std::string>())
-        ("no-cache", "Disable caching", cxxopts::value<bool>()->default_value("false"))
-        ("clear-cache", "Clear all cached data", cxxopts::value<bool>()->default_value("false"))
-        ("no-growth", "Disable text growth animations", cxxopts::value<bool>()->default_value("false"))
-        ("progress", "Emit structured progress logs (PROGRESS ...)", cxxopts::value<bool>()->default_value("false")->implicit_value("true"))
-        ("bg-theme", "Background video theme (space, nature, abstract, minimal)", cxxopts::value<std::string>())
-        ("custom-audio", "Custom audio file path or URL (gapless mode only)", cxxopts::value<std::string>())
-        ("custom-timing", "Custom timing file (VTT or SRT format)", cxxopts::value<std::string>())
-        ("generate-backend-metadata,gbm", "Generate metadata for backend server and exit")
-        ("seed", "Deterministic value for reproducible results", cxxopts::value<unsigned int>()->default_value("99"))
-        ("enable-dynamic-bg", "Enable dynamic background video selection based on themes", cxxopts::value<bool>()->default_value("false"))
-        ("local-video-dir", "Use local directory for dynamic backgrounds instead of R2", cxxopts::value<std::string>())
-        ("r2-endpoint", "R2 endpoint URL (e.g., https://pub-xxx.r2.dev)", cxxopts::value<std::string>())
-        ("r2-access-key", "R2 access key (for private buckets)", cxxopts::value<std::string>())
-        ("r2-secret-key", "R2 secret key (for private buckets)", cxxopts::value<std::string>())
-        ("r2-bucket", "R2 bucket name", cxxopts::value<std::string>()->default_value("quran-background-videos"))
-        ("standardize-local", "Standardize all videos in a local directory", cxxopts::value<std::string>())
-        ("standardize-r2", "Standardize videos in R2 bucket (requires credentials)", cxxopts::value<std::string>())
-        ("segment-long-verses", "Enable segmentation of long verses into timed parts", cxxopts::value<bool>()->default_value("false"))
-        ("segment-data", "Path to reciter-specific segment timing JSON file", cxxopts::value<std::string>())
-        ("long-verses", "Path to list of long verses (default: metadata/long-verses.json)", cxxopts::value<std::string>()->default_value("metadata/long-verses.json"))
-        ("h,help", "Print usage");
-    
-    cli_parser.parse_positional({"surah", "from", "to"});
-    auto result = cli_parser.parse(argc, argv);
+    std::vector<char*> parseArgv(argv, argv + argc);
+    if (serveMode) {
+        invocationArgs.erase(invocationArgs.begin() + 1);
+        parseArgv.erase(parseArgv.begin() + 1);
+    }
+    cxxopts::Options cli_parser = CommandLine::buildParser();
+    auto result = cli_parser.parse(static_cast<int>(parseArgv.size()), parseArgv.data());
 
     // Handle standardization
     if (result.count("standardize-local")) {
@@ -109,171 +118,121 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    if (result.count("help") || !result.count("surah") || !result.count("from") || !result.count("to")) {
-        std::cout << cli_parser.help() << std::endl;
-        std::cout << "\nRecitation Modes:\n"
-                  << "  gapped  - Ayah-by-ayah with pauses between verses (default)\n"
-                  << "  gapless - Continuous surah recitation with precise timing\n\n"
-                  << "Custom Recitation (gapless mode only):\n"
-                  << "  Use --custom-audio and --custom-timing together to specify:\n"
-                  << "    --custom-audio <path|url>  - Path or URL to audio file\n"
-                  << "    --custom-timing <file>     - VTT or SRT file with verse timings\n"
-                  << "  Example:\n"
-                  << "    --custom-audio ./my_recitation.mp3 --custom-timing ./timings.vtt\n\n";
-        return 1;
-    }
-
-    const std::string gaplessDisabledError = "Error: Gapless mode is temporarily disabled because it's too buggy and the gapless data needs to be cleaned first.";
-
-    CLIOptions options;
-    options.surah = result["surah"].as<int>();
-    options.from = result["from"].as<int>();
-    options.to = result["to"].as<int>();
-    options.configPath = result["config"].as<std::string>();
-    options.configPathProvided = result.count("config") > 0;
-    if (result.count("reciter")) options.reciterId = result["reciter"].as<int>();
-    if (result.count("translation")) options.translationId = result["translation"].as<int>();
-    if (result.count("mode")) options.recitationMode = result["mode"].as<std::string>();
-    if (result.count("width")) options.width = result["width"].as<int>();
-    if (result.count("height")) options.height = result["height"].as<int>();
-    if (result.count("fps")) options.fps = result["fps"].as<int>();
-    if (result.count("arabic-font-size")) options.arabicFontSize = result["arabic-font-size"].as<int>();
-    if (result.count("translation-font-size")) options.translationFontSize = result["translation-font-size"].as<int>();
-    options.noCache = result["no-cache"].as<bool>();
-    options.clearCache = result["clear-cache"].as<bool>();
-    options.preset = result["preset"].as<std::string>();
-    options.presetProvided = result.count("preset");
-    options.encoder = result["encoder"].as<std::string>();
-    options.enableTextGrowth = !result["no-growth"].as<bool>();
-    options.emitProgress = result["progress"].as<bool>();
-    if (result.count("text-padding")) options.textPaddingOverride = result["text-padding"].as<double>();
-    if (result.count("quality-profile")) options.qualityProfile = result["quality-profile"].as<std::string>();
-    if (result.count("crf")) options.customCRF = result["crf"].as<int>();
-    if (result.count("pix-fmt")) options.pixelFormatOverride = result["pix-fmt"].as<std::string>();
-    if (result.count("video-bitrate")) options.videoBitrateOverride = result["video-bitrate"].as<std::string>();
-    if (result.count("maxrate")) options.videoMaxRateOverride = result["maxrate"].as<std::string>();
-    if (result.count("bufsize")) options.videoBufSizeOverride = result["bufsize"].as<std::string>();
-    
-    // Dynamic background video options
-    options.videoSelection.seed = result["seed"].as<unsigned int>();
-    options.videoSelection.enableDynamicBackgrounds = result["enable-dynamic-bg"].as<bool>();
-    if (result.count("local-video-dir")) {
-        options.videoSelection.localVideoDirectory = result["local-video-dir"].as<std::string>();
-    }
-    if (result.count("r2-endpoint")) options.videoSelection.r2Endpoint = result["r2-endpoint"].as<std::string>();
-    if (result.count("r2-access-key")) {
-        options.videoSelection.r2AccessKey = result["r2-access-key"].as<std::string>();
-        options.videoSelection.usePublicBucket = false;
-    }
-    if (result.count("r2-secret-key")) {
-        options.videoSelection.r2SecretKey = result["r2-secret-key"].as<std::string>();
-        options.videoSelection.usePublicBucket = false;
-    }
-    if (result.count("r2-bucket")) options.videoSelection.r2Bucket = result["r2-bucket"].as<std::string>();
-
-    // Verse segmentation options
-    options.segmentLongVerses = result["segment-long-verses"].as<bool>();
-    if (result.count("segment-data")) {
-        options.segmentDataPath = result["segment-data"].as<std::string>();
+    if (result.count("build-text-index")) {
+        try {
+            CLIOptions options;
+            options.configPath = result["config"].as<std::string>();
+            options.configPathProvided = result.count("config") > 0;
+            AppConfig config = loadConfig(options.configPath, options);
+            fs::path indexPath = Data::VerseTextIndex::defaultIndexPath(config.quranWordByWordPath);
+            Data::VerseTextIndex::build(config.quranWordByWordPath, indexPath);
+            Data::VerseTextIndex index(indexPath);
+            std::cout << "Built verse text index (" << index.wordCount() << " words): "
+                      << indexPath.string() << std::endl;
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << "Fatal Error: " << e.what() << std::endl;
+            return 1;
+        }
     }
-    options.longVersesPath = result["long-verses"].as<std::string>();
 
-    // Validate segmentation options
-    if (options.segmentLongVerses && options.segmentDataPath.empty()) {
-        std::cerr << "Error: --segment-long-verses requires --segment-data to specify the segment timing file." << std::endl;
-        return 1;
+    if (result.count("build-data-packs")) {
+        try {
+            CLIOptions options;
+            options.configPath = result["config"].as<std::string>();
+            options.configPathProvided = result.count("config") > 0;
+            loadConfig(options.configPath, options);
+            for (const auto& [translationId, file] : QuranData::translationFiles) {
+                if (!CacheUtils::fileIsValid(CacheUtils::resolveDataPath(file))) {
+                    std::cerr << "  ! Skipping translation " << translationId << ": " << file << " not found" << std::endl;
+                    continue;
+                }
+                std::cout << "Translation " << translationId << " -> " << CacheUtils::buildTranslationPack(translationId).string() << std::endl;
+            }
+            for (const auto& [reciterId, file] : QuranData::reciterFiles) {
+                if (!CacheUtils::fileIsValid(CacheUtils::resolveDataPath(file))) {
+                    std::cerr << "  ! Skipping reciter " << reciterId << ": " << file << " not found" << std::endl;
+                    continue;
+                }
+                std::cout << "Reciter " << reciterId << " -> " << CacheUtils::buildReciterPack(reciterId).string() << std::endl;
+            }
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << "Fatal Error: " << e.what() << std::endl;
+            return 1;
+        }
     }
 
-    // Custom recitation options
-    if (result.count("custom-audio")) options.customAudioPath = result["custom-audio"].as<std::string>();
-    if (result.count("custom-timing")) options.customTimingFile = result["custom-timing"].as<std::string>();
-    
-    // Validate custom recitation usage
-    if (!options.customAudioPath.empty() || !options.customTimingFile.empty()) {
-        if (options.customAudioPath.empty() || options.customTimingFile.empty()) {
-            std::cerr << "Error: Both --custom-audio and --custom-timing must be specified together." << std::endl;
+    if (result.count("batch")) {
+        try {
+            fs::path cacheDir = CacheUtils::getCacheRoot();
+            if (result["clear-cache"].as<bool>() && fs::exists(cacheDir)) {
+                std::cout << "Clearing cache..." << std::endl;
+                fs::remove_all(cacheDir);
+            }
+            configureResources(result, result["batch-parallel"].as<int>());
+            BatchRunner::Settings settings;
+            settings.jobsFile = result["batch"].as<std::string>();
+            if (result.count("batch-status")) settings.statusFile = result["batch-status"].as<std::string>();
+            settings.parallel = result["batch-parallel"].as<int>();
+            settings.baseArgs = jobBaseArgs(invocationArgs);
+            return BatchRunner::run(settings) == 0 ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Fatal Error: " << e.what() << std::endl;
             return 1;
         }
-        // Custom recitations only work in gapless mode
-        if (options.recitationMode.empty()) {
-            options.recitationMode = "gapless";
-        } else if (options.recitationMode != "gapless") {
-            std::cerr << "Error: Custom recitations only work in gapless mode." << std::endl;
+    }
+
+    if (serveMode) {
+        try {
+            fs::path cacheDir = CacheUtils::getCacheRoot();
+            if (result["clear-cache"].as<bool>() && fs::exists(cacheDir)) {
+                std::cout << "Clearing cache..." << std::endl;
+                fs::remove_all(cacheDir);
+            }
+            configureResources(result, result["serve-parallel"].as<int>());
+            RenderServer::Settings settings;
+            settings.socketPath = result["socket"].as<std::string>();
+            settings.parallel = result["serve-parallel"].as<int>();
+            settings.baseArgs = jobBaseArgs(invocationArgs);
+            settings.configPath = result["config"].as<std::string>();
+            settings.configPathProvided = result.count("config") > 0;
+            return RenderServer::serve(settings);
+        } catch (const std::exception& e) {
+            std::cerr << "Fatal Error: " << e.what() << std::endl;
             return 1;
         }
     }
 
-    // We want to allow gapless mode for custom audio
-    if (options.recitationMode == "gapless" && options.customAudioPath.empty()) {
-        std::cerr << gaplessDisabledError << std::endl;
+    if (result.count("help") || !CommandLine::hasRange(result)) {
+        std::cout << cli_parser.help() << std::endl;
+        std::cout << CommandLine::usageNotes();
         return 1;
     }
-    
-    if (result.count("output")) {
-        options.output = result["output"].as<std::string>();
-    } else {
-        fs::path default_output_dir = "out";
-        if (!fs::exists(default_output_dir)) {
-            if (!fs::create_directories(default_output_dir)) {
-                throw std::runtime_error("Failed to create directory: " + default_output_dir.string());
-            }
-        }
-        options.output = "out/surah-" + std::to_string(options.surah) + "_" + std::to_string(options.from) + "-" + std::to_string(options.to) + ".mp4";
+
+    CLIOptions options;
+    try {
+        options = CommandLine::toOptions(result);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
     }
-    
+    configureResources(result, 1);
+
     try {
         fs::path cacheDir = CacheUtils::getCacheRoot();
         if (options.clearCache && fs::exists(cacheDir)) {
             std::cout << "Clearing cache..." << std::endl;
             fs::remove_all(cacheDir);
         }
-        
-        AppConfig config = loadConfig(options.configPath, options);
 
-        // We want to allow gapless mode for custom audio
-        if (config.recitationMode == RecitationMode::GAPLESS && options.customAudioPath.empty()) {
-            std::cerr << gaplessDisabledError << std::endl;
+        AppConfig config = RenderJob::loadJobConfig(options);
+        RenderJob::Result rendered = RenderJob::render(options, config, invocationArgs);
+        BackgroundVideo::releaseR2Clients();
+        if (!rendered.succeeded) {
+            std::cerr << "Fatal Error: " << rendered.error << std::endl;
             return 1;
         }
-        
-        // Override background theme if specified
-        if (result.count("bg-theme")) {
-            std::string theme = result["bg-theme"].as<std::string>();
-            auto it = QuranData::backgroundThemes.find(theme);
-            if (it != QuranData::backgroundThemes.end()) {
-                fs::path themePath = it->second;
-                if (!themePath.is_absolute()) {
-                    themePath = fs::path(config.assetFolderPath) / themePath;
-                }
-                config.assetBgVideo = themePath.string();
-            } else {
-                std::cerr << "Warning: Unknown theme '" << theme << "', using default." << std::endl;
-            }
-        }
-        
-        validateAssets(config);
-
-        std::string modeStr = (config.recitationMode == RecitationMode::GAPLESS) ? "gapless" : "gapped";
-        std::cout << "Rendering Surah " << options.surah << ", verses " << options.from << "-" << options.to << std::endl;
-        std::cout << "Mode: " << modeStr << std::endl;
-        std::cout << "Config: " << config.width << "x" << config.height << " @ " << config.fps << "fps, reciter=" << config.reciterId << ", translation=" << config.translationId << std::endl;
-        std::cout << "Text growth: " << (config.enableTextGrowth ? "enabled" : "disabled") << std::endl;
-
-    auto processExecutor = std::make_shared<SystemProcessExecutor>();
-    auto apiClient = std::make_shared<LiveApiClient>();
-    auto verses = apiClient->fetchQuranData(options, config);
-
-    // Create segmentation manager if enabled
-    auto segmentManager = VerseSegmentation::createManager(
-        options.segmentLongVerses,
-        options.longVersesPath,
-        options.segmentDataPath
-    );
-
-    MetadataWriter::writeMetadata(options, config, invocationArgs);
-    VideoGenerator::generateVideo(options, config, verses, processExecutor, segmentManager.get());
-    VideoGenerator::generateThumbnail(options, config, processExecutor);
-
     } catch (const std::exception& e) {
         std::cerr << "Fatal Error: " << e.what() << std::endl;
         return 1;
@@ -1,5 +1,6 @@
 #include "metadata_writer.h"
 #include "quran_data.h"
+#include "resource_governor.h"
 #include <cerrno>
 #include <chrono>
 #include <filesystem>
@@ -214,13 +215,35 @@ json buildArtifactsBlock(const CLIOptions& options) {
     return artifacts;
 }
 
+json buildResourcesBlock(const ResourceBudget& budget) {
+    const Resources::HostInfo& host = Resources::Governor::shared().host();
+    json block = {
+        {"cpus", budget.cpus},
+        {"encoderThreads", budget.encoderThreads},
+        {"filterThreads", budget.filterThreads},
+        {"memoryBytes", budget.memoryBytes},
+        {"coreSet", budget.coreSet},
+        {"host", {
+            {"logicalCpus", host.logicalCpus},
+            {"usableCpus", host.usableCpus()},
+            {"cgroupCpuQuota", host.cgroupCpuQuota},
+            {"usableMemoryBytes", host.usableMemoryBytes()},
+            {"numaNodes", host.numaNodes.size()}
+        }}
+    };
+    if (budget.numaNode >= 0) block["numaNode"] = budget.numaNode;
+    return block;
+}
+
 } // namespace
 
 namespace MetadataWriter {
 
 void writeMetadata(const CLIOptions& options,
                    const AppConfig& config,
-                   const std::vector<std::string>& rawArgs) {
+                   const std::vector<std::string>& rawArgs,
+                   const std::string& renderFingerprint,
+                   bool servedFromCache) {
     fs::path outputPath = options.output.empty() ? fs::path("out/render.mp4") : fs::path(options.output);
     fs::path metadataPath = outputPath;
     metadataPath.replace_extension(".metadata.json");
@@ -235,6 +258,15 @@ void writeMetadata(const CLIOptions& options,
     metadata["command"] = buildCommandBlock(rawArgs);
     metadata["paths"] = buildPathsBlock(options, config, metadataPath);
     metadata["artifacts"] = buildArtifactsBlock(options);
+    if (options.resources.cpus > 0) {
+        metadata["resources"] = buildResourcesBlock(options.resources);
+    }
+    if (!renderFingerprint.empty()) {
+        metadata["render"] = {
+            {"fingerprint", renderFingerprint},
+            {"servedFromCache", servedFromCache}
+        };
+    }
 
     std::ofstream file(metadataPath);
     if (!file.is_open()) {
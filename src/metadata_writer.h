@@ -7,9 +7,13 @@
 
 namespace MetadataWriter {
 
+// `renderFingerprint` identifies the render in the output cache (empty when
+// caching is off); `servedFromCache` marks outputs restored from it.
 void writeMetadata(const CLIOptions& options,
                    const AppConfig& config,
-                   const std::vector<std::string>& rawArgs);
+                   const std::vector<std::string>& rawArgs,
+                   const std::string& renderFingerprint = "",
+                   bool servedFromCache = false);
 
 void generateBackendMetadata(const std::string& outputPath);
 
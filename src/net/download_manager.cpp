@@ -0,0 +1,518 @@
+#include "net/download_manager.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <string_view>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <cpr/cpr.h>
+#if __has_include(<cpr/http_version.h>)
+#include <cpr/http_version.h>
+#define QVM_CPR_HAS_HTTP_VERSION 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::mutex sharedOptionsMutex;
+Net::DownloadManager::Options sharedOptions;
+bool sharedCreated = false;
+
+void configureSession(cpr::Session& session) {
+    session.SetTimeout(cpr::Timeout{60000});
+    session.SetVerifySsl(cpr::VerifySsl{true});
+    session.SetRedirect(cpr::Redirect{true});
+#ifdef QVM_CPR_HAS_HTTP_VERSION
+    // Negotiates HTTP/2 over TLS via ALPN and falls back to HTTP/1.1.
+    session.SetHttpVersion(cpr::HttpVersion{cpr::HttpVersionCode::VERSION_2_0_TLS});
+#endif
+}
+
+bool fileIsValid(const fs::path& path) {
+    std::error_code ec;
+    return fs::exists(path, ec) && fs::file_size(path, ec) > 0;
+}
+
+std::uintmax_t sizeOrZero(const fs::path& path) {
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    return ec ? 0 : size;
+}
+
+fs::path withSuffix(const fs::path& path, const char* suffix) {
+    fs::path result = path;
+    result += suffix;
+    return result;
+}
+
+std::string lowerCase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return value;
+}
+
+// Identity of a partially downloaded resource, kept next to the .part file
+// so a retry (or a later run) only asks for the bytes that are missing.
+struct PartialInfo {
+    std::string validator;        // ETag, or Last-Modified when there is no ETag
+    std::int64_t totalBytes = -1; // full resource size, -1 when unknown
+};
+
+PartialInfo readPartialInfo(const fs::path& metaPath) {
+    PartialInfo info;
+    std::ifstream in(metaPath);
+    if (in.is_open()) {
+        std::getline(in, info.validator);
+        std::string total;
+        if (std::getline(in, total) && !total.empty()) {
+            info.totalBytes = std::strtoll(total.c_str(), nullptr, 10);
+        }
+    }
+    return info;
+}
+
+void writePartialInfo(const fs::path& metaPath, const PartialInfo& info) {
+    std::ofstream out(metaPath, std::ios::trunc);
+    out << info.validator << "\n" << info.totalBytes << "\n";
+}
+
+// Response headers of the final hop (redirects reset the state).
+struct ResponseHead {
+    long status = 0;
+    std::string etag;
+    std::string lastModified;
+    std::int64_t contentLength = -1;
+    std::int64_t rangeStart = -1;
+    std::int64_t rangeTotal = -1;
+    bool acceptsRanges = false;
+    bool contentEncoded = false;  // lengths then describe the encoded body
+
+    void consume(std::string_view line) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) line.remove_suffix(1);
+        if (line.rfind("HTTP/", 0) == 0) {
+            *this = ResponseHead{};
+            size_t space = line.find(' ');
+            if (space != std::string_view::npos) {
+                status = std::strtol(std::string(line.substr(space + 1)).c_str(), nullptr, 10);
+            }
+            return;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) return;
+        std::string name = lowerCase(std::string(line.substr(0, colon)));
+        std::string value(line.substr(colon + 1));
+        value.erase(0, value.find_first_not_of(" \t"));
+        if (name == "etag") {
+            etag = value;
+        } else if (name == "last-modified") {
+            lastModified = value;
+        } else if (name == "content-length") {
+            contentLength = std::strtoll(value.c_str(), nullptr, 10);
+        } else if (name == "content-encoding") {
+            contentEncoded = lowerCase(value) != "identity";
+        } else if (name == "accept-ranges") {
+            acceptsRanges = lowerCase(value).find("bytes") != std::string::npos;
+        } else if (name == "content-range") {
+            // "bytes <start>-<end>/<total|*>"
+            size_t space = value.find(' ');
+            size_t slash = value.find('/');
+            if (space != std::string::npos) rangeStart = std::strtoll(value.c_str() + space + 1, nullptr, 10);
+            if (slash != std::string::npos && value[slash + 1] != '*') {
+                rangeTotal = std::strtoll(value.c_str() + slash + 1, nullptr, 10);
+            }
+        }
+    }
+
+    std::string validator() const {
+        // Weak ETags are not allowed in If-Range; fall back to the date.
+        if (!etag.empty() && etag.rfind("W/", 0) != 0) return etag;
+        return lastModified;
+    }
+};
+
+// One transfer with retries on an already configured, reusable session.
+//
+// Bytes are staged in "<destination>.part" and renamed into place only after
+// the size matches what the server announced, so an interrupted download
+// never looks like a valid cache entry. When the server supports ranges and
+// gives a validator (ETag or Last-Modified), retries resume with
+// "Range: bytes=<have>-" guarded by If-Range; a changed resource answers 200
+// and the part file is restarted. A 206 for some other range than the one
+// asked for cannot be appended, so the part file is dropped and the transfer
+// restarts at once with a plain GET.
+bool fetchToFile(cpr::Session& session, const std::string& url, const fs::path& destination, int maxRetries) {
+    if (destination.has_parent_path()) {
+        std::error_code ec;
+        fs::create_directories(destination.parent_path(), ec);
+    }
+    const fs::path partPath = withSuffix(destination, ".part");
+    const fs::path metaPath = withSuffix(destination, ".part.meta");
+    auto discardPartial = [&]() {
+        std::error_code ec;
+        fs::remove(partPath, ec);
+        fs::remove(metaPath, ec);
+    };
+
+    for (int attempt = 1; attempt <= maxRetries; ++attempt) {
+        PartialInfo partial = readPartialInfo(metaPath);
+        std::uintmax_t have = sizeOrZero(partPath);
+        if (have > 0 && partial.validator.empty()) {
+            // Nothing to prove the bytes belong to the current resource.
+            discardPartial();
+            have = 0;
+        }
+        if (have > 0 && partial.totalBytes > 0 && static_cast<std::int64_t>(have) >= partial.totalBytes) {
+            // Completed earlier but never renamed (e.g. the process died).
+            if (static_cast<std::int64_t>(have) == partial.totalBytes) {
+                std::error_code ec;
+                fs::rename(partPath, destination, ec);
+                if (!ec) {
+                    fs::remove(metaPath, ec);
+                    return true;
+                }
+            }
+            discardPartial();
+            have = 0;
+        }
+
+        cpr::Header headers{{"User-Agent", "quran-video-maker/1.0"}};
+        if (have > 0) {
+            headers["Range"] = "bytes=" + std::to_string(have) + "-";
+            headers["If-Range"] = partial.validator;
+        }
+        session.SetHeader(headers);
+        session.SetUrl(cpr::Url{url});
+
+        ResponseHead head;
+        std::ofstream out;
+        bool appending = false;
+        bool writeFailed = false;
+        bool rangeMismatch = false;
+        session.SetHeaderCallback(cpr::HeaderCallback{[&](std::string_view line, intptr_t) {
+            head.consume(line);
+            return true;
+        }});
+        auto response = session.Download(cpr::WriteCallback{[&](std::string_view data, intptr_t) {
+            if (!out.is_open()) {
+                // First body bytes: the final response headers are known now.
+                if (head.status < 200 || head.status >= 300) return true; // error body, ignore
+                appending = head.status == 206 && head.rangeStart == static_cast<std::int64_t>(have);
+                if (head.status == 206 && !appending) {
+                    rangeMismatch = true;
+                    writeFailed = true;
+                    return false;
+                }
+                PartialInfo info;
+                if (!head.contentEncoded) {
+                    info.validator = (head.acceptsRanges || head.status == 206) ? head.validator() : std::string();
+                    info.totalBytes = head.status == 206 ? head.rangeTotal : head.contentLength;
+                }
+                if (appending && info.validator.empty()) info.validator = partial.validator;
+                writePartialInfo(metaPath, info);
+                partial = info;
+                out.open(partPath, std::ios::binary | (appending ? std::ios::app : std::ios::trunc));
+                if (!out.is_open()) {
+                    writeFailed = true;
+                    return false;
+                }
+            }
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            return static_cast<bool>(out);
+        }});
+        if (out.is_open()) out.close();
+
+        const bool transferOk = response.error.code == cpr::ErrorCode::OK && !writeFailed &&
+                                head.status >= 200 && head.status < 300;
+        const std::uintmax_t got = sizeOrZero(partPath);
+        const bool sizeOk = partial.totalBytes < 0 ? got > 0
+                                                   : static_cast<std::int64_t>(got) == partial.totalBytes;
+        if (transferOk && sizeOk) {
+            std::error_code ec;
+            fs::rename(partPath, destination, ec);
+            if (ec) {
+                // Windows cannot rename over an existing file.
+                fs::remove(destination, ec);
+                fs::rename(partPath, destination, ec);
+            }
+            if (!ec && fileIsValid(destination)) {
+                fs::remove(metaPath, ec);
+                return true;
+            }
+        }
+
+        if (rangeMismatch && have > 0) {
+            // Not a failed attempt: the next request asks for the whole resource.
+            discardPartial();
+            --attempt;
+            continue;
+        }
+        if (head.status == 416 || (transferOk && !sizeOk)) {
+            // Our range no longer fits the resource, or the body does not
+            // match its announced length: start over next time.
+            discardPartial();
+        } else if (partial.validator.empty()) {
+            // The server cannot resume this resource; keep nothing.
+            discardPartial();
+        }
+
+        if (attempt == maxRetries) {
+            std::cerr << "  ! Download failed for " << url
+                      << " (HTTP " << (head.status ? head.status : response.status_code)
+                      << ", cpr error=" << static_cast<int>(response.error.code)
+                      << " - " << response.error.message << ")" << std::endl;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(250 * attempt));
+    }
+    return false;
+}
+
+// Fetches one byte range into destination. Returns false at once when the
+// server answers with anything but the requested range.
+bool fetchRangeToFile(cpr::Session& session, const std::string& url, const fs::path& destination,
+                      std::int64_t firstByte, std::int64_t lastByte, int maxRetries) {
+    if (destination.has_parent_path()) {
+        std::error_code ec;
+        fs::create_directories(destination.parent_path(), ec);
+    }
+    const fs::path partPath = withSuffix(destination, ".part");
+    for (int attempt = 1; attempt <= maxRetries; ++attempt) {
+        session.SetHeader(cpr::Header{{"User-Agent", "quran-video-maker/1.0"},
+                                      {"Range", "bytes=" + std::to_string(firstByte) + "-" + std::to_string(lastByte)}});
+        session.SetUrl(cpr::Url{url});
+
+        ResponseHead head;
+        std::ofstream out;
+        bool rangeIgnored = false;
+        session.SetHeaderCallback(cpr::HeaderCallback{[&](std::string_view line, intptr_t) {
+            head.consume(line);
+            return true;
+        }});
+        auto response = session.Download(cpr::WriteCallback{[&](std::string_view data, intptr_t) {
+            if (!out.is_open()) {
+                if (head.status < 200 || head.status >= 300) return true;
+                if (head.status != 206 || head.rangeStart != firstByte || head.contentEncoded) {
+                    // Whole resource or some other slice: stop before it all arrives.
+                    rangeIgnored = true;
+                    return false;
+                }
+                out.open(partPath, std::ios::binary | std::ios::trunc);
+                if (!out.is_open()) return false;
+            }
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            return static_cast<bool>(out);
+        }});
+        if (out.is_open()) out.close();
+
+        if (rangeIgnored || head.status == 200 || head.status == 416) {
+            std::error_code ec;
+            fs::remove(partPath, ec);
+            return false;
+        }
+        const std::uintmax_t got = sizeOrZero(partPath);
+        const bool ok = response.error.code == cpr::ErrorCode::OK && head.status == 206 && got > 0 &&
+                        (head.contentLength < 0 || static_cast<std::int64_t>(got) == head.contentLength);
+        if (ok) {
+            std::error_code ec;
+            fs::rename(partPath, destination, ec);
+            if (ec) {
+                fs::remove(destination, ec);
+                fs::rename(partPath, destination, ec);
+            }
+            if (!ec) return true;
+        }
+
+        std::error_code ec;
+        fs::remove(partPath, ec);
+        if (attempt == maxRetries) {
+            std::cerr << "  ! Range download failed for " << url
+                      << " (HTTP " << (head.status ? head.status : response.status_code)
+                      << ", cpr error=" << static_cast<int>(response.error.code)
+                      << " - " << response.error.message << ")" << std::endl;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(250 * attempt));
+    }
+    return false;
+}
+
+} // namespace
+
+namespace Net {
+
+DownloadManager::DownloadManager(Options options)
+    : options_(options) {
+    options_.workers = std::max(1, options_.workers);
+    options_.perHostLimit = std::max(1, options_.perHostLimit);
+    workers_.reserve(static_cast<size_t>(options_.workers));
+    for (int i = 0; i < options_.workers; ++i) {
+        workers_.emplace_back(&DownloadManager::workerLoop, this);
+    }
+}
+
+DownloadManager::~DownloadManager() {
+    std::list<Job> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        abandoned.swap(queue_);
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) worker.join();
+    }
+    for (auto& job : abandoned) {
+        job.promise->set_value(false);
+    }
+}
+
+DownloadManager& DownloadManager::shared() {
+    static DownloadManager* instance = [] {
+        std::lock_guard<std::mutex> lock(sharedOptionsMutex);
+        sharedCreated = true;
+        // Intentionally leaked: workers must not be joined during static
+        // destruction, after cpr/curl globals may already be gone.
+        return new DownloadManager(sharedOptions);
+    }();
+    return *instance;
+}
+
+void DownloadManager::configureShared(Options options) {
+    std::lock_guard<std::mutex> lock(sharedOptionsMutex);
+    if (sharedCreated) {
+        std::cerr << "Warning: download limits changed after the download manager started; ignoring." << std::endl;
+        return;
+    }
+    sharedOptions = options;
+}
+
+std::string DownloadManager::hostKey(const std::string& url) {
+    size_t schemeEnd = url.find("://");
+    size_t hostStart = (schemeEnd == std::string::npos) ? 0 : schemeEnd + 3;
+    size_t hostEnd = url.find_first_of("/?#", hostStart);
+    std::string key = url.substr(0, hostEnd == std::string::npos ? url.size() : hostEnd);
+    std::transform(key.begin(), key.end(), key.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return key;
+}
+
+std::shared_future<bool> DownloadManager::enqueue(const std::string& url,
+                                                  const fs::path& destination,
+                                                  Priority priority,
+                                                  int maxRetries) {
+    Job job;
+    job.url = url;
+    job.destination = destination;
+    job.priority = priority;
+    job.maxRetries = maxRetries;
+    return submit(std::move(job));
+}
+
+std::shared_future<bool> DownloadManager::enqueueRange(const std::string& url,
+                                                       const fs::path& destination,
+                                                       std::int64_t firstByte,
+                                                       std::int64_t lastByte,
+                                                       Priority priority,
+                                                       int maxRetries) {
+    Job job;
+    job.url = url;
+    job.destination = destination;
+    job.priority = priority;
+    job.maxRetries = maxRetries;
+    job.firstByte = std::max<std::int64_t>(0, firstByte);
+    job.lastByte = std::max(job.firstByte, lastByte);
+    return submit(std::move(job));
+}
+
+std::shared_future<bool> DownloadManager::submit(Job job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string destinationKey = job.destination.lexically_normal().string();
+    auto pendingIt = pending_.find(destinationKey);
+    if (pendingIt != pending_.end()) {
+        // Let an urgent request pull an already queued transfer forward.
+        for (auto& queued : queue_) {
+            if (queued.destination.lexically_normal().string() == destinationKey && queued.priority < job.priority) {
+                queued.priority = job.priority;
+            }
+        }
+        return pendingIt->second;
+    }
+    if (stopping_) {
+        std::promise<bool> rejected;
+        rejected.set_value(false);
+        return rejected.get_future().share();
+    }
+
+    job.host = hostKey(job.url);
+    job.maxRetries = std::max(1, job.maxRetries);
+    job.sequence = nextSequence_++;
+    job.promise = std::make_shared<std::promise<bool>>();
+    std::shared_future<bool> future = job.promise->get_future().share();
+    pending_.emplace(destinationKey, future);
+    queue_.push_back(std::move(job));
+    wake_.notify_one();
+    return future;
+}
+
+bool DownloadManager::download(const std::string& url,
+                               const fs::path& destination,
+                               Priority priority,
+                               int maxRetries) {
+    return enqueue(url, destination, priority, maxRetries).get();
+}
+
+std::list<DownloadManager::Job>::iterator DownloadManager::nextRunnable() {
+    auto best = queue_.end();
+    for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+        auto active = activePerHost_.find(it->host);
+        if (active != activePerHost_.end() && active->second >= options_.perHostLimit) continue;
+        if (best == queue_.end() || it->priority > best->priority ||
+            (it->priority == best->priority && it->sequence < best->sequence)) {
+            best = it;
+        }
+    }
+    return best;
+}
+
+void DownloadManager::workerLoop() {
+    cpr::Session session;
+    configureSession(session);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        std::list<Job>::iterator next;
+        wake_.wait(lock, [&] {
+            if (stopping_) return true;
+            next = nextRunnable();
+            return next != queue_.end();
+        });
+        if (stopping_) return;
+
+        Job job = std::move(*next);
+        queue_.erase(next);
+        ++activePerHost_[job.host];
+        lock.unlock();
+
+        bool ok = false;
+        try {
+            ok = job.firstByte >= 0
+                ? fetchRangeToFile(session, job.url, job.destination, job.firstByte, job.lastByte, job.maxRetries)
+                : fetchToFile(session, job.url, job.destination, job.maxRetries);
+        } catch (const std::exception& e) {
+            std::cerr << "  ! Download failed for " << job.url << ": " << e.what() << std::endl;
+        }
+
+        lock.lock();
+        if (--activePerHost_[job.host] == 0) activePerHost_.erase(job.host);
+        pending_.erase(job.destination.lexically_normal().string());
+        job.promise->set_value(ok);
+        // A host slot opened up; jobs skipped for that host may now run.
+        wake_.notify_all();
+    }
+}
+
+} // namespace Net
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Net {
+
+enum class Priority {
+    Low = 0,     // speculative prefetch (e.g. upcoming background clips)
+    Normal = 1,  // per-verse audio
+    High = 2     // something a render is blocked on right now
+};
+
+// Fixed pool of download workers shared by the whole process.
+//
+// Each worker owns one HTTP session for its lifetime, so connections stay open
+// between files (keep-alive, and HTTP/2 where the server and curl support it)
+// instead of paying a TCP/TLS handshake per file. Queued work is served by
+// priority, then in submission order, and no more than `perHostLimit`
+// transfers run against one host at a time. Requests for a destination that
+// is already queued or in flight share the existing transfer.
+class DownloadManager {
+public:
+    struct Options {
+        int workers = 8;
+        int perHostLimit = 4;
+    };
+
+    explicit DownloadManager(Options options);
+    DownloadManager() : DownloadManager(Options{}) {}
+    ~DownloadManager();
+
+    DownloadManager(const DownloadManager&) = delete;
+    DownloadManager& operator=(const DownloadManager&) = delete;
+
+    // Process-wide instance, created on first use with the options passed to
+    // configureShared() (or the defaults).
+    static DownloadManager& shared();
+    // Must be called before the first shared(); later calls are ignored.
+    static void configureShared(Options options);
+
+    // Queues url -> destination. The future becomes true once the file is in
+    // place and non-empty, false when every attempt failed.
+    std::shared_future<bool> enqueue(const std::string& url,
+                                     const std::filesystem::path& destination,
+                                     Priority priority = Priority::Normal,
+                                     int maxRetries = 4);
+
+    // Queues bytes [firstByte, lastByte] of url -> destination (fewer when the
+    // resource ends earlier). Resolves false without retrying when the server
+    // ignores the Range header, so callers can fall back to a full download.
+    std::shared_future<bool> enqueueRange(const std::string& url,
+                                          const std::filesystem::path& destination,
+                                          std::int64_t firstByte,
+                                          std::int64_t lastByte,
+                                          Priority priority = Priority::Normal,
+                                          int maxRetries = 4);
+
+    // Blocking convenience wrapper. Do not call from inside a download worker.
+    bool download(const std::string& url,
+                  const std::filesystem::path& destination,
+                  Priority priority = Priority::Normal,
+                  int maxRetries = 4);
+
+    const Options& options() const { return options_; }
+
+    // "scheme://host[:port]" of a URL; the unit of the per-host limit.
+    static std::string hostKey(const std::string& url);
+
+private:
+    struct Job {
+        std::string url;
+        std::filesystem::path destination;
+        std::string host;
+        Priority priority = Priority::Normal;
+        int maxRetries = 4;
+        std::int64_t firstByte = -1;  // >= 0 for a ranged transfer
+        std::int64_t lastByte = -1;
+        std::uint64_t sequence = 0;
+        std::shared_ptr<std::promise<bool>> promise;
+    };
+
+    std::shared_future<bool> submit(Job job);
+    void workerLoop();
+    // Highest-priority queued job whose host has a free slot; caller holds mutex_.
+    std::list<Job>::iterator nextRunnable();
+
+    Options options_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::list<Job> queue_;
+    std::unordered_map<std::string, int> activePerHost_;
+    std::unordered_map<std::string, std::shared_future<bool>> pending_;
+    std::uint64_t nextSequence_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace Net
@@ -0,0 +1,54 @@
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <vector>
+
+namespace Parallel {
+
+void forEach(size_t count, size_t workers, const Work& work, const Progress& onDone) {
+    forEachWithState(count, workers, [&work]() { return work; }, onDone);
+}
+
+void forEachWithState(size_t count, size_t workers, const std::function<Work()>& makeWork, const Progress& onDone) {
+    if (count == 0) return;
+    workers = std::max<size_t>(1, std::min(workers, count));
+
+    std::atomic<size_t> next{0};
+    size_t done = 0;
+    std::atomic<bool> failed{false};
+    std::mutex progressMutex;
+    std::vector<std::future<void>> pool;
+    for (size_t w = 0; w < workers; ++w) {
+        pool.push_back(std::async(std::launch::async, [&]() {
+            try {
+                Work work = makeWork();
+                for (size_t i = next++; i < count && !failed; i = next++) {
+                    work(i);
+                    if (onDone) {
+                        // Counted under the lock, so reports only ever go up
+                        std::lock_guard<std::mutex> lock(progressMutex);
+                        onDone(++done);
+                    }
+                }
+            } catch (...) {
+                failed = true;
+                throw;
+            }
+        }));
+    }
+    std::exception_ptr failure;
+    for (auto& worker : pool) {
+        try {
+            worker.get();
+        } catch (...) {
+            if (!failure) failure = std::current_exception();
+        }
+    }
+    if (failure) std::rethrow_exception(failure);
+}
+
+} // namespace Parallel
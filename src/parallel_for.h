@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Bounded worker pools for independent items (chunk and clip encodes, verse
+// fetches, sprite rasterization, video downloads).
+namespace Parallel {
+
+using Work = std::function<void(size_t index)>;
+// Called after each item with the number finished so far, one call at a time.
+using Progress = std::function<void(size_t finished)>;
+
+// Runs work(0) .. work(count - 1) on up to `workers` threads, taking items in
+// index order. Once an item throws no further items start; the first
+// exception is rethrown after every worker has stopped.
+void forEach(size_t count, size_t workers, const Work& work, const Progress& onDone = nullptr);
+
+// As forEach, for work that needs per-thread state: makeWork runs once on
+// each worker thread and returns the work that thread applies to its items.
+void forEachWithState(size_t count,
+                      size_t workers,
+                      const std::function<Work()>& makeWork,
+                      const Progress& onDone = nullptr);
+
+} // namespace Parallel
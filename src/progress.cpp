@@ -0,0 +1,42 @@
+#include "progress.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace Progress {
+
+std::string format(const std::string& stage,
+                   const std::string& status,
+                   double percent,
+                   double elapsedSeconds,
+                   double etaSeconds,
+                   const std::string& message) {
+    std::ostringstream oss;
+    oss.setf(std::ios::fixed);
+    oss << std::setprecision(2);
+    oss << "PROGRESS {\"stage\":\"" << stage << "\",\"status\":\"" << status << "\"";
+    if (percent >= 0.0) oss << ",\"percent\":" << percent;
+    if (elapsedSeconds >= 0.0) oss << ",\"elapsedSeconds\":" << elapsedSeconds;
+    if (etaSeconds >= 0.0) oss << ",\"etaSeconds\":" << etaSeconds;
+    if (!message.empty()) oss << ",\"message\":\"" << message << "\"";
+    oss << "}";
+    return oss.str();
+}
+
+void emit(const Sink& sink,
+          const std::string& stage,
+          const std::string& status,
+          double percent,
+          double elapsedSeconds,
+          double etaSeconds,
+          const std::string& message) {
+    std::string line = format(stage, status, percent, elapsedSeconds, etaSeconds, message);
+    if (sink) {
+        sink(line);
+    } else {
+        std::cout << line << std::endl;
+    }
+}
+
+} // namespace Progress
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+// Structured `PROGRESS {...}` lines for job runners. They go to stdout unless
+// the render was given a sink (`qvm serve` streams them to the client).
+namespace Progress {
+
+using Sink = std::function<void(const std::string& line)>;
+
+// Negative numbers and an empty message are left out of the event.
+std::string format(const std::string& stage,
+                   const std::string& status,
+                   double percent = -1.0,
+                   double elapsedSeconds = -1.0,
+                   double etaSeconds = -1.0,
+                   const std::string& message = "");
+
+void emit(const Sink& sink,
+          const std::string& stage,
+          const std::string& status,
+          double percent = -1.0,
+          double elapsedSeconds = -1.0,
+          double etaSeconds = -1.0,
+          const std::string& message = "");
+
+} // namespace Progress
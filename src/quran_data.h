@@ -39,6 +39,14 @@ namespace QuranData {
         {3, "amh"},
         {4, "urd"}
     };
+
+    // ISO 639-2 codes for the language tag of timed-text tracks
+    inline const std::map<int, std::string> translationTrackLanguages = {
+        {1, "eng"},
+        {2, "orm"},
+        {3, "amh"},
+        {4, "urd"}
+    };
     
     // Mapping translationId -> translation JSON path
     inline const std::map<int, std::string> translationFiles = {
@@ -350,6 +358,14 @@ namespace QuranData {
         return "en";
     }
 
+    inline std::string getTranslationTrackLanguage(int translationId) {
+        auto it = translationTrackLanguages.find(translationId);
+        if (it != translationTrackLanguages.end()) {
+            return it->second;
+        }
+        return "und";
+    }
+
     inline bool isTranslationRtl(int translationId) {
         auto it = translationDirectionIsRtl.find(translationId);
         if (it != translationDirectionIsRtl.end()) {
@@ -136,6 +136,15 @@ std::string Client::downloadVideo(const std::string& key, const fs::path& localP
     if (!fs::exists(localPath) || fs::file_size(localPath) == 0) {
         throw std::runtime_error("Downloaded file is empty or missing: " + localPath.string());
     }
+    // A connection dropped mid-body leaves a readable but truncated file
+    const long long expected = outcome.GetResult().GetContentLength();
+    const auto written = static_cast<long long>(fs::file_size(localPath));
+    if (!outFile || (expected > 0 && written != expected)) {
+        std::error_code ec;
+        fs::remove(localPath, ec);
+        throw std::runtime_error("Incomplete download of '" + key + "': got " + std::to_string(written) +
+                                 " of " + std::to_string(expected) + " bytes");
+    }
     
     return localPath.string();
 }
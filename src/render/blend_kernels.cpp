@@ -0,0 +1,197 @@
+#include "render/blend_kernels.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define QVM_BLEND_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile each SIMD kernel for its own instruction set, so the
+// rest of the binary keeps the baseline target; MSVC needs no attribute
+#if defined(__GNUC__) || defined(__clang__)
+#define QVM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define QVM_TARGET(isa)
+#endif
+
+namespace {
+
+// round(x / 255), exact for x in [0, 65279]
+inline unsigned div255(unsigned x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+void blendScalar(std::uint8_t* dst, const std::uint16_t* value, const std::uint8_t* alpha, int count, unsigned level) {
+    for (int i = 0; i < count; ++i) {
+        unsigned a = div255(alpha[i] * level);
+        unsigned v = div255(value[i] * level);
+        dst[i] = static_cast<std::uint8_t>(std::min(255u, v + div255(dst[i] * (255 - a))));
+    }
+}
+
+#ifdef QVM_BLEND_X86
+
+QVM_TARGET("sse4.1") inline __m128i div255x8(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+QVM_TARGET("sse4.1")
+void blendSse41(std::uint8_t* dst, const std::uint16_t* value, const std::uint8_t* alpha, int count, unsigned level) {
+    const __m128i lv = _mm_set1_epi16(static_cast<short>(level));
+    const __m128i opaque = _mm_set1_epi16(255);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(value + i));
+        __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(alpha + i)));
+        __m128i d = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(dst + i)));
+        a = div255x8(_mm_mullo_epi16(a, lv));
+        v = div255x8(_mm_mullo_epi16(v, lv));
+        d = div255x8(_mm_mullo_epi16(d, _mm_sub_epi16(opaque, a)));
+        __m128i out = _mm_add_epi16(v, d);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(out, out));
+    }
+    blendScalar(dst + i, value + i, alpha + i, count - i, level);
+}
+
+QVM_TARGET("avx2") inline __m256i div255x16(__m256i x) {
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+QVM_TARGET("avx2")
+void blendAvx2(std::uint8_t* dst, const std::uint16_t* value, const std::uint8_t* alpha, int count, unsigned level) {
+    const __m256i lv = _mm256_set1_epi16(static_cast<short>(level));
+    const __m256i opaque = _mm256_set1_epi16(255);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(value + i));
+        __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(alpha + i)));
+        __m256i d = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i)));
+        a = div255x16(_mm256_mullo_epi16(a, lv));
+        v = div255x16(_mm256_mullo_epi16(v, lv));
+        d = div255x16(_mm256_mullo_epi16(d, _mm256_sub_epi16(opaque, a)));
+        __m256i out = _mm256_add_epi16(v, d);
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(out), _mm256_extracti128_si256(out, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    blendScalar(dst + i, value + i, alpha + i, count - i, level);
+}
+
+struct CpuFeatures {
+    bool sse41 = false;
+    bool avx2 = false;
+};
+
+CpuFeatures detectCpu() {
+    CpuFeatures features;
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4] = {};
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    features.sse41 = (info[2] & (1 << 19)) != 0;
+    const bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    if (maxLeaf >= 7 && osSavesYmm) {
+        __cpuidex(info, 7, 0);
+        features.avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    // Also checks that the OS saves the AVX registers
+    __builtin_cpu_init();
+    features.sse41 = __builtin_cpu_supports("sse4.1");
+    features.avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return features;
+}
+
+#endif // QVM_BLEND_X86
+
+} // namespace
+
+namespace Render {
+
+BlendKernel bestBlendKernel() {
+    static const BlendKernel best = [] {
+        auto kernels = supportedBlendKernels();
+        return kernels.back();
+    }();
+    return best;
+}
+
+std::vector<BlendKernel> supportedBlendKernels() {
+    std::vector<BlendKernel> kernels{BlendKernel::Scalar};
+#ifdef QVM_BLEND_X86
+    static const CpuFeatures cpu = detectCpu();
+    if (cpu.sse41) kernels.push_back(BlendKernel::Sse41);
+    if (cpu.avx2) kernels.push_back(BlendKernel::Avx2);
+#endif
+    return kernels;
+}
+
+const char* blendKernelName(BlendKernel kernel) {
+    switch (kernel) {
+        case BlendKernel::Sse41:
+            return "sse4.1";
+        case BlendKernel::Avx2:
+            return "avx2";
+        case BlendKernel::Scalar:
+            break;
+    }
+    return "scalar";
+}
+
+void blendRow8(std::uint8_t* dst, const std::uint16_t* value, const std::uint8_t* alpha, int count, unsigned level) {
+    blendRow8(bestBlendKernel(), dst, value, alpha, count, level);
+}
+
+void blendRow8(BlendKernel kernel,
+               std::uint8_t* dst,
+               const std::uint16_t* value,
+               const std::uint8_t* alpha,
+               int count,
+               unsigned level) {
+    level = std::min(level, 255u);
+    switch (kernel) {
+#ifdef QVM_BLEND_X86
+        case BlendKernel::Sse41:
+            blendSse41(dst, value, alpha, count, level);
+            return;
+        case BlendKernel::Avx2:
+            blendAvx2(dst, value, alpha, count, level);
+            return;
+#else
+        case BlendKernel::Sse41:
+        case BlendKernel::Avx2:
+            throw std::runtime_error(std::string("Blend kernel not built for this CPU: ") + blendKernelName(kernel));
+#endif
+        case BlendKernel::Scalar:
+            break;
+    }
+    blendScalar(dst, value, alpha, count, level);
+}
+
+void blendRow16(std::uint16_t* dst,
+                const std::uint16_t* value,
+                const std::uint8_t* alpha,
+                int count,
+                unsigned level,
+                int depth) {
+    level = std::min(level, 255u);
+    const std::uint32_t maxValue = (1u << depth) - 1;
+    for (int i = 0; i < count; ++i) {
+        std::uint32_t a = div255(alpha[i] * level);
+        std::uint32_t v = (value[i] * level + 127) / 255;
+        std::uint32_t rest = (dst[i] * (255 - a) + 127) / 255;
+        dst[i] = static_cast<std::uint16_t>(std::min(maxValue, v + rest));
+    }
+}
+
+} // namespace Render
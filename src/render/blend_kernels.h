@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Row kernels for blending premultiplied subtitle samples into frame planes.
+// Every kernel computes the same integer result, so output does not depend
+// on the CPU a render runs on:
+//     value' = round(value * level / 255), alpha' = round(alpha * level / 255)
+//     dst    = min(max, value' + round(dst * (255 - alpha') / 255))
+namespace Render {
+
+enum class BlendKernel {
+    Scalar,
+    Sse41,
+    Avx2,
+};
+
+// The fastest kernel this CPU supports, detected once.
+BlendKernel bestBlendKernel();
+// Kernels this CPU supports, scalar first.
+std::vector<BlendKernel> supportedBlendKernels();
+const char* blendKernelName(BlendKernel kernel);
+
+// Blends `count` samples at opacity `level` (0-255) into 8-bit pixels with
+// the best kernel, or with a specific one (which must be supported).
+void blendRow8(std::uint8_t* dst, const std::uint16_t* value, const std::uint8_t* alpha, int count, unsigned level);
+void blendRow8(BlendKernel kernel,
+               std::uint8_t* dst,
+               const std::uint16_t* value,
+               const std::uint8_t* alpha,
+               int count,
+               unsigned level);
+
+// Blends into samples of `depth` bits (9-16) stored in 16-bit words.
+void blendRow16(std::uint16_t* dst,
+                const std::uint16_t* value,
+                const std::uint8_t* alpha,
+                int count,
+                unsigned level,
+                int depth);
+
+} // namespace Render
@@ -0,0 +1,57 @@
+#include "render/chunk_planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Render {
+
+std::vector<ChunkRange> planChunks(const std::vector<double>& boundaries,
+                                   double totalSeconds,
+                                   int chunkCount,
+                                   double frameDuration,
+                                   double minChunkSeconds) {
+    std::vector<ChunkRange> chunks;
+    if (totalSeconds <= 0.0) return chunks;
+
+    auto snap = [frameDuration](double t) {
+        return frameDuration > 0.0 ? std::round(t / frameDuration) * frameDuration : t;
+    };
+
+    std::vector<double> candidates;
+    for (double b : boundaries) {
+        double t = snap(b);
+        if (t >= minChunkSeconds && t <= totalSeconds - minChunkSeconds) candidates.push_back(t);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<double> cuts;
+    double previous = 0.0;
+    for (int k = 1; k < chunkCount; ++k) {
+        double ideal = totalSeconds * k / chunkCount;
+        double best = -1.0;
+        double bestDistance = std::numeric_limits<double>::infinity();
+        for (double c : candidates) {
+            if (c < previous + minChunkSeconds) continue;
+            double distance = std::abs(c - ideal);
+            if (distance < bestDistance) {
+                best = c;
+                bestDistance = distance;
+            }
+        }
+        if (best < 0.0) break;
+        cuts.push_back(best);
+        previous = best;
+    }
+
+    double start = 0.0;
+    for (double cut : cuts) {
+        chunks.push_back({start, cut});
+        start = cut;
+    }
+    chunks.push_back({start, totalSeconds});
+    return chunks;
+}
+
+} // namespace Render
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+namespace Render {
+
+struct ChunkRange {
+    double startSeconds = 0.0;
+    double endSeconds = 0.0;
+};
+
+// Split the timeline [0, totalSeconds) into at most `chunkCount` contiguous
+// ranges of roughly equal length. Cuts are only placed on the given
+// boundaries (verse starts on the video timeline), snapped to the frame grid
+// so every chunk holds a whole number of frames. Chunks shorter than
+// `minChunkSeconds` are never produced; fewer chunks are returned instead.
+std::vector<ChunkRange> planChunks(const std::vector<double>& boundaries,
+                                   double totalSeconds,
+                                   int chunkCount,
+                                   double frameDuration,
+                                   double minChunkSeconds = 2.0);
+
+} // namespace Render
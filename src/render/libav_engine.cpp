@@ -0,0 +1,1006 @@
+#include "render/libav_engine.h"
+#include "render/sprite_compositor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavfilter/buffersrc.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/mem.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 28, 100)
+#define QVM_HAVE_CH_LAYOUT 1
+#else
+#define QVM_HAVE_CH_LAYOUT 0
+#endif
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 59
+using InputFormatPtr = const AVInputFormat*;
+#else
+using InputFormatPtr = AVInputFormat*;
+#endif
+
+const AVRational kMicroseconds{1, AV_TIME_BASE};
+
+std::string avError(int code) {
+    char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(code, buffer, sizeof(buffer));
+    return buffer;
+}
+
+void check(int code, const std::string& what) {
+    if (code < 0) {
+        throw std::runtime_error("libav render: " + what + " (" + avError(code) + ")");
+    }
+}
+
+struct FrameDeleter { void operator()(AVFrame* f) const { av_frame_free(&f); } };
+struct PacketDeleter { void operator()(AVPacket* p) const { av_packet_free(&p); } };
+struct CodecDeleter { void operator()(AVCodecContext* c) const { avcodec_free_context(&c); } };
+struct GraphDeleter { void operator()(AVFilterGraph* g) const { avfilter_graph_free(&g); } };
+struct InOutDeleter { void operator()(AVFilterInOut* io) const { avfilter_inout_free(&io); } };
+struct InputDeleter { void operator()(AVFormatContext* f) const { avformat_close_input(&f); } };
+struct OutputDeleter {
+    void operator()(AVFormatContext* f) const {
+        if (!f) return;
+        if (f->pb && !(f->oformat->flags & AVFMT_NOFILE)) avio_closep(&f->pb);
+        avformat_free_context(f);
+    }
+};
+
+using FramePtr = std::unique_ptr<AVFrame, FrameDeleter>;
+using PacketPtr = std::unique_ptr<AVPacket, PacketDeleter>;
+using CodecPtr = std::unique_ptr<AVCodecContext, CodecDeleter>;
+
+// Decoded stream of one demuxed input, feeding a buffer source in the graph.
+struct DecodedStream {
+    int streamIndex = -1;
+    AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+    CodecPtr decoder;
+    AVFilterContext* source = nullptr;
+    bool closed = false;
+};
+
+// Input stream remuxed without decoding ("-c copy").
+struct CopiedStream {
+    int streamIndex = -1;
+    size_t output = 0;
+    size_t map = 0;
+};
+
+struct OpenInput {
+    const Render::InputSpec* spec = nullptr;
+    std::unique_ptr<AVFormatContext, InputDeleter> format;
+    std::vector<DecodedStream> streams;
+    std::vector<CopiedStream> copies;
+    int64_t startTimeUs = 0;
+    int64_t loopOffsetUs = 0;  // added to timestamps after each wrap of a looped input
+    int64_t maxEndUs = 0;      // furthest timestamp produced so far (relative, without loop offset)
+    bool eof = false;
+    // Next stream-copied packet, read ahead and held until the encoders catch up
+    PacketPtr copyPacket;
+    double copySeconds = 0.0;  // its timestamp on the output timeline
+    const CopiedStream* copyTarget = nullptr;
+    bool copyEof = false;
+
+    DecodedStream* find(int streamIndex) {
+        for (auto& s : streams) {
+            if (s.streamIndex == streamIndex) return &s;
+        }
+        return nullptr;
+    }
+};
+
+struct EncodedStream {
+    AVFilterContext* sink = nullptr;
+    CodecPtr encoder;
+    AVStream* stream = nullptr;
+    const AVStream* copySource = nullptr;  // set for stream-copied maps
+    std::unique_ptr<Render::SpriteCompositor> sprites;
+    // Variable frame rate after sprites: the last frame encoded, and how many
+    // identical frames have been dropped since (at most maxRepeats)
+    FramePtr lastKept;
+    int repeats = 0;
+    int maxRepeats = 0;
+    size_t nextKeyframe = 0;  // first of encoder.keyframeTimes not yet forced
+    double lastSeconds = 0.0;  // output time of the last frame sent to the encoder
+    bool finished = false;
+    bool flushed = false;
+};
+
+struct OpenOutput {
+    const Render::OutputSpec* spec = nullptr;
+    std::unique_ptr<AVFormatContext, OutputDeleter> format;
+    std::vector<EncodedStream> streams;
+};
+
+// A reference to an input stream in ffmpeg syntax ("1:a", "[0:v]").
+struct StreamRef {
+    int input = -1;
+    char kind = 'v';
+};
+
+bool parseStreamRef(const std::string& text, StreamRef& ref) {
+    static const std::regex pattern(R"(^\[?(\d+):([av])\]?$)");
+    std::smatch m;
+    if (!std::regex_match(text, m, pattern)) return false;
+    ref.input = std::stoi(m[1].str());
+    ref.kind = m[2].str()[0];
+    return true;
+}
+
+std::string sourceLabel(int input, char kind) {
+    return "qvm_src_" + std::to_string(input) + "_" + kind;
+}
+
+std::string inputLabel(int input, char kind) {
+    return "qvm_in_" + std::to_string(input) + "_" + kind;
+}
+
+std::string formatSeconds(double seconds) {
+    std::ostringstream oss;
+    oss.precision(6);
+    oss << std::fixed << seconds;
+    return oss.str();
+}
+
+// Per-input pre-processing that reproduces the CLI input options (-ss, -t,
+// -itsoffset) with filters so that trimming stays sample accurate.
+std::string inputChain(const Render::InputSpec& spec, char kind) {
+    const bool audio = (kind == 'a');
+    std::vector<std::string> filters;
+    if (spec.seekSeconds >= 0.0 || spec.durationSeconds >= 0.0) {
+        std::string trim = audio ? "atrim=" : "trim=";
+        std::vector<std::string> args;
+        if (spec.seekSeconds >= 0.0) args.push_back("start=" + formatSeconds(spec.seekSeconds));
+        if (spec.durationSeconds >= 0.0) args.push_back("duration=" + formatSeconds(spec.durationSeconds));
+        for (size_t i = 0; i < args.size(); ++i) trim += (i ? ":" : "") + args[i];
+        filters.push_back(trim);
+        filters.push_back(audio ? "asetpts=PTS-STARTPTS" : "setpts=PTS-STARTPTS");
+    }
+    if (spec.offsetSeconds > 0.0) {
+        if (audio) {
+            auto delayMs = static_cast<long long>(spec.offsetSeconds * 1000.0 + 0.5);
+            filters.push_back("adelay=delays=" + std::to_string(delayMs) + ":all=1");
+        } else {
+            filters.push_back("setpts=PTS+" + formatSeconds(spec.offsetSeconds) + "/TB");
+        }
+    }
+    if (filters.empty()) filters.push_back(audio ? "anull" : "null");
+
+    std::string chain;
+    for (size_t i = 0; i < filters.size(); ++i) {
+        if (i) chain += ",";
+        chain += filters[i];
+    }
+    return chain;
+}
+
+// Media type of the first pad produced by a lavfi source description
+// such as "anullsrc=r=44100:cl=stereo".
+char lavfiKind(const std::string& description) {
+    std::string name = description.substr(0, description.find_first_of("=,;["));
+    const AVFilter* filter = avfilter_get_by_name(name.c_str());
+    if (!filter) throw std::runtime_error("libav render: unknown lavfi source '" + name + "'");
+#if LIBAVFILTER_VERSION_INT >= AV_VERSION_INT(8, 3, 100)
+    if (avfilter_filter_pad_count(filter, 1) == 0) {
+#else
+    if (avfilter_pad_count(filter->outputs) == 0) {
+#endif
+        throw std::runtime_error("libav render: lavfi input '" + name + "' has no outputs");
+    }
+    return avfilter_pad_get_type(filter->outputs, 0) == AVMEDIA_TYPE_AUDIO ? 'a' : 'v';
+}
+
+// Whether two software video frames hold the same picture, byte for byte.
+bool samePicture(const AVFrame& a, const AVFrame& b) {
+    if (a.format != b.format || a.width != b.width || a.height != b.height) return false;
+    auto format = static_cast<AVPixelFormat>(a.format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    if (!desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) return false;
+    for (int p = 0; p < 4 && a.data[p]; ++p) {
+        if (!b.data[p]) return false;
+        int rows = (p == 1 || p == 2) ? AV_CEIL_RSHIFT(a.height, desc->log2_chroma_h) : a.height;
+        int bytes = av_image_get_linesize(format, a.width, p);
+        for (int y = 0; y < rows; ++y) {
+            if (std::memcmp(a.data[p] + static_cast<ptrdiff_t>(y) * a.linesize[p],
+                            b.data[p] + static_cast<ptrdiff_t>(y) * b.linesize[p], bytes) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::string bufferSourceArgs(const AVCodecContext* dec, const AVStream* stream) {
+    std::ostringstream args;
+    if (dec->codec_type == AVMEDIA_TYPE_VIDEO) {
+        AVRational sar = dec->sample_aspect_ratio.num ? dec->sample_aspect_ratio : AVRational{1, 1};
+        args << "video_size=" << dec->width << "x" << dec->height
+             << ":pix_fmt=" << static_cast<int>(dec->pix_fmt)
+             << ":time_base=" << kMicroseconds.num << "/" << kMicroseconds.den
+             << ":pixel_aspect=" << sar.num << "/" << sar.den;
+        AVRational rate = stream->avg_frame_rate.num ? stream->avg_frame_rate : stream->r_frame_rate;
+        if (rate.num && rate.den) args << ":frame_rate=" << rate.num << "/" << rate.den;
+    } else {
+        args << "time_base=" << kMicroseconds.num << "/" << kMicroseconds.den
+             << ":sample_rate=" << dec->sample_rate
+             << ":sample_fmt=" << av_get_sample_fmt_name(dec->sample_fmt);
+#if QVM_HAVE_CH_LAYOUT
+        char layout[128] = {0};
+        if (dec->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) {
+            AVChannelLayout defaultLayout;
+            av_channel_layout_default(&defaultLayout, dec->ch_layout.nb_channels);
+            av_channel_layout_describe(&defaultLayout, layout, sizeof(layout));
+        } else {
+            av_channel_layout_describe(&dec->ch_layout, layout, sizeof(layout));
+        }
+        args << ":channel_layout=" << layout;
+#else
+        uint64_t layout = dec->channel_layout ? dec->channel_layout
+                                              : static_cast<uint64_t>(av_get_default_channel_layout(dec->channels));
+        args << ":channel_layout=0x" << std::hex << layout;
+#endif
+    }
+    return args.str();
+}
+
+class Job {
+public:
+    Job(const Render::RenderPlan& plan, const Render::LibavEngine::ProgressCallback& onProgress)
+        : plan_(plan), onProgress_(onProgress) {}
+
+    void run() {
+        if (plan_.outputs.empty()) throw std::runtime_error("libav render: plan has no outputs");
+        collectStreamRefs();
+        openInputs();
+        buildGraph();
+        openOutputs();
+        mainLoop();
+        copyPackets(std::numeric_limits<double>::infinity());
+        finish();
+    }
+
+private:
+    const Render::RenderPlan& plan_;
+    const Render::LibavEngine::ProgressCallback& onProgress_;
+
+    std::set<std::pair<int, char>> usedStreams_;
+    std::map<std::string, std::string> directMaps_;  // "1:a" -> label of its pass-through chain
+    struct CopyMap { StreamRef ref; size_t output; size_t map; };
+    std::vector<CopyMap> copyMaps_;
+    std::vector<OpenInput> inputs_;
+    std::unique_ptr<AVFilterGraph, GraphDeleter> graph_;
+    std::vector<OpenOutput> outputs_;
+    FramePtr frame_{av_frame_alloc()};
+    PacketPtr packet_{av_packet_alloc()};
+
+    void collectStreamRefs() {
+        static const std::regex labelPattern(R"(\[(\d+):([av])\])");
+        for (std::sregex_iterator it(plan_.filterComplex.begin(), plan_.filterComplex.end(), labelPattern), end;
+             it != end; ++it) {
+            auto key = std::make_pair(std::stoi((*it)[1].str()), (*it)[2].str()[0]);
+            if (!usedStreams_.insert(key).second) {
+                throw std::runtime_error("libav render: input stream " + (*it)[0].str() +
+                                         " is referenced more than once");
+            }
+        }
+        for (size_t o = 0; o < plan_.outputs.size(); ++o) {
+            const auto& output = plan_.outputs[o];
+            for (size_t m = 0; m < output.maps.size(); ++m) {
+                const std::string& map = output.maps[m];
+                StreamRef ref;
+                if (!parseStreamRef(map, ref)) {
+                    if (map.size() > 2 && map.front() == '[' && map.back() == ']') continue;  // graph label
+                    throw std::runtime_error("libav render: unsupported map '" + map + "'");
+                }
+                const std::string& codec = ref.kind == 'v' ? output.encoder.videoCodec : output.encoder.audioCodec;
+                if (codec == "copy") {
+                    copyMaps_.push_back({ref, o, m});
+                    continue;
+                }
+                auto key = std::make_pair(ref.input, ref.kind);
+                if (!usedStreams_.insert(key).second) {
+                    throw std::runtime_error("libav render: input stream " + map + " is referenced more than once");
+                }
+                directMaps_[std::to_string(ref.input) + ":" + ref.kind] =
+                    "qvm_map_" + std::to_string(ref.input) + "_" + ref.kind;
+            }
+        }
+        auto checkIndex = [&](int input) {
+            if (input < 0 || input >= static_cast<int>(plan_.inputs.size())) {
+                throw std::runtime_error("libav render: stream reference to missing input " + std::to_string(input));
+            }
+        };
+        for (const auto& used : usedStreams_) checkIndex(used.first);
+        for (const auto& copy : copyMaps_) checkIndex(copy.ref.input);
+        for (const auto& output : plan_.outputs) {
+            if (output.chaptersInput >= 0) checkIndex(output.chaptersInput);
+        }
+    }
+
+    void openInputs() {
+        inputs_.resize(plan_.inputs.size());
+        for (size_t i = 0; i < plan_.inputs.size(); ++i) {
+            const auto& spec = plan_.inputs[i];
+            OpenInput& input = inputs_[i];
+            input.spec = &spec;
+            if (spec.format == "lavfi") continue;  // realised as a source filter in the graph
+
+            InputFormatPtr forced = nullptr;
+            if (!spec.format.empty()) {
+                forced = av_find_input_format(spec.format.c_str());
+                if (!forced) throw std::runtime_error("libav render: unknown input format " + spec.format);
+            }
+            AVDictionary* options = nullptr;
+            for (const auto& [key, value] : spec.formatOptions) {
+                av_dict_set(&options, key.c_str(), value.c_str(), 0);
+            }
+
+            AVFormatContext* ctx = nullptr;
+            int ret = avformat_open_input(&ctx, spec.path.c_str(), forced, &options);
+            av_dict_free(&options);
+            check(ret, "could not open input " + spec.path);
+            input.format.reset(ctx);
+            check(avformat_find_stream_info(ctx, nullptr), "could not read stream info for " + spec.path);
+            input.startTimeUs = (ctx->start_time != AV_NOPTS_VALUE) ? ctx->start_time : 0;
+
+            for (char kind : {'v', 'a'}) {
+                if (!usedStreams_.count({static_cast<int>(i), kind})) continue;
+                AVMediaType type = (kind == 'v') ? AVMEDIA_TYPE_VIDEO : AVMEDIA_TYPE_AUDIO;
+                int index = av_find_best_stream(ctx, type, -1, -1, nullptr, 0);
+                check(index, "no " + std::string(kind == 'v' ? "video" : "audio") + " stream in " + spec.path);
+
+                AVStream* stream = ctx->streams[index];
+                const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+                if (!codec) throw std::runtime_error("libav render: no decoder for stream in " + spec.path);
+                DecodedStream decoded;
+                decoded.streamIndex = index;
+                decoded.type = type;
+                decoded.decoder.reset(avcodec_alloc_context3(codec));
+                check(avcodec_parameters_to_context(decoded.decoder.get(), stream->codecpar),
+                      "could not copy decoder parameters");
+                decoded.decoder->pkt_timebase = stream->time_base;
+                check(avcodec_open2(decoded.decoder.get(), codec, nullptr), "could not open decoder for " + spec.path);
+                input.streams.push_back(std::move(decoded));
+            }
+
+            for (const auto& copy : copyMaps_) {
+                if (copy.ref.input != static_cast<int>(i)) continue;
+                if (!input.streams.empty() || spec.seekSeconds >= 0.0 || spec.durationSeconds >= 0.0 || spec.loop) {
+                    throw std::runtime_error("libav render: stream copy of " + spec.path +
+                                             " cannot be combined with filtering, seeking or looping");
+                }
+                AVMediaType type = (copy.ref.kind == 'v') ? AVMEDIA_TYPE_VIDEO : AVMEDIA_TYPE_AUDIO;
+                int index = av_find_best_stream(ctx, type, -1, -1, nullptr, 0);
+                check(index, "no stream to copy in " + spec.path);
+                input.copies.push_back({index, copy.output, copy.map});
+            }
+
+            for (unsigned s = 0; s < ctx->nb_streams; ++s) {
+                bool copied = std::any_of(input.copies.begin(), input.copies.end(),
+                                          [s](const CopiedStream& c) { return c.streamIndex == static_cast<int>(s); });
+                if (!input.find(static_cast<int>(s)) && !copied) ctx->streams[s]->discard = AVDISCARD_ALL;
+            }
+
+            if (spec.seekSeconds > 0.0) {
+                // Coarse demuxer seek; the trim filter makes the cut exact.
+                int64_t target = input.startTimeUs + static_cast<int64_t>(spec.seekSeconds * AV_TIME_BASE);
+                if (avformat_seek_file(ctx, -1, std::numeric_limits<int64_t>::min(), target, target, 0) < 0) {
+                    avformat_seek_file(ctx, -1, std::numeric_limits<int64_t>::min(), 0, 0, 0);
+                }
+            }
+        }
+    }
+
+    std::string graphDescription() {
+        std::ostringstream desc;
+        for (const auto& [index, kind] : usedStreams_) {
+            const auto& spec = plan_.inputs[index];
+            std::string outLabel = inputLabel(index, kind);
+            std::string ref = std::to_string(index) + ":" + kind;
+            if (directMaps_.count(ref)) outLabel = directMaps_[ref];
+
+            if (spec.format == "lavfi") {
+                if (lavfiKind(spec.path) != kind) {
+                    throw std::runtime_error("libav render: lavfi input " + ref + " has the wrong media type");
+                }
+                desc << spec.path << "," << inputChain(spec, kind) << "[" << outLabel << "];";
+            } else {
+                desc << "[" << sourceLabel(index, kind) << "]" << inputChain(spec, kind)
+                     << "[" << outLabel << "];";
+            }
+        }
+
+        static const std::regex labelPattern(R"(\[(\d+):([av])\])");
+        std::string body = std::regex_replace(plan_.filterComplex, labelPattern, "[qvm_in_$1_$2]");
+        if (!body.empty()) {
+            desc << body;
+        } else {
+            std::string prefix = desc.str();
+            if (!prefix.empty() && prefix.back() == ';') prefix.pop_back();
+            return prefix;
+        }
+        return desc.str();
+    }
+
+    AVFilterContext* createFilter(const char* filterName, const std::string& name, const std::string& args) {
+        const AVFilter* filter = avfilter_get_by_name(filterName);
+        if (!filter) throw std::runtime_error(std::string("libav render: filter unavailable: ") + filterName);
+        AVFilterContext* ctx = nullptr;
+        check(avfilter_graph_create_filter(&ctx, filter, name.c_str(), args.empty() ? nullptr : args.c_str(),
+                                           nullptr, graph_.get()),
+              "could not create " + std::string(filterName) + " filter");
+        return ctx;
+    }
+
+    void buildGraph() {
+        outputs_.resize(plan_.outputs.size());
+        for (size_t o = 0; o < plan_.outputs.size(); ++o) {
+            outputs_[o].spec = &plan_.outputs[o];
+            outputs_[o].streams.resize(plan_.outputs[o].maps.size());
+        }
+        for (const auto& input : inputs_) {
+            for (const auto& copy : input.copies) {
+                EncodedStream& out = outputs_[copy.output].streams[copy.map];
+                out.copySource = input.format->streams[copy.streamIndex];
+                out.finished = true;  // not driven by the filter graph
+                out.flushed = true;
+            }
+        }
+
+        std::string description = graphDescription();
+        if (description.empty()) return;  // pure remux
+
+        graph_.reset(avfilter_graph_alloc());
+        if (!graph_) throw std::runtime_error("libav render: could not allocate filter graph");
+        if (plan_.filterThreads > 0) graph_->nb_threads = plan_.filterThreads;
+
+        AVFilterInOut* openIns = nullptr;
+        AVFilterInOut* openOuts = nullptr;
+        check(avfilter_graph_parse2(graph_.get(), description.c_str(), &openIns, &openOuts),
+              "could not parse filter graph");
+        std::unique_ptr<AVFilterInOut, InOutDeleter> insGuard(openIns);
+        std::unique_ptr<AVFilterInOut, InOutDeleter> outsGuard(openOuts);
+
+        // Wire buffer sources to the per-input chains.
+        for (AVFilterInOut* in = openIns; in; in = in->next) {
+            std::string label = in->name ? in->name : "";
+            DecodedStream* target = nullptr;
+            OpenInput* owner = nullptr;
+            for (size_t i = 0; i < inputs_.size() && !target; ++i) {
+                for (auto& stream : inputs_[i].streams) {
+                    char kind = stream.type == AVMEDIA_TYPE_VIDEO ? 'v' : 'a';
+                    if (label == sourceLabel(static_cast<int>(i), kind)) {
+                        target = &stream;
+                        owner = &inputs_[i];
+                        break;
+                    }
+                }
+            }
+            if (!target) throw std::runtime_error("libav render: unconnected filter input [" + label + "]");
+
+            AVStream* stream = owner->format->streams[target->streamIndex];
+            const char* filterName = target->type == AVMEDIA_TYPE_VIDEO ? "buffer" : "abuffer";
+            target->source = createFilter(filterName, label, bufferSourceArgs(target->decoder.get(), stream));
+            check(avfilter_link(target->source, 0, in->filter_ctx, in->pad_idx), "could not link " + label);
+        }
+
+        // Attach a sink to every label an output maps.
+        std::map<std::string, std::pair<size_t, size_t>> sinkSlots;
+        for (size_t o = 0; o < plan_.outputs.size(); ++o) {
+            for (size_t m = 0; m < plan_.outputs[o].maps.size(); ++m) {
+                if (outputs_[o].streams[m].copySource) continue;
+                const std::string& map = plan_.outputs[o].maps[m];
+                StreamRef ref;
+                std::string label = parseStreamRef(map, ref)
+                    ? directMaps_[std::to_string(ref.input) + ":" + ref.kind]
+                    : map.substr(1, map.size() - 2);
+                if (!sinkSlots.emplace(label, std::make_pair(o, m)).second) {
+                    throw std::runtime_error("libav render: label [" + label + "] is mapped more than once");
+                }
+            }
+        }
+
+        for (AVFilterInOut* out = openOuts; out; out = out->next) {
+            std::string label = out->name ? out->name : "";
+            auto slot = sinkSlots.find(label);
+            if (slot == sinkSlots.end()) {
+                throw std::runtime_error("libav render: filter output [" + label + "] is not mapped");
+            }
+            const auto& encoder = plan_.outputs[slot->second.first].encoder;
+            bool video = avfilter_pad_get_type(out->filter_ctx->output_pads, out->pad_idx) == AVMEDIA_TYPE_VIDEO;
+
+            AVFilterContext* convert = nullptr;
+            AVFilterContext* sink = nullptr;
+            if (video) {
+                std::string pixFmt = encoder.pixelFormat.empty() ? "yuv420p" : encoder.pixelFormat;
+                convert = createFilter("format", "fmt_" + label, "pix_fmts=" + pixFmt);
+                sink = createFilter("buffersink", "out_" + label, "");
+            } else {
+                convert = createFilter("aformat", "fmt_" + label, "sample_fmts=fltp");
+                sink = createFilter("abuffersink", "out_" + label, "");
+            }
+            check(avfilter_link(out->filter_ctx, out->pad_idx, convert, 0), "could not link " + label);
+            check(avfilter_link(convert, 0, sink, 0), "could not link sink for " + label);
+            outputs_[slot->second.first].streams[slot->second.second].sink = sink;
+            sinkSlots.erase(slot);
+        }
+        if (!sinkSlots.empty()) {
+            throw std::runtime_error("libav render: mapped label [" + sinkSlots.begin()->first +
+                                     "] is not produced by the filter graph");
+        }
+
+        check(avfilter_graph_config(graph_.get(), nullptr), "could not configure filter graph");
+    }
+
+    void openEncoder(EncodedStream& out, AVFormatContext* format, const Render::EncoderSettings& settings) {
+        bool video = av_buffersink_get_type(out.sink) == AVMEDIA_TYPE_VIDEO;
+        const std::string& codecName = video ? settings.videoCodec : settings.audioCodec;
+        if (codecName.empty()) throw std::runtime_error("libav render: no encoder configured for mapped stream");
+        const AVCodec* codec = avcodec_find_encoder_by_name(codecName.c_str());
+        if (!codec) throw std::runtime_error("libav render: encoder not available: " + codecName);
+
+        out.encoder.reset(avcodec_alloc_context3(codec));
+        AVCodecContext* enc = out.encoder.get();
+        AVDictionary* options = nullptr;
+        if (video) {
+            enc->width = av_buffersink_get_w(out.sink);
+            enc->height = av_buffersink_get_h(out.sink);
+            enc->pix_fmt = static_cast<AVPixelFormat>(av_buffersink_get_format(out.sink));
+            enc->sample_aspect_ratio = av_buffersink_get_sample_aspect_ratio(out.sink);
+            AVRational rate = av_buffersink_get_frame_rate(out.sink);
+            enc->framerate = rate;
+            enc->time_base = (rate.num && rate.den) ? av_inv_q(rate) : av_buffersink_get_time_base(out.sink);
+            if (!settings.preset.empty()) av_dict_set(&options, "preset", settings.preset.c_str(), 0);
+            if (settings.crf >= 0) av_dict_set(&options, "crf", std::to_string(settings.crf).c_str(), 0);
+            if (!settings.videoBitrate.empty()) av_dict_set(&options, "b", settings.videoBitrate.c_str(), 0);
+            if (!settings.videoMaxRate.empty()) av_dict_set(&options, "maxrate", settings.videoMaxRate.c_str(), 0);
+            if (!settings.videoBufSize.empty()) av_dict_set(&options, "bufsize", settings.videoBufSize.c_str(), 0);
+            if (settings.allowSoftwareFallback) av_dict_set(&options, "allow_sw", "1", 0);
+            if (settings.closedGop) av_dict_set(&options, "flags", "+cgop", 0);
+            if (settings.keyframeInterval > 0) enc->gop_size = settings.keyframeInterval;
+            if (settings.threads > 0) av_dict_set(&options, "threads", std::to_string(settings.threads).c_str(), 0);
+        } else {
+            enc->sample_rate = av_buffersink_get_sample_rate(out.sink);
+            enc->sample_fmt = static_cast<AVSampleFormat>(av_buffersink_get_format(out.sink));
+#if QVM_HAVE_CH_LAYOUT
+            check(av_buffersink_get_ch_layout(out.sink, &enc->ch_layout), "could not read channel layout");
+#else
+            enc->channel_layout = av_buffersink_get_channel_layout(out.sink);
+            enc->channels = av_buffersink_get_channels(out.sink);
+#endif
+            enc->time_base = AVRational{1, enc->sample_rate};
+            if (!settings.audioBitrate.empty()) av_dict_set(&options, "b", settings.audioBitrate.c_str(), 0);
+        }
+        if ((format->oformat->flags & AVFMT_GLOBALHEADER) || settings.globalHeader) {
+            enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+
+        int ret = avcodec_open2(enc, codec, &options);
+        av_dict_free(&options);
+        check(ret, "could not open encoder " + codecName);
+
+        if (!video && !(codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+            av_buffersink_set_frame_size(out.sink, enc->frame_size);
+        }
+
+        out.stream = avformat_new_stream(format, nullptr);
+        if (!out.stream) throw std::runtime_error("libav render: could not create output stream");
+        check(avcodec_parameters_from_context(out.stream->codecpar, enc), "could not copy encoder parameters");
+        out.stream->time_base = enc->time_base;
+    }
+
+    // Like -map_chapters: the output carries the input's chapters unchanged.
+    // An input read only for its chapters (an ffmetadata file) has no used
+    // streams, so it is opened but never demuxed.
+    void copyChapters(const OpenInput& input, AVFormatContext* ctx) {
+        if (!input.format) throw std::runtime_error("libav render: chapters need a demuxed input");
+        const AVFormatContext* source = input.format.get();
+        for (unsigned c = 0; c < source->nb_chapters; ++c) {
+            const AVChapter* from = source->chapters[c];
+            auto* chapter = static_cast<AVChapter*>(av_mallocz(sizeof(AVChapter)));
+            if (!chapter) throw std::runtime_error("libav render: out of memory copying chapters");
+            chapter->id = from->id;
+            chapter->time_base = from->time_base;
+            chapter->start = from->start;
+            chapter->end = from->end;
+            if (av_dict_copy(&chapter->metadata, from->metadata, 0) < 0 ||
+                av_dynarray_add_nofree(&ctx->chapters, reinterpret_cast<int*>(&ctx->nb_chapters), chapter) < 0) {
+                av_dict_free(&chapter->metadata);
+                av_free(chapter);
+                throw std::runtime_error("libav render: out of memory copying chapters");
+            }
+        }
+    }
+
+    void openOutputs() {
+        for (auto& output : outputs_) {
+            AVFormatContext* ctx = nullptr;
+            const char* formatName = output.spec->format.empty() ? nullptr : output.spec->format.c_str();
+            check(avformat_alloc_output_context2(&ctx, nullptr, formatName, output.spec->path.c_str()),
+                  "could not create output context for " + output.spec->path);
+            output.format.reset(ctx);
+
+            for (auto& stream : output.streams) {
+                if (stream.copySource) {
+                    stream.stream = avformat_new_stream(ctx, nullptr);
+                    if (!stream.stream) throw std::runtime_error("libav render: could not create output stream");
+                    check(avcodec_parameters_copy(stream.stream->codecpar, stream.copySource->codecpar),
+                          "could not copy stream parameters");
+                    stream.stream->codecpar->codec_tag = 0;
+                    stream.stream->time_base = stream.copySource->time_base;
+                    continue;
+                }
+                openEncoder(stream, ctx, output.spec->encoder);
+                if (output.spec->subtitleSprites && stream.encoder->codec_type == AVMEDIA_TYPE_VIDEO) {
+                    stream.sprites = std::make_unique<Render::SpriteCompositor>(output.spec->subtitleSprites,
+                                                                               output.spec->subtitleSpritesOffset);
+                    if (output.spec->encoder.variableFrameRate) {
+                        // Like the graph's mpdecimate: at least one frame a second
+                        AVRational rate = stream.encoder->framerate;
+                        double fps = (rate.num && rate.den) ? av_q2d(rate) : 30.0;
+                        stream.maxRepeats = std::max(1, static_cast<int>(std::lround(fps)) - 1);
+                    }
+                }
+            }
+
+            if (output.spec->chaptersInput >= 0) copyChapters(inputs_[output.spec->chaptersInput], ctx);
+
+            if (!(ctx->oformat->flags & AVFMT_NOFILE)) {
+                check(avio_open(&ctx->pb, output.spec->path.c_str(), AVIO_FLAG_WRITE),
+                      "could not open " + output.spec->path);
+            }
+            AVDictionary* muxOptions = nullptr;
+            if (output.spec->fastStart) av_dict_set(&muxOptions, "movflags", "+faststart", 0);
+            for (const auto& [key, value] : output.spec->formatOptions) {
+                av_dict_set(&muxOptions, key.c_str(), value.c_str(), 0);
+            }
+            int ret = avformat_write_header(ctx, &muxOptions);
+            av_dict_free(&muxOptions);
+            check(ret, "could not write header for " + output.spec->path);
+        }
+    }
+
+    // Push one decoded frame into the stream's buffer source, rebasing its
+    // timestamp into microseconds relative to the input start.
+    void pushFrame(OpenInput& input, DecodedStream& stream, AVFrame* frame) {
+        AVStream* avStream = input.format->streams[stream.streamIndex];
+        int64_t ts = frame->best_effort_timestamp;
+        if (ts == AV_NOPTS_VALUE) ts = frame->pts;
+        if (ts != AV_NOPTS_VALUE) {
+            int64_t us = av_rescale_q(ts, avStream->time_base, kMicroseconds) - input.startTimeUs;
+            int64_t durationUs = 0;
+            if (stream.type == AVMEDIA_TYPE_AUDIO && frame->sample_rate > 0) {
+                durationUs = av_rescale(frame->nb_samples, AV_TIME_BASE, frame->sample_rate);
+            } else if (stream.type == AVMEDIA_TYPE_VIDEO) {
+                AVRational rate = av_guess_frame_rate(input.format.get(), avStream, frame);
+                if (rate.num && rate.den) durationUs = av_rescale_q(1, av_inv_q(rate), kMicroseconds);
+            }
+            input.maxEndUs = std::max(input.maxEndUs, us + durationUs);
+            frame->pts = us + input.loopOffsetUs;
+        }
+        check(av_buffersrc_add_frame_flags(stream.source, frame, AV_BUFFERSRC_FLAG_KEEP_REF),
+              "could not feed filter graph");
+        av_frame_unref(frame);
+    }
+
+    void decodeInto(OpenInput& input, DecodedStream& stream, const AVPacket* packet) {
+        int ret = avcodec_send_packet(stream.decoder.get(), packet);
+        if (ret < 0 && ret != AVERROR_EOF) check(ret, "decoder rejected packet from " + input.spec->path);
+        while (true) {
+            ret = avcodec_receive_frame(stream.decoder.get(), frame_.get());
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+            check(ret, "could not decode " + input.spec->path);
+            pushFrame(input, stream, frame_.get());
+        }
+    }
+
+    bool pastRequestedRange(const OpenInput& input) const {
+        const auto& spec = *input.spec;
+        if (spec.durationSeconds < 0.0 || spec.loop) return false;
+        double end = std::max(0.0, spec.seekSeconds) + spec.durationSeconds;
+        // Keep a small margin so the trim filter sees the frame that crosses the boundary.
+        return input.maxEndUs > static_cast<int64_t>((end + 0.5) * AV_TIME_BASE);
+    }
+
+    void closeInput(OpenInput& input) {
+        for (auto& stream : input.streams) {
+            if (stream.closed) continue;
+            decodeInto(input, stream, nullptr);
+            check(av_buffersrc_add_frame_flags(stream.source, nullptr, 0), "could not close filter input");
+            stream.closed = true;
+        }
+        input.eof = true;
+    }
+
+    // Read packets from one input until at least one frame reached the graph
+    // or the input ends.
+    void feedInput(OpenInput& input) {
+        if (input.eof) return;
+        while (true) {
+            int ret = av_read_frame(input.format.get(), packet_.get());
+            if (ret == AVERROR_EOF || (ret < 0 && input.format->pb && avio_feof(input.format->pb))) {
+                if (input.spec->loop && input.maxEndUs > 0) {
+                    for (auto& stream : input.streams) {
+                        decodeInto(input, stream, nullptr);
+                        avcodec_flush_buffers(stream.decoder.get());
+                    }
+                    input.loopOffsetUs += input.maxEndUs;
+                    input.maxEndUs = 0;
+                    check(avformat_seek_file(input.format.get(), -1, std::numeric_limits<int64_t>::min(),
+                                             input.startTimeUs, input.startTimeUs, 0),
+                          "could not loop input " + input.spec->path);
+                    continue;
+                }
+                closeInput(input);
+                return;
+            }
+            check(ret, "could not read from " + input.spec->path);
+
+            DecodedStream* stream = input.find(packet_->stream_index);
+            if (!stream) {
+                av_packet_unref(packet_.get());
+                continue;
+            }
+            decodeInto(input, *stream, packet_.get());
+            av_packet_unref(packet_.get());
+            if (pastRequestedRange(input)) closeInput(input);
+            return;
+        }
+    }
+
+    void writePackets(OpenOutput& output, EncodedStream& stream) {
+        while (true) {
+            int ret = avcodec_receive_packet(stream.encoder.get(), packet_.get());
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+            check(ret, "encoder failed for " + output.spec->path);
+            packet_->stream_index = stream.stream->index;
+            av_packet_rescale_ts(packet_.get(), stream.encoder->time_base, stream.stream->time_base);
+            check(av_interleaved_write_frame(output.format.get(), packet_.get()),
+                  "could not write to " + output.spec->path);
+        }
+    }
+
+    void flushEncoder(OpenOutput& output, EncodedStream& stream) {
+        if (stream.flushed) return;
+        stream.finished = true;
+        stream.flushed = true;
+        check(avcodec_send_frame(stream.encoder.get(), nullptr), "could not flush encoder");
+        writePackets(output, stream);
+    }
+
+    // Pull everything the sinks have ready without triggering new requests.
+    bool drainSinks() {
+        bool progressed = false;
+        for (auto& output : outputs_) {
+            for (auto& stream : output.streams) {
+                if (stream.copySource) continue;  // no sink: fed by copyPackets()
+                while (true) {
+                    int ret = av_buffersink_get_frame_flags(stream.sink, frame_.get(), AV_BUFFERSINK_FLAG_NO_REQUEST);
+                    if (ret == AVERROR(EAGAIN)) break;
+                    if (ret == AVERROR_EOF) {
+                        if (!stream.flushed) progressed = true;
+                        flushEncoder(output, stream);
+                        break;
+                    }
+                    check(ret, "could not read from filter graph");
+                    progressed = true;
+                    if (stream.flushed) {
+                        // Past the output duration; discard so the sink does not accumulate.
+                        av_frame_unref(frame_.get());
+                        continue;
+                    }
+
+                    AVRational sinkBase = av_buffersink_get_time_base(stream.sink);
+                    double seconds = frame_->pts != AV_NOPTS_VALUE ? frame_->pts * av_q2d(sinkBase) : 0.0;
+                    if (output.spec->durationSeconds >= 0.0 && seconds >= output.spec->durationSeconds) {
+                        av_frame_unref(frame_.get());
+                        flushEncoder(output, stream);
+                        continue;
+                    }
+                    if (frame_->pts != AV_NOPTS_VALUE) {
+                        frame_->pts = av_rescale_q(frame_->pts, sinkBase, stream.encoder->time_base);
+                    }
+                    if (stream.sprites) {
+                        check(av_frame_make_writable(frame_.get()), "could not write subtitles onto a frame");
+                        stream.sprites->apply(frame_.get(), seconds);
+                    }
+                    if (stream.encoder->codec_type == AVMEDIA_TYPE_VIDEO) {
+                        frame_->pict_type = AV_PICTURE_TYPE_NONE;
+                        // Like -force_key_frames: the first frame at or past each time
+                        const auto& keyframes = output.spec->encoder.keyframeTimes;
+                        if (stream.nextKeyframe < keyframes.size() && seconds >= keyframes[stream.nextKeyframe] - 1e-6) {
+                            frame_->pict_type = AV_PICTURE_TYPE_I;
+                            while (stream.nextKeyframe < keyframes.size() && keyframes[stream.nextKeyframe] <= seconds + 1e-6) {
+                                ++stream.nextKeyframe;
+                            }
+                        }
+                        if (onProgress_) onProgress_(seconds);
+                    }
+                    if (stream.maxRepeats > 0) {
+                        // A forced keyframe is never dropped as a repeat
+                        if (stream.lastKept && stream.repeats < stream.maxRepeats && frame_->pict_type != AV_PICTURE_TYPE_I &&
+                            samePicture(*stream.lastKept, *frame_)) {
+                            ++stream.repeats;
+                            av_frame_unref(frame_.get());
+                            continue;
+                        }
+                        stream.repeats = 0;
+                        if (!stream.lastKept) stream.lastKept.reset(av_frame_alloc());
+                        av_frame_unref(stream.lastKept.get());
+                        check(av_frame_ref(stream.lastKept.get(), frame_.get()), "could not keep a reference frame");
+                    }
+                    stream.lastSeconds = seconds;
+                    int sendRet = avcodec_send_frame(stream.encoder.get(), frame_.get());
+                    av_frame_unref(frame_.get());
+                    check(sendRet, "encoder rejected frame for " + output.spec->path);
+                    writePackets(output, stream);
+                }
+            }
+        }
+        return progressed;
+    }
+
+    bool allFinished() const {
+        for (const auto& output : outputs_) {
+            for (const auto& stream : output.streams) {
+                if (stream.copySource) continue;
+                if (!stream.finished) return false;
+            }
+        }
+        return true;
+    }
+
+    void mainLoop() {
+        if (!graph_) return;
+        while (!allFinished()) {
+            int ret = avfilter_graph_request_oldest(graph_.get());
+            if (ret == AVERROR_EOF) {
+                drainSinks();
+                break;
+            }
+            if (ret != AVERROR(EAGAIN)) check(ret, "filter graph failed");
+
+            if (ret == AVERROR(EAGAIN)) {
+                // Feed the input whose buffer source the graph starved most.
+                OpenInput* neediest = nullptr;
+                unsigned mostFailed = 0;
+                for (auto& input : inputs_) {
+                    for (auto& stream : input.streams) {
+                        if (stream.closed) continue;
+                        unsigned failed = av_buffersrc_get_nb_failed_requests(stream.source);
+                        if (!neediest || failed > mostFailed) {
+                            neediest = &input;
+                            mostFailed = failed;
+                        }
+                    }
+                }
+                if (!neediest) {
+                    if (!drainSinks()) throw std::runtime_error("libav render: filter graph stalled");
+                    continue;
+                }
+                feedInput(*neediest);
+            }
+            drainSinks();
+            copyPackets(encodedSeconds());
+        }
+    }
+
+    // Output time every filtered stream has reached; copied packets up to it
+    // can be written without running ahead of the encoders.
+    double encodedSeconds() const {
+        double seconds = std::numeric_limits<double>::infinity();
+        for (const auto& output : outputs_) {
+            for (const auto& stream : output.streams) {
+                if (stream.copySource || stream.finished) continue;
+                seconds = std::min(seconds, stream.lastSeconds);
+            }
+        }
+        return seconds;
+    }
+
+    // Read ahead to the input's next packet of a copied stream, rebased onto
+    // the output timeline; false at the end of the input.
+    bool readCopyPacket(OpenInput& input) {
+        if (input.copyTarget) return true;
+        if (input.copyEof) return false;
+        if (!input.copyPacket) input.copyPacket.reset(av_packet_alloc());
+        AVPacket* packet = input.copyPacket.get();
+        int64_t offsetUs = static_cast<int64_t>(input.spec->offsetSeconds * AV_TIME_BASE) - input.startTimeUs;
+        while (true) {
+            int ret = av_read_frame(input.format.get(), packet);
+            if (ret == AVERROR_EOF) {
+                input.copyEof = true;
+                return false;
+            }
+            check(ret, "could not read from " + input.spec->path);
+
+            auto copy = std::find_if(input.copies.begin(), input.copies.end(), [&](const CopiedStream& c) {
+                return c.streamIndex == packet->stream_index;
+            });
+            if (copy == input.copies.end()) {
+                av_packet_unref(packet);
+                continue;
+            }
+            const OpenOutput& output = outputs_[copy->output];
+            AVRational inBase = output.streams[copy->map].copySource->time_base;
+            int64_t offset = av_rescale_q(offsetUs, kMicroseconds, inBase);
+            if (packet->pts != AV_NOPTS_VALUE) packet->pts += offset;
+            if (packet->dts != AV_NOPTS_VALUE) packet->dts += offset;
+
+            int64_t ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+            int64_t shown = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (output.spec->durationSeconds >= 0.0 && shown != AV_NOPTS_VALUE &&
+                shown * av_q2d(inBase) >= output.spec->durationSeconds) {
+                av_packet_unref(packet);
+                continue;
+            }
+            input.copySeconds = ts != AV_NOPTS_VALUE ? ts * av_q2d(inBase) : 0.0;
+            input.copyTarget = &*copy;
+            return true;
+        }
+    }
+
+    // Remux copied packets up to `untilSeconds`, alongside the encoded ones,
+    // so the muxer receives both streams in decode order and interleaves
+    // them closely instead of appending the copies after the encode.
+    void copyPackets(double untilSeconds) {
+        for (auto& input : inputs_) {
+            if (input.copies.empty()) continue;
+            while (readCopyPacket(input) && input.copySeconds <= untilSeconds) {
+                OpenOutput& output = outputs_[input.copyTarget->output];
+                EncodedStream& stream = output.streams[input.copyTarget->map];
+                AVPacket* packet = input.copyPacket.get();
+                packet->stream_index = stream.stream->index;
+                packet->pos = -1;
+                av_packet_rescale_ts(packet, stream.copySource->time_base, stream.stream->time_base);
+                input.copyTarget = nullptr;
+                check(av_interleaved_write_frame(output.format.get(), packet),
+                      "could not write to " + output.spec->path);
+            }
+        }
+    }
+
+    void finish() {
+        for (auto& output : outputs_) {
+            for (auto& stream : output.streams) {
+                if (!stream.copySource) flushEncoder(output, stream);
+            }
+            check(av_write_trailer(output.format.get()), "could not finalize " + output.spec->path);
+        }
+    }
+};
+
+} // namespace
+
+namespace Render {
+
+void LibavEngine::run(const RenderPlan& plan, const ProgressCallback& onProgress) {
+    Job job(plan, onProgress);
+    job.run();
+}
+
+} // namespace Render
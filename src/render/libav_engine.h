@@ -0,0 +1,31 @@
+#pragma once
+
+#include "render/render_plan.h"
+
+#include <functional>
+
+namespace Render {
+
+// Executes a RenderPlan inside the current process using libavformat,
+// libavcodec and libavfilter instead of spawning the ffmpeg CLI.
+//
+// The plan's filter graph is used as-is; input labels such as "[0:v]" are
+// wired to buffer sources fed by our own demux/decode loop, and every
+// output map is attached to a buffer sink feeding an encoder. All contexts
+// are owned by a single run() call, so independent jobs may run engines
+// concurrently on different threads.
+//
+// Codec and filter contexts are not carried over between runs: an encoder
+// drained at the end of its output cannot be reopened, and every plan
+// differs in frame size, rate, subtitle file or graph text. What batch jobs
+// share instead is the process itself (no ffmpeg startup per job) and the
+// caches above the engine: background plates, subtitle sprites and clips.
+class LibavEngine {
+public:
+    // Called with the current output position (seconds) as frames are encoded.
+    using ProgressCallback = std::function<void(double outSeconds)>;
+
+    void run(const RenderPlan& plan, const ProgressCallback& onProgress = nullptr);
+};
+
+} // namespace Render
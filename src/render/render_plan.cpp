@@ -0,0 +1,194 @@
+#include "render/render_plan.h"
+#include "interfaces/IProcessExecutor.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void appendInput(std::ostringstream& cmd, const Render::InputSpec& input) {
+    if (input.loop) cmd << "-stream_loop -1 ";
+    if (input.offsetSeconds != 0.0) cmd << "-itsoffset " << input.offsetSeconds << " ";
+    if (!input.format.empty()) cmd << "-f " << input.format << " ";
+    for (const auto& [key, value] : input.formatOptions) {
+        cmd << "-" << key << " " << value << " ";
+    }
+    if (input.seekSeconds >= 0.0) cmd << "-ss " << input.seekSeconds << " ";
+    if (input.durationSeconds >= 0.0) cmd << "-t " << input.durationSeconds << " ";
+    if (input.format == "lavfi") {
+        // Filter descriptions are not file paths; keep them verbatim.
+        cmd << "-i " << input.path << " ";
+    } else {
+        cmd << "-i \"" << Render::toFfmpegPath(input.path) << "\" ";
+    }
+}
+
+void appendEncoder(std::ostringstream& cmd, const Render::EncoderSettings& encoder) {
+    const bool copyVideo = (encoder.videoCodec == "copy");
+    cmd << "-c:v " << encoder.videoCodec << " ";
+    if (!copyVideo) {
+        if (!encoder.preset.empty()) cmd << "-preset " << encoder.preset << " ";
+        if (encoder.crf >= 0) cmd << "-crf " << encoder.crf << " ";
+        if (!encoder.videoBitrate.empty()) cmd << "-b:v " << encoder.videoBitrate << " ";
+        if (!encoder.videoMaxRate.empty()) cmd << "-maxrate " << encoder.videoMaxRate << " ";
+        if (!encoder.videoBufSize.empty()) cmd << "-bufsize " << encoder.videoBufSize << " ";
+        if (encoder.allowSoftwareFallback) cmd << "-allow_sw 1 ";
+        std::string flags;
+        if (encoder.closedGop) flags += "+cgop";
+        if (encoder.globalHeader) flags += "+global_header";
+        if (!flags.empty()) cmd << "-flags " << flags << " ";
+        if (encoder.keyframeInterval > 0) cmd << "-g " << encoder.keyframeInterval << " ";
+        if (!encoder.keyframeTimes.empty()) {
+            cmd << "-force_key_frames ";
+            for (size_t i = 0; i < encoder.keyframeTimes.size(); ++i) {
+                char time[32];
+                std::snprintf(time, sizeof(time), "%.6f", encoder.keyframeTimes[i]);
+                cmd << (i > 0 ? "," : "") << time;
+            }
+            cmd << " ";
+        }
+        if (encoder.variableFrameRate) cmd << "-fps_mode vfr ";
+    }
+    if (!encoder.audioCodec.empty()) {
+        cmd << "-c:a " << encoder.audioCodec << " ";
+        if (!encoder.audioBitrate.empty() && encoder.audioCodec != "copy") cmd << "-b:a " << encoder.audioBitrate << " ";
+    } else {
+        cmd << "-an ";
+    }
+    if (!encoder.subtitleCodec.empty()) cmd << "-c:s " << encoder.subtitleCodec << " ";
+    if (!copyVideo && !encoder.pixelFormat.empty()) cmd << "-pix_fmt " << encoder.pixelFormat << " ";
+}
+
+void appendOutput(std::ostringstream& cmd, const Render::OutputSpec& output) {
+    for (const auto& map : output.maps) {
+        if (!map.empty() && map.front() == '[') {
+            cmd << "-map \"" << map << "\" ";
+        } else {
+            cmd << "-map " << map << " ";
+        }
+    }
+    if (output.chaptersInput >= 0) cmd << "-map_chapters " << output.chaptersInput << " ";
+    if (output.durationSeconds >= 0.0) cmd << "-t " << output.durationSeconds << " ";
+    appendEncoder(cmd, output.encoder);
+    for (size_t i = 0; i < output.subtitleLanguages.size(); ++i) {
+        cmd << "-metadata:s:s:" << i << " language=" << output.subtitleLanguages[i] << " ";
+    }
+    if (output.fastStart) cmd << "-movflags +faststart ";
+    if (output.encoder.threads > 0) cmd << "-threads " << output.encoder.threads << " ";
+    if (!output.format.empty()) cmd << "-f " << output.format << " ";
+    for (const auto& [key, value] : output.formatOptions) {
+        cmd << "-" << key << " " << value << " ";
+    }
+    cmd << "\"" << output.path << "\"";
+}
+
+} // namespace
+
+namespace Render {
+
+std::string toFfmpegPath(const fs::path& p) {
+    return p.generic_string(); // forward slashes are accepted on all platforms
+}
+
+std::string toFfmpegFilterPath(const fs::path& p) {
+    std::string s = toFfmpegPath(p);
+#ifdef _WIN32
+    std::string out;
+    out.reserve(s.size() * 2);
+    for (char ch : s) {
+        if (ch == ':') {
+            out.append("\\:");
+        } else if (ch == '\'') {
+            out.append("\\'");
+        } else {
+            out.push_back(ch);
+        }
+    }
+    return out;
+#else
+    return s;
+#endif
+}
+
+std::string toFfmpegTeePath(const fs::path& p) {
+    std::string s = toFfmpegPath(p);
+    std::string out;
+    out.reserve(s.size() * 2);
+    for (char ch : s) {
+        // The tee muxer splits its target with av_get_token, which also takes quotes and backslashes
+        if (ch == '|' || ch == '[' || ch == ']' || ch == ':' || ch == '\\' || ch == '\'') out.push_back('\\');
+        out.push_back(ch);
+    }
+    return out;
+}
+
+fs::path findFfmpeg() {
+    const char* pathEnv = std::getenv("PATH");
+    if (!pathEnv) return {};
+#ifdef _WIN32
+    const char separator = ';';
+    const std::string name = "ffmpeg.exe";
+#else
+    const char separator = ':';
+    const std::string name = "ffmpeg";
+#endif
+    std::string paths(pathEnv);
+    size_t start = 0;
+    while (start <= paths.size()) {
+        size_t end = paths.find(separator, start);
+        if (end == std::string::npos) end = paths.size();
+        if (end > start) {
+            fs::path candidate = fs::path(paths.substr(start, end - start)) / name;
+            std::error_code ec;
+            if (fs::is_regular_file(candidate, ec)) return candidate;
+        }
+        start = end + 1;
+    }
+    return {};
+}
+
+std::string buildCommand(const RenderPlan& plan) {
+    std::ostringstream cmd;
+    cmd << "ffmpeg ";
+    if (plan.emitProgress) {
+        cmd << "-progress pipe:1 -nostats -loglevel warning ";
+    }
+    cmd << "-y ";
+    if (plan.filterThreads > 0) cmd << "-filter_complex_threads " << plan.filterThreads << " ";
+    for (const auto& input : plan.inputs) {
+        appendInput(cmd, input);
+    }
+    if (!plan.filterComplex.empty()) {
+        cmd << "-filter_complex \"" << plan.filterComplex << "\" ";
+    }
+    for (size_t i = 0; i < plan.outputs.size(); ++i) {
+        if (i > 0) cmd << " ";
+        appendOutput(cmd, plan.outputs[i]);
+    }
+    return cmd.str();
+}
+
+void runCommandLine(Interfaces::IProcessExecutor& executor,
+                    const RenderPlan& plan,
+                    double totalDurationSeconds) {
+    for (const auto& output : plan.outputs) {
+        if (output.subtitleSprites) throw std::runtime_error("Subtitle sprites need the libav render backend");
+    }
+    std::string command = buildCommand(plan);
+    std::cout << "\nExecuting FFmpeg command:\n" << command << std::endl << std::endl;
+
+    if (plan.emitProgress) {
+        executor.executeWithProgress(command, totalDurationSeconds);
+    } else {
+        int exit_code = executor.execute(command);
+        if (exit_code != 0) throw std::runtime_error("FFmpeg execution failed");
+    }
+}
+
+} // namespace Render
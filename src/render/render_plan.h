@@ -0,0 +1,114 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Interfaces {
+    class IProcessExecutor;
+}
+
+namespace Render {
+
+struct SpriteTrack;
+
+// One input of a render job, mirroring an ffmpeg `-i` together with the
+// input options that precede it on the command line.
+struct InputSpec {
+    std::string path;
+    std::string format;                                // forced demuxer (-f), e.g. "concat" or "lavfi"
+    std::map<std::string, std::string> formatOptions;  // demuxer options, e.g. {"safe", "0"}
+    bool loop = false;                                 // -stream_loop -1
+    double seekSeconds = -1.0;                         // -ss (ignored when negative)
+    double durationSeconds = -1.0;                     // -t (ignored when negative)
+    double offsetSeconds = 0.0;                        // -itsoffset
+};
+
+// Codec names follow ffmpeg; "copy" remuxes a directly mapped input stream.
+struct EncoderSettings {
+    std::string videoCodec = "libx264";
+    std::string preset;
+    int crf = -1;
+    std::string videoBitrate;
+    std::string videoMaxRate;
+    std::string videoBufSize;
+    bool allowSoftwareFallback = false;  // h264_videotoolbox -allow_sw
+    bool closedGop = false;              // -flags +cgop, required for stream-copy joins
+    int keyframeInterval = 0;            // -g in frames, 0 lets the encoder decide
+    std::vector<double> keyframeTimes;   // -force_key_frames: output seconds that start a new GOP
+    bool globalHeader = false;           // -flags +global_header, for muxers that cannot ask for it (tee)
+    bool variableFrameRate = false;      // -fps_mode vfr: frames dropped upstream leave gaps, not duplicates
+    std::string audioCodec = "aac";      // empty for video-only outputs
+    std::string audioBitrate = "128k";
+    std::string subtitleCodec;           // -c:s for mapped subtitle streams, empty when there are none
+    std::string pixelFormat = "yuv420p";
+    int threads = 0;                     // -threads, 0 lets the encoder decide
+};
+
+struct OutputSpec {
+    std::string path;
+    std::string format;                                // forced muxer (-f), e.g. "tee" or "segment"
+    std::map<std::string, std::string> formatOptions;  // muxer options, e.g. {"segment_times", "4,9.5"}
+    // Either a filter graph label ("[v]") or an input stream ("1:a").
+    std::vector<std::string> maps;
+    double durationSeconds = -1.0;
+    EncoderSettings encoder;
+    bool fastStart = true;
+    // -map_chapters: input whose chapters the output carries. With -1 the
+    // ffmpeg CLI copies those of the first input that has any and the libav
+    // engine writes none.
+    int chaptersInput = -1;
+    // ISO 639-2 language of each mapped subtitle stream ("2:s"), in map order.
+    // Subtitle streams are muxed by the ffmpeg CLI only.
+    std::vector<std::string> subtitleLanguages;
+    // Subtitle sprites blended onto the video before encoding, in place of an
+    // `ass` filter (libav backend only); the offset is the track time of the
+    // output's first frame. With encoder.variableFrameRate, frames identical
+    // to the last one encoded are dropped after blending, since the graph
+    // cannot see the sprites.
+    std::shared_ptr<const SpriteTrack> subtitleSprites;
+    double subtitleSpritesOffset = 0.0;
+};
+
+// Complete description of an encode: what ffmpeg would receive on its
+// command line, but structured so that in-process backends can build the
+// same graph without going through a shell.
+struct RenderPlan {
+    std::vector<InputSpec> inputs;
+    std::string filterComplex;
+    std::vector<OutputSpec> outputs;
+    bool emitProgress = false;
+    int filterThreads = 0;  // -filter_complex_threads, 0 lets libavfilter decide
+};
+
+// Thrown by executors when a render is stopped through its cancel flag.
+class Cancelled : public std::runtime_error {
+public:
+    Cancelled() : std::runtime_error("Render cancelled") {}
+};
+
+// Normalize paths for ffmpeg arguments.
+std::string toFfmpegPath(const std::filesystem::path& p);
+
+// Escape characters that are significant to FFmpeg filter arguments (e.g., colons inside paths).
+std::string toFfmpegFilterPath(const std::filesystem::path& p);
+
+// Escape characters that separate tee muxer outputs and their options ('|', '[',
+// ']', ':', quotes and backslashes).
+std::string toFfmpegTeePath(const std::filesystem::path& p);
+
+// The ffmpeg executable the command line runs, empty when it is not on PATH.
+std::filesystem::path findFfmpeg();
+
+// Render the plan as a single ffmpeg command line.
+std::string buildCommand(const RenderPlan& plan);
+
+// Run the plan through the ffmpeg CLI using the executor's shell primitives.
+void runCommandLine(Interfaces::IProcessExecutor& executor,
+                    const RenderPlan& plan,
+                    double totalDurationSeconds);
+
+} // namespace Render
@@ -0,0 +1,337 @@
+#include "render/sprite_compositor.h"
+#include "data/pack_io.h"
+#include "render/blend_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kSpriteMagic[8] = {'Q', 'V', 'M', 'S', 'P', 'R', '0', '1'};
+constexpr size_t kHeaderSize = sizeof(kSpriteMagic) + 4 * sizeof(std::int32_t);
+
+void appendInt(std::string& out, std::int32_t value) {
+    auto bits = static_cast<std::uint32_t>(value);
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>((bits >> (8 * i)) & 0xFF));
+}
+
+std::int32_t readInt(const std::string& in, size_t offset) {
+    std::uint32_t bits = 0;
+    for (int i = 0; i < 4; ++i) bits |= static_cast<std::uint32_t>(static_cast<unsigned char>(in[offset + i])) << (8 * i);
+    return static_cast<std::int32_t>(bits);
+}
+
+int floorShift(int value, int shift) {
+    return value >= 0 ? value >> shift : -((-value + (1 << shift) - 1) >> shift);
+}
+
+int ceilShift(int value, int shift) {
+    return -floorShift(-value, shift);
+}
+
+// Where a sprite lands once scaled around the anchor.
+struct Placement {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+Placement placeSprite(const Render::Sprite& sprite, double scale, double anchorX, double anchorY) {
+    if (std::abs(scale - 1.0) < 1e-9) return {sprite.x, sprite.y, sprite.width, sprite.height};
+    return {
+        static_cast<int>(std::lround(anchorX + (sprite.x - anchorX) * scale)),
+        static_cast<int>(std::lround(anchorY + (sprite.y - anchorY) * scale)),
+        std::max(1, static_cast<int>(std::lround(sprite.width * scale))),
+        std::max(1, static_cast<int>(std::lround(sprite.height * scale))),
+    };
+}
+
+// Bilinear resample of premultiplied RGBA, sampling pixel centres.
+std::vector<std::uint8_t> resample(const Render::Sprite& sprite, int width, int height) {
+    if (width == sprite.width && height == sprite.height) return sprite.rgba;
+    std::vector<std::uint8_t> out(static_cast<size_t>(width) * height * 4);
+    const double sx = static_cast<double>(sprite.width) / width;
+    const double sy = static_cast<double>(sprite.height) / height;
+    for (int y = 0; y < height; ++y) {
+        double fy = std::clamp((y + 0.5) * sy - 0.5, 0.0, sprite.height - 1.0);
+        int y0 = static_cast<int>(fy);
+        int y1 = std::min(y0 + 1, sprite.height - 1);
+        double wy = fy - y0;
+        for (int x = 0; x < width; ++x) {
+            double fx = std::clamp((x + 0.5) * sx - 0.5, 0.0, sprite.width - 1.0);
+            int x0 = static_cast<int>(fx);
+            int x1 = std::min(x0 + 1, sprite.width - 1);
+            double wx = fx - x0;
+            const std::uint8_t* p00 = &sprite.rgba[(static_cast<size_t>(y0) * sprite.width + x0) * 4];
+            const std::uint8_t* p01 = &sprite.rgba[(static_cast<size_t>(y0) * sprite.width + x1) * 4];
+            const std::uint8_t* p10 = &sprite.rgba[(static_cast<size_t>(y1) * sprite.width + x0) * 4];
+            const std::uint8_t* p11 = &sprite.rgba[(static_cast<size_t>(y1) * sprite.width + x1) * 4];
+            std::uint8_t* dst = &out[(static_cast<size_t>(y) * width + x) * 4];
+            for (int c = 0; c < 4; ++c) {
+                double top = p00[c] + (p01[c] - p00[c]) * wx;
+                double bottom = p10[c] + (p11[c] - p10[c]) * wx;
+                dst[c] = static_cast<std::uint8_t>(std::lround(top + (bottom - top) * wy));
+            }
+        }
+    }
+    return out;
+}
+
+// The planar YUV layouts the blend handles: three planes, 8 to 16 bits,
+// native-endian samples.
+const AVPixFmtDescriptor* planarYuv(const AVFrame& frame) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame.format));
+    bool supported = desc && desc->nb_components >= 3 &&
+                     !(desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM |
+                                      AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BE)) &&
+                     (desc->flags & AV_PIX_FMT_FLAG_PLANAR);
+    for (int c = 0; supported && c < 3; ++c) {
+        const auto& comp = desc->comp[c];
+        supported = comp.plane == c && comp.shift == 0 && comp.depth >= 8 && comp.depth <= 16 &&
+                    comp.step == (comp.depth > 8 ? 2 : 1);
+    }
+    if (!supported) {
+        const char* name = desc ? desc->name : "unknown";
+        throw std::runtime_error(std::string("Subtitle sprites cannot be drawn on pixel format ") + name);
+    }
+    return desc;
+}
+
+// Transparent gaps shorter than this are blended through (they leave the
+// frame unchanged) rather than splitting a run
+constexpr int kSpanGap = 16;
+
+void findSpans(Render::SpriteCompositor::Stamp::Plane& plane) {
+    plane.spans.clear();
+    for (int row = 0; row < plane.height; ++row) {
+        const std::uint16_t* value = &plane.value[static_cast<size_t>(row) * plane.width];
+        const std::uint8_t* alpha = &plane.alpha[static_cast<size_t>(row) * plane.width];
+        int begin = -1, end = -1;
+        for (int col = 0; col < plane.width; ++col) {
+            if (alpha[col] == 0 && value[col] == 0) continue;
+            if (begin >= 0 && col - end >= kSpanGap) {
+                plane.spans.push_back({row, begin, end});
+                begin = -1;
+            }
+            if (begin < 0) begin = col;
+            end = col + 1;
+        }
+        if (begin >= 0) plane.spans.push_back({row, begin, end});
+    }
+}
+
+void blendPlane(const Render::SpriteCompositor::Stamp::Plane& plane, unsigned level, int depth, AVFrame* frame, int index) {
+    for (const auto& span : plane.spans) {
+        std::uint8_t* line = frame->data[index] + static_cast<ptrdiff_t>(plane.y + span.row) * frame->linesize[index];
+        size_t offset = static_cast<size_t>(span.row) * plane.width + span.begin;
+        int count = span.end - span.begin;
+        if (depth > 8) {
+            auto* dst = reinterpret_cast<std::uint16_t*>(line) + plane.x + span.begin;
+            Render::blendRow16(dst, &plane.value[offset], &plane.alpha[offset], count, level, depth);
+        } else {
+            Render::blendRow8(line + plane.x + span.begin, &plane.value[offset], &plane.alpha[offset], count, level);
+        }
+    }
+}
+
+} // namespace
+
+namespace Render {
+
+void saveSprite(const Sprite& sprite, const fs::path& path) {
+    std::string bytes(kSpriteMagic, sizeof(kSpriteMagic));
+    appendInt(bytes, sprite.x);
+    appendInt(bytes, sprite.y);
+    appendInt(bytes, sprite.width);
+    appendInt(bytes, sprite.height);
+    bytes.append(reinterpret_cast<const char*>(sprite.rgba.data()), sprite.rgba.size());
+    Data::writeFileAtomically(path, bytes);
+}
+
+Sprite loadSprite(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Could not open sprite " + path.string());
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.size() < kHeaderSize || std::memcmp(bytes.data(), kSpriteMagic, sizeof(kSpriteMagic)) != 0) {
+        throw std::runtime_error("Not a sprite file: " + path.string());
+    }
+    Sprite sprite;
+    sprite.x = readInt(bytes, sizeof(kSpriteMagic));
+    sprite.y = readInt(bytes, sizeof(kSpriteMagic) + 4);
+    sprite.width = readInt(bytes, sizeof(kSpriteMagic) + 8);
+    sprite.height = readInt(bytes, sizeof(kSpriteMagic) + 12);
+    size_t pixels = static_cast<size_t>(std::max(0, sprite.width)) * static_cast<size_t>(std::max(0, sprite.height));
+    if (bytes.size() != kHeaderSize + pixels * 4) throw std::runtime_error("Truncated sprite file: " + path.string());
+    sprite.rgba.assign(bytes.begin() + kHeaderSize, bytes.end());
+    return sprite;
+}
+
+double cueOpacity(const SpriteCue& cue, double seconds) {
+    if (seconds < cue.start || seconds >= cue.end) return 0.0;
+    double opacity = 1.0;
+    if (cue.fadeInSeconds > 0.0) opacity = std::min(opacity, (seconds - cue.start) / cue.fadeInSeconds);
+    if (cue.fadeOutSeconds > 0.0) opacity = std::min(opacity, (cue.end - seconds) / cue.fadeOutSeconds);
+    return std::clamp(opacity, 0.0, 1.0);
+}
+
+double cueScale(const SpriteCue& cue, double seconds) {
+    if (cue.growthFactor <= 1.0 || cue.end <= cue.start) return 1.0;
+    double progress = std::clamp((seconds - cue.start) / (cue.end - cue.start), 0.0, 1.0);
+    return (1.0 + (cue.growthFactor - 1.0) * progress) / cue.growthFactor;
+}
+
+SpriteCompositor::SpriteCompositor(std::shared_ptr<const SpriteTrack> track, double offsetSeconds)
+    : track_(std::move(track)), offsetSeconds_(offsetSeconds) {}
+
+SpriteCompositor::~SpriteCompositor() = default;
+
+SpriteCompositor::Stamp SpriteCompositor::makeStamp(const Sprite& sprite,
+                                                    double scale,
+                                                    double anchorX,
+                                                    double anchorY,
+                                                    const AVFrame& frame) {
+    const AVPixFmtDescriptor* desc = planarYuv(frame);
+    Placement place = placeSprite(sprite, scale, anchorX, anchorY);
+    Stamp stamp;
+    stamp.x = place.x;
+    stamp.y = place.y;
+    stamp.width = place.width;
+    stamp.height = place.height;
+    if (sprite.empty()) return stamp;
+    std::vector<std::uint8_t> rgba = resample(sprite, place.width, place.height);
+
+    // Premultiplied Y'CbCr of every sprite pixel, in frame units
+    const int depth = desc->comp[0].depth;
+    const double unit = std::ldexp(1.0, depth - 8);
+    const double maxValue = std::ldexp(1.0, depth) - 1.0;
+    const bool fullRange = frame.color_range == AVCOL_RANGE_JPEG ||
+                           std::strncmp(desc->name, "yuvj", 4) == 0;
+    double kr = 0.299, kb = 0.114;
+    if (frame.colorspace == AVCOL_SPC_BT709) {
+        kr = 0.2126;
+        kb = 0.0722;
+    } else if (frame.colorspace == AVCOL_SPC_BT2020_NCL || frame.colorspace == AVCOL_SPC_BT2020_CL) {
+        kr = 0.2627;
+        kb = 0.0593;
+    }
+    const double yOffset = fullRange ? 0.0 : 16.0 * unit;
+    const double yScale = fullRange ? maxValue : 219.0 * unit;
+    const double cOffset = 128.0 * unit;
+    const double cScale = fullRange ? maxValue : 224.0 * unit;
+
+    const size_t count = static_cast<size_t>(place.width) * place.height;
+    std::vector<double> premul[3];
+    std::vector<double> alpha(count);
+    for (auto& plane : premul) plane.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        double r = rgba[i * 4] / 255.0, g = rgba[i * 4 + 1] / 255.0, b = rgba[i * 4 + 2] / 255.0;
+        double a = rgba[i * 4 + 3] / 255.0;
+        double luma = kr * r + (1.0 - kr - kb) * g + kb * b;
+        alpha[i] = a;
+        premul[0][i] = a * yOffset + yScale * luma;
+        premul[1][i] = a * cOffset + cScale * (b - luma) / (2.0 * (1.0 - kb));
+        premul[2][i] = a * cOffset + cScale * (r - luma) / (2.0 * (1.0 - kr));
+    }
+
+    // Each plane pixel averages the sprite pixels it covers; the parts of its
+    // block outside the sprite count as transparent
+    for (int p = 0; p < 3; ++p) {
+        const int shiftX = p == 0 ? 0 : desc->log2_chroma_w;
+        const int shiftY = p == 0 ? 0 : desc->log2_chroma_h;
+        const int planeWidth = AV_CEIL_RSHIFT(frame.width, shiftX);
+        const int planeHeight = AV_CEIL_RSHIFT(frame.height, shiftY);
+        int x0 = std::max(0, floorShift(place.x, shiftX));
+        int y0 = std::max(0, floorShift(place.y, shiftY));
+        int x1 = std::min(planeWidth, ceilShift(place.x + place.width, shiftX));
+        int y1 = std::min(planeHeight, ceilShift(place.y + place.height, shiftY));
+        Stamp::Plane& plane = stamp.planes[p];
+        if (x1 <= x0 || y1 <= y0) continue;
+        plane.x = x0;
+        plane.y = y0;
+        plane.width = x1 - x0;
+        plane.height = y1 - y0;
+        plane.value.assign(static_cast<size_t>(plane.width) * plane.height, 0);
+        plane.alpha.assign(static_cast<size_t>(plane.width) * plane.height, 0);
+
+        const double blockSize = static_cast<double>(1 << (shiftX + shiftY));
+        for (int py = y0; py < y1; ++py) {
+            for (int px = x0; px < x1; ++px) {
+                double sumValue = 0.0, sumAlpha = 0.0;
+                for (int ly = std::max(py << shiftY, place.y); ly < std::min((py + 1) << shiftY, place.y + place.height); ++ly) {
+                    for (int lx = std::max(px << shiftX, place.x); lx < std::min((px + 1) << shiftX, place.x + place.width); ++lx) {
+                        size_t i = static_cast<size_t>(ly - place.y) * place.width + (lx - place.x);
+                        sumValue += premul[p][i];
+                        sumAlpha += alpha[i];
+                    }
+                }
+                size_t o = static_cast<size_t>(py - y0) * plane.width + (px - x0);
+                plane.value[o] = static_cast<std::uint16_t>(std::lround(std::clamp(sumValue / blockSize, 0.0, maxValue)));
+                plane.alpha[o] = static_cast<std::uint8_t>(std::lround(255.0 * sumAlpha / blockSize));
+            }
+        }
+        findSpans(plane);
+    }
+    return stamp;
+}
+
+void SpriteCompositor::blendStamp(const Stamp& stamp, double opacity, AVFrame* frame) {
+    const AVPixFmtDescriptor* desc = planarYuv(*frame);
+    auto level = static_cast<unsigned>(std::lround(std::clamp(opacity, 0.0, 1.0) * 255.0));
+    if (level == 0) return;
+    for (int p = 0; p < 3; ++p) {
+        blendPlane(stamp.planes[p], level, desc->comp[p].depth, frame, p);
+    }
+}
+
+void SpriteCompositor::apply(AVFrame* frame, double seconds) {
+    if (!track_) return;
+    const auto& cues = track_->cues;
+    const double t = seconds + offsetSeconds_;
+    if (t < lastSeconds_) {
+        cursor_ = 0;
+        active_.clear();
+    }
+    lastSeconds_ = t;
+
+    while (cursor_ < cues.size() && cues[cursor_].end <= t) ++cursor_;
+    for (auto it = active_.begin(); it != active_.end();) {
+        it = cues[it->first].end <= t ? active_.erase(it) : std::next(it);
+    }
+
+    for (size_t i = cursor_; i < cues.size() && cues[i].start <= t; ++i) {
+        const SpriteCue& cue = cues[i];
+        double opacity = cueOpacity(cue, t);
+        if (opacity <= 0.0) continue;
+
+        auto found = active_.find(i);
+        if (found == active_.end()) {
+            found = active_.emplace(i, Active{loadSprite(cue.sprite), {}, false}).first;
+        }
+        Active& entry = found->second;
+        if (entry.sprite.empty()) continue;
+
+        double scale = cueScale(cue, t);
+        Placement place = placeSprite(entry.sprite, scale, cue.anchorX, cue.anchorY);
+        if (!entry.hasStamp || place.x != entry.stamp.x || place.y != entry.stamp.y ||
+            place.width != entry.stamp.width || place.height != entry.stamp.height) {
+            entry.stamp = makeStamp(entry.sprite, scale, cue.anchorX, cue.anchorY, *frame);
+            entry.hasStamp = true;
+        }
+        blendStamp(entry.stamp, opacity, frame);
+    }
+}
+
+} // namespace Render
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <vector>
+
+struct AVFrame;
+
+namespace Render {
+
+// A subtitle event rasterized once, at its largest size and full opacity.
+struct Sprite {
+    int x = 0;  // top-left corner in the frame
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint8_t> rgba;  // premultiplied, row-major, width * height * 4
+
+    bool empty() const { return width <= 0 || height <= 0; }
+};
+
+// Sprites are stored as a small header followed by the RGBA bytes. Writes
+// are atomic; loadSprite throws std::runtime_error on a missing or damaged file.
+void saveSprite(const Sprite& sprite, const std::filesystem::path& path);
+Sprite loadSprite(const std::filesystem::path& path);
+
+// When and how a sprite is shown. Fades and growth follow the \fad and
+// \t(\fs) tags of the subtitle script they replace.
+struct SpriteCue {
+    double start = 0.0;  // seconds on the track's timeline, as libass reads them
+    double end = 0.0;
+    double fadeInSeconds = 0.0;
+    double fadeOutSeconds = 0.0;
+    double growthFactor = 1.0;  // the sprite's size relative to the cue's first frame
+    double anchorX = 0.0;       // point the cue grows around
+    double anchorY = 0.0;
+    std::filesystem::path sprite;
+};
+
+struct SpriteTrack {
+    std::vector<SpriteCue> cues;  // ordered by start
+};
+
+// Opacity (0-1) and scale relative to the sprite of a cue at `seconds`.
+double cueOpacity(const SpriteCue& cue, double seconds);
+double cueScale(const SpriteCue& cue, double seconds);
+
+// Draws a sprite track onto decoded frames with a per-pixel alpha blend, in
+// place of the libass pass of the `ass` filter. Sprites are loaded when their
+// cue starts and dropped when it ends; a scaled copy is reused while the
+// growth moves it by less than a pixel. Only the glyph-covered runs of each
+// row are blended, with the SIMD kernels of blend_kernels.h.
+class SpriteCompositor {
+public:
+    // `offsetSeconds` is the track time of the output's first frame.
+    SpriteCompositor(std::shared_ptr<const SpriteTrack> track, double offsetSeconds = 0.0);
+    ~SpriteCompositor();
+    SpriteCompositor(const SpriteCompositor&) = delete;
+    SpriteCompositor& operator=(const SpriteCompositor&) = delete;
+
+    // Blends the cues visible at `seconds` (output time) into a writable
+    // frame in a planar YUV format. Throws std::runtime_error for other formats.
+    void apply(AVFrame* frame, double seconds);
+
+    // A sprite converted to the frame's planes at one size and position.
+    struct Stamp {
+        struct Plane {
+            int x = 0;
+            int y = 0;
+            int width = 0;
+            int height = 0;
+            std::vector<std::uint16_t> value;  // premultiplied component, in frame units
+            std::vector<std::uint8_t> alpha;
+            // Runs of each row that change the frame; blending skips the rest
+            struct Span {
+                int row;
+                int begin;
+                int end;
+            };
+            std::vector<Span> spans;
+        };
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+        Plane planes[3];
+    };
+
+    // Exposed for tests: the sprite scaled by `scale` around the anchor and
+    // converted to the frame's format, and the blend of a stamp at `opacity`.
+    static Stamp makeStamp(const Sprite& sprite, double scale, double anchorX, double anchorY, const AVFrame& frame);
+    static void blendStamp(const Stamp& stamp, double opacity, AVFrame* frame);
+
+private:
+    struct Active {
+        Sprite sprite;
+        Stamp stamp;
+        bool hasStamp = false;
+    };
+
+    std::shared_ptr<const SpriteTrack> track_;
+    double offsetSeconds_;
+    size_t cursor_ = 0;
+    double lastSeconds_ = -1.0;
+    std::map<size_t, Active> active_;
+};
+
+} // namespace Render
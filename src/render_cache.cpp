@@ -0,0 +1,386 @@
+#include "render_cache.h"
+#include "cache_utils.h"
+#include "data/file_digests.h"
+#include "data/sha256.h"
+#include "localization_utils.h"
+#include "render/render_plan.h"
+#include "subtitle_builder.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+// Bump when the rendering pipeline changes in a way the inputs below do not capture.
+constexpr int kFormatVersion = 1;
+
+bool isLikelyUri(const std::string& value) {
+    auto pos = value.find("://");
+    return pos != std::string::npos && pos > 0;
+}
+
+fs::path executablePath() {
+#ifdef _WIN32
+    char buffer[MAX_PATH];
+    DWORD length = GetModuleFileNameA(NULL, buffer, MAX_PATH);
+    return length > 0 ? fs::path(std::string(buffer, length)) : fs::path();
+#else
+    std::error_code ec;
+    fs::path path = fs::read_symlink("/proc/self/exe", ec);
+    return ec ? fs::path() : path;
+#endif
+}
+
+// Content digest of a local file; remote URLs and unreadable paths stand for themselves.
+json fileInput(const std::string& path) {
+    if (path.empty() || isLikelyUri(path)) return path;
+    std::string digest = Data::FileDigests::shared().digest(path);
+    return digest.empty() ? json(path) : json(digest);
+}
+
+json fontInput(const FontConfig& font) {
+    return {{"family", font.family}, {"file", fileInput(font.file)}, {"size", font.size}, {"color", font.color}};
+}
+
+json optionInputs(const CLIOptions& options) {
+    json inputs;
+    inputs["surah"] = options.surah;
+    inputs["from"] = options.from;
+    inputs["to"] = options.to;
+    inputs["outputExtension"] = fs::path(options.output).extension().string();
+    inputs["preset"] = options.preset;
+    inputs["encoder"] = options.encoder;
+    inputs["renderBackend"] = options.renderBackend;
+    inputs["parallelChunks"] = options.parallelChunks;
+    inputs["backgroundPlate"] = options.backgroundPlate;
+    inputs["subtitleSprites"] = options.subtitleSprites;
+    inputs["variableFrameRate"] = options.variableFrameRate;
+    for (const auto& profile : options.extraOutputs) {
+        inputs["extraOutputs"].push_back({{"width", profile.width},
+                                          {"height", profile.height},
+                                          {"fps", profile.fps},
+                                          {"extension", fs::path(profile.path).extension().string()}});
+    }
+    for (int id : options.softTranslations) {
+        json source;
+        try {
+            source = fileInput(CacheUtils::translationSourcePath(id).string());
+        } catch (const std::exception&) {
+            source = nullptr;
+        }
+        inputs["softTranslations"].push_back({{"id", id}, {"source", source}});
+    }
+    if (!options.softTranslations.empty()) inputs["burnArabic"] = options.burnArabic;
+    if (!options.verseClipsDir.empty()) inputs["verseClips"] = true;
+    inputs["verseChapters"] = options.verseChapters;
+    inputs["clipLibrary"] = options.clipLibrary;
+    inputs["customAudio"] = fileInput(options.customAudioPath);
+    inputs["customTiming"] = fileInput(options.customTimingFile);
+    inputs["segmentLongVerses"] = options.segmentLongVerses;
+    if (options.segmentLongVerses) {
+        inputs["segmentData"] = fileInput(options.segmentDataPath);
+        inputs["longVerses"] = fileInput(options.longVersesPath);
+    }
+    return inputs;
+}
+
+json dataFileInputs(const AppConfig& config) {
+    json inputs;
+    try {
+        inputs["translation"] = fileInput(CacheUtils::translationSourcePath(config.translationId).string());
+    } catch (const std::exception&) {
+        inputs["translation"] = nullptr;
+    }
+    if (config.recitationMode == RecitationMode::GAPPED) {
+        try {
+            inputs["reciter"] = fileInput(CacheUtils::reciterSourcePath(config.reciterId).string());
+        } catch (const std::exception&) {
+            inputs["reciter"] = nullptr;
+        }
+    }
+    inputs["localization"] = RenderCache::describeLocalization(config);
+    return inputs;
+}
+
+json verseInputs(const std::vector<VerseData>& verses) {
+    json inputs = json::array();
+    for (const auto& verse : verses) {
+        json segments = json::array();
+        for (const auto& segment : verse.wordSegments) {
+            segments.push_back({segment.wordIndex, segment.startMs, segment.endMs});
+        }
+        inputs.push_back({
+            {"key", verse.verseKey},
+            {"text", verse.text},
+            {"translation", verse.translation},
+            {"duration", verse.durationInSeconds},
+            {"audio", fileInput(verse.localAudioPath)},
+            {"from", verse.timestampFromMs},
+            {"to", verse.timestampToMs},
+            {"absoluteFrom", verse.absoluteTimestampFromMs},
+            {"absoluteTo", verse.absoluteTimestampToMs},
+            {"customAudio", verse.fromCustomAudio},
+            {"words", std::move(segments)},
+        });
+    }
+    return inputs;
+}
+
+void linkOrCopy(const fs::path& from, const fs::path& to) {
+    if (to.has_parent_path()) fs::create_directories(to.parent_path());
+    std::error_code ec;
+    fs::remove(to, ec);
+    fs::create_hard_link(from, to, ec);
+    if (ec) {
+        fs::copy_file(from, to, fs::copy_options::overwrite_existing);
+    }
+}
+
+// Where an entry keeps the i-th extra output.
+fs::path extraEntryPath(const fs::path& entry, size_t index, const fs::path& output) {
+    return entry / ("extra-" + std::to_string(index) + output.extension().string());
+}
+
+// Where an entry keeps the i-th text track.
+fs::path textEntryPath(const fs::path& entry, size_t index) {
+    return entry / ("text-" + std::to_string(index) + ".vtt");
+}
+
+// manifest.json of a verse clip directory and the clips it lists; empty
+// when there is no readable manifest.
+std::vector<fs::path> verseClipFiles(const fs::path& directory) {
+    std::vector<fs::path> files;
+    std::ifstream in(directory / "manifest.json");
+    if (!in.is_open()) return files;
+    json manifest = json::parse(in, nullptr, false);
+    if (manifest.is_discarded() || !manifest.contains("clips")) return files;
+    files.push_back(directory / "manifest.json");
+    for (const auto& clip : manifest["clips"]) files.push_back(directory / clip.value("file", ""));
+    return files;
+}
+
+} // namespace
+
+namespace RenderCache {
+
+OutputSet outputsFor(const CLIOptions& options) {
+    OutputSet outputs;
+    outputs.video = options.output.empty() ? fs::path("out/render.mp4") : fs::path(options.output);
+    outputs.metadata = outputs.video;
+    outputs.metadata.replace_extension(".metadata.json");
+    outputs.thumbnail = outputs.video.parent_path() / "thumbnail.jpeg";
+    for (const auto& profile : options.extraOutputs) outputs.extraVideos.push_back(profile.path);
+    for (int id : options.softTranslations) {
+        outputs.textTracks.push_back(SubtitleBuilder::textTrackPath(outputs.video, id));
+    }
+    outputs.verseClips = options.verseClipsDir;
+    return outputs;
+}
+
+json describeInputs(const CLIOptions& options,
+                    const AppConfig& config,
+                    const std::vector<VerseData>& verses,
+                    const json& backgroundInputs) {
+    json inputs;
+    inputs["format"] = kFormatVersion;
+    inputs["binaries"] = describeBinaries();
+    inputs["options"] = optionInputs(options);
+    inputs["config"] = describeConfig(config);
+    inputs["data"] = dataFileInputs(config);
+    inputs["verses"] = verseInputs(verses);
+    inputs["background"] = backgroundInputs;
+    Data::FileDigests::shared().flush();
+    return inputs;
+}
+
+json describeLocalization(const AppConfig& config) {
+    const std::string lang = LocalizationUtils::getLanguageCode(config);
+    auto dataFile = [](const fs::path& relative) {
+        return fileInput(CacheUtils::resolveDataPath(relative).string());
+    };
+    return {
+        {"language", lang},
+        {"surahNames", dataFile(fs::path("data/surah-names") / (lang + ".json"))},
+        {"reciterNames", dataFile(fs::path("data/reciter-names") / (lang + ".json"))},
+        {"surahLabel", dataFile("data/misc/surah.json")},
+        {"numbers", dataFile("data/misc/numbers.json")},
+    };
+}
+
+json describeConfig(const AppConfig& config) {
+    json inputs;
+    inputs["width"] = config.width;
+    inputs["height"] = config.height;
+    inputs["fps"] = config.fps;
+    inputs["reciterId"] = config.reciterId;
+    inputs["translationId"] = config.translationId;
+    inputs["translationIsRtl"] = config.translationIsRtl;
+    inputs["recitationMode"] = config.recitationMode == RecitationMode::GAPLESS ? "gapless" : "gapped";
+    inputs["arabicFont"] = fontInput(config.arabicFont);
+    inputs["translationFont"] = fontInput(config.translationFont);
+    inputs["translationFallbackFontFamily"] = config.translationFallbackFontFamily;
+    inputs["overlayColor"] = config.overlayColor;
+    inputs["backgroundVideo"] = fileInput(config.assetBgVideo);
+    inputs["quranWordByWord"] = fileInput(config.quranWordByWordPath);
+    inputs["introDuration"] = config.introDuration;
+    inputs["pauseAfterIntroDuration"] = config.pauseAfterIntroDuration;
+    inputs["introFadeOutMs"] = config.introFadeOutMs;
+    inputs["enableTextGrowth"] = config.enableTextGrowth;
+    inputs["textGrowthThreshold"] = config.textGrowthThreshold;
+    inputs["maxGrowthFactor"] = config.maxGrowthFactor;
+    inputs["growthRateFactor"] = config.growthRateFactor;
+    inputs["fadeDurationFactor"] = config.fadeDurationFactor;
+    inputs["minFadeDuration"] = config.minFadeDuration;
+    inputs["maxFadeDuration"] = config.maxFadeDuration;
+    inputs["textWrapThreshold"] = config.textWrapThreshold;
+    inputs["arabicMaxWidthFraction"] = config.arabicMaxWidthFraction;
+    inputs["translationMaxWidthFraction"] = config.translationMaxWidthFraction;
+    inputs["textHorizontalPadding"] = config.textHorizontalPadding;
+    inputs["textVerticalPadding"] = config.textVerticalPadding;
+    inputs["verticalShift"] = config.verticalShift;
+    inputs["thumbnailColors"] = config.thumbnailColors;
+    inputs["thumbnailNumberPadding"] = config.thumbnailNumberPadding;
+    inputs["qualityProfile"] = config.qualityProfile;
+    inputs["crf"] = config.crf;
+    inputs["pixelFormat"] = config.pixelFormat;
+    inputs["videoBitrate"] = config.videoBitrate;
+    inputs["videoMaxRate"] = config.videoMaxRate;
+    inputs["videoBufSize"] = config.videoBufSize;
+    inputs["dynamicBackgrounds"] = config.videoSelection.enableDynamicBackgrounds;
+    if (config.videoSelection.enableDynamicBackgrounds) {
+        inputs["themeMetadata"] = fileInput(config.videoSelection.themeMetadataPath);
+    }
+    return inputs;
+}
+
+json describeBinaries() {
+    return {
+        {"qvm", fileInput(executablePath().string())},
+        {"ffmpeg", fileInput(Render::findFfmpeg().string())},
+    };
+}
+
+std::string fingerprint(const json& inputs) {
+    return Data::sha256Hex(inputs.dump());
+}
+
+fs::path entryDirectory(const std::string& fingerprint) {
+    return CacheUtils::getCacheRoot() / "renders" / fingerprint.substr(0, 2) / fingerprint;
+}
+
+bool restore(const std::string& fingerprint, const OutputSet& outputs) {
+    fs::path entry = entryDirectory(fingerprint);
+    fs::path video = entry / ("video" + outputs.video.extension().string());
+    std::error_code ec;
+    if (!fs::is_regular_file(video, ec) || fs::file_size(video, ec) == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < outputs.extraVideos.size(); ++i) {
+        if (!fs::is_regular_file(extraEntryPath(entry, i, outputs.extraVideos[i]), ec)) return false;
+    }
+    for (size_t i = 0; i < outputs.textTracks.size(); ++i) {
+        if (!fs::is_regular_file(textEntryPath(entry, i), ec)) return false;
+    }
+    std::vector<fs::path> storedClips;
+    if (!outputs.verseClips.empty()) {
+        storedClips = verseClipFiles(entry / "verse-clips");
+        if (storedClips.empty()) return false;
+    }
+    try {
+        linkOrCopy(video, outputs.video);
+        for (size_t i = 0; i < outputs.extraVideos.size(); ++i) {
+            linkOrCopy(extraEntryPath(entry, i, outputs.extraVideos[i]), outputs.extraVideos[i]);
+        }
+        for (size_t i = 0; i < outputs.textTracks.size(); ++i) {
+            linkOrCopy(textEntryPath(entry, i), outputs.textTracks[i]);
+        }
+        for (const auto& clip : storedClips) linkOrCopy(clip, outputs.verseClips / clip.filename());
+        if (fs::exists(entry / "thumbnail.jpeg", ec)) {
+            linkOrCopy(entry / "thumbnail.jpeg", outputs.thumbnail);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "  ! Could not restore cached render: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void store(const std::string& fingerprint, const OutputSet& outputs) {
+    std::error_code ec;
+    if (!fs::is_regular_file(outputs.video, ec) || fs::file_size(outputs.video, ec) == 0) {
+        return;
+    }
+    for (const auto& extra : outputs.extraVideos) {
+        if (!fs::is_regular_file(extra, ec) || fs::file_size(extra, ec) == 0) return;
+    }
+    for (const auto& track : outputs.textTracks) {
+        if (!fs::is_regular_file(track, ec)) return;
+    }
+    std::vector<fs::path> clips;
+    if (!outputs.verseClips.empty()) {
+        clips = verseClipFiles(outputs.verseClips);
+        if (clips.empty()) return;
+        for (const auto& clip : clips) {
+            if (!fs::is_regular_file(clip, ec)) return;
+        }
+    }
+    fs::path entry = entryDirectory(fingerprint);
+    if (fs::exists(entry, ec)) {
+        return;
+    }
+    fs::path staging = entry.parent_path() /
+        (".staging-" + fingerprint + "-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    try {
+        fs::create_directories(staging);
+        linkOrCopy(outputs.video, staging / ("video" + outputs.video.extension().string()));
+        for (size_t i = 0; i < outputs.extraVideos.size(); ++i) {
+            linkOrCopy(outputs.extraVideos[i], extraEntryPath(staging, i, outputs.extraVideos[i]));
+        }
+        for (size_t i = 0; i < outputs.textTracks.size(); ++i) {
+            linkOrCopy(outputs.textTracks[i], textEntryPath(staging, i));
+        }
+        for (const auto& clip : clips) linkOrCopy(clip, staging / "verse-clips" / clip.filename());
+        if (fs::exists(outputs.thumbnail, ec)) {
+            linkOrCopy(outputs.thumbnail, staging / "thumbnail.jpeg");
+        }
+        // Metadata is rewritten in place on every run, so it is copied, never linked
+        if (fs::exists(outputs.metadata, ec)) {
+            fs::copy_file(outputs.metadata, staging / "metadata.json", fs::copy_options::overwrite_existing);
+        }
+        fs::rename(staging, entry);
+    } catch (const std::exception& e) {
+        // Another process may have stored the same fingerprint first
+        if (!fs::exists(entry, ec)) {
+            std::cerr << "  ! Could not store render in cache: " << e.what() << std::endl;
+        }
+    }
+    fs::remove_all(staging, ec);
+}
+
+void detachOutputs(const OutputSet& outputs) {
+    std::vector<fs::path> paths = outputs.extraVideos;
+    paths.insert(paths.end(), outputs.textTracks.begin(), outputs.textTracks.end());
+    if (!outputs.verseClips.empty()) {
+        auto clips = verseClipFiles(outputs.verseClips);
+        paths.insert(paths.end(), clips.begin(), clips.end());
+    }
+    paths.push_back(outputs.video);
+    paths.push_back(outputs.thumbnail);
+    for (const auto& path : paths) {
+        std::error_code ec;
+        if (fs::is_regular_file(path, ec) && fs::hard_link_count(path, ec) > 1) {
+            fs::remove(path, ec);
+        }
+    }
+}
+
+} // namespace RenderCache
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "types.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Content-addressed store of finished renders. A render's fingerprint is the
+// SHA-256 of a canonical description of everything that shapes its output:
+// the resolved config and options, the contents of the data, font, asset and
+// audio files it reads, the background selection inputs and the binaries
+// doing the work. Identical requests are then served by linking the stored
+// files into place instead of rendering again.
+//
+// Entries live under <cache root>/renders/<fp[0..2]>/<fp>/ and are written to
+// a staging directory first, so a crashed render never leaves a partial entry.
+namespace RenderCache {
+
+struct OutputSet {
+    std::filesystem::path video;
+    std::filesystem::path thumbnail;
+    std::filesystem::path metadata;
+    std::vector<std::filesystem::path> extraVideos;  // --extra-output files, in order
+    std::vector<std::filesystem::path> textTracks;   // --soft-translations sidecars, in order
+    std::filesystem::path verseClips;                // --verse-clips directory (manifest and clips)
+};
+
+// Where a render with these options writes its files.
+OutputSet outputsFor(const CLIOptions& options);
+
+// Canonical inputs of a render. `backgroundInputs` is
+// BackgroundVideo::Manager::selectionInputs() (null without dynamic backgrounds).
+nlohmann::json describeInputs(const CLIOptions& options,
+                              const AppConfig& config,
+                              const std::vector<VerseData>& verses,
+                              const nlohmann::json& backgroundInputs);
+
+// Parts of describeInputs(), shared with the clip library's keys: the resolved
+// config (file settings replaced by content digests), the qvm/ffmpeg binaries
+// and the localization tables the intro card is written from.
+nlohmann::json describeConfig(const AppConfig& config);
+nlohmann::json describeBinaries();
+nlohmann::json describeLocalization(const AppConfig& config);
+
+std::string fingerprint(const nlohmann::json& inputs);
+
+std::filesystem::path entryDirectory(const std::string& fingerprint);
+
+// Links (or copies, across filesystems) a stored render's files to `outputs`. Returns false when there is no complete entry.
+bool restore(const std::string& fingerprint, const OutputSet& outputs);
+
+// Records finished outputs under the fingerprint. Failures are reported and
+// otherwise ignored; the cache never fails a render.
+void store(const std::string& fingerprint, const OutputSet& outputs);
+
+// Removes output files that share storage with a cache entry, so writing a
+// new render to the same path cannot modify the stored copy.
+void detachOutputs(const OutputSet& outputs);
+
+} // namespace RenderCache
@@ -0,0 +1,185 @@
+#include "render_job.h"
+#include "config_loader.h"
+#include "quran_data.h"
+#include "LiveApiClient.h"
+#include "SystemProcessExecutor.h"
+#include "LibavProcessExecutor.h"
+#include "video_generator.h"
+#include "metadata_writer.h"
+#include "verse_segmentation.h"
+#include "background_video_manager.h"
+#include "render_cache.h"
+#include "audio/duration_manifest.h"
+#include "resource_governor.h"
+
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void throwIfCancelled(const CLIOptions& options) {
+    if (options.cancelRequested && *options.cancelRequested) throw Render::Cancelled();
+}
+
+std::string renderFingerprint(const CLIOptions& options, const AppConfig& config, const std::vector<VerseData>& verses) {
+    BackgroundVideo::Manager selectionProbe(config, options);
+    nlohmann::json backgroundInputs = selectionProbe.selectionInputs();
+    selectionProbe.cleanup();
+    return RenderCache::fingerprint(RenderCache::describeInputs(options, config, verses, backgroundInputs));
+}
+
+} // namespace
+
+namespace RenderJob {
+
+AppConfig loadJobConfig(CLIOptions& options) {
+    AppConfig config = loadConfig(options.configPath, options);
+
+    // We want to allow gapless mode for custom audio
+    if (config.recitationMode == RecitationMode::GAPLESS && options.customAudioPath.empty()) {
+        throw std::runtime_error("Gapless mode is temporarily disabled because it's too buggy and the gapless data needs to be cleaned first.");
+    }
+
+    // Override background theme if specified
+    if (!options.backgroundTheme.empty()) {
+        auto it = QuranData::backgroundThemes.find(options.backgroundTheme);
+        if (it != QuranData::backgroundThemes.end()) {
+            fs::path themePath = it->second;
+            if (!themePath.is_absolute()) {
+                themePath = fs::path(config.assetFolderPath) / themePath;
+            }
+            config.assetBgVideo = themePath.string();
+        } else {
+            std::cerr << "Warning: Unknown theme '" << options.backgroundTheme << "', using default." << std::endl;
+        }
+    }
+
+    validateAssets(config);
+    return config;
+}
+
+Result render(const CLIOptions& jobOptions,
+              const AppConfig& config,
+              const std::vector<std::string>& invocationArgs) {
+    Result result;
+    try {
+        // The lease pins this thread (and the encoders it starts) when asked,
+        // so it lives on this thread until the render is done
+        auto lease = Resources::Governor::shared().acquire();
+        CLIOptions options = jobOptions;
+        options.resources = lease.budget();
+
+        fs::path outputDir = fs::path(options.output).parent_path();
+        if (!outputDir.empty()) {
+            fs::create_directories(outputDir);
+        }
+        for (const auto& profile : options.extraOutputs) {
+            fs::path extraDir = fs::path(profile.path).parent_path();
+            if (!extraDir.empty()) fs::create_directories(extraDir);
+        }
+        if (!options.verseClipsDir.empty()) fs::create_directories(options.verseClipsDir);
+
+        std::string modeStr = (config.recitationMode == RecitationMode::GAPLESS) ? "gapless" : "gapped";
+        std::cout << "Rendering Surah " << options.surah << ", verses " << options.from << "-" << options.to << std::endl;
+        std::cout << "Mode: " << modeStr << std::endl;
+        std::cout << "Config: " << config.width << "x" << config.height << " @ " << config.fps << "fps, reciter=" << config.reciterId << ", translation=" << config.translationId << std::endl;
+        std::cout << "Text growth: " << (config.enableTextGrowth ? "enabled" : "disabled") << std::endl;
+        std::cout << "Resources: " << options.resources.cpus << " cores, " << options.resources.encoderThreads
+                  << " encoder / " << options.resources.filterThreads << " filter threads";
+        if (!options.resources.coreSet.empty()) {
+            std::cout << ", pinned to " << options.resources.coreSet.size() << " cores";
+            if (options.resources.numaNode >= 0) std::cout << " on NUMA node " << options.resources.numaNode;
+        }
+        std::cout << std::endl;
+
+        std::shared_ptr<Interfaces::IProcessExecutor> processExecutor;
+        if (options.renderBackend == "libav") {
+            processExecutor = std::make_shared<LibavProcessExecutor>(options.progressSink, options.cancelRequested);
+        } else {
+            processExecutor = std::make_shared<SystemProcessExecutor>(options.progressSink, options.cancelRequested);
+        }
+        auto apiClient = std::make_shared<LiveApiClient>();
+        // Pipelined: encode from the metadata timeline while the audio downloads
+        std::vector<VerseData> verses;
+        VideoGenerator::PendingVerses pendingVerses;
+        if (options.pipelineFetch && VideoGenerator::supportsPendingAudio(options, config)) {
+            verses = apiClient->planQuranData(options, config);
+        }
+        if (!verses.empty()) {
+            std::cout << "Pipelined fetch: encoding while the audio of " << verses.size() << " verses downloads" << std::endl;
+            pendingVerses = std::async(std::launch::async, [apiClient, options, config]() {
+                return apiClient->fetchQuranData(options, config);
+            }).share();
+        } else {
+            if (options.pipelineFetch) {
+                std::cout << "Pipelined fetch needs uncached gapped audio with durations in the reciter metadata "
+                             "and a single output; fetching first" << std::endl;
+            }
+            verses = apiClient->fetchQuranData(options, config);
+        }
+        throwIfCancelled(options);
+
+        // Create segmentation manager if enabled
+        auto segmentManager = VerseSegmentation::createManager(
+            options.segmentLongVerses,
+            options.longVersesPath,
+            options.segmentDataPath
+        );
+
+        // Identical requests are served from the render cache
+        RenderCache::OutputSet outputs = RenderCache::outputsFor(options);
+        // A pipelined render's audio is not fetched yet, so it is fingerprinted
+        // (and stored) once it is, but never looked up
+        if (!options.noCache && !pendingVerses.valid()) {
+            result.fingerprint = renderFingerprint(options, config, verses);
+            if (RenderCache::restore(result.fingerprint, outputs)) {
+                MetadataWriter::writeMetadata(options, config, invocationArgs, result.fingerprint, true);
+                Audio::DurationManifest::shared().flush();
+                std::cout << "\n✅ Identical render found in cache (" << result.fingerprint.substr(0, 12)
+                          << "). Video saved to: " << options.output << std::endl;
+                result.succeeded = true;
+                result.servedFromCache = true;
+                return result;
+            }
+        }
+        RenderCache::detachOutputs(outputs);
+        throwIfCancelled(options);
+
+        if (!pendingVerses.valid()) MetadataWriter::writeMetadata(options, config, invocationArgs, result.fingerprint);
+        result.succeeded = VideoGenerator::generateVideo(options, config, verses, processExecutor, segmentManager.get(),
+                                                         pendingVerses);
+        throwIfCancelled(options);
+        if (pendingVerses.valid()) {
+            // The fingerprint needs the fetched audio, so the metadata that records it follows the encode
+            if (result.succeeded && !options.noCache) {
+                result.fingerprint = renderFingerprint(options, config, pendingVerses.get());
+            }
+            MetadataWriter::writeMetadata(options, config, invocationArgs, result.fingerprint);
+        }
+        VideoGenerator::generateThumbnail(options, config, processExecutor);
+        if (result.succeeded && !result.fingerprint.empty()) {
+            RenderCache::store(result.fingerprint, outputs);
+        }
+        if (!result.succeeded) {
+            result.error = "Video generation failed";
+        }
+        Audio::DurationManifest::shared().flush();
+    } catch (const Render::Cancelled& e) {
+        result.succeeded = false;
+        result.cancelled = true;
+        result.error = e.what();
+    } catch (const std::exception& e) {
+        result.succeeded = false;
+        result.error = e.what();
+    }
+    return result;
+}
+
+} // namespace RenderJob
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+// One render from resolved options to finished files: the pipeline shared by
+// a single qvm run and every job of a batch. Data packs, fonts, indexes and
+// the download queue are process-wide, so later jobs in the same process
+// start warm.
+namespace RenderJob {
+
+struct Result {
+    bool succeeded = false;
+    bool servedFromCache = false;
+    bool cancelled = false;  // stopped through options.cancelRequested
+    std::string fingerprint;
+    std::string error;
+};
+
+// Loads the job's config and applies the options that act on it (background
+// theme). Throws std::runtime_error when the config or its assets are unusable.
+AppConfig loadJobConfig(CLIOptions& options);
+
+// Fetches, renders (or restores from the render cache) and writes metadata
+// and thumbnail. Never throws; failures are reported in the result. Raising
+// options.cancelRequested stops the job between stages or mid-encode.
+Result render(const CLIOptions& options,
+              const AppConfig& config,
+              const std::vector<std::string>& invocationArgs);
+
+} // namespace RenderJob
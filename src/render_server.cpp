@@ -0,0 +1,424 @@
+#include "render_server.h"
+#include "batch_runner.h"
+#include "cache_utils.h"
+#include "config_loader.h"
+#include "render_job.h"
+#include "background_video_manager.h"
+#include "audio/duration_manifest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+#if !defined(_WIN32)
+namespace {
+
+constexpr size_t kMaxRequestBytes = 1 << 20;
+
+std::atomic<bool> stopRequested{false};
+
+void requestStop(int) {
+    stopRequested = true;
+}
+
+// Sockets are close-on-exec, so the ffmpeg of one job does not keep another
+// client's connection (or the listener) open.
+int cloexecSocket() {
+#if defined(__linux__)
+    return socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#else
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+#endif
+}
+
+int cloexecAccept(int listener) {
+#if defined(__linux__)
+    return accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+#else
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd >= 0) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+#endif
+}
+
+// A client socket. Progress lines from the render and the connection's own
+// replies are serialized; the first failed write marks the client as gone.
+class Connection {
+public:
+    explicit Connection(int fd) : fd_(fd) {}
+    ~Connection() { ::close(fd_); }
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    bool send(const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (gone_) return false;
+        std::string data = line + "\n";
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t count = ::write(fd_, data.data() + written, data.size() - written);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) {
+                gone_ = true;
+                return false;
+            }
+            written += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    // Reads the request, which ends at the first newline or when the client
+    // shuts down its side. False when nothing usable arrives before the
+    // client leaves or the server stops.
+    bool readLine(std::string& line) {
+        std::string pending;
+        char buffer[4096];
+        while (!stopRequested) {
+            auto newline = pending.find('\n');
+            if (newline != std::string::npos) {
+                line = pending.substr(0, newline);
+                return true;
+            }
+            if (pending.size() > kMaxRequestBytes) return false;
+            pollfd descriptor{fd_, POLLIN, 0};
+            int ready = poll(&descriptor, 1, 200);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready < 0) return false;
+            if (ready == 0) continue;
+            ssize_t count = ::read(fd_, buffer, sizeof(buffer));
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) {
+                line = pending;
+                return !pending.empty();
+            }
+            pending.append(buffer, static_cast<size_t>(count));
+        }
+        return false;
+    }
+
+    // Waits up to `timeoutMs` for the client to hang up. A client that only
+    // shut down its writing side is still listening and does not count.
+    bool hungUp(int timeoutMs) {
+        pollfd descriptor{fd_, 0, 0};
+        int ready = poll(&descriptor, 1, timeoutMs);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ready > 0 && (descriptor.revents & (POLLHUP | POLLERR))) gone_ = true;
+        return gone_;
+    }
+
+private:
+    int fd_;
+    std::mutex mutex_;
+    bool gone_ = false;
+};
+
+// Jobs known to the server, in arrival order. At most `parallel` of them
+// render at once; the rest wait for a slot first come, first served.
+class Scheduler {
+public:
+    explicit Scheduler(int parallel) : parallel_(std::max(1, parallel)) {}
+
+    // Registers a job; null when an active job has the same id or output.
+    std::shared_ptr<std::atomic<bool>> add(const std::string& id, const std::string& output, std::string& conflict) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& job : jobs_) {
+            if (job.id == id) {
+                conflict = "a job with id " + id + " is already active";
+                return nullptr;
+            }
+            if (job.output == output) {
+                conflict = "output " + output + " is already being written by job " + job.id;
+                return nullptr;
+            }
+        }
+        jobs_.push_back({id, output, std::make_shared<std::atomic<bool>>(false), false});
+        return jobs_.back().cancel;
+    }
+
+    // Blocks until the job may render. False when it was cancelled first.
+    bool acquire(const std::string& id) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto job = find(id);
+        changed_.wait(lock, [&]() {
+            if (*job->cancel) return true;
+            if (running_ >= parallel_) return false;
+            auto next = std::find_if(jobs_.begin(), jobs_.end(), [](const Entry& entry) {
+                return !entry.running && !*entry.cancel;
+            });
+            return next == job;
+        });
+        if (*job->cancel) return false;
+        job->running = true;
+        ++running_;
+        return true;
+    }
+
+    void finish(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto job = find(id);
+        if (job == jobs_.end()) return;
+        if (job->running) --running_;
+        jobs_.erase(job);
+        changed_.notify_all();
+    }
+
+    bool cancel(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto job = find(id);
+        if (job == jobs_.end()) return false;
+        *job->cancel = true;
+        changed_.notify_all();
+        return true;
+    }
+
+    void cancelAll() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& job : jobs_) *job.cancel = true;
+        changed_.notify_all();
+    }
+
+    json status() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        json running = json::array();
+        json queued = json::array();
+        for (const auto& job : jobs_) {
+            (job.running ? running : queued).push_back(job.id);
+        }
+        return {{"running", running}, {"queued", queued}};
+    }
+
+private:
+    struct Entry {
+        std::string id;
+        std::string output;
+        std::shared_ptr<std::atomic<bool>> cancel;
+        bool running;
+    };
+
+    std::list<Entry>::iterator find(const std::string& id) {
+        return std::find_if(jobs_.begin(), jobs_.end(), [&](const Entry& entry) { return entry.id == id; });
+    }
+
+    const int parallel_;
+    int running_ = 0;
+    std::list<Entry> jobs_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+};
+
+struct ServerState {
+    explicit ServerState(const RenderServer::Settings& serverSettings)
+        : settings(serverSettings), scheduler(serverSettings.parallel) {}
+
+    const RenderServer::Settings& settings;
+    Scheduler scheduler;
+    std::mutex configMutex;  // loading a config touches the process-wide data root
+    std::atomic<size_t> jobCounter{0};
+};
+
+void reply(Connection& client, const std::string& kind, const json& body) {
+    std::string line = kind + " " + body.dump();
+    std::cout << line << std::endl;
+    client.send(line);
+}
+
+void runJob(Connection& client, const json& request, ServerState& state) {
+    json status = {{"id", "job-" + std::to_string(++state.jobCounter)}};
+    BatchRunner::Job job;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    try {
+        job = BatchRunner::parseJob(request, state.settings.baseArgs, status["id"].get<std::string>());
+        status["id"] = job.id;
+
+        // Every job shares the data root set by the server's config
+        fs::path configDir = resolveConfigPath(job.options.configPath, job.options.configPathProvided).parent_path();
+        if (fs::weakly_canonical(configDir) != CacheUtils::getDataRoot()) {
+            throw std::invalid_argument("config " + job.options.configPath +
+                                        " is in a different directory than the server's config");
+        }
+        {
+            std::lock_guard<std::mutex> lock(state.configMutex);
+            job.config = RenderJob::loadJobConfig(job.options);
+        }
+
+        std::string conflict;
+        std::string outputKey = fs::absolute(job.options.output).lexically_normal().string();
+        cancel = state.scheduler.add(job.id, outputKey, conflict);
+        if (!cancel) throw std::invalid_argument(conflict);
+    } catch (const std::exception& e) {
+        status["status"] = "failed";
+        status["error"] = e.what();
+        reply(client, "JOB", status);
+        return;
+    }
+
+    job.options.emitProgress = true;
+    job.options.progressSink = [&client](const std::string& line) { client.send(line); };
+    job.options.cancelRequested = cancel;
+    reply(client, "ACCEPTED", {{"id", job.id}, {"output", job.options.output}});
+
+    auto start = std::chrono::steady_clock::now();
+    auto rendering = std::async(std::launch::async, [&]() {
+        if (!state.scheduler.acquire(job.id)) {
+            RenderJob::Result result;
+            result.cancelled = true;
+            result.error = "Render cancelled";
+            return result;
+        }
+        return RenderJob::render(job.options, job.config, job.args);
+    });
+    while (rendering.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        if (client.hungUp(200)) {
+            state.scheduler.cancel(job.id);
+            break;
+        }
+    }
+    RenderJob::Result result = rendering.get();
+    state.scheduler.finish(job.id);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    status["status"] = result.cancelled ? "cancelled"
+                     : !result.succeeded ? "failed"
+                     : result.servedFromCache ? "cached" : "rendered";
+    status["output"] = job.options.output;
+    status["seconds"] = std::round(seconds * 100.0) / 100.0;
+    if (!result.fingerprint.empty()) status["fingerprint"] = result.fingerprint;
+    if (!result.error.empty()) status["error"] = result.error;
+    reply(client, "JOB", status);
+}
+
+void handleConnection(int fd, ServerState& state) {
+    Connection client(fd);
+    std::string text;
+    if (!client.readLine(text)) return;
+
+    json request;
+    try {
+        request = json::parse(text);
+    } catch (const std::exception& e) {
+        reply(client, "JOB", {{"status", "failed"}, {"error", std::string("invalid request: ") + e.what()}});
+        return;
+    }
+
+    if (request.is_object() && request.contains("cancel")) {
+        const json& target = request["cancel"];
+        std::string id = target.is_string() ? target.get<std::string>() : target.dump();
+        reply(client, "CANCEL", {{"id", id}, {"found", state.scheduler.cancel(id)}});
+    } else if (request.is_object() && request.contains("status")) {
+        reply(client, "STATUS", state.scheduler.status());
+    } else {
+        runJob(client, request, state);
+    }
+}
+
+int openSocket(const fs::path& socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::string path = socketPath.string();
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is empty or too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    if (fs::exists(socketPath)) {
+        // A socket nobody answers on is left over from a server that died
+        int probe = cloexecSocket();
+        bool live = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) ::close(probe);
+        if (live) throw std::runtime_error("Another server is already listening on " + path);
+        fs::remove(socketPath);
+    }
+
+    int listener = cloexecSocket();
+    if (listener < 0) throw std::runtime_error("Failed to create socket: " + std::string(std::strerror(errno)));
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        std::string reason = std::strerror(errno);
+        ::close(listener);
+        throw std::runtime_error("Failed to listen on " + path + ": " + reason);
+    }
+    return listener;
+}
+
+} // namespace
+#endif
+
+namespace RenderServer {
+
+int serve(const Settings& settings) {
+#if defined(_WIN32)
+    (void)settings;
+    throw std::runtime_error("qvm serve needs Unix domain sockets and is not available on Windows");
+#else
+    // Loading the config up front sets the data root every job renders against
+    CLIOptions startup;
+    startup.configPath = settings.configPath;
+    startup.configPathProvided = settings.configPathProvided;
+    loadConfig(startup.configPath, startup);
+
+    int listener = openSocket(settings.socketPath);
+    stopRequested = false;
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+
+    ServerState state(settings);
+    std::cout << "Serving on " << settings.socketPath.string() << " (" << std::max(1, settings.parallel)
+              << " jobs at a time, config " << startup.configPath << ")" << std::endl;
+
+    std::list<std::future<void>> connections;
+    while (!stopRequested) {
+        connections.remove_if([](std::future<void>& connection) {
+            return connection.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        });
+        pollfd descriptor{listener, POLLIN, 0};
+        if (poll(&descriptor, 1, 200) <= 0) continue;
+        int fd = cloexecAccept(listener);
+        if (fd < 0) continue;
+        connections.push_back(std::async(std::launch::async, [fd, &state]() {
+            try {
+                handleConnection(fd, state);
+            } catch (const std::exception& e) {
+                std::cerr << "  ! Connection failed: " << e.what() << std::endl;
+            }
+        }));
+    }
+
+    std::cout << "Shutting down; cancelling active jobs..." << std::endl;
+    state.scheduler.cancelAll();
+    connections.clear();  // waits for every connection to finish
+    ::close(listener);
+    std::error_code ec;
+    fs::remove(settings.socketPath, ec);
+    BackgroundVideo::releaseR2Clients();
+    Audio::DurationManifest::shared().flush();
+    return 0;
+#endif
+}
+
+} // namespace RenderServer
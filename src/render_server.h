@@ -0,0 +1,33 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// `qvm serve`: a long-running renderer listening on a Unix socket, so data
+// packs, indexes, fonts and background clients stay warm between jobs.
+//
+// A client connects and writes one JSON line:
+//   - a job, in the batch format ({"id": "x", "surah": 1, "from": 1, "to": 7}).
+//     The server answers "ACCEPTED {...}", streams the job's "PROGRESS {...}"
+//     events and ends with a "JOB {...}" status line (rendered, cached,
+//     failed or cancelled) before closing. Closing the connection early
+//     cancels the job.
+//   - {"cancel": "<id>"}, answered with "CANCEL {"id": ..., "found": ...}".
+//   - {"status": true}, answered with "STATUS {"running": [...], "queued": [...]}".
+namespace RenderServer {
+
+struct Settings {
+    std::filesystem::path socketPath;
+    int parallel = 1;                  // jobs rendered at once; later ones queue
+    std::vector<std::string> baseArgs; // flags applied to every job, before the job's own
+    std::string configPath;            // config loaded at startup; jobs must share its directory
+    bool configPathProvided = false;
+};
+
+// Serves until SIGINT or SIGTERM, then cancels running jobs and removes the
+// socket. Throws std::runtime_error when the socket cannot be opened or the
+// platform has no Unix sockets.
+int serve(const Settings& settings);
+
+} // namespace RenderServer
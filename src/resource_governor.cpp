@@ -0,0 +1,353 @@
+#include "resource_governor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Frames an x264 encode keeps alive at once (lookahead, references, frame
+// threads and the filter graph's queue), used to size parallel encodes.
+constexpr std::uint64_t kFramesInFlight = 100;
+
+std::string readFirstLine(const fs::path& path) {
+    std::ifstream file(path);
+    std::string line;
+    if (file.is_open()) std::getline(file, line);
+    return line;
+}
+
+#if defined(__linux__)
+// Directory of `controller` for this process, from /proc/self/cgroup: the
+// v1 hierarchy naming the controller, or the v2 one ("0::/path") for "".
+std::string cgroupPath(const std::string& controller) {
+    std::ifstream file("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(file, line)) {
+        auto first = line.find(':');
+        auto second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) continue;
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+        if (controller.empty()) {
+            if (controllers.empty()) return path;
+            continue;
+        }
+        std::stringstream names(controllers);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            if (name == controller) return path;
+        }
+    }
+    return "";
+}
+
+// First readable value among our own cgroup's file and the hierarchy root's
+// (inside a cgroup namespace the root already is our cgroup).
+std::string cgroupValue(const fs::path& hierarchy, const std::string& path, const std::string& file) {
+    for (const fs::path& dir : {hierarchy / fs::path(path).relative_path(), hierarchy}) {
+        std::string value = readFirstLine(dir / file);
+        if (!value.empty()) return value;
+    }
+    return "";
+}
+
+double cgroupCpuQuota() {
+    std::string v2 = cgroupValue("/sys/fs/cgroup", cgroupPath(""), "cpu.max");
+    if (!v2.empty()) return Resources::parseCpuMax(v2);
+    std::string path = cgroupPath("cpu");
+    try {
+        std::string quota = cgroupValue("/sys/fs/cgroup/cpu", path, "cpu.cfs_quota_us");
+        std::string period = cgroupValue("/sys/fs/cgroup/cpu", path, "cpu.cfs_period_us");
+        if (quota.empty() || period.empty()) return 0.0;
+        double quotaUs = std::stod(quota);
+        double periodUs = std::stod(period);
+        return quotaUs > 0.0 && periodUs > 0.0 ? quotaUs / periodUs : 0.0;
+    } catch (const std::exception&) {
+        return 0.0;
+    }
+}
+
+std::uint64_t cgroupMemoryLimit() {
+    std::string value = cgroupValue("/sys/fs/cgroup", cgroupPath(""), "memory.max");
+    if (value.empty()) value = cgroupValue("/sys/fs/cgroup/memory", cgroupPath("memory"), "memory.limit_in_bytes");
+    if (value.empty() || value == "max") return 0;
+    try {
+        return std::stoull(value);
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+std::vector<int> affinityCpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::vector<int> cpus;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool setAffinity(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+std::vector<Resources::NumaNode> numaNodes(const std::vector<int>& allowed) {
+    std::map<int, std::vector<int>> nodes;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator("/sys/devices/system/node", ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4) continue;
+        int node = 0;
+        try {
+            node = std::stoi(name.substr(4));
+        } catch (const std::exception&) {
+            continue;
+        }
+        for (int cpu : Resources::parseCpuList(readFirstLine(entry.path() / "cpulist"))) {
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu)) nodes[node].push_back(cpu);
+        }
+    }
+    // Nodes without allowed CPUs are dropped, so ids may have gaps
+    std::vector<Resources::NumaNode> result;
+    for (auto& [node, cpus] : nodes) {
+        if (!cpus.empty()) result.push_back({node, std::move(cpus)});
+    }
+    return result;
+}
+#endif
+
+} // namespace
+
+namespace Resources {
+
+int HostInfo::usableCpus() const {
+    int cpus = allowedCpus.empty() ? static_cast<int>(logicalCpus) : static_cast<int>(allowedCpus.size());
+    if (cgroupCpuQuota > 0.0) cpus = std::min(cpus, static_cast<int>(std::ceil(cgroupCpuQuota)));
+    return std::max(1, cpus);
+}
+
+std::uint64_t HostInfo::usableMemoryBytes() const {
+    if (cgroupMemoryLimitBytes == 0) return physicalMemoryBytes;
+    if (physicalMemoryBytes == 0) return cgroupMemoryLimitBytes;
+    return std::min(cgroupMemoryLimitBytes, physicalMemoryBytes);
+}
+
+HostInfo detectHost() {
+    HostInfo host;
+    host.logicalCpus = std::max(1u, std::thread::hardware_concurrency());
+#if defined(__linux__)
+    host.allowedCpus = affinityCpus();
+    host.cgroupCpuQuota = cgroupCpuQuota();
+    host.cgroupMemoryLimitBytes = cgroupMemoryLimit();
+#endif
+#if !defined(_WIN32)
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && pageSize > 0) {
+        host.physicalMemoryBytes = static_cast<std::uint64_t>(pages) * static_cast<std::uint64_t>(pageSize);
+    }
+#endif
+    // cgroup v1 reports "no limit" as a huge page-aligned number
+    if (host.physicalMemoryBytes > 0 && host.cgroupMemoryLimitBytes >= host.physicalMemoryBytes) {
+        host.cgroupMemoryLimitBytes = 0;
+    }
+    if (host.allowedCpus.empty()) {
+        for (unsigned cpu = 0; cpu < host.logicalCpus; ++cpu) host.allowedCpus.push_back(static_cast<int>(cpu));
+    }
+#if defined(__linux__)
+    host.numaNodes = numaNodes(host.allowedCpus);
+#endif
+    if (host.numaNodes.empty()) host.numaNodes.push_back({-1, host.allowedCpus});
+    return host;
+}
+
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream parts(list);
+    std::string part;
+    while (std::getline(parts, part, ',')) {
+        try {
+            auto dash = part.find('-');
+            int first = std::stoi(part.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+    return cpus;
+}
+
+double parseCpuMax(const std::string& cpuMax) {
+    std::stringstream fields(cpuMax);
+    std::string quota;
+    double period = 100000.0;
+    fields >> quota >> period;
+    if (quota.empty() || quota == "max" || period <= 0.0) return 0.0;
+    try {
+        return std::stod(quota) / period;
+    } catch (const std::exception&) {
+        return 0.0;
+    }
+}
+
+int parallelEncodes(const ResourceBudget& budget, int width, int height) {
+    if (budget.memoryBytes == 0 || width <= 0 || height <= 0) return std::numeric_limits<int>::max();
+    // 8-bit 4:2:0 frames; 10-bit formats are covered by the estimate's headroom
+    std::uint64_t perEncode = static_cast<std::uint64_t>(width) * static_cast<std::uint64_t>(height) * 3 / 2 * kFramesInFlight;
+    std::uint64_t fit = std::max<std::uint64_t>(1, budget.memoryBytes / perEncode);
+    return static_cast<int>(std::min<std::uint64_t>(fit, std::numeric_limits<int>::max()));
+}
+
+Governor::Lease::Lease(Governor* owner, size_t slot, ResourceBudget budget)
+    : owner_(owner), slot_(slot), budget_(std::move(budget)) {
+#if defined(__linux__)
+    if (!budget_.coreSet.empty()) {
+        previousCpus_ = affinityCpus();
+        if (!setAffinity(budget_.coreSet)) {
+            std::cerr << "  ! Could not pin render to its cores; running unpinned" << std::endl;
+            previousCpus_.clear();
+            budget_.coreSet.clear();
+            budget_.numaNode = -1;
+        }
+    }
+#endif
+}
+
+Governor::Lease::Lease(Lease&& other) noexcept
+    : owner_(other.owner_), slot_(other.slot_), budget_(std::move(other.budget_)),
+      previousCpus_(std::move(other.previousCpus_)) {
+    other.owner_ = nullptr;
+    other.previousCpus_.clear();
+}
+
+Governor::Lease::~Lease() {
+#if defined(__linux__)
+    if (!previousCpus_.empty()) setAffinity(previousCpus_);
+#endif
+    if (owner_) owner_->release(slot_);
+}
+
+Governor& Governor::shared() {
+    static Governor governor;
+    return governor;
+}
+
+void Governor::configure(const Settings& settings) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settings_ = settings;
+    settings_.concurrentRenders = std::max(1, settings.concurrentRenders);
+    slotsInUse_.resize(std::max(slotsInUse_.size(), static_cast<size_t>(settings_.concurrentRenders)), false);
+}
+
+const HostInfo& Governor::host() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    detectLocked();
+    return host_;
+}
+
+void Governor::detectLocked() {
+    if (detected_) return;
+    host_ = detectHost();
+    detected_ = true;
+}
+
+ResourceBudget Governor::budgetFor(const HostInfo& host, const Settings& settings, size_t slot) {
+    int renders = std::max(1, settings.concurrentRenders);
+    int cpus = host.usableCpus();
+    if (settings.cpus > 0) cpus = std::min(cpus, settings.cpus);
+
+    // Cores are dealt out in NUMA node order, so a render's share stays on
+    // one node whenever the share fits in it
+    std::vector<int> ordered;
+    for (const auto& node : host.numaNodes) ordered.insert(ordered.end(), node.cpus.begin(), node.cpus.end());
+    if (ordered.empty()) ordered = host.allowedCpus;
+
+    size_t index = slot % static_cast<size_t>(renders);
+    int share = std::max(1, cpus / renders);
+    int remainder = cpus > renders ? cpus % renders : 0;
+    int offset = static_cast<int>(index) * share + std::min(static_cast<int>(index), remainder);
+    if (static_cast<int>(index) < remainder) ++share;
+
+    ResourceBudget budget;
+    budget.cpus = share;
+    budget.encoderThreads = share;
+    // The overlay and subtitle filters are light next to x264; half the share
+    // keeps them from competing with the encoder for cores
+    budget.filterThreads = std::max(1, share / 2);
+    std::uint64_t memory = host.usableMemoryBytes();
+    budget.memoryBytes = memory / static_cast<std::uint64_t>(renders);
+
+    if (settings.pinCores && !ordered.empty()) {
+        for (int i = 0; i < share; ++i) {
+            budget.coreSet.push_back(ordered[static_cast<size_t>(offset + i) % ordered.size()]);
+        }
+        std::sort(budget.coreSet.begin(), budget.coreSet.end());
+        budget.coreSet.erase(std::unique(budget.coreSet.begin(), budget.coreSet.end()), budget.coreSet.end());
+        for (const auto& node : host.numaNodes) {
+            bool contained = std::all_of(budget.coreSet.begin(), budget.coreSet.end(), [&](int cpu) {
+                return std::find(node.cpus.begin(), node.cpus.end(), cpu) != node.cpus.end();
+            });
+            if (contained) {
+                budget.numaNode = node.id;
+                break;
+            }
+        }
+    }
+    return budget;
+}
+
+Governor::Lease Governor::acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    detectLocked();
+    if (slotsInUse_.empty()) slotsInUse_.resize(static_cast<size_t>(std::max(1, settings_.concurrentRenders)), false);
+    // More renders than configured share the slots' cores instead of failing
+    auto freeSlot = std::find(slotsInUse_.begin(), slotsInUse_.end(), false);
+    size_t slot = static_cast<size_t>(freeSlot - slotsInUse_.begin());
+    if (freeSlot == slotsInUse_.end()) {
+        slot = slotsInUse_.size();
+        slotsInUse_.push_back(true);
+    } else {
+        *freeSlot = true;
+    }
+    return Lease(this, slot, budgetFor(host_, settings_, slot));
+}
+
+int Governor::downloadWorkers() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    detectLocked();
+    // Downloads wait on the network, not the CPU, so they get two workers per
+    // core up to the download manager's default of 8
+    return std::clamp(2 * host_.usableCpus(), 2, 8);
+}
+
+void Governor::release(size_t slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slot < slotsInUse_.size()) slotsInUse_[slot] = false;
+}
+
+} // namespace Resources
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Splits the host's CPUs and memory between the renders a process runs at
+// once (one for a single run, --batch-parallel or --serve-parallel otherwise),
+// so encoders neither oversubscribe small hosts nor leave large ones idle.
+namespace Resources {
+
+struct NumaNode {
+    int id = -1;           // the kernel's node number, -1 when the topology is unknown
+    std::vector<int> cpus; // allowed CPUs on the node
+};
+
+// What this process may use, after affinity masks and cgroup quotas.
+struct HostInfo {
+    unsigned logicalCpus = 1;                  // CPUs online
+    std::vector<int> allowedCpus;              // CPUs in our affinity mask
+    double cgroupCpuQuota = 0.0;               // cores allowed by the cgroup, 0 = unlimited
+    std::uint64_t physicalMemoryBytes = 0;     // 0 = unknown
+    std::uint64_t cgroupMemoryLimitBytes = 0;  // 0 = unlimited
+    std::vector<NumaNode> numaNodes;           // nodes with allowed CPUs (one node when unknown)
+
+    // Cores renders may keep busy: the affinity mask, capped by the quota.
+    int usableCpus() const;
+    // Memory renders may use: the cgroup limit or physical memory (0 = unknown).
+    std::uint64_t usableMemoryBytes() const;
+};
+
+// Reads /proc and /sys on Linux; elsewhere only the CPU count is known.
+HostInfo detectHost();
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}. Malformed parts are skipped.
+std::vector<int> parseCpuList(const std::string& list);
+// Cores granted by a cgroup v2 `cpu.max` line ("200000 100000" -> 2.0), 0 for "max".
+double parseCpuMax(const std::string& cpuMax);
+
+// Encodes of width x height that fit in the budget's memory at once (at
+// least 1, unbounded without a memory figure), for chunked and clip-library
+// renders.
+int parallelEncodes(const ResourceBudget& budget, int width, int height);
+
+class Governor {
+public:
+    struct Settings {
+        int cpus = 0;               // cores to use, 0 = all the host allows
+        int concurrentRenders = 1;  // renders expected to run at once
+        bool pinCores = false;      // pin each render to its own cores (Linux)
+    };
+
+    // A render's slot. Pinning applies to the thread that acquired the lease
+    // (and threads and processes it starts) until the lease is destroyed,
+    // which must happen on the same thread.
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&&) = delete;
+        Lease(const Lease&) = delete;
+        ~Lease();
+
+        const ResourceBudget& budget() const { return budget_; }
+
+    private:
+        friend class Governor;
+        Lease(Governor* owner, size_t slot, ResourceBudget budget);
+
+        Governor* owner_;
+        size_t slot_;
+        ResourceBudget budget_;
+        std::vector<int> previousCpus_;  // affinity to restore when pinned
+    };
+
+    static Governor& shared();
+
+    void configure(const Settings& settings);
+    const HostInfo& host();
+
+    // Budget of slot `slot` out of settings.concurrentRenders.
+    static ResourceBudget budgetFor(const HostInfo& host, const Settings& settings, size_t slot);
+
+    Lease acquire();
+
+    // Download workers to run for the whole process when not set explicitly.
+    int downloadWorkers();
+
+private:
+    void release(size_t slot);
+    void detectLocked();
+
+    std::mutex mutex_;
+    Settings settings_;
+    bool detected_ = false;
+    HostInfo host_;
+    std::vector<bool> slotsInUse_;
+};
+
+} // namespace Resources
@@ -9,6 +9,9 @@
 #include <future>
 #include <cctype>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "cache_utils.h"
 #include "localization_utils.h"
 #include "text/text_layout.h"
 
@@ -16,13 +19,27 @@ namespace fs = std::filesystem;
 
 namespace {
 
-std::string format_time_ass(double seconds) {
+// Splits a time the way it is written to the script, dropping anything
+// below a centisecond.
+struct AssTime {
+    int hours;
+    int minutes;
+    int secs;
+    int centiseconds;
+};
+
+AssTime split_time_ass(double seconds) {
     int hours = seconds / 3600;
     seconds -= hours * 3600;
     int minutes = seconds / 60;
     seconds -= minutes * 60;
     int secs = seconds;
     int centiseconds = (seconds - secs) * 100;
+    return {hours, minutes, secs, centiseconds};
+}
+
+std::string format_time_ass(double seconds) {
+    auto [hours, minutes, secs, centiseconds] = split_time_ass(seconds);
 
     std::stringstream ss;
     ss << hours << ":" << std::setfill('0') << std::setw(2) << minutes << ":"
@@ -39,6 +56,35 @@ std::string format_ass_color(const std::string& hex_color) {
     return "&H" + clean_hex + "&";
 }
 
+// hh:mm:ss.mmm of a WebVTT cue timing
+std::string format_time_vtt(double seconds) {
+    long long ms = std::llround(std::max(0.0, seconds) * 1000.0);
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%02lld:%02lld:%02lld.%03lld",
+                  ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000);
+    return buffer;
+}
+
+// Cue payload: markup characters escaped, no blank lines (which end a cue)
+std::string vtt_payload(const std::string& text) {
+    std::string out;
+    out.reserve(text.size());
+    for (char ch : text) {
+        switch (ch) {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '\r': break;
+            case '\n':
+                if (!out.empty() && out.back() != '\n') out += '\n';
+                break;
+            default: out += ch;
+        }
+    }
+    while (!out.empty() && out.back() == '\n') out.pop_back();
+    return out;
+}
+
 bool is_basic_latin_ascii(unsigned char c) {
     return c >= 0x20 && c <= 0x7E;
 }
@@ -111,16 +157,55 @@ std::string applyLatinFontFallback(const std::string& text,
     return result;
 }
 
-std::string buildAssFile(const AppConfig& config,
-                         const CLIOptions& options,
-                         const std::vector<VerseData>& verses,
-                         double intro_duration,
-                         double pause_after_intro_duration,
-                         const VerseSegmentation::Manager* segmentManager) {
-    fs::path ass_path = fs::temp_directory_path() / "subtitles.ass";
-    std::ofstream ass_file(ass_path);
-    if (!ass_file.is_open()) throw std::runtime_error("Failed to create temporary subtitle file.");
+bool burnsTranslation(const CLIOptions& options) {
+    return options.softTranslations.empty();
+}
+
+std::vector<double> verseStartTimes(const std::vector<VerseData>& verses,
+                                    double intro_duration,
+                                    double pause_after_intro_duration) {
+    std::vector<double> starts;
+    starts.reserve(verses.size());
+    double cumulative_time = intro_duration + pause_after_intro_duration;
+    for (const auto& verse : verses) {
+        starts.push_back(cumulative_time);
+        cumulative_time += verse.durationInSeconds;
+    }
+    return starts;
+}
+
+std::string buildAssHeader(const AppConfig& config) {
+    TextLayout::Engine layoutEngine(config);
+    int styleMargin = std::max(10, static_cast<int>(layoutEngine.paddingPixels()));
+
+    std::ostringstream header;
+    header << "[Script Info]\nTitle: Quran Video Subtitles\nScriptType: v4.00+\n";
+    header << "PlayResX: " << config.width << "\nPlayResY: " << config.height << "\n\n";
+    header << "[V4+ Styles]\n";
+    header << "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n";
+    header << "Style: Arabic," << config.arabicFont.family << "," << config.arabicFont.size << "," << format_ass_color(config.arabicFont.color) << ",&H000000FF,&H00000000,&H99000000,0,0,0,0,100,100,0,0,1,1,1,5," << styleMargin << "," << styleMargin << "," << config.arabicFont.size * 1.5 << ",-1\n";
+    header << "Style: Translation," << config.translationFont.family << "," << config.translationFont.size << "," << format_ass_color(config.translationFont.color) << ",&H000000FF,&H00000000,&H99000000,0,0,0,0,100,100,0,0,1,1,1,5," << styleMargin << "," << styleMargin << "," << config.height / 2 + config.translationFont.size << ",-1\n\n";
+    header << "[Events]\n";
+    header << "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+    return header.str();
+}
 
+std::string dialogueLine(const Cue& cue) {
+    return "Dialogue: 0," + format_time_ass(cue.start) + "," + format_time_ass(cue.end) +
+           ",Translation,,0,0,0,," + cue.text;
+}
+
+double scriptTime(double seconds) {
+    AssTime t = split_time_ass(seconds);
+    return ((t.hours * 60 + t.minutes) * 60 + t.secs) + t.centiseconds / 100.0;
+}
+
+std::vector<Cue> buildCues(const AppConfig& config,
+                           const CLIOptions& options,
+                           const std::vector<VerseData>& verses,
+                           double intro_duration,
+                           double pause_after_intro_duration,
+                           const VerseSegmentation::Manager* segmentManager) {
     std::string language_code = LocalizationUtils::getLanguageCode(config);
     std::string localized_surah_name = LocalizationUtils::getLocalizedSurahName(options.surah, language_code);
     std::string localized_surah_label = LocalizationUtils::getLocalizedSurahLabel(language_code);
@@ -131,59 +216,83 @@ std::string buildAssFile(const AppConfig& config,
                                config.translationFallbackFontFamily,
                                config.translationFont.family);
 
-    ass_file << "[Script Info]\nTitle: Quran Video Subtitles\nScriptType: v4.00+\n";
-    ass_file << "PlayResX: " << config.width << "\nPlayResY: " << config.height << "\n\n";
-
     TextLayout::Engine layoutEngine(config);
-    double paddingPixels = layoutEngine.paddingPixels();
-    int styleMargin = std::max(10, static_cast<int>(paddingPixels));
-
-    ass_file << "[V4+ Styles]\n";
-    ass_file << "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n";
-    ass_file << "Style: Arabic," << config.arabicFont.family << "," << config.arabicFont.size << "," << format_ass_color(config.arabicFont.color) << ",&H000000FF,&H00000000,&H99000000,0,0,0,0,100,100,0,0,1,1,1,5," << styleMargin << "," << styleMargin << "," << config.arabicFont.size * 1.5 << ",-1\n";
-    ass_file << "Style: Translation," << config.translationFont.family << "," << config.translationFont.size << "," << format_ass_color(config.translationFont.color) << ",&H000000FF,&H00000000,&H99000000,0,0,0,0,100,100,0,0,1,1,1,5," << styleMargin << "," << styleMargin << "," << config.height / 2 + config.translationFont.size << ",-1\n\n";
-    ass_file << "[Events]\n";
-    ass_file << "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+    std::vector<Cue> cues;
 
     // Intro subtitle
     int base_font_size = config.translationFont.size;
     int scaled_font_size = static_cast<int>(base_font_size * (config.width * 0.7 / (base_font_size * 6.0)));
     if (scaled_font_size < base_font_size) scaled_font_size = base_font_size;
 
-    ass_file << "Dialogue: 0,0:00:00.00," << format_time_ass(intro_duration)
-            << ",Translation,,0,0,0,,{\\an5\\pos(" << config.width/2 << "," << config.height/2 << ")"
-            << "\\fs" << scaled_font_size
-            << "\\b1\\bord4\\shad3\\be2\\c&HFFFFFF&\\3c&H000000&"
-            << "\\fad(0," << config.introFadeOutMs << ")}" << localized_surah_text_render << "\n";
+    auto introCue = [&](double y, const std::string& tags, const std::string& text) {
+        Cue cue;
+        cue.start = 0.0;
+        cue.end = intro_duration;
+        cue.fadeOutSeconds = config.introFadeOutMs / 1000.0;
+        cue.anchorX = config.width / 2;
+        cue.anchorY = y;
+        std::ostringstream head;
+        head << "{\\an5\\pos(" << config.width / 2 << "," << y << ")" << tags;
+        cue.staticText = head.str() + "}" + text;
+        head << "\\fad(0," << config.introFadeOutMs << ")}";
+        cue.text = head.str() + text;
+        return cue;
+    };
+
+    // Soft translations carry the intro card and the translation lines as
+    // text tracks; the picture keeps the Arabic, or nothing at all
+    const bool burn_translation = burnsTranslation(options);
+    if (!burn_translation && !options.burnArabic) return cues;
 
-    std::string range_text = LocalizationUtils::getLocalizedNumber(options.surah, language_code) +
-                             " • " + std::to_string(options.from) + "-" + std::to_string(options.to);
-    
-    range_text = applyLatinFontFallback(range_text,
-                                        config.translationFallbackFontFamily,
-                                        config.translationFont.family);
+    if (burn_translation) {
+        std::ostringstream title_tags;
+        title_tags << "\\fs" << scaled_font_size << "\\b1\\bord4\\shad3\\be2\\c&HFFFFFF&\\3c&H000000&";
+        cues.push_back(introCue(config.height / 2, title_tags.str(), localized_surah_text_render));
 
-    ass_file << "Dialogue: 0,0:00:00.00," << format_time_ass(intro_duration)
-            << ",Translation,,0,0,0,,{\\an5\\pos(" << config.width/2 << "," << config.height/2 + scaled_font_size*1.5 << ")"
-            << "\\fs" << scaled_font_size/2
-            << "\\b0\\bord2\\shad1\\be1\\c&HFFFFFF&\\3c&H000000&"
-            << "\\fad(0," << config.introFadeOutMs << ")}"
-            << range_text << "\n";
+        std::string range_text = LocalizationUtils::getLocalizedNumber(options.surah, language_code) +
+                                 " • " + std::to_string(options.from) + "-" + std::to_string(options.to);
+
+        range_text = applyLatinFontFallback(range_text,
+                                            config.translationFallbackFontFamily,
+                                            config.translationFont.family);
+
+        std::ostringstream range_tags;
+        range_tags << "\\fs" << scaled_font_size / 2 << "\\b0\\bord2\\shad1\\be1\\c&HFFFFFF&\\3c&H000000&";
+        cues.push_back(introCue(config.height / 2 + scaled_font_size * 1.5, range_tags.str(), range_text));
+    }
 
     // Collect all dialogue entries (verses and segments)
     std::vector<SegmentDialogue> allDialogues;
     
-    double cumulative_time = intro_duration + pause_after_intro_duration;
+    std::vector<double> verse_starts = verseStartTimes(verses, intro_duration, pause_after_intro_duration);
     double verticalPadding = config.height * std::clamp(config.textVerticalPadding, 0.0, 0.3);
 
+    // Check which verses should be segmented
+    std::vector<char> segmented(verses.size(), 0);
+    for (size_t idx = 0; idx < verses.size(); ++idx) {
+        segmented[idx] = segmentManager &&
+                         segmentManager->isEnabled() &&
+                         segmentManager->shouldSegmentVerse(verses[idx].verseKey);
+    }
+
+    // Lay out whole verses in parallel; the engine's font pool is thread-safe
+    std::vector<TextLayout::LayoutResult> verse_layouts(verses.size());
+    size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), verses.size());
+    std::vector<std::future<void>> layout_jobs;
+    for (size_t w = 0; w < workers; ++w) {
+        layout_jobs.push_back(std::async(std::launch::async, [&, w]() {
+            for (size_t idx = w; idx < verses.size(); idx += workers) {
+                if (!segmented[idx]) verse_layouts[idx] = layoutEngine.layoutVerse(verses[idx]);
+            }
+        }));
+    }
+    for (auto& job : layout_jobs) job.get();
+
     for (size_t idx = 0; idx < verses.size(); ++idx) {
         const VerseData& verse = verses[idx];
+        double cumulative_time = verse_starts[idx];
         double verse_audio_start = verse.timestampFromMs / 1000.0;
-        
-        // Check if this verse should be segmented
-        bool useSegmentation = segmentManager && 
-                               segmentManager->isEnabled() && 
-                               segmentManager->shouldSegmentVerse(verse.verseKey);
+        bool useSegmentation = segmented[idx];
         
         if (useSegmentation) {
             // Get segments for this verse
@@ -227,7 +336,7 @@ std::string buildAssFile(const AppConfig& config,
             }
         } else {
             // Standard verse handling (no segmentation)
-            auto layout = layoutEngine.layoutVerse(verse);
+            const auto& layout = verse_layouts[idx];
             
             SegmentDialogue dialogue;
             dialogue.startTime = cumulative_time;
@@ -245,14 +354,12 @@ std::string buildAssFile(const AppConfig& config,
             
             allDialogues.push_back(dialogue);
         }
-        
-        cumulative_time += verse.durationInSeconds;
     }
 
     // Generate dialogue lines for all entries
     for (const auto& dialogue : allDialogues) {
         int arabic_size = dialogue.arabicSize;
-        int translation_size = dialogue.translationSize;
+        int translation_size = burn_translation ? dialogue.translationSize : 0;
         double duration = dialogue.endTime - dialogue.startTime;
 
         // Scale down if needed to fit screen
@@ -281,32 +388,143 @@ std::string buildAssFile(const AppConfig& config,
             std::max(duration * config.fadeDurationFactor, config.minFadeDuration),
             config.maxFadeDuration);
 
-        std::stringstream combined;
-        combined << "{\\an5\\q2\\rArabic"
-                 << "\\fs" << arabic_size
-                 << "\\pos(" << config.width / 2 << "," << arabic_y << ")"
-                 << "\\fad(" << (fade_time * 1000) << "," << (fade_time * 1000) << ")";
-        if (dialogue.growEnabled) {
-            combined << "\\t(0," << duration * 1000 << ",\\fs" 
-                     << arabic_size * dialogue.arabicGrowthFactor << ")";
-        }
-        combined << "}" << dialogue.arabicText
-                 << "\\N{\\an5\\q2\\rTranslation"
-                 << "\\fs" << translation_size
-                 << "\\pos(" << config.width / 2 << "," << translation_y << ")"
-                 << "\\fad(" << (fade_time * 1000) << "," << (fade_time * 1000) << ")";
-        if (dialogue.translationGrowthFactor > 1.0) {
-            combined << "\\t(0," << duration * 1000 << ",\\fs"
-                     << translation_size * dialogue.translationGrowthFactor << ")";
+        bool grow_translation = dialogue.translationGrowthFactor > 1.0;
+        double final_arabic_size = dialogue.growEnabled ? arabic_size * dialogue.arabicGrowthFactor : arabic_size;
+        double final_translation_size = grow_translation ? translation_size * dialogue.translationGrowthFactor
+                                                         : translation_size;
+
+        // The script animates fades and growth; the static form is the last
+        // frame of the growth at full opacity. Only the first \pos of an
+        // event applies, so the whole block grows around the Arabic anchor.
+        auto compose = [&](bool animated) {
+            std::stringstream combined;
+            combined << "{\\an5\\q2\\rArabic"
+                     << "\\fs" << (animated ? arabic_size : final_arabic_size)
+                     << "\\pos(" << config.width / 2 << "," << arabic_y << ")";
+            if (animated) {
+                combined << "\\fad(" << (fade_time * 1000) << "," << (fade_time * 1000) << ")";
+                if (dialogue.growEnabled) {
+                    combined << "\\t(0," << duration * 1000 << ",\\fs" 
+                             << arabic_size * dialogue.arabicGrowthFactor << ")";
+                }
+            }
+            combined << "}" << dialogue.arabicText;
+            if (!burn_translation) return combined.str();
+            combined << "\\N{\\an5\\q2\\rTranslation"
+                     << "\\fs" << (animated ? translation_size : final_translation_size)
+                     << "\\pos(" << config.width / 2 << "," << translation_y << ")";
+            if (animated) {
+                combined << "\\fad(" << (fade_time * 1000) << "," << (fade_time * 1000) << ")";
+                if (grow_translation) {
+                    combined << "\\t(0," << duration * 1000 << ",\\fs"
+                             << translation_size * dialogue.translationGrowthFactor << ")";
+                }
+            }
+            combined << "}" << dialogue.translationText;
+            return combined.str();
+        };
+
+        Cue cue;
+        cue.start = dialogue.startTime;
+        cue.end = dialogue.endTime;
+        cue.text = compose(true);
+        cue.staticText = compose(false);
+        cue.fadeInSeconds = fade_time;
+        cue.fadeOutSeconds = fade_time;
+        cue.growthFactor = dialogue.growEnabled ? dialogue.arabicGrowthFactor : 1.0;
+        cue.anchorX = config.width / 2;
+        cue.anchorY = arabic_y;
+        cues.push_back(std::move(cue));
+    }
+
+    return cues;
+}
+
+std::vector<Cue> buildTranslationCues(const AppConfig& config,
+                                      const CLIOptions& options,
+                                      const std::vector<VerseData>& verses,
+                                      double intro_duration,
+                                      double pause_after_intro_duration,
+                                      int translationId,
+                                      const VerseSegmentation::Manager* segmentManager) {
+    std::string language_code = QuranData::getTranslationLanguageCode(translationId);
+    std::vector<Cue> cues;
+
+    Cue intro;
+    intro.start = 0.0;
+    intro.end = intro_duration;
+    intro.text = LocalizationUtils::getLocalizedSurahLabel(language_code) + " " +
+                 LocalizationUtils::getLocalizedSurahName(options.surah, language_code) + "\n" +
+                 LocalizationUtils::getLocalizedNumber(options.surah, language_code) + " • " +
+                 std::to_string(options.from) + "-" + std::to_string(options.to);
+    cues.push_back(std::move(intro));
+
+    // Segment texts belong to the render's own translation; other
+    // translations show the whole verse over its segments
+    const bool own_translation = translationId == config.translationId;
+    std::vector<double> verse_starts = verseStartTimes(verses, intro_duration, pause_after_intro_duration);
+    for (size_t idx = 0; idx < verses.size(); ++idx) {
+        const VerseData& verse = verses[idx];
+        double verse_start = verse_starts[idx];
+        bool segmented = own_translation && segmentManager && segmentManager->isEnabled() &&
+                         segmentManager->shouldSegmentVerse(verse.verseKey);
+        if (segmented) {
+            double verse_audio_start = verse.timestampFromMs / 1000.0;
+            for (const auto& segment : segmentManager->getSegments(verse.verseKey)) {
+                Cue cue;
+                cue.start = verse_start + (segment.startSeconds - verse_audio_start);
+                cue.end = verse_start + (segment.endSeconds - verse_audio_start);
+                cue.text = segment.translation;
+                cues.push_back(std::move(cue));
+            }
+            continue;
         }
-        combined << "}" << dialogue.translationText;
+        Cue cue;
+        cue.start = verse_start;
+        cue.end = verse_start + verse.durationInSeconds;
+        cue.text = own_translation ? verse.translation : CacheUtils::getTranslationText(translationId, verse.verseKey);
+        cues.push_back(std::move(cue));
+    }
+    return cues;
+}
 
-        ass_file << "Dialogue: 0," << format_time_ass(dialogue.startTime) << ","
-                 << format_time_ass(dialogue.endTime)
-                 << ",Translation,,0,0,0,," << combined.str() << "\n";
+std::string webVttDocument(const std::vector<Cue>& cues) {
+    std::ostringstream vtt;
+    vtt << "WEBVTT\n";
+    for (const auto& cue : cues) {
+        std::string payload = vtt_payload(cue.text);
+        if (payload.empty()) continue;
+        // Cut to the script's centiseconds, so each line changes on the same
+        // frame as the burned-in Arabic
+        vtt << "\n" << format_time_vtt(scriptTime(cue.start)) << " --> " << format_time_vtt(scriptTime(cue.end))
+            << "\n" << payload << "\n";
     }
+    return vtt.str();
+}
+
+fs::path textTrackPath(const fs::path& video, int translationId) {
+    fs::path path = video;
+    path.replace_extension("." + std::to_string(translationId) + "." +
+                           QuranData::getTranslationLanguageCode(translationId) + ".vtt");
+    return path;
+}
 
+std::string buildAssFile(const AppConfig& config,
+                         const CLIOptions& options,
+                         const std::vector<VerseData>& verses,
+                         double intro_duration,
+                         double pause_after_intro_duration,
+                         const VerseSegmentation::Manager* segmentManager,
+                         const fs::path& assPath) {
+    fs::path ass_path = assPath.empty() ? fs::temp_directory_path() / "subtitles.ass" : assPath;
+    std::ofstream ass_file(ass_path);
+    if (!ass_file.is_open()) throw std::runtime_error("Failed to create temporary subtitle file.");
+
+    ass_file << buildAssHeader(config);
+    for (const auto& cue : buildCues(config, options, verses, intro_duration, pause_after_intro_duration, segmentManager)) {
+        ass_file << dialogueLine(cue) << "\n";
+    }
     return ass_path.string();
 }
 
-} // namespace SubtitleBuilder
\ No newline at end of file
+} // namespace SubtitleBuilder
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <filesystem>
 #include <string>
 #include <vector>
 #include <memory>
@@ -11,10 +12,71 @@ namespace SubtitleBuilder {
                                        const std::string& fallbackFont,
                                        const std::string& primaryFont);
 
+    // False with --soft-translations: verse cues then burn in only the Arabic
+    // (or nothing, with --burn-in none) and the intro card moves to the text tracks.
+    bool burnsTranslation(const CLIOptions& options);
+
+    // Start time of every verse on the video timeline (after intro and pause).
+    std::vector<double> verseStartTimes(const std::vector<VerseData>& verses,
+                                        double introDuration,
+                                        double pauseAfterIntroDuration);
+
+    // One dialogue event. `text` is what the script holds, with its fade
+    // and growth animation; `staticText` draws the event at its final size
+    // and full opacity, for rasterizing once and animating per frame.
+    struct Cue {
+        double start = 0.0;
+        double end = 0.0;
+        std::string text;
+        std::string staticText;
+        double fadeInSeconds = 0.0;
+        double fadeOutSeconds = 0.0;
+        double growthFactor = 1.0;  // final size relative to the first frame
+        double anchorX = 0.0;       // the event's \pos, which it grows around
+        double anchorY = 0.0;
+    };
+
+    // [Script Info], styles and the [Events] format line.
+    std::string buildAssHeader(const AppConfig& config);
+
+    // The intro card and every verse (or verse segment) in playback order.
+    std::vector<Cue> buildCues(const AppConfig& config,
+                               const CLIOptions& options,
+                               const std::vector<VerseData>& verses,
+                               double introDuration,
+                               double pauseAfterIntroDuration,
+                               const VerseSegmentation::Manager* segmentManager = nullptr);
+
+    // The cue as a "Dialogue:" line of the script.
+    std::string dialogueLine(const Cue& cue);
+
+    // `seconds` as libass reads it back from the script (whole centiseconds).
+    double scriptTime(double seconds);
+
+    // Plain-text cues of one translation on the timeline of buildCues(): the
+    // intro card, then every verse, or every segment of a segmented verse when
+    // `translationId` is the render's own translation.
+    std::vector<Cue> buildTranslationCues(const AppConfig& config,
+                                          const CLIOptions& options,
+                                          const std::vector<VerseData>& verses,
+                                          double introDuration,
+                                          double pauseAfterIntroDuration,
+                                          int translationId,
+                                          const VerseSegmentation::Manager* segmentManager = nullptr);
+
+    // The `text` of each cue as a WebVTT document; empty cues are skipped.
+    std::string webVttDocument(const std::vector<Cue>& cues);
+
+    // Sidecar of a translation's text track: <video stem>.<id>.<language>.vtt
+    std::filesystem::path textTrackPath(const std::filesystem::path& video, int translationId);
+
+    // Writes the subtitle script to `assPath` (a shared temp file when empty)
+    // and returns its path.
     std::string buildAssFile(const AppConfig& config,
                              const CLIOptions& options,
                              const std::vector<VerseData>& verses,
                              double introDuration,
                              double pauseAfterIntroDuration,
-                             const VerseSegmentation::Manager* segmentManager = nullptr);
+                             const VerseSegmentation::Manager* segmentManager = nullptr,
+                             const std::filesystem::path& assPath = {});
 }
@@ -0,0 +1,210 @@
+#include "subtitle_sprites.h"
+#include "cache_utils.h"
+#include "data/file_digests.h"
+#include "data/sha256.h"
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+#include <nlohmann/json.hpp>
+
+extern "C" {
+#include <ass/ass.h>
+}
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+// Bump when rasterization changes in a way the key inputs do not capture.
+constexpr int kFormatVersion = 1;
+
+fs::path fontsDirectory(const AppConfig& config) {
+    return fs::absolute(config.assetFolderPath) / "fonts";
+}
+
+// Everything a sprite key shares across the cues of one config.
+json keyBase(const AppConfig& config) {
+    json fonts = json::object();
+    std::error_code ec;
+    for (fs::directory_iterator it(fontsDirectory(config), ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_regular_file(ec)) {
+            fonts[it->path().filename().string()] = Data::FileDigests::shared().digest(it->path());
+        }
+    }
+    return {
+        {"format", kFormatVersion},
+        {"libass", ass_library_version()},
+        {"header", SubtitleBuilder::buildAssHeader(config)},
+        {"fonts", fonts},
+    };
+}
+
+std::string keyFor(json base, const std::string& staticText) {
+    base["text"] = staticText;
+    return Data::sha256Hex(base.dump());
+}
+
+void quietMessages(int level, const char* format, va_list args, void*) {
+    if (level > 1) return;  // errors only, as the ass filter reports them
+    char message[1024];
+    std::vsnprintf(message, sizeof(message), format, args);
+    std::cerr << "  ! libass: " << message << std::endl;
+}
+
+// One libass library and renderer, set up like the ass filter's. A renderer
+// must not be shared between threads, so each worker owns one.
+class Rasterizer {
+public:
+    Rasterizer(const AppConfig& config, const std::string& header)
+        : header_(header), width_(config.width), height_(config.height) {
+        library_ = ass_library_init();
+        if (!library_) throw std::runtime_error("Could not initialize libass");
+        ass_set_message_cb(library_, quietMessages, nullptr);
+        ass_set_fonts_dir(library_, fontsDirectory(config).string().c_str());
+        renderer_ = ass_renderer_init(library_);
+        if (!renderer_) {
+            ass_library_done(library_);
+            throw std::runtime_error("Could not initialize the libass renderer");
+        }
+        ass_set_frame_size(renderer_, width_, height_);
+        ass_set_storage_size(renderer_, width_, height_);
+        ass_set_fonts(renderer_, nullptr, nullptr, ASS_FONTPROVIDER_AUTODETECT, nullptr, 1);
+    }
+
+    ~Rasterizer() {
+        ass_renderer_done(renderer_);
+        ass_library_done(library_);
+    }
+
+    Rasterizer(const Rasterizer&) = delete;
+    Rasterizer& operator=(const Rasterizer&) = delete;
+
+    // The event drawn alone at t=0, composited back to front into the
+    // bounding box of its images.
+    Render::Sprite rasterize(const std::string& staticText) {
+        std::string script = header_ + "Dialogue: 0,0:00:00.00,0:01:00.00,Translation,,0,0,0,," + staticText + "\n";
+        ASS_Track* track = ass_read_memory(library_, script.data(), script.size(), nullptr);
+        if (!track) throw std::runtime_error("libass could not parse a subtitle event");
+
+        Render::Sprite sprite;
+        int left = INT_MAX, top = INT_MAX, right = INT_MIN, bottom = INT_MIN;
+        ASS_Image* images = ass_render_frame(renderer_, track, 0, nullptr);
+        for (ASS_Image* image = images; image; image = image->next) {
+            if (image->w <= 0 || image->h <= 0) continue;
+            left = std::min(left, std::max(0, image->dst_x));
+            top = std::min(top, std::max(0, image->dst_y));
+            right = std::max(right, std::min(width_, image->dst_x + image->w));
+            bottom = std::max(bottom, std::min(height_, image->dst_y + image->h));
+        }
+        if (right > left && bottom > top) {
+            sprite.x = left;
+            sprite.y = top;
+            sprite.width = right - left;
+            sprite.height = bottom - top;
+            sprite.rgba.assign(static_cast<size_t>(sprite.width) * sprite.height * 4, 0);
+            for (ASS_Image* image = images; image; image = image->next) composite(*image, sprite);
+        }
+        ass_free_track(track);
+        return sprite;
+    }
+
+private:
+    // Source-over of one coverage bitmap in its colour (0xRRGGBBAA, AA being
+    // transparency) onto the premultiplied canvas.
+    static void composite(const ASS_Image& image, Render::Sprite& sprite) {
+        const unsigned r = (image.color >> 24) & 0xFF;
+        const unsigned g = (image.color >> 16) & 0xFF;
+        const unsigned b = (image.color >> 8) & 0xFF;
+        const unsigned opacity = 255 - (image.color & 0xFF);
+        for (int y = 0; y < image.h; ++y) {
+            int fy = image.dst_y + y - sprite.y;
+            if (fy < 0 || fy >= sprite.height) continue;
+            for (int x = 0; x < image.w; ++x) {
+                int fx = image.dst_x + x - sprite.x;
+                if (fx < 0 || fx >= sprite.width) continue;
+                unsigned k = (image.bitmap[y * image.stride + x] * opacity + 127) / 255;
+                if (k == 0) continue;
+                std::uint8_t* dst = &sprite.rgba[(static_cast<size_t>(fy) * sprite.width + fx) * 4];
+                dst[0] = static_cast<std::uint8_t>((r * k + dst[0] * (255 - k) + 127) / 255);
+                dst[1] = static_cast<std::uint8_t>((g * k + dst[1] * (255 - k) + 127) / 255);
+                dst[2] = static_cast<std::uint8_t>((b * k + dst[2] * (255 - k) + 127) / 255);
+                dst[3] = static_cast<std::uint8_t>((255 * k + dst[3] * (255 - k) + 127) / 255);
+            }
+        }
+    }
+
+    std::string header_;
+    int width_;
+    int height_;
+    ASS_Library* library_ = nullptr;
+    ASS_Renderer* renderer_ = nullptr;
+};
+
+} // namespace
+
+namespace SubtitleSprites {
+
+std::string spriteKey(const AppConfig& config, const std::string& staticText) {
+    return keyFor(keyBase(config), staticText);
+}
+
+fs::path spritePath(const std::string& key) {
+    return CacheUtils::getCacheRoot() / "sprites" / key.substr(0, 2) / (key + ".sprite");
+}
+
+std::shared_ptr<const Render::SpriteTrack> prepareTrack(const AppConfig& config,
+                                                        const std::vector<SubtitleBuilder::Cue>& cues,
+                                                        int workers) {
+    const json base = keyBase(config);
+    Data::FileDigests::shared().flush();
+
+    auto track = std::make_shared<Render::SpriteTrack>();
+    std::map<std::string, const SubtitleBuilder::Cue*> missing;  // one raster per distinct sprite
+    for (const auto& cue : cues) {
+        // Events that end where they start (an intro card of length zero) are never drawn
+        if (SubtitleBuilder::scriptTime(cue.end) <= SubtitleBuilder::scriptTime(cue.start)) continue;
+        Render::SpriteCue spriteCue;
+        spriteCue.start = SubtitleBuilder::scriptTime(cue.start);
+        spriteCue.end = SubtitleBuilder::scriptTime(cue.end);
+        spriteCue.fadeInSeconds = cue.fadeInSeconds;
+        spriteCue.fadeOutSeconds = cue.fadeOutSeconds;
+        spriteCue.growthFactor = cue.growthFactor;
+        spriteCue.anchorX = cue.anchorX;
+        spriteCue.anchorY = cue.anchorY;
+        std::string key = keyFor(base, cue.staticText);
+        spriteCue.sprite = spritePath(key);
+        std::error_code ec;
+        if (!fs::is_regular_file(spriteCue.sprite, ec)) missing.emplace(key, &cue);
+        track->cues.push_back(std::move(spriteCue));
+    }
+    std::stable_sort(track->cues.begin(), track->cues.end(),
+                     [](const Render::SpriteCue& a, const Render::SpriteCue& b) { return a.start < b.start; });
+
+    if (!missing.empty()) {
+        std::cout << "Subtitle sprites: rasterizing " << missing.size() << " of " << cues.size() << std::endl;
+        std::vector<std::pair<std::string, const SubtitleBuilder::Cue*>> jobs(missing.begin(), missing.end());
+        const std::string header = base["header"].get<std::string>();
+        // One rasterizer (fonts and libass renderer) per thread
+        Parallel::forEachWithState(jobs.size(), static_cast<size_t>(std::max(1, workers)), [&]() -> Parallel::Work {
+            auto rasterizer = std::make_shared<Rasterizer>(config, header);
+            return [&jobs, rasterizer](size_t i) {
+                fs::path path = spritePath(jobs[i].first);
+                fs::create_directories(path.parent_path());
+                Render::saveSprite(rasterizer->rasterize(jobs[i].second->staticText), path);
+            };
+        });
+    } else {
+        std::cout << "Subtitle sprites: all " << cues.size() << " cached" << std::endl;
+    }
+    return track;
+}
+
+} // namespace SubtitleSprites
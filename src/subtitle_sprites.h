@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.h"
+#include "subtitle_builder.h"
+#include "render/sprite_compositor.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Subtitle events rasterized once with libass into premultiplied RGBA
+// sprites, so renders blend them onto frames instead of running libass on
+// every frame. A sprite's key covers what shapes its pixels (the frame size
+// and styles, the event's static text, the font files and the libass
+// version) but not its timing, so a verse laid out the same way is
+// rasterized once and reused by every later render.
+//
+// Sprites live under <cache root>/sprites/<key[0..2]>/<key>.sprite.
+namespace SubtitleSprites {
+
+std::string spriteKey(const AppConfig& config, const std::string& staticText);
+
+std::filesystem::path spritePath(const std::string& key);
+
+// The sprite track for `cues`, rasterizing sprites missing from the cache on
+// up to `workers` threads. Throws std::runtime_error when libass fails.
+std::shared_ptr<const Render::SpriteTrack> prepareTrack(const AppConfig& config,
+                                                        const std::vector<SubtitleBuilder::Cue>& cues,
+                                                        int workers);
+
+} // namespace SubtitleSprites
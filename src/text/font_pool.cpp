@@ -0,0 +1,142 @@
+#include "text/font_pool.h"
+
+#include <stdexcept>
+
+#include <hb-ft.h>
+#include <hb.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+namespace fs = std::filesystem;
+
+namespace TextLayout {
+
+// FreeType library handle. Creating and destroying faces must be serialized
+// per library, so every face operation takes `mutex`.
+struct FontPool::Library {
+    FT_Library ft = nullptr;
+    std::mutex mutex;
+
+    Library() {
+        if (FT_Init_FreeType(&ft)) throw std::runtime_error("Failed to init FreeType");
+    }
+    ~Library() { FT_Done_FreeType(ft); }
+};
+
+struct Font::Impl {
+    std::shared_ptr<FontPool::Library> library;
+    FT_Face face = nullptr;
+    hb_font_t* hbFont = nullptr;
+    hb_buffer_t* buffer = nullptr;
+    std::mutex mutex;
+    // Word advances keyed by segment properties + word text.
+    std::unordered_map<std::string, double> wordWidths;
+
+    double shapedWidth() {
+        hb_shape(hbFont, buffer, nullptr, 0);
+        unsigned int glyph_count;
+        hb_glyph_position_t* glyph_pos = hb_buffer_get_glyph_positions(buffer, &glyph_count);
+        double width = 0.0;
+        for (unsigned int i = 0; i < glyph_count; ++i) {
+            width += glyph_pos[i].x_advance / 64.0;
+        }
+        return width;
+    }
+
+    double wordWidth(const std::string& word, const hb_segment_properties_t& props, const std::string& keyPrefix) {
+        std::string key = keyPrefix + word;
+        auto it = wordWidths.find(key);
+        if (it != wordWidths.end()) return it->second;
+        hb_buffer_clear_contents(buffer);
+        hb_buffer_add_utf8(buffer, word.c_str(), static_cast<int>(word.size()), 0, -1);
+        hb_buffer_set_segment_properties(buffer, &props);
+        double width = shapedWidth();
+        wordWidths.emplace(std::move(key), width);
+        return width;
+    }
+
+    ~Impl() {
+        if (buffer) hb_buffer_destroy(buffer);
+        if (hbFont) hb_font_destroy(hbFont);
+        if (face) {
+            std::lock_guard<std::mutex> lock(library->mutex);
+            FT_Done_Face(face);
+        }
+    }
+};
+
+Font::Font(std::unique_ptr<Impl> impl) : impl_(std::move(impl)) {}
+
+Font::~Font() = default;
+
+double Font::measure(const std::string& text) {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    hb_buffer_t* buf = impl_->buffer;
+    hb_buffer_clear_contents(buf);
+    hb_buffer_add_utf8(buf, text.c_str(), -1, 0, -1);
+    hb_buffer_guess_segment_properties(buf);
+    return impl_->shapedWidth();
+}
+
+Font::WordMetrics Font::measureWords(const std::string& line, const std::vector<std::string>& words) {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    hb_buffer_t* buf = impl_->buffer;
+    hb_buffer_clear_contents(buf);
+    hb_buffer_add_utf8(buf, line.c_str(), -1, 0, -1);
+    hb_buffer_guess_segment_properties(buf);
+    hb_segment_properties_t props;
+    hb_buffer_get_segment_properties(buf, &props);
+
+    const char* language = hb_language_to_string(props.language);
+    std::string keyPrefix = std::to_string(static_cast<unsigned>(props.script)) + "/" +
+                            std::to_string(static_cast<unsigned>(props.direction)) + "/" +
+                            (language ? language : "") + "|";
+    WordMetrics metrics;
+    metrics.words.reserve(words.size());
+    for (const auto& word : words) {
+        metrics.words.push_back(impl_->wordWidth(word, props, keyPrefix));
+    }
+    metrics.space = impl_->wordWidth(" ", props, keyPrefix);
+    return metrics;
+}
+
+FontPool::FontPool() : library_(std::make_shared<Library>()) {}
+
+FontPool::~FontPool() = default;
+
+std::shared_ptr<FontPool> FontPool::shared() {
+    static std::shared_ptr<FontPool> pool = std::make_shared<FontPool>();
+    return pool;
+}
+
+std::shared_ptr<Font> FontPool::get(const fs::path& file, int pixelSize) {
+    auto key = std::make_pair(file.string(), pixelSize);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = fonts_.find(key);
+    if (it != fonts_.end()) return it->second;
+
+    auto impl = std::make_unique<Font::Impl>();
+    impl->library = library_;
+    {
+        std::lock_guard<std::mutex> libraryLock(library_->mutex);
+        if (FT_New_Face(library_->ft, key.first.c_str(), 0, &impl->face)) {
+            impl->face = nullptr;
+            throw std::runtime_error("Failed to load font: " + key.first);
+        }
+    }
+    FT_Set_Char_Size(impl->face, 0, pixelSize * 64, 0, 0);
+    // HarfBuzz keeps its shape-plan cache on the face, so it survives across verses too.
+    impl->hbFont = hb_ft_font_create(impl->face, nullptr);
+    impl->buffer = hb_buffer_create();
+
+    auto font = std::shared_ptr<Font>(new Font(std::move(impl)));
+    fonts_.emplace(key, font);
+    return font;
+}
+
+size_t FontPool::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fonts_.size();
+}
+
+} // namespace TextLayout
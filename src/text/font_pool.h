@@ -0,0 +1,66 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace TextLayout {
+
+// A font file loaded into FreeType at one pixel size with its HarfBuzz font.
+// Shaping state (face, hb_font, buffer) is reused between calls; calls are
+// serialized per font since an FT_Face must not be used concurrently.
+class Font {
+public:
+    ~Font();
+    Font(const Font&) = delete;
+    Font& operator=(const Font&) = delete;
+
+    // Advance width in pixels of the shaped UTF-8 text.
+    double measure(const std::string& text);
+
+    struct WordMetrics {
+        std::vector<double> words;
+        double space = 0.0;
+    };
+
+    // Advances of each word and of a single space, shaped with the script and
+    // direction HarfBuzz guesses for the whole `line`, so an isolated word is
+    // shaped the way it would be inside the line. Memoized per font.
+    WordMetrics measureWords(const std::string& line, const std::vector<std::string>& words);
+
+private:
+    friend class FontPool;
+    struct Impl;
+    explicit Font(std::unique_ptr<Impl> impl);
+    std::unique_ptr<Impl> impl_;
+};
+
+// Process-wide cache of loaded fonts keyed by (font file, pixel size).
+// All methods are thread-safe, so layout may run on several threads.
+class FontPool {
+public:
+    FontPool();
+    ~FontPool();
+    FontPool(const FontPool&) = delete;
+    FontPool& operator=(const FontPool&) = delete;
+
+    // Shared pool used by TextLayout::Engine unless one is supplied.
+    static std::shared_ptr<FontPool> shared();
+
+    std::shared_ptr<Font> get(const std::filesystem::path& file, int pixelSize);
+    size_t size() const;
+
+private:
+    friend class Font;
+    struct Library;
+    std::shared_ptr<Library> library_;
+    mutable std::mutex mutex_;
+    std::map<std::pair<std::string, int>, std::shared_ptr<Font>> fonts_;
+};
+
+} // namespace TextLayout
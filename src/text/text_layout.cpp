@@ -7,11 +7,6 @@
 #include <string>
 #include <vector>
 
-#include <hb-ft.h>
-#include <hb.h>
-#include <ft2build.h>
-#include FT_FREETYPE_H
-
 namespace fs = std::filesystem;
 
 namespace {
@@ -59,46 +54,6 @@ bool should_grow(int word_count, const AppConfig& config) {
     return config.enableTextGrowth && word_count < config.textGrowthThreshold;
 }
 
-struct FontContext {
-    FT_Library ft;
-    FT_Face face;
-    hb_font_t* hb_font;
-};
-
-FontContext init_font(const fs::path& font_file, int font_size) {
-    FontContext ctx;
-    if (FT_Init_FreeType(&ctx.ft)) throw std::runtime_error("Failed to init FreeType");
-    if (FT_New_Face(ctx.ft, font_file.string().c_str(), 0, &ctx.face)) {
-        FT_Done_FreeType(ctx.ft);
-        throw std::runtime_error("Failed to load font: " + font_file.string());
-    }
-    FT_Set_Char_Size(ctx.face, 0, font_size * 64, 0, 0);
-    ctx.hb_font = hb_ft_font_create(ctx.face, nullptr);
-    return ctx;
-}
-
-void free_font(FontContext& ctx) {
-    hb_font_destroy(ctx.hb_font);
-    FT_Done_Face(ctx.face);
-    FT_Done_FreeType(ctx.ft);
-}
-
-double measure_text_width(FontContext& ctx, const std::string& text) {
-    hb_buffer_t* buf = hb_buffer_create();
-    hb_buffer_add_utf8(buf, text.c_str(), -1, 0, -1);
-    hb_buffer_guess_segment_properties(buf);
-    hb_shape(ctx.hb_font, buf, nullptr, 0);
-
-    unsigned int glyph_count;
-    hb_glyph_position_t* glyph_pos = hb_buffer_get_glyph_positions(buf, &glyph_count);
-    double width = 0.0;
-    for (unsigned int i = 0; i < glyph_count; ++i) {
-        width += glyph_pos[i].x_advance / 64.0;
-    }
-    hb_buffer_destroy(buf);
-    return width;
-}
-
 std::vector<std::string> split_ass_lines(const std::string& text) {
     std::vector<std::string> lines;
     size_t start = 0;
@@ -115,14 +70,29 @@ std::vector<std::string> split_ass_lines(const std::string& text) {
     return lines;
 }
 
-std::string wrap_single_line(const std::string& line, FontContext& ctx, double max_width) {
-    if (line.empty() || measure_text_width(ctx, line) <= max_width) {
+// Greedy word wrap. Unless `exact` is set, line widths are computed
+// additively from memoized word and space advances; only candidates whose
+// estimate falls near the limit, on either side, are shaped in full, which
+// corrects for kerning across spaces and keeps the break decisions identical
+// to shaping every candidate. The band widens with each word added since the
+// line was last shaped, since the kerning the sum leaves out adds up.
+std::string wrap_single_line(const std::string& line, TextLayout::Font& font, double max_width, bool exact) {
+    if (line.empty() || font.measure(line) <= max_width) {
         return line;
     }
 
     std::istringstream iss(line);
-    std::string word;
+    std::vector<std::string> words;
+    for (std::string word; iss >> word;) words.push_back(word);
+
+    TextLayout::Font::WordMetrics metrics;
+    if (!exact) metrics = font.measureWords(line, words);
+    const double tolerance = std::max(4.0, max_width * 0.05);
+    const double join_tolerance = std::max(1.0, metrics.space * 0.25);
+    size_t joins = 0;  // words added to the current line by estimate alone
+
     std::string current;
+    double current_width = 0.0;
     std::vector<std::string> wrapped_lines;
     auto flush_current = [&]() {
         if (!current.empty()) {
@@ -131,13 +101,42 @@ std::string wrap_single_line(const std::string& line, FontContext& ctx, double m
         }
     };
 
-    while (iss >> word) {
-        std::string candidate = current.empty() ? word : current + " " + word;
-        if (measure_text_width(ctx, candidate) <= max_width || current.empty()) {
-            current = candidate;
+    for (size_t i = 0; i < words.size(); ++i) {
+        const std::string& word = words[i];
+        if (current.empty()) {
+            current = word;
+            current_width = exact ? 0.0 : metrics.words[i];
+            joins = 0;
+            continue;
+        }
+
+        std::string candidate = current + " " + word;
+        bool fits;
+        if (exact) {
+            fits = font.measure(candidate) <= max_width;
+        } else {
+            double estimate = current_width + metrics.space + metrics.words[i];
+            const double band = tolerance + static_cast<double>(joins + 1) * join_tolerance;
+            if (estimate < max_width - band) {
+                fits = true;
+                ++joins;
+            } else if (estimate > max_width + band) {
+                fits = false;
+            } else {
+                estimate = font.measure(candidate);
+                fits = estimate <= max_width;
+                joins = 0;
+            }
+            if (fits) current_width = estimate;
+        }
+
+        if (fits) {
+            current = std::move(candidate);
         } else {
             flush_current();
             current = word;
+            current_width = exact ? 0.0 : metrics.words[i];
+            joins = 0;
         }
     }
     flush_current();
@@ -150,13 +149,13 @@ std::string wrap_single_line(const std::string& line, FontContext& ctx, double m
     return rebuilt.empty() ? line : rebuilt;
 }
 
-std::string wrap_if_needed(const std::string& text, FontContext& ctx, double max_width) {
+std::string wrap_if_needed(const std::string& text, TextLayout::Font& font, double max_width, bool exact) {
     auto lines = split_ass_lines(text);
     bool applied = false;
     for (auto& line : lines) {
-        double width = measure_text_width(ctx, line);
+        double width = font.measure(line);
         if (width > max_width) {
-            line = wrap_single_line(line, ctx, max_width);
+            line = wrap_single_line(line, font, max_width, exact);
             applied = true;
         }
     }
@@ -178,8 +177,8 @@ double clamp_padding(double value) {
 
 namespace TextLayout {
 
-Engine::Engine(const AppConfig& config)
-    : config_(config) {
+Engine::Engine(const AppConfig& config, std::shared_ptr<FontPool> fonts)
+    : config_(config), fonts_(std::move(fonts)) {
     paddingPixels_ = config.width * clamp_padding(config.textHorizontalPadding);
     arabicWrapWidth_ = std::max(50.0, (config.width - 2.0 * paddingPixels_) * config.arabicMaxWidthFraction);
     translationWrapWidth_ =
@@ -196,18 +195,16 @@ LayoutResult Engine::layoutVerse(const VerseData& verse) const {
         : 1.0;
     int maxArabicSize = std::max(1, static_cast<int>(layout.baseArabicSize * layout.arabicGrowthFactor));
 
-    FontContext arabic_ctx = init_font(config_.arabicFont.file, maxArabicSize);
-    layout.wrappedArabic = wrap_if_needed(verse.text, arabic_ctx, arabicWrapWidth_);
-    free_font(arabic_ctx);
+    auto arabic_font = fonts_->get(config_.arabicFont.file, maxArabicSize);
+    layout.wrappedArabic = wrap_if_needed(verse.text, *arabic_font, arabicWrapWidth_, exactMeasurement_);
 
     layout.baseTranslationSize = adaptive_font_size_translation(verse.translation, config_.translationFont.size);
     layout.translationGrowthFactor = layout.growArabic ? layout.arabicGrowthFactor : 1.0;
     int maxTranslationSize =
         std::max(1, static_cast<int>(layout.baseTranslationSize * layout.translationGrowthFactor));
 
-    FontContext translation_ctx = init_font(config_.translationFont.file, maxTranslationSize);
-    layout.wrappedTranslation = wrap_if_needed(verse.translation, translation_ctx, translationWrapWidth_);
-    free_font(translation_ctx);
+    auto translation_font = fonts_->get(config_.translationFont.file, maxTranslationSize);
+    layout.wrappedTranslation = wrap_if_needed(verse.translation, *translation_font, translationWrapWidth_, exactMeasurement_);
 
     return layout;
 }
@@ -225,18 +222,16 @@ LayoutResult Engine::layoutSegment(const std::string& arabic,
         : 1.0;
     int maxArabicSize = std::max(1, static_cast<int>(layout.baseArabicSize * layout.arabicGrowthFactor));
 
-    FontContext arabic_ctx = init_font(config_.arabicFont.file, maxArabicSize);
-    layout.wrappedArabic = wrap_if_needed(arabic, arabic_ctx, arabicWrapWidth_);
-    free_font(arabic_ctx);
+    auto arabic_font = fonts_->get(config_.arabicFont.file, maxArabicSize);
+    layout.wrappedArabic = wrap_if_needed(arabic, *arabic_font, arabicWrapWidth_, exactMeasurement_);
 
     layout.baseTranslationSize = adaptive_font_size_translation(translation, config_.translationFont.size);
     layout.translationGrowthFactor = layout.growArabic ? layout.arabicGrowthFactor : 1.0;
     int maxTranslationSize =
         std::max(1, static_cast<int>(layout.baseTranslationSize * layout.translationGrowthFactor));
 
-    FontContext translation_ctx = init_font(config_.translationFont.file, maxTranslationSize);
-    layout.wrappedTranslation = wrap_if_needed(translation, translation_ctx, translationWrapWidth_);
-    free_font(translation_ctx);
+    auto translation_font = fonts_->get(config_.translationFont.file, maxTranslationSize);
+    layout.wrappedTranslation = wrap_if_needed(translation, *translation_font, translationWrapWidth_, exactMeasurement_);
 
     return layout;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "types.h"
+#include "text/font_pool.h"
+#include <memory>
 #include <string>
 
 namespace TextLayout {
@@ -16,9 +18,12 @@ struct LayoutResult {
     int arabicWordCount = 0;
 };
 
+// Wraps and sizes verse text for the subtitle track. Fonts come from a
+// FontPool, so constructing engines is cheap and layout calls may run
+// concurrently.
 class Engine {
 public:
-    explicit Engine(const AppConfig& config);
+    explicit Engine(const AppConfig& config, std::shared_ptr<FontPool> fonts = FontPool::shared());
 
     LayoutResult layoutVerse(const VerseData& verse) const;
     LayoutResult layoutSegment(const std::string& arabic, const std::string& translation, double durationSeconds) const;
@@ -26,11 +31,17 @@ public:
     double arabicWrapWidth() const { return arabicWrapWidth_; }
     double translationWrapWidth() const { return translationWrapWidth_; }
 
+    // Shape every wrap candidate in full instead of summing memoized word
+    // advances. Slower (quadratic per line); kept as the reference behaviour.
+    void setExactMeasurement(bool exact) { exactMeasurement_ = exact; }
+
 private:
     const AppConfig& config_;
+    std::shared_ptr<FontPool> fonts_;
     double paddingPixels_;
     double arabicWrapWidth_;
     double translationWrapWidth_;
+    bool exactMeasurement_ = false;
 };
 
 } // namespace TextLayout
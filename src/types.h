@@ -1,4 +1,8 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -121,6 +125,26 @@ struct VerseData {
     std::string sourceAudioPath;
 };
 
+// Share of the host one render may use, assigned by the resource governor.
+// Zero values leave the choice to ffmpeg/libav.
+struct ResourceBudget {
+    int cpus = 0;                 // cores for this render
+    int encoderThreads = 0;       // -threads per encode
+    int filterThreads = 0;        // -filter_complex_threads
+    std::uint64_t memoryBytes = 0;
+    std::vector<int> coreSet;     // CPUs the render is pinned to (empty: not pinned)
+    int numaNode = -1;            // node holding every pinned core, -1 if none or mixed
+};
+
+// Another output of the same render, at its own size and frame rate, cut
+// from the same background decode and audio (--extra-output).
+struct OutputProfile {
+    int width = 0;
+    int height = 0;
+    int fps = 0;       // 0 keeps the render's frame rate
+    std::string path;
+};
+
 struct CLIOptions {
     int surah;
     int from;
@@ -139,9 +163,29 @@ struct CLIOptions {
     bool clearCache = false;
     std::string preset = "fast";
     std::string encoder = "software";
+    std::string renderBackend = "cli";   // "cli" (spawn ffmpeg) or "libav" (in-process)
+    int parallelChunks = 0;              // >1 splits the video encode into verse-aligned chunks
+    bool clipLibrary = false;            // assemble the range from cached per-verse clips
+    bool backgroundPlate = false;        // loop a cached pre-scaled, pre-dimmed copy of the static background
+    bool subtitleSprites = false;        // blend cached pre-rasterized subtitles instead of the ass filter (libav)
+    bool variableFrameRate = false;      // encode only frames that differ from the previous one (static backgrounds)
+    std::vector<OutputProfile> extraOutputs;  // rendered alongside `output` in the same pass
+    std::vector<int> softTranslations;   // translations muxed as timed-text tracks instead of burned in
+    bool burnArabic = true;              // with soft translations: false leaves the picture without text
+    std::string verseClipsDir = "";      // also cut one clip per verse into this directory, in the same encode
+    bool verseChapters = true;           // a keyframe and an MP4 chapter at every verse start
+    bool pipelineFetch = false;          // encode from the metadata timeline while verse audio downloads
+    std::string backgroundTheme = "";    // --bg-theme, a key of QuranData::backgroundThemes
+    int downloadWorkers = 0;             // 0 keeps the download manager default
+    int downloadsPerHost = 0;            // 0 keeps the download manager default
     std::string recitationMode = "";  // "gapped" or "gapless"
     bool presetProvided = false;
     bool emitProgress = false;
+    // Set for jobs of `qvm serve`: where PROGRESS lines go (stdout when empty)
+    // and a flag that, once raised, stops the render at its next check
+    std::function<void(const std::string&)> progressSink;
+    std::shared_ptr<const std::atomic<bool>> cancelRequested;
+    ResourceBudget resources;  // filled by RenderJob from the resource governor
     
     // Custom recitation support (gapless only)
     std::string customAudioPath = "";     // Path or URL to audio file
@@ -0,0 +1,148 @@
+#include "verse_clips.h"
+#include "render/render_plan.h"
+#include "subtitle_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+// Numbered output of the segment muxer, counted from 0 in clip order
+fs::path segmentPath(const fs::path& directory, size_t index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), ".segment-%03zu.mp4", index);
+    return directory / name;
+}
+
+std::string formatSeconds(double seconds) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.6f", seconds);
+    return text;
+}
+
+std::string clipFileName(const std::string& verseKey) {
+    std::string name = verseKey;
+    std::replace(name.begin(), name.end(), ':', '_');
+    return name + ".mp4";
+}
+
+// FFMETADATA escapes '=', ';', '#', '\\' and newlines with a backslash
+std::string metadataValue(const std::string& value) {
+    std::string escaped;
+    for (char ch : value) {
+        if (ch == '=' || ch == ';' || ch == '#' || ch == '\\' || ch == '\n') escaped.push_back('\\');
+        escaped.push_back(ch);
+    }
+    return escaped;
+}
+
+} // namespace
+
+namespace VerseClips {
+
+std::vector<Clip> planClips(const AppConfig& config, const std::vector<VerseData>& verses, double totalSeconds) {
+    const double fps = config.fps > 0 ? config.fps : 30.0;
+    auto snap = [fps](double t) { return std::round(t * fps) / fps; };
+
+    std::vector<Clip> clips;
+    auto startClip = [&](const std::string& verseKey, const std::string& file, double start) {
+        if (!clips.empty() && start <= clips.back().startSeconds) {
+            // The clip before holds no frame; this verse takes its place
+            clips.back().verseKey = verseKey;
+            clips.back().file = file;
+            return;
+        }
+        if (!clips.empty()) clips.back().endSeconds = start;
+        clips.push_back({verseKey, file, start, start});
+    };
+
+    std::vector<double> starts = SubtitleBuilder::verseStartTimes(verses, config.introDuration, config.pauseAfterIntroDuration);
+    if (verses.empty() || snap(starts.front()) > 0.0) startClip("", "intro.mp4", 0.0);
+    for (size_t i = 0; i < verses.size(); ++i) {
+        startClip(verses[i].verseKey, clipFileName(verses[i].verseKey), snap(starts[i]));
+    }
+    if (!clips.empty()) clips.back().endSeconds = std::max(clips.back().startSeconds, snap(totalSeconds));
+    return clips;
+}
+
+std::vector<double> cutTimes(const std::vector<Clip>& clips) {
+    std::vector<double> times;
+    for (size_t i = 1; i < clips.size(); ++i) times.push_back(clips[i].startSeconds);
+    return times;
+}
+
+std::string chapterMetadata(const std::vector<Clip>& clips) {
+    std::ostringstream doc;
+    doc << ";FFMETADATA1\n";
+    for (const Clip& clip : clips) {
+        doc << "\n[CHAPTER]\nTIMEBASE=1/1000\n"
+            << "START=" << std::llround(clip.startSeconds * 1000.0) << "\n"
+            << "END=" << std::llround(clip.endSeconds * 1000.0) << "\n"
+            << "title=" << metadataValue(clip.verseKey.empty() ? "Intro" : clip.verseKey) << "\n";
+    }
+    return doc.str();
+}
+
+std::string teeTarget(const fs::path& video, const fs::path& directory, const std::vector<Clip>& clips) {
+    std::ostringstream times;
+    for (double t : cutTimes(clips)) times << (times.tellp() > 0 ? "," : "") << formatSeconds(t);
+    std::string pattern = Render::toFfmpegTeePath(directory / ".segment-%03d.mp4");
+
+    std::ostringstream target;
+    target << "[f=mp4:movflags=+faststart]" << Render::toFfmpegTeePath(video) << "|"
+           << "[f=segment:segment_format=mp4:reset_timestamps=1:segment_format_options=movflags=+faststart";
+    if (times.tellp() > 0) target << ":segment_times=" << times.str();
+    target << "]" << pattern;
+    return target.str();
+}
+
+void finalize(const fs::path& directory, const CLIOptions& options, const std::vector<Clip>& clips) {
+    json manifest;
+    manifest["surah"] = options.surah;
+    manifest["from"] = options.from;
+    manifest["to"] = options.to;
+    manifest["video"] = fs::path(options.output).filename().string();
+    manifest["clips"] = json::array();
+    for (size_t i = 0; i < clips.size(); ++i) {
+        const Clip& clip = clips[i];
+        fs::path segment = segmentPath(directory, i);
+        std::error_code ec;
+        if (!fs::is_regular_file(segment, ec)) {
+            throw std::runtime_error("Verse clip segment missing: " + segment.string());
+        }
+        fs::rename(segment, directory / clip.file);
+        manifest["clips"].push_back({
+            {"kind", clip.verseKey.empty() ? "intro" : "verse"},
+            {"verse", clip.verseKey.empty() ? json(nullptr) : json(clip.verseKey)},
+            {"file", clip.file},
+            {"start", clip.startSeconds},
+            {"end", clip.endSeconds},
+            {"duration", clip.endSeconds - clip.startSeconds},
+        });
+    }
+    // A segment past the plan means a cut fell between keyframes; it is not a verse
+    for (size_t i = clips.size(); ; ++i) {
+        std::error_code ec;
+        fs::path extra = segmentPath(directory, i);
+        if (!fs::exists(extra, ec)) break;
+        std::cerr << "  ! Unexpected verse clip segment removed: " << extra.string() << std::endl;
+        fs::remove(extra, ec);
+    }
+
+    fs::path manifestPath = directory / "manifest.json";
+    std::ofstream out(manifestPath);
+    if (!out.is_open()) throw std::runtime_error("Failed to write " + manifestPath.string());
+    out << manifest.dump(2) << "\n";
+}
+
+} // namespace VerseClips
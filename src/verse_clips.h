@@ -0,0 +1,47 @@
+#pragma once
+
+#include "types.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// One clip per verse cut from the render's own encode (--verse-clips DIR).
+// Keyframes are forced at every verse start of the subtitle timeline and a
+// tee muxer feeds the segment muxer alongside the full video, so the clips
+// cost no extra encode. The numbered segments are then renamed S_V.mp4
+// (intro.mp4 for the intro card) and listed in DIR/manifest.json.
+//
+// The same cuts give every render its verse structure: a keyframe and an
+// MP4 chapter, titled by verse key, at each verse start.
+namespace VerseClips {
+
+struct Clip {
+    std::string verseKey;       // empty for the intro card
+    std::string file;           // name inside the clip directory
+    double startSeconds = 0.0;  // on the full video's timeline, on the frame grid
+    double endSeconds = 0.0;
+};
+
+// The clips of a render in playback order, cut on the frame grid. Verses
+// shorter than a frame get no clip of their own.
+std::vector<Clip> planClips(const AppConfig& config, const std::vector<VerseData>& verses, double totalSeconds);
+
+// Start of every clip after the first: the keyframes to force and the cuts.
+std::vector<double> cutTimes(const std::vector<Clip>& clips);
+
+// FFMETADATA document with one chapter per clip, titled by verse key
+// ("Intro" for the intro card), in milliseconds.
+std::string chapterMetadata(const std::vector<Clip>& clips);
+
+// Tee muxer target writing `video` and the numbered segments of `directory`
+// in one pass.
+std::string teeTarget(const std::filesystem::path& video,
+                      const std::filesystem::path& directory,
+                      const std::vector<Clip>& clips);
+
+// Renames the segments to their clip names and writes manifest.json.
+// Throws std::runtime_error when a segment is missing.
+void finalize(const std::filesystem::path& directory, const CLIOptions& options, const std::vector<Clip>& clips);
+
+} // namespace VerseClips
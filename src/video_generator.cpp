@@ -4,6 +4,15 @@
 #include "quran_data.h"
 #include "audio/custom_audio_processor.h"
 #include "interfaces/IProcessExecutor.h"
+#include "render/render_plan.h"
+#include "render/chunk_planner.h"
+#include "clip_library.h"
+#include "background_plate.h"
+#include "subtitle_sprites.h"
+#include "verse_clips.h"
+#include "progress.h"
+#include "parallel_for.h"
+#include "resource_governor.h"
 #include <chrono>
 #include <cstdio>
 #include <iostream>
@@ -17,8 +26,12 @@
 #include <limits>
 #include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <optional>
+#include <thread>
 #include "subtitle_builder.h"
 #include "localization_utils.h"
+#include "cache_utils.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -27,64 +40,614 @@ extern "C" {
 namespace fs = std::filesystem;
 
 namespace {
-    void emitProgressEvent(const std::string& stage,
-                       const std::string& status,
-                       double percent = -1.0,
-                       double elapsedSeconds = -1.0,
-                       double etaSeconds = -1.0,
-                       const std::string& message = "") {
-    std::ostringstream oss;
-    oss.setf(std::ios::fixed);
-    oss << std::setprecision(2);
-    oss << "PROGRESS {\"stage\":\"" << stage << "\",\"status\":\"" << status << "\"";
-    if (percent >= 0.0) oss << ",\"percent\":" << percent;
-    if (elapsedSeconds >= 0.0) oss << ",\"elapsedSeconds\":" << elapsedSeconds;
-    if (etaSeconds >= 0.0) oss << ",\"etaSeconds\":" << etaSeconds;
-    if (!message.empty()) oss << ",\"message\":\"" << message << "\"";
-    oss << "}";
-    std::cout << oss.str() << std::endl;
-}
-
-void emitStageMessage(const std::string& stage,
+void emitStageMessage(const CLIOptions& options,
+                      const std::string& stage,
                       const std::string& status,
                       const std::string& message) {
-    emitProgressEvent(stage, status, -1.0, -1.0, -1.0, message);
+    Progress::emit(options.progressSink, stage, status, -1.0, -1.0, -1.0, message);
+}
+
+// Cores this render may use: its governor budget, or the whole machine when
+// the caller did not go through RenderJob
+int renderCpus(const CLIOptions& options) {
+    if (options.resources.cpus > 0) return options.resources.cpus;
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+Render::EncoderSettings makeEncoderSettings(const CLIOptions& options, const AppConfig& config) {
+    Render::EncoderSettings encoder;
+    encoder.pixelFormat = config.pixelFormat;
+    encoder.threads = options.resources.encoderThreads;
+    if (options.encoder == "hardware") {
+        #if defined(__APPLE__)
+            encoder.videoCodec = "h264_videotoolbox";
+            encoder.videoBitrate = !config.videoBitrate.empty() ? config.videoBitrate : "3500k";
+            encoder.videoMaxRate = config.videoMaxRate;
+            encoder.videoBufSize = config.videoBufSize;
+            encoder.allowSoftwareFallback = true;
+            std::cout << "Using hardware encoder: h264_videotoolbox" << std::endl;
+            return encoder;
+        #endif
+    }
+    encoder.preset = options.preset;
+    encoder.crf = config.crf;
+    encoder.videoBitrate = config.videoBitrate;
+    encoder.videoMaxRate = config.videoMaxRate;
+    encoder.videoBufSize = config.videoBufSize;
+    if (options.encoder != "hardware") {
+        std::cout << "Using software encoder: libx264 ('" << options.preset << "')" << std::endl;
+    }
+    return encoder;
+}
+
+// Drops frames identical to the last one kept (no 8x8 block differs; mpdecimate
+// does not look at the 8 leftmost columns), keeping at least one frame a second
+// so the video never trails the audio by more than that.
+std::string decimateFilter(double fps) {
+    int maxDropped = std::max(1, static_cast<int>(std::lround(fps)) - 1);
+    return ",mpdecimate=hi=0:lo=0:frac=0:max=" + std::to_string(maxDropped);
+}
+
+// Removes a scratch directory when the render leaves its scope, whether it
+// finished or threw.
+struct ScratchDir {
+    fs::path path;
+    explicit ScratchDir(fs::path dir) : path(std::move(dir)) { fs::create_directories(path); }
+    ScratchDir(const ScratchDir&) = delete;
+    ScratchDir& operator=(const ScratchDir&) = delete;
+    ~ScratchDir() {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+};
+
+// A concat list entry. Variable-rate files may end before their last frame
+// slot, so their duration is written out to keep the files that follow in place.
+void writeConcatEntry(std::ofstream& list, const fs::path& path, bool variableFrameRate, double durationSeconds) {
+    list << "file '" << Render::toFfmpegPath(fs::absolute(path)) << "'\n";
+    if (variableFrameRate) {
+        char duration[32];
+        std::snprintf(duration, sizeof(duration), "%.6f", durationSeconds);
+        list << "duration " << duration << "\n";
+    }
+}
+
+// The render's config at an extra output's size and frame rate; its text is
+// laid out again at that size.
+AppConfig profileConfig(const AppConfig& config, const OutputProfile& profile) {
+    AppConfig profiled = config;
+    profiled.width = profile.width;
+    profiled.height = profile.height;
+    if (profile.fps > 0) profiled.fps = profile.fps;
+    return profiled;
+}
+
+// An --extra-output branch of a single-pass render and its subtitles.
+struct ExtraOutput {
+    const OutputProfile* profile = nullptr;
+    AppConfig config;
+    fs::path assFile;
+    std::string subtitleChain;  // ",ass=..." or empty with sprites
+    std::shared_ptr<const Render::SpriteTrack> sprites;
+};
+
+// Codec carrying timed text in a container, empty when it has none
+std::string textTrackCodec(const fs::path& video) {
+    std::string extension = video.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    if (extension == ".mp4" || extension == ".m4v" || extension == ".mov") return "mov_text";
+    if (extension == ".mkv" || extension == ".webm") return "webvtt";
+    return "";
+}
+
+// Adds the --soft-translations sidecars to a finished video as subtitle
+// streams, copying its audio and video. The libav engine maps only audio and
+// video, so this always runs through the ffmpeg CLI (see requireTextTrackMuxer).
+void muxTextTracks(const fs::path& video, const CLIOptions& options, Interfaces::IProcessExecutor& executor) {
+    std::string codec = textTrackCodec(video);
+    if (codec.empty()) {
+        std::cout << video.extension().string() << " files hold no text tracks; translations are left as sidecars" << std::endl;
+        return;
+    }
+
+    Render::RenderPlan plan;
+    Render::InputSpec source;
+    source.path = video.string();
+    plan.inputs.push_back(source);
+
+    Render::OutputSpec output;
+    fs::path muxed = video;
+    muxed.replace_extension(".tracks" + video.extension().string());
+    output.path = muxed.string();
+    output.maps = {"0:v", "0:a"};
+    for (size_t i = 0; i < options.softTranslations.size(); ++i) {
+        int id = options.softTranslations[i];
+        Render::InputSpec track;
+        track.path = SubtitleBuilder::textTrackPath(options.output, id).string();
+        plan.inputs.push_back(track);
+        output.maps.push_back(std::to_string(i + 1) + ":s");
+        output.subtitleLanguages.push_back(QuranData::getTranslationTrackLanguage(id));
+    }
+    output.encoder.videoCodec = "copy";
+    output.encoder.audioCodec = "copy";
+    output.encoder.subtitleCodec = codec;
+    output.fastStart = codec == "mov_text";  // a mov muxer option
+    plan.outputs.push_back(output);
+
+    Render::runCommandLine(executor, plan, 0.0);
+    std::error_code ec;
+    fs::rename(muxed, video, ec);
+    if (ec) throw std::runtime_error("Failed to add text tracks to " + video.string() + ": " + ec.message());
+}
+
+// Soft translations are muxed by the ffmpeg CLI even with the libav backend;
+// without one on PATH the render would only fail after the whole encode.
+void requireTextTrackMuxer(const CLIOptions& options) {
+    if (options.softTranslations.empty() || options.renderBackend != "libav") return;
+    bool muxes = !textTrackCodec(options.output).empty();
+    for (const auto& profile : options.extraOutputs) muxes = muxes || !textTrackCodec(profile.path).empty();
+    if (muxes && Render::findFfmpeg().empty()) {
+        throw std::runtime_error("--soft-translations adds its text tracks with the ffmpeg CLI, which is not on PATH; "
+                                 "install ffmpeg or render to a container without text tracks");
+    }
+}
+
+struct AudioTiming {
+    double leadIn;          // intro + pause before the first verse
+    double versesDuration;
+    double minTimestampSec;
+    double maxTimestampSec;
+};
+
+// Recitation track of a render plan: the inputs are appended to the plan,
+// `filter` is the graph fragment (empty when the input is mapped directly).
+struct AudioTrack {
+    std::string filter;
+    std::string map;
+    double totalDuration = 0.0;
+    fs::path concatList;  // scratch file to remove once the render is done
+};
+
+AudioTrack appendAudioInputs(Render::RenderPlan& plan,
+                             const AppConfig& config,
+                             const std::vector<VerseData>& verses,
+                             const AudioTiming& timing) {
+    AudioTrack track;
+    int audioInputIndex = static_cast<int>(plan.inputs.size());
+
+    // Handle audio differently for gapped vs gapless
+    if (config.recitationMode == RecitationMode::GAPLESS) {
+        // For gapless: use single surah audio file with precise trimming
+        if (verses.empty()) throw std::runtime_error("No verses to render");
+
+        std::string audioPath;
+        for (const auto& verse : verses) {
+            if (verse.localAudioPath.empty()) continue;
+            audioPath = verse.localAudioPath;
+            if (verse.fromCustomAudio) break;
+        }
+        if (audioPath.empty()) throw std::runtime_error("No audio path found for gapless render");
+        bool customClip = verses[0].fromCustomAudio;
+        double startTime = customClip ? 0.0 : timing.minTimestampSec;
+        double endTime = customClip ? timing.versesDuration : timing.maxTimestampSec;
+        double trimmedDuration = std::max(0.0, endTime - startTime);
+        double measuredAudioDuration = customClip
+            ? Audio::CustomAudioProcessor::probeDuration(audioPath)
+            : trimmedDuration;
+        double audioDuration = customClip
+            ? std::max(measuredAudioDuration, timing.versesDuration)
+            : measuredAudioDuration;
+        track.totalDuration = timing.leadIn + audioDuration;
+
+        Render::InputSpec silence;
+        silence.format = "lavfi";
+        silence.durationSeconds = timing.leadIn;
+        silence.path = "anullsrc=r=44100:cl=stereo";
+        plan.inputs.push_back(silence);
+
+        Render::InputSpec recitation;
+        recitation.path = audioPath;
+        if (!customClip) {
+            recitation.seekSeconds = startTime;
+            recitation.durationSeconds = trimmedDuration;
+        }
+        plan.inputs.push_back(recitation);
+
+        std::ostringstream filter;
+        filter << "[" << audioInputIndex << ":a][" << (audioInputIndex + 1) << ":a]concat=n=2:v=0:a=1[a]";
+        track.filter = filter.str();
+        track.map = "[a]";
+    } else {
+        // For gapped: concatenate individual ayah audio files
+        std::string concat_file_path = CacheUtils::uniqueTempPath("qvm_audiolist_", ".txt").string();
+        {
+            std::ofstream concat_file(concat_file_path);
+            if (!concat_file.is_open()) throw std::runtime_error("Failed to create audio list file.");
+            for (const auto& verse : verses) {
+                concat_file << "file '" << Render::toFfmpegPath(fs::absolute(verse.localAudioPath)) << "'\n";
+            }
+        }
+
+        track.totalDuration = timing.leadIn;
+        for (const auto& verse : verses) track.totalDuration += verse.durationInSeconds;
+
+        Render::InputSpec recitation;
+        track.concatList = concat_file_path;
+        recitation.path = concat_file_path;
+        recitation.format = "concat";
+        recitation.formatOptions["safe"] = "0";
+        recitation.offsetSeconds = timing.leadIn;
+        plan.inputs.push_back(recitation);
+        track.map = std::to_string(audioInputIndex) + ":a";
+    }
+    return track;
+}
+
+// Recitation laid on a timeline the video was already encoded on: the planned
+// one of a pipelined render, or the frame grid of the clip library. Each
+// verse's audio is pinned to its planned slot, cut at its end and padded when
+// short, so durations that are off by a few milliseconds per verse cannot add
+// up along the range. `starts` gives where each verse begins in its file when
+// verses share one (gapless), empty when every file starts with its verse.
+AudioTrack appendPinnedAudio(Render::RenderPlan& plan,
+                             const std::vector<VerseData>& planned,
+                             const std::vector<VerseData>& fetched,
+                             double leadIn,
+                             const std::vector<double>& starts = {}) {
+    AudioTrack track;
+    int audioInputIndex = static_cast<int>(plan.inputs.size());
+    track.concatList = CacheUtils::uniqueTempPath("qvm_audiolist_", ".txt");
+    {
+        std::ofstream concat_file(track.concatList);
+        if (!concat_file.is_open()) throw std::runtime_error("Failed to create audio list file.");
+        for (size_t i = 0; i < fetched.size(); ++i) {
+            double start = starts.empty() ? 0.0 : starts[i];
+            char inpoint[32], outpoint[32], slot[32];
+            std::snprintf(inpoint, sizeof(inpoint), "%.6f", start);
+            std::snprintf(outpoint, sizeof(outpoint), "%.6f", start + planned[i].durationInSeconds);
+            std::snprintf(slot, sizeof(slot), "%.6f", planned[i].durationInSeconds);
+            concat_file << "file '" << Render::toFfmpegPath(fs::absolute(fetched[i].localAudioPath)) << "'\n";
+            if (start > 0.0) concat_file << "inpoint " << inpoint << "\n";
+            concat_file << "outpoint " << outpoint << "\n"
+                        << "duration " << slot << "\n";
+        }
+    }
+
+    track.totalDuration = leadIn;
+    for (const auto& verse : planned) track.totalDuration += verse.durationInSeconds;
+
+    Render::InputSpec recitation;
+    recitation.path = track.concatList.string();
+    recitation.format = "concat";
+    recitation.formatOptions["safe"] = "0";
+    recitation.offsetSeconds = leadIn;
+    plan.inputs.push_back(recitation);
+    track.filter = "[" + std::to_string(audioInputIndex) + ":a]aresample=async=1:min_hard_comp=0.01[a]";
+    track.map = "[a]";
+    return track;
 }
+
+// Where each verse starts in its recitation file, for pinning a gapless
+// recitation; empty for gapped files, which start with their verse.
+std::vector<double> recitationStarts(const AppConfig& config, const std::vector<VerseData>& verses) {
+    std::vector<double> starts;
+    if (config.recitationMode != RecitationMode::GAPLESS) return starts;
+    // A custom clip holds the range back to back; a surah file keeps its timestamps
+    double offset = 0.0;
+    for (const auto& verse : verses) {
+        starts.push_back(verse.fromCustomAudio ? offset : verse.timestampFromMs / 1000.0);
+        offset += verse.durationInSeconds;
+    }
+    return starts;
 }
 
-// Normalize paths for ffmpeg arguments.
-static std::string to_ffmpeg_path(const fs::path& p) {
-    return p.generic_string(); // forward slashes are accepted on all platforms
+// Whether fetched verses fit the timeline the video was encoded on: the same
+// verses, each within a frame of its planned duration.
+bool matchesPlannedTimeline(const std::vector<VerseData>& planned, const std::vector<VerseData>& fetched, double fps) {
+    if (planned.size() != fetched.size()) return false;
+    for (size_t i = 0; i < planned.size(); ++i) {
+        if (planned[i].verseKey != fetched[i].verseKey) return false;
+        if (std::abs(planned[i].durationInSeconds - fetched[i].durationInSeconds) > 1.0 / fps) return false;
+    }
+    return true;
 }
 
-// Escape characters that are significant to FFmpeg filter arguments (e.g., colons inside paths).
-static std::string to_ffmpeg_filter_path(const fs::path& p) {
-    std::string s = to_ffmpeg_path(p);
-#ifdef _WIN32
-    std::string out;
-    out.reserve(s.size() * 2);
-    for (char ch : s) {
-        if (ch == ':') {
-            out.append("\\:");
-        } else if (ch == '\'') {
-            out.append("\\'");
+// The looped video behind a static-background render: the configured source,
+// or its plate, which is already at the output size and frame rate and dimmed.
+struct StaticBackground {
+    std::string path;
+    double loopSeconds = 0.0;
+    bool plate = false;
+};
+
+StaticBackground staticBackground(const CLIOptions& options,
+                                  const AppConfig& config,
+                                  Interfaces::IProcessExecutor& processExecutor) {
+    StaticBackground background;
+    background.path = config.assetBgVideo;
+    if (options.backgroundPlate && options.noCache) {
+        std::cout << "Background plate needs the cache; scaling the source video" << std::endl;
+    } else if (options.backgroundPlate && !options.extraOutputs.empty()) {
+        std::cout << "Background plate holds one output format; scaling the source video for every output" << std::endl;
+    } else if (options.backgroundPlate) {
+        try {
+            if (options.emitProgress) emitStageMessage(options, "background", "running", "Preparing background plate");
+            background.path = BackgroundPlate::ensurePlate(options, config, processExecutor).string();
+            background.plate = true;
+            if (options.emitProgress) emitStageMessage(options, "background", "completed", "Background plate ready");
+        } catch (const Render::Cancelled&) {
+            throw;
+        } catch (const std::exception& e) {
+            std::cerr << "  ! Background plate unavailable, scaling the source video: " << e.what() << std::endl;
+        }
+    }
+    background.loopSeconds = Audio::CustomAudioProcessor::probeDuration(background.path);
+    return background;
+}
+
+// Write the verse chapters to `file` and append them to the plan as an
+// ffmetadata input, returning its index for OutputSpec::chaptersInput.
+int appendChapterInput(Render::RenderPlan& plan, const std::vector<VerseClips::Clip>& cuts, const fs::path& file) {
+    std::ofstream out(file);
+    if (!out.is_open()) throw std::runtime_error("Failed to create chapter file.");
+    out << VerseClips::chapterMetadata(cuts);
+    out.close();
+
+    Render::InputSpec input;
+    input.path = file.string();
+    input.format = "ffmetadata";
+    plan.inputs.push_back(input);
+    return static_cast<int>(plan.inputs.size()) - 1;
+}
+
+// Encode the video track as independent closed-GOP chunks cut at verse
+// boundaries, in parallel, and write the concat list joining them.
+// `keyframeTimes` (render seconds) are forced inside each chunk.
+void encodeChunks(const CLIOptions& options,
+                  const AppConfig& config,
+                  const std::vector<VerseData>& verses,
+                  double leadIn,
+                  double totalDuration,
+                  const BackgroundVideo::Manager& bgManager,
+                  bool dynamicBackground,
+                  const StaticBackground& background,
+                  const std::string& overlayChain,
+                  const std::string& assChain,
+                  const std::string& decimateChain,
+                  const std::shared_ptr<const Render::SpriteTrack>& sprites,
+                  const Render::EncoderSettings& encoder,
+                  const std::vector<double>& keyframeTimes,
+                  const fs::path& chunkDir,
+                  Interfaces::IProcessExecutor& processExecutor) {
+    double fps = config.fps > 0 ? config.fps : 30.0;
+    std::vector<double> boundaries = SubtitleBuilder::verseStartTimes(verses, leadIn, 0.0);
+    auto chunks = Render::planChunks(boundaries, totalDuration, options.parallelChunks, 1.0 / fps);
+    // Chunks beyond what the render's memory holds wait for a running one to finish
+    size_t workers = std::min(chunks.size(), static_cast<size_t>(
+        Resources::parallelEncodes(options.resources, config.width, config.height)));
+    std::cout << "Encoding " << chunks.size() << " verse-aligned chunks, " << workers << " at a time" << std::endl;
+
+    int threadsPerChunk = std::max(1, renderCpus(options) / static_cast<int>(workers));
+
+    std::vector<Render::RenderPlan> plans;
+    std::vector<std::string> chunkPaths;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const auto& chunk = chunks[i];
+        Render::RenderPlan plan;
+        plan.filterThreads = std::max(1, threadsPerChunk / 2);
+        std::ostringstream filter;
+        filter << std::fixed << std::setprecision(6);
+
+        std::vector<std::string> inputFiles;
+        std::string windowFilter = dynamicBackground
+            ? bgManager.buildWindowFilterComplex(chunk.startSeconds, chunk.endSeconds, inputFiles)
+            : "";
+        if (!windowFilter.empty()) {
+            for (const auto& file : inputFiles) {
+                Render::InputSpec input;
+                input.path = file;
+                plan.inputs.push_back(input);
+            }
+            filter << windowFilter << overlayChain;
         } else {
-            out.push_back(ch);
+            // Start the looped background where the single-pass render would be at this point
+            Render::InputSpec input;
+            input.path = background.path;
+            input.loop = true;
+            if (background.loopSeconds > 0.0) input.seekSeconds = std::fmod(chunk.startSeconds, background.loopSeconds);
+            plan.inputs.push_back(input);
+            filter << "[0:v]setpts=PTS-STARTPTS+" << chunk.startSeconds << "/TB";
+            if (!background.plate) {
+                filter << ",fps=" << fps << ",scale=" << config.width << ":" << config.height << overlayChain;
+            }
         }
+        // Subtitles are drawn on absolute timestamps, then the chunk is rebased to zero
+        filter << assChain << decimateChain << ",setpts=PTS-STARTPTS[v]";
+        plan.filterComplex = filter.str();
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "chunk_%03zu.mp4", i);
+        Render::OutputSpec output;
+        output.path = (chunkDir / name).string();
+        output.maps = {"[v]"};
+        output.durationSeconds = chunk.endSeconds - chunk.startSeconds;
+        output.encoder = encoder;
+        output.encoder.audioCodec.clear();
+        output.encoder.closedGop = true;
+        output.encoder.threads = threadsPerChunk;
+        // Rebased like the chunk; its first frame is a keyframe already
+        for (double t : keyframeTimes) {
+            if (t > chunk.startSeconds + 0.5 / fps && t < chunk.endSeconds) {
+                output.encoder.keyframeTimes.push_back(t - chunk.startSeconds);
+            }
+        }
+        output.fastStart = false;
+        output.subtitleSprites = sprites;
+        output.subtitleSpritesOffset = chunk.startSeconds;
+        plan.outputs.push_back(output);
+
+        chunkPaths.push_back(output.path);
+        plans.push_back(plan);
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    if (options.emitProgress) Progress::emit(options.progressSink, "encoding", "running", 0.0, 0.0, -1.0, "Encoding chunks");
+    try {
+        Parallel::forEach(plans.size(), workers,
+            [&](size_t i) { processExecutor.render(plans[i], chunks[i].endSeconds - chunks[i].startSeconds); },
+            [&](size_t finished) {
+                if (!options.emitProgress) return;
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+                double percent = 100.0 * static_cast<double>(finished) / static_cast<double>(plans.size());
+                Progress::emit(options.progressSink, "encoding", "running", percent, elapsed, -1.0,
+                               "Encoded chunk " + std::to_string(finished) + "/" + std::to_string(plans.size()));
+            });
+    } catch (...) {
+        if (options.emitProgress) Progress::emit(options.progressSink, "encoding", "failed", -1.0, -1.0, -1.0, "Chunk encoding failed");
+        throw;
+    }
+
+    std::ofstream list(chunkDir / "chunks.txt");
+    if (!list.is_open()) throw std::runtime_error("Failed to create chunk list file.");
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        writeConcatEntry(list, chunkPaths[i], encoder.variableFrameRate, chunks[i].endSeconds - chunks[i].startSeconds);
     }
-    return out;
-#else
-    return s;
-#endif
 }
 
-void VideoGenerator::generateVideo(const CLIOptions& options, 
+// Encode the intro and verse clips missing from the clip library, then write
+// the concat list joining every clip of the range.
+void assembleClips(const CLIOptions& options,
+                   const AppConfig& config,
+                   const std::vector<VerseData>& verses,
+                   const std::vector<ClipLibrary::Clip>& clips,
+                   const StaticBackground& background,
+                   const std::string& overlayChain,
+                   const std::string& fontsPath,
+                   bool subtitleSprites,
+                   const Render::EncoderSettings& encoder,
+                   const VerseSegmentation::Manager* segmentManager,
+                   const fs::path& chunkDir,
+                   Interfaces::IProcessExecutor& processExecutor) {
+    double fps = config.fps > 0 ? config.fps : 30.0;
+    std::vector<const ClipLibrary::Clip*> missing;
+    for (const auto& clip : clips) {
+        if (!ClipLibrary::isStored(clip)) missing.push_back(&clip);
+    }
+    std::cout << "Clip library: " << (clips.size() - missing.size()) << "/" << clips.size()
+              << " clips cached, encoding " << missing.size() << std::endl;
+
+    if (!missing.empty()) {
+        size_t workers = std::min({missing.size(),
+                                   static_cast<size_t>(options.parallelChunks > 1 ? options.parallelChunks : 4),
+                                   static_cast<size_t>(Resources::parallelEncodes(options.resources, config.width, config.height))});
+        int threadsPerClip = std::max(1, renderCpus(options) / static_cast<int>(workers));
+        auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+
+        auto encodeClip = [&](size_t index) {
+            const auto& clip = *missing[index];
+            fs::path assPath = chunkDir / ("clip_" + std::to_string(index) + ".ass");
+            std::shared_ptr<const Render::SpriteTrack> sprites;
+            if (subtitleSprites) {
+                auto cues = clip.verseIndex < 0
+                    ? SubtitleBuilder::buildCues(config, options, {}, config.introDuration,
+                                                 config.pauseAfterIntroDuration, nullptr)
+                    : SubtitleBuilder::buildCues(config, options, {verses[clip.verseIndex]}, 0.0, 0.0, segmentManager);
+                sprites = SubtitleSprites::prepareTrack(config, cues, 1);
+            } else if (clip.verseIndex < 0) {
+                SubtitleBuilder::buildAssFile(config, options, {}, config.introDuration,
+                                              config.pauseAfterIntroDuration, nullptr, assPath);
+            } else {
+                SubtitleBuilder::buildAssFile(config, options, {verses[clip.verseIndex]}, 0.0, 0.0,
+                                              segmentManager, assPath);
+            }
+
+            Render::RenderPlan plan;
+            plan.filterThreads = std::max(1, threadsPerClip / 2);
+            Render::InputSpec input;
+            input.path = background.path;
+            input.loop = true;
+            input.seekSeconds = clip.backgroundSeekSeconds;
+            plan.inputs.push_back(input);
+            std::ostringstream filter;
+            filter << "[0:v]setpts=PTS-STARTPTS";
+            if (!background.plate) {
+                filter << ",fps=" << fps << ",scale=" << config.width << ":" << config.height << overlayChain;
+            }
+            if (!sprites) filter << ",ass='" << Render::toFfmpegFilterPath(assPath) << "':fontsdir='" << fontsPath << "'";
+            if (!sprites && encoder.variableFrameRate) filter << decimateFilter(fps);
+            filter << "[v]";
+            plan.filterComplex = filter.str();
+
+            // Encode next to the final name and rename, so the library never holds a partial clip
+            fs::create_directories(clip.path.parent_path());
+            fs::path partial = clip.path.parent_path() / (clip.key + ".partial-" + std::to_string(stamp) + ".mp4");
+            double duration = static_cast<double>(clip.frameCount) / fps;
+            Render::OutputSpec output;
+            output.path = partial.string();
+            output.maps = {"[v]"};
+            output.durationSeconds = duration;
+            output.encoder = encoder;
+            output.encoder.audioCodec.clear();
+            output.encoder.closedGop = true;
+            output.encoder.threads = threadsPerClip;
+            output.fastStart = false;
+            output.subtitleSprites = sprites;
+            plan.outputs.push_back(output);
+
+            try {
+                processExecutor.render(plan, duration);
+                fs::rename(partial, clip.path);
+            } catch (...) {
+                std::error_code ec;
+                fs::remove(partial, ec);
+                throw;
+            }
+        };
+
+        auto startTime = std::chrono::steady_clock::now();
+        if (options.emitProgress) Progress::emit(options.progressSink, "encoding", "running", 0.0, 0.0, -1.0, "Encoding clips");
+        try {
+            Parallel::forEach(missing.size(), workers, encodeClip, [&](size_t finished) {
+                if (!options.emitProgress) return;
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+                double percent = 100.0 * static_cast<double>(finished) / static_cast<double>(missing.size());
+                Progress::emit(options.progressSink, "encoding", "running", percent, elapsed, -1.0,
+                               "Encoded clip " + std::to_string(finished) + "/" + std::to_string(missing.size()));
+            });
+        } catch (...) {
+            if (options.emitProgress) Progress::emit(options.progressSink, "encoding", "failed", -1.0, -1.0, -1.0, "Clip encoding failed");
+            throw;
+        }
+    }
+
+    std::ofstream list(chunkDir / "chunks.txt");
+    if (!list.is_open()) throw std::runtime_error("Failed to create chunk list file.");
+    for (const auto& clip : clips) {
+        writeConcatEntry(list, clip.path, encoder.variableFrameRate, static_cast<double>(clip.frameCount) / fps);
+    }
+}
+}
+
+bool VideoGenerator::supportsPendingAudio(const CLIOptions& options, const AppConfig& config) {
+    // Extra outputs and verse clips take their audio in the one pass that encodes them
+    return config.recitationMode == RecitationMode::GAPPED && options.customAudioPath.empty() &&
+           options.extraOutputs.empty() && options.verseClipsDir.empty();
+}
+
+bool VideoGenerator::generateVideo(const CLIOptions& options, 
                                    const AppConfig& config, 
                                    const std::vector<VerseData>& verses, 
                                    std::shared_ptr<Interfaces::IProcessExecutor> processExecutor,
-                                   const VerseSegmentation::Manager* segmentManager) {
+                                   const VerseSegmentation::Manager* segmentManager,
+                                   PendingVerses pendingAudio) {
     try {
         std::cout << "\n=== Starting Video Rendering ===" << std::endl;
+        const bool pipelined = pendingAudio.valid();
+        if (pipelined && !supportsPendingAudio(options, config)) {
+            throw std::invalid_argument("Pipelined fetching needs a gapped recitation rendered to a single output");
+        }
+        requireTextTrackMuxer(options);
         
         double intro_duration = config.introDuration;
         double pause_after_intro_duration = config.pauseAfterIntroDuration;
@@ -110,202 +673,343 @@ void VideoGenerator::generateVideo(const CLIOptions& options,
         
         if (config.videoSelection.enableDynamicBackgrounds) {
             if (options.emitProgress) {
-                emitStageMessage("background", "running", "Selecting background videos");
+                emitStageMessage(options, "background", "running", "Selecting background videos");
             }
             bgFilterComplex = bgManager.buildFilterComplex(total_duration, bgInputFiles);
             if (options.emitProgress) {
-                emitStageMessage("background", "completed", 
+                emitStageMessage(options, "background", "completed", 
                             "Selected " + std::to_string(bgInputFiles.size()) + " background videos");
             }
         }
 
-        std::cout << "Generating subtitles..." << std::endl;
-        if (options.emitProgress) emitStageMessage("subtitles", "running", "Generating subtitles");
-        std::string ass_filename = SubtitleBuilder::buildAssFile(config, options, verses, intro_duration, pause_after_intro_duration, segmentManager);
-        std::string ass_ffmpeg_path = to_ffmpeg_filter_path(fs::path(ass_filename));
-        std::string fonts_ffmpeg_path = to_ffmpeg_filter_path(fs::absolute(config.assetFolderPath) / "fonts");
-        if (options.emitProgress) emitStageMessage("subtitles", "completed", "Subtitles generated");
+        // Extra outputs branch off the one background decode of a single-pass
+        // graph, and verse clips are cut from its encode
+        const bool has_extra_outputs = !options.extraOutputs.empty();
+        const bool single_pass = has_extra_outputs || !options.verseClipsDir.empty();
+        if (single_pass && (options.parallelChunks > 1 || options.clipLibrary)) {
+            std::cout << "Extra outputs and verse clips are rendered in a single pass; ignoring --parallel-chunks and --clip-library" << std::endl;
+        }
+        // A pipelined render encodes the video track alone, as one chunk at least
+        const bool use_chunks = (options.parallelChunks > 1 || pipelined) && !single_pass;
 
-        size_t at_pos = config.overlayColor.find('@');
-        bool apply_overlay = true;
-        if (at_pos != std::string::npos) {
-            try {
-                double alpha = std::stod(config.overlayColor.substr(at_pos + 1));
-                if (alpha <= 0.0) apply_overlay = false;
-            } catch(...) {}
+        // Clips are cut from the looped static background and shared through the cache
+        bool use_clip_library = options.clipLibrary && bgInputFiles.empty() && !options.noCache && !single_pass;
+        if (options.clipLibrary && !single_pass && !use_clip_library) {
+            std::cout << "Clip library needs a static background and the cache; rendering the range directly" << std::endl;
         }
 
-        std::ostringstream video_codec;
-        if (options.encoder == "hardware") {
-            #if defined(__APPLE__)
-                video_codec << "-c:v h264_videotoolbox ";
-                const std::string hardwareBitrate = !config.videoBitrate.empty() ? config.videoBitrate : "3500k";
-                video_codec << "-b:v " << hardwareBitrate << " ";
-                if (!config.videoMaxRate.empty()) video_codec << "-maxrate " << config.videoMaxRate << " ";
-                if (!config.videoBufSize.empty()) video_codec << "-bufsize " << config.videoBufSize << " ";
-                video_codec << "-allow_sw 1";
-                std::cout << "Using hardware encoder: h264_videotoolbox" << std::endl;
-            #else
-                video_codec << "-c:v libx264 -preset " << options.preset << " -crf " << config.crf << " ";
-                if (!config.videoBitrate.empty()) video_codec << "-b:v " << config.videoBitrate << " ";
-                if (!config.videoMaxRate.empty()) video_codec << "-maxrate " << config.videoMaxRate << " ";
-                if (!config.videoBufSize.empty()) video_codec << "-bufsize " << config.videoBufSize << " ";
-            #endif
-        } else {
-            video_codec << "-c:v libx264 -preset " << options.preset << " -crf " << config.crf << " ";
-            if (!config.videoBitrate.empty()) video_codec << "-b:v " << config.videoBitrate << " ";
-            if (!config.videoMaxRate.empty()) video_codec << "-maxrate " << config.videoMaxRate << " ";
-            if (!config.videoBufSize.empty()) video_codec << "-bufsize " << config.videoBufSize << " ";
-            std::cout << "Using software encoder: libx264 ('" << options.preset << "')" << std::endl;
+        // Sprites are blended by the in-process backend and kept in the cache
+        bool use_sprites = options.subtitleSprites && options.renderBackend == "libav" && !options.noCache;
+        if (options.subtitleSprites && !use_sprites) {
+            std::cout << "Subtitle sprites need the libav backend and the cache; drawing subtitles with libass" << std::endl;
         }
 
-        // Build ffmpeg command with all inputs
-        std::stringstream final_cmd;
-        final_cmd << "ffmpeg ";
-        if (options.emitProgress) {
-            final_cmd << "-progress pipe:1 -nostats -loglevel warning ";
+        // The clip library writes one subtitle file (or sprite track) per clip while encoding
+        std::string ass_ffmpeg_path;
+        fs::path ass_file_path;
+        std::shared_ptr<const Render::SpriteTrack> sprite_track;
+        std::string fonts_ffmpeg_path = Render::toFfmpegFilterPath(fs::absolute(config.assetFolderPath) / "fonts");
+        if (!use_clip_library) {
+            std::cout << "Generating subtitles..." << std::endl;
+            if (options.emitProgress) emitStageMessage(options, "subtitles", "running", "Generating subtitles");
+            if (use_sprites) {
+                auto cues = SubtitleBuilder::buildCues(config, options, verses, intro_duration, pause_after_intro_duration, segmentManager);
+                sprite_track = SubtitleSprites::prepareTrack(config, cues, renderCpus(options));
+            } else {
+                ass_file_path = SubtitleBuilder::buildAssFile(config, options, verses, intro_duration, pause_after_intro_duration, segmentManager,
+                                                              CacheUtils::uniqueTempPath("qvm_subtitles_", ".ass"));
+                ass_ffmpeg_path = Render::toFfmpegFilterPath(ass_file_path);
+            }
+            if (options.emitProgress) emitStageMessage(options, "subtitles", "completed", "Subtitles generated");
         }
-        final_cmd << "-y ";
-        
-        // Add background video inputs
-        if (!bgInputFiles.empty()) {
-            // Dynamic backgrounds - add all video files as inputs
-            for (const auto& bgFile : bgInputFiles) {
-                final_cmd << "-i \"" << to_ffmpeg_path(bgFile) << "\" ";
+
+        // Soft translations: a WebVTT sidecar per translation, on the timeline of the burned-in Arabic
+        for (int id : options.softTranslations) {
+            fs::path track_path = SubtitleBuilder::textTrackPath(options.output, id);
+            std::ofstream track(track_path, std::ios::binary);
+            if (!track.is_open()) throw std::runtime_error("Failed to create text track " + track_path.string());
+            track << SubtitleBuilder::webVttDocument(SubtitleBuilder::buildTranslationCues(
+                config, options, verses, intro_duration, pause_after_intro_duration, id, segmentManager));
+        }
+
+        // Each extra output lays its text out for its own size
+        std::vector<ExtraOutput> extra_outputs;
+        for (const auto& profile : options.extraOutputs) {
+            ExtraOutput extra;
+            extra.profile = &profile;
+            extra.config = profileConfig(config, profile);
+            if (use_sprites) {
+                auto cues = SubtitleBuilder::buildCues(extra.config, options, verses, intro_duration, pause_after_intro_duration, segmentManager);
+                extra.sprites = SubtitleSprites::prepareTrack(extra.config, cues, renderCpus(options));
+            } else {
+                extra.assFile = SubtitleBuilder::buildAssFile(extra.config, options, verses, intro_duration, pause_after_intro_duration,
+                                                              segmentManager, CacheUtils::uniqueTempPath("qvm_subtitles_", ".ass"));
+                extra.subtitleChain = ",ass='" + Render::toFfmpegFilterPath(extra.assFile) + "':fontsdir='" + fonts_ffmpeg_path + "'";
             }
-        } else {
-            // Static background with loop
-            final_cmd << "-stream_loop -1 -i \"" << to_ffmpeg_path(config.assetBgVideo) << "\" ";
+            extra_outputs.push_back(std::move(extra));
         }
-        
-        // Handle audio differently for gapped vs gapless
-        if (config.recitationMode == RecitationMode::GAPLESS) {
-            // For gapless: use single surah audio file with precise trimming
-            if (verses.empty()) throw std::runtime_error("No verses to render");
-            
-            std::string audioPath;
-            for (const auto& verse : verses) {
-                if (verse.localAudioPath.empty()) continue;
-                audioPath = verse.localAudioPath;
-                if (verse.fromCustomAudio) break;
+
+        Render::EncoderSettings encoder = makeEncoderSettings(options, config);
+
+        // Only a static background can hold still long enough for repeated frames to pay off
+        encoder.variableFrameRate = options.variableFrameRate && bgInputFiles.empty();
+        if (options.variableFrameRate && !encoder.variableFrameRate) {
+            std::cout << "Variable frame rate needs a static background; encoding at a constant frame rate" << std::endl;
+        }
+        // Sprites are drawn after the graph, so the engine drops repeated frames itself
+        std::string decimate_chain = encoder.variableFrameRate && !use_sprites
+            ? decimateFilter(config.fps > 0 ? config.fps : 30.0)
+            : "";
+
+        // Overlay and subtitles are burned in after the background chain; a
+        // background plate already carries the overlay
+        StaticBackground static_background;
+        if (bgInputFiles.empty()) static_background = staticBackground(options, config, *processExecutor);
+        std::string overlay_chain = BackgroundPlate::overlayFilter(config);
+        std::string ass_chain = use_sprites ? "" : ",ass='" + ass_ffmpeg_path + "':fontsdir='" + fonts_ffmpeg_path + "'";
+
+        const double lead_in = intro_duration + pause_after_intro_duration;
+        std::optional<std::vector<VerseData>> retimed_verses;
+        // Verse starts on the frame grid: keyframes, chapters and --verse-clips cuts
+        std::vector<VerseClips::Clip> verse_cuts;
+        const bool verse_clips = !options.verseClipsDir.empty();
+        const bool verse_structure = options.verseChapters || verse_clips;
+        fs::path chapters_file;
+        AudioTiming audioTiming{lead_in, verses_duration, minTimestampSec, maxTimestampSec};
+
+        if (use_chunks || use_clip_library) {
+            ScratchDir scratch(CacheUtils::uniqueTempPath("qvm_chunks_"));
+            const fs::path& chunk_dir = scratch.path;
+
+            // Final pass: stream-copy the joined chunks and mux the recitation once
+            Render::RenderPlan muxPlan;
+            Render::InputSpec chunkList;
+            chunkList.path = (chunk_dir / "chunks.txt").string();
+            chunkList.format = "concat";
+            chunkList.formatOptions["safe"] = "0";
+            muxPlan.inputs.push_back(chunkList);
+
+            // Clips are rounded to whole frames one by one; the recitation
+            // follows their frame grid instead of the exact verse durations
+            std::vector<ClipLibrary::Clip> clips;
+            std::vector<VerseData> clip_verses;
+            double clip_lead_in = lead_in;
+            if (use_clip_library) {
+                double fps = config.fps > 0 ? config.fps : 30.0;
+                clips = ClipLibrary::planClips(options, config, verses, static_background.loopSeconds, segmentManager);
+                clip_verses = ClipLibrary::clipTimeline(clips, verses, fps);
+                clip_lead_in = ClipLibrary::clipLeadIn(clips, fps);
+                total_duration = clip_lead_in;
+                for (const auto& verse : clip_verses) total_duration += verse.durationInSeconds;
             }
-            if (audioPath.empty()) throw std::runtime_error("No audio path found for gapless render");
-            bool customClip = !verses.empty() && verses[0].fromCustomAudio;
-            double startTime = customClip ? 0.0 : minTimestampSec;
-            double endTime = customClip ? verses_duration : maxTimestampSec;
-            double trimmedDuration = std::max(0.0, endTime - startTime);
-            double measuredAudioDuration = customClip
-                ? Audio::CustomAudioProcessor::probeDuration(audioPath)
-                : trimmedDuration;
-            double audioDuration = customClip
-                ? std::max(measuredAudioDuration, verses_duration)
-                : measuredAudioDuration;
-            total_duration = intro_duration + pause_after_intro_duration + audioDuration;
-            
-            final_cmd << "-f lavfi -t " << (intro_duration + pause_after_intro_duration) << " -i anullsrc=r=44100:cl=stereo ";
-            if (!customClip) {
-                final_cmd << "-ss " << startTime << " -t " << trimmedDuration << " ";
+            const std::vector<VerseData>& timeline = use_clip_library ? clip_verses : verses;
+
+            AudioTrack audio;
+            if (!pipelined) {
+                audio = use_clip_library
+                    ? appendPinnedAudio(muxPlan, clip_verses, verses, clip_lead_in, recitationStarts(config, verses))
+                    : appendAudioInputs(muxPlan, config, verses, audioTiming);
+                total_duration = audio.totalDuration;
+                muxPlan.filterComplex = audio.filter;
             }
-            final_cmd << "-i \"" << to_ffmpeg_path(audioPath) << "\" ";
-            
-            // Build filter complex
-            final_cmd << "-filter_complex \"";
-            
-            // Handle video part
-            if (!bgInputFiles.empty()) {
-                // Dynamic backgrounds - use the pre-built filter complex
-                final_cmd << bgFilterComplex;
+            if (verse_structure) verse_cuts = VerseClips::planClips(config, timeline, total_duration);
+
+            Render::OutputSpec output;
+            output.path = options.output;
+            output.encoder = encoder;
+            output.encoder.videoCodec = "copy";
+            output.maps = {"0:v"};
+            output.durationSeconds = total_duration;
+            if (!verse_cuts.empty()) {
+                chapters_file = CacheUtils::uniqueTempPath("qvm_chapters_", ".txt");
+                output.chaptersInput = appendChapterInput(muxPlan, verse_cuts, chapters_file);
+            }
+
+            if (use_clip_library) {
+                assembleClips(options, config, verses, clips, static_background, overlay_chain, fonts_ffmpeg_path,
+                              use_sprites, encoder, segmentManager, chunk_dir, *processExecutor);
             } else {
-                // Static background
-                final_cmd << "[0:v]setpts=PTS-STARTPTS,scale=" << config.width << ":" << config.height;
+                encodeChunks(options, config, verses, lead_in, total_duration, bgManager, !bgInputFiles.empty(),
+                             static_background, overlay_chain, ass_chain, decimate_chain, sprite_track, encoder,
+                             VerseClips::cutTimes(verse_cuts), chunk_dir, *processExecutor);
             }
-            
-            // Add overlay if needed
-            if (apply_overlay) {
-                final_cmd << ",drawbox=x=0:y=0:w=iw:h=ih:color=" << config.overlayColor << ":t=fill";
+
+            if (pipelined) {
+                std::cout << "Waiting for the recitation download..." << std::endl;
+                auto waitStart = std::chrono::steady_clock::now();
+                const std::vector<VerseData>& fetched = pendingAudio.get();
+                double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+                std::cout << "Recitation ready after " << std::fixed << std::setprecision(1) << waited << "s of waiting"
+                          << std::defaultfloat << std::endl;
+                if (matchesPlannedTimeline(verses, fetched, config.fps > 0 ? config.fps : 30.0)) {
+                    audio = appendPinnedAudio(muxPlan, timeline, fetched, clip_lead_in);
+                    muxPlan.filterComplex = audio.filter;
+                } else {
+                    std::cerr << "  ! Fetched recitation does not match the reciter metadata; encoding again on its timeline"
+                              << std::endl;
+                    retimed_verses = fetched;
+                }
             }
-            
-            // Add subtitles
-            final_cmd << ",ass='" << ass_ffmpeg_path << "':fontsdir='" 
-                      << fonts_ffmpeg_path << "'[v];";
-            
-            // Handle audio concatenation
-            int audioInputIndex = bgInputFiles.empty() ? 1 : bgInputFiles.size();
-            final_cmd << "[" << audioInputIndex << ":a][" << (audioInputIndex + 1) << ":a]concat=n=2:v=0:a=1[a]\" ";
-            
-            // Map outputs
-            final_cmd << "-map \"[v]\" -map \"[a]\" "
-                      << "-t " << total_duration << " ";
-                      
-        } else {
-            // For gapped: concatenate individual ayah audio files
-            std::string concat_file_path = (fs::temp_directory_path() / "audiolist.txt").string();
-            {
-                std::ofstream concat_file(concat_file_path);
-                if (!concat_file.is_open()) throw std::runtime_error("Failed to create audio list file.");
-                for (const auto& verse : verses) {
-                    concat_file << "file '" << to_ffmpeg_path(fs::absolute(verse.localAudioPath)) << "'\n";
+
+            if (!retimed_verses) {
+                output.maps.push_back(audio.map);
+                muxPlan.outputs.push_back(output);
+                std::cout << "Joining chunks and muxing audio..." << std::endl;
+                processExecutor->render(muxPlan, total_duration);
+                if (options.emitProgress) {
+                    Progress::emit(options.progressSink, "encoding", "completed", 100.0, -1.0, 0.0, "Encoding complete");
                 }
             }
-            
-            double totalVideoDuration = intro_duration + pause_after_intro_duration;
-            for(const auto& verse : verses) totalVideoDuration += verse.durationInSeconds;
-            total_duration = totalVideoDuration;
-            
-            int audioInputIndex = bgInputFiles.empty() ? 1 : bgInputFiles.size();
-            final_cmd << "-itsoffset " << (intro_duration + pause_after_intro_duration) << " "
-                      << "-f concat -safe 0 -i \"" << to_ffmpeg_path(concat_file_path) << "\" ";
-            
-            // Build filter complex
-            final_cmd << "-filter_complex \"";
-            
-            // Handle video part
+
+            std::error_code ec;
+            if (!audio.concatList.empty()) fs::remove(audio.concatList, ec);
+        } else {
+            Render::RenderPlan plan;
+            plan.emitProgress = options.emitProgress;
+            plan.filterThreads = options.resources.filterThreads;
+
+            // Background frames as decoded, and the chain turning them into the main output
+            std::string background_chain;
+            std::string primary_chain;
             if (!bgInputFiles.empty()) {
-                // Dynamic backgrounds - use the pre-built filter complex
-                final_cmd << bgFilterComplex;
+                // Dynamic backgrounds - add all video files as inputs and use the pre-built filter complex
+                for (const auto& bgFile : bgInputFiles) {
+                    Render::InputSpec input;
+                    input.path = bgFile;
+                    plan.inputs.push_back(input);
+                }
+                background_chain = bgFilterComplex;
+                primary_chain = overlay_chain;
             } else {
-                // Static background
-                final_cmd << "[0:v]setpts=PTS-STARTPTS,scale=" << config.width << ":" << config.height;
+                // Static background with loop
+                Render::InputSpec input;
+                input.path = static_background.path;
+                input.loop = true;
+                plan.inputs.push_back(input);
+                background_chain = "[0:v]setpts=PTS-STARTPTS";
+                if (!static_background.plate) {
+                    primary_chain = ",scale=" + std::to_string(config.width) + ":" + std::to_string(config.height) + overlay_chain;
+                }
             }
-            
-            // Add overlay if needed
-            if (apply_overlay) {
-                final_cmd << ",drawbox=x=0:y=0:w=iw:h=ih:color=" << config.overlayColor << ":t=fill";
+            primary_chain += ass_chain + decimate_chain;
+
+            std::ostringstream video_filter;
+            if (extra_outputs.empty()) {
+                video_filter << background_chain << primary_chain << "[v]";
+            } else {
+                // Decode once and split: every extra output resamples, fills its
+                // frame (cropping to its aspect), dims and draws its own subtitles
+                video_filter << background_chain << ",split=" << extra_outputs.size() + 1;
+                for (size_t i = 0; i <= extra_outputs.size(); ++i) video_filter << "[layer" << i << "]";
+                video_filter << ";[layer0]" << (primary_chain.empty() ? "null" : primary_chain.substr(1)) << "[v]";
+                for (size_t i = 0; i < extra_outputs.size(); ++i) {
+                    const AppConfig& extra = extra_outputs[i].config;
+                    std::string size = std::to_string(extra.width) + ":" + std::to_string(extra.height);
+                    video_filter << ";[layer" << i + 1 << "]fps=" << extra.fps
+                                 << ",scale=" << size << ":force_original_aspect_ratio=increase,crop=" << size << ",setsar=1"
+                                 << overlay_chain << extra_outputs[i].subtitleChain
+                                 << (decimate_chain.empty() ? "" : decimateFilter(extra.fps))
+                                 << "[extra" << i + 1 << "]";
+                }
             }
-            
-            // Add subtitles
-            final_cmd << ",ass='" << ass_ffmpeg_path << "':fontsdir='" 
-                      << fonts_ffmpeg_path << "'[v]\" ";
-            
-            // Map outputs
-            final_cmd << "-map \"[v]\" -map " << audioInputIndex << ":a "
-                      << "-t " << totalVideoDuration << " ";
-        }
 
-        // Add encoding options
-        final_cmd << video_codec.str() << " "
-                  << "-c:a aac -b:a 128k "
-                  << "-pix_fmt " << config.pixelFormat << " "
-                  << "-movflags +faststart "
-                  << "-threads 8 "
-                  << "\"" << options.output << "\"";
+            AudioTrack audio = appendAudioInputs(plan, config, verses, audioTiming);
+            total_duration = audio.totalDuration;
+            if (verse_structure) verse_cuts = VerseClips::planClips(config, verses, total_duration);
+            int chapters_input = -1;
+            if (options.verseChapters && !verse_clips && !verse_cuts.empty()) {
+                // The tee muxer does not hand chapters to its outputs, so
+                // --verse-clips renders get the keyframes only
+                chapters_file = CacheUtils::uniqueTempPath("qvm_chapters_", ".txt");
+                chapters_input = appendChapterInput(plan, verse_cuts, chapters_file);
+            }
+            std::string audio_filter = audio.filter;
+            std::vector<std::string> audio_maps{audio.map};
+            if (!extra_outputs.empty()) {
+                // Mixed once, encoded for each output
+                std::ostringstream split;
+                split << (audio.map.front() == '[' ? audio.map : "[" + audio.map + "]") << "asplit=" << extra_outputs.size() + 1;
+                audio_maps.clear();
+                for (size_t i = 0; i <= extra_outputs.size(); ++i) {
+                    split << "[audio" << i << "]";
+                    audio_maps.push_back("[audio" + std::to_string(i) + "]");
+                }
+                audio_filter = audio_filter.empty() ? split.str() : audio_filter + ";" + split.str();
+            }
+            plan.filterComplex = audio_filter.empty() ? video_filter.str() : video_filter.str() + ";" + audio_filter;
 
-        std::cout << "\nExecuting FFmpeg command:\n" << final_cmd.str() << std::endl << std::endl;
-        
-        if (options.emitProgress) {
-            processExecutor->executeWithProgress(final_cmd.str(), total_duration);
-        } else {
-            int exit_code = processExecutor->execute(final_cmd.str());
-            if (exit_code != 0) throw std::runtime_error("FFmpeg execution failed");
+            // Outputs encode side by side and share the render's encoder threads
+            Render::EncoderSettings output_encoder = encoder;
+            if (encoder.threads > 0) {
+                output_encoder.threads = std::max(1, encoder.threads / static_cast<int>(extra_outputs.size() + 1));
+            }
+            Render::OutputSpec output;
+            output.path = options.output;
+            output.encoder = output_encoder;
+            output.maps = {"[v]", audio_maps[0]};
+            output.durationSeconds = total_duration;
+            output.subtitleSprites = sprite_track;
+            output.encoder.keyframeTimes = VerseClips::cutTimes(verse_cuts);
+            output.chaptersInput = chapters_input;
+            if (verse_clips) {
+                // Every verse starts a GOP, and the segment muxer cuts there
+                // while the same packets go to the full video
+                output.format = "tee";
+                output.path = VerseClips::teeTarget(options.output, options.verseClipsDir, verse_cuts);
+                output.fastStart = false;
+                output.encoder.globalHeader = true;
+            }
+            plan.outputs.push_back(output);
+            for (size_t i = 0; i < extra_outputs.size(); ++i) {
+                Render::OutputSpec extra;
+                extra.path = extra_outputs[i].profile->path;
+                extra.encoder = output_encoder;
+                extra.encoder.keyframeTimes = output.encoder.keyframeTimes;
+                extra.chaptersInput = chapters_input;
+                extra.maps = {"[extra" + std::to_string(i + 1) + "]", audio_maps[i + 1]};
+                extra.durationSeconds = total_duration;
+                extra.subtitleSprites = extra_outputs[i].sprites;
+                plan.outputs.push_back(extra);
+            }
+            processExecutor->render(plan, total_duration);
+            std::error_code ec;
+            if (!audio.concatList.empty()) fs::remove(audio.concatList, ec);
+            if (verse_clips) VerseClips::finalize(options.verseClipsDir, options, verse_cuts);
+        }
+
+        // One stream copy adds every translation, however many there are
+        if (!options.softTranslations.empty() && !retimed_verses) {
+            std::cout << "Muxing " << options.softTranslations.size() << " translation track(s)..." << std::endl;
+            muxTextTracks(options.output, options, *processExecutor);
+            for (const auto& extra : extra_outputs) muxTextTracks(extra.profile->path, options, *processExecutor);
         }
 
         // Cleanup temporary background video files
         bgManager.cleanup();
+        if (!chapters_file.empty()) {
+            std::error_code ec;
+            fs::remove(chapters_file, ec);
+        }
+        if (!ass_file_path.empty()) {
+            std::error_code ec;
+            fs::remove(ass_file_path, ec);
+        }
+        for (const auto& extra : extra_outputs) {
+            std::error_code ec;
+            if (!extra.assFile.empty()) fs::remove(extra.assFile, ec);
+        }
+        if (retimed_verses) return generateVideo(options, config, *retimed_verses, processExecutor, segmentManager);
 
         std::cout << "\n✅ Render complete! Video saved to: " << options.output << std::endl;
+        for (const auto& extra : extra_outputs) std::cout << "   Also saved: " << extra.profile->path << std::endl;
+        if (verse_clips) {
+            std::cout << "   Verse clips: " << verse_cuts.size() << " in " << options.verseClipsDir << std::endl;
+        }
+        return true;
 
     } catch(const std::exception& e) {
         std::cerr << "❌ An error occurred during video generation: " << e.what() << std::endl;
+        return false;
     }
 }
 
@@ -361,7 +1065,7 @@ void VideoGenerator::generateThumbnail(const CLIOptions& options, const AppConfi
         std::string number_color = pick_color();
         int number_size = scaled_font_size * 0.5;
 
-        fs::path ass_path = fs::temp_directory_path() / "thumbnail.ass";
+        fs::path ass_path = CacheUtils::uniqueTempPath("qvm_thumbnail_", ".ass");
         std::ofstream ass_file(ass_path);
         if (!ass_file.is_open()) throw std::runtime_error("Failed to create temporary ASS file.");
 
@@ -388,18 +1092,20 @@ void VideoGenerator::generateThumbnail(const CLIOptions& options, const AppConfi
                 
         ass_file.close();
 
-        std::string fonts_dir = to_ffmpeg_filter_path(fs::absolute(config.assetFolderPath) / "fonts");
+        std::string fonts_dir = Render::toFfmpegFilterPath(fs::absolute(config.assetFolderPath) / "fonts");
 
         std::stringstream cmd;
         cmd << "ffmpeg -y "
             << "-ss 0 "
-            << "-i \"" << to_ffmpeg_path(config.assetBgVideo) << "\" "
-            << "-vf \"ass='" << to_ffmpeg_filter_path(ass_path) << "':fontsdir='" << fonts_dir << "'\" "
+            << "-i \"" << Render::toFfmpegPath(config.assetBgVideo) << "\" "
+            << "-vf \"ass='" << Render::toFfmpegFilterPath(ass_path) << "':fontsdir='" << fonts_dir << "'\" "
             << "-frames:v 1 "
             << "-q:v 2 "
             << "\"" << thumbnail_path << "\"";
 
         int exit_code = processExecutor->execute(cmd.str());
+        std::error_code ec;
+        fs::remove(ass_path, ec);
         if (exit_code != 0) throw std::runtime_error("FFmpeg thumbnail generation failed");
 
         std::cout << "✅ Thumbnail saved to: " << thumbnail_path << std::endl;
@@ -2,15 +2,27 @@
 #include "types.h"
 #include "interfaces/IProcessExecutor.h"
 #include "verse_segmentation.h"
+#include <future>
 #include <vector>
 #include <memory>
 
 namespace VideoGenerator {
-    void generateVideo(const CLIOptions& options, 
+    // Verses whose audio is still downloading when the encode starts.
+    using PendingVerses = std::shared_future<std::vector<VerseData>>;
+
+    // Returns false when rendering failed (the error has already been reported).
+    // With `pendingAudio` (--pipeline), `verses` carry the timeline planned
+    // from reciter metadata: the video track is encoded from it right away and
+    // the fetched verses are awaited only to mux the recitation.
+    bool generateVideo(const CLIOptions& options, 
                        const AppConfig& config, 
                        const std::vector<VerseData>& verses, 
                        std::shared_ptr<Interfaces::IProcessExecutor> processExecutor,
-                       const VerseSegmentation::Manager* segmentManager = nullptr);
+                       const VerseSegmentation::Manager* segmentManager = nullptr,
+                       PendingVerses pendingAudio = {});
+    // Whether a render can take pending audio: gapped recitation from the
+    // reciter's files, with one output encoded apart from its audio.
+    bool supportsPendingAudio(const CLIOptions& options, const AppConfig& config);
     void generateThumbnail(const CLIOptions& options, 
                            const AppConfig& config, 
                            std::shared_ptr<Interfaces::IProcessExecutor> processExecutor);
@@ -0,0 +1,43 @@
+#pragma once
+#include "cache_utils.h"
+#include "config_loader.h"
+#include "types.h"
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+// A fresh qvm_<name>_fixture directory under the system temp dir whose
+// "cache" subdirectory is the cache root while the fixture lives. The previous
+// root is restored and the directory removed when it goes out of scope.
+class CacheFixture {
+public:
+    explicit CacheFixture(const std::string& name)
+        : dir_(std::filesystem::temp_directory_path() / ("qvm_" + name + "_fixture")),
+          previousCacheRoot_(CacheUtils::getCacheRoot()) {
+        std::filesystem::remove_all(dir_);
+        std::filesystem::create_directories(dir_);
+        CacheUtils::setCacheRoot(dir_ / "cache");
+    }
+
+    ~CacheFixture() {
+        CacheUtils::setCacheRoot(previousCacheRoot_);
+        std::error_code ec;
+        std::filesystem::remove_all(dir_, ec);
+    }
+
+    CacheFixture(const CacheFixture&) = delete;
+    CacheFixture& operator=(const CacheFixture&) = delete;
+
+    const std::filesystem::path& dir() const { return dir_; }
+
+    // The repository's config.json, as a render with `options` would load it.
+    static AppConfig config(CLIOptions& options) {
+        static const std::filesystem::path root =
+            std::filesystem::absolute(std::filesystem::path(__FILE__)).parent_path().parent_path();
+        return loadConfig((root / "config.json").string(), options);
+    }
+
+private:
+    std::filesystem::path dir_;
+    std::filesystem::path previousCacheRoot_;
+};
@@ -0,0 +1,153 @@
+#pragma once
+#ifndef _WIN32
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Minimal HTTP/1.1 server on 127.0.0.1 for exercising the download manager.
+// Every request on every (keep-alive) connection is passed to the handler,
+// which returns the whole raw response; requests are recorded in arrival order.
+// A response carrying "Connection: close" ends its connection once sent, which
+// also cuts off a body shorter than its Content-Length.
+class LoopbackHttpServer {
+public:
+    struct Request {
+        std::string path;
+        std::map<std::string, std::string> headers;  // names lower-cased
+    };
+    using Handler = std::function<std::string(const Request&)>;
+
+    explicit LoopbackHttpServer(Handler handler) : handler_(std::move(handler)) {
+        listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        ::bind(listener_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        ::listen(listener_, 16);
+        socklen_t length = sizeof(addr);
+        ::getsockname(listener_, reinterpret_cast<sockaddr*>(&addr), &length);
+        port_ = ntohs(addr.sin_port);
+        acceptor_ = std::thread([this] { acceptLoop(); });
+    }
+
+    ~LoopbackHttpServer() {
+        ::shutdown(listener_, SHUT_RDWR);
+        ::close(listener_);
+        acceptor_.join();
+        std::vector<std::thread> connections;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : sockets_) ::shutdown(fd, SHUT_RDWR);
+            connections.swap(connections_);
+        }
+        for (auto& connection : connections) connection.join();
+        for (int fd : sockets_) ::close(fd);
+    }
+
+    std::string url(const std::string& path) const {
+        return "http://127.0.0.1:" + std::to_string(port_) + path;
+    }
+
+    std::vector<Request> requests() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return requests_;
+    }
+
+    // Blocks until `count` requests have arrived (or a few seconds passed).
+    bool waitForRequests(size_t count) const {
+        for (int i = 0; i < 500; ++i) {
+            if (requests().size() >= count) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+
+    static std::string response(int status,
+                                const std::string& body,
+                                const std::vector<std::string>& headers = {}) {
+        const char* reason = status == 206 ? " Partial Content" : status < 300 ? " OK" : " Error";
+        std::string raw = "HTTP/1.1 " + std::to_string(status) + reason + "\r\n";
+        for (const auto& header : headers) raw += header + "\r\n";
+        raw += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        return raw;
+    }
+
+private:
+    void acceptLoop() {
+        while (true) {
+            int fd = ::accept(listener_, nullptr, nullptr);
+            if (fd < 0) return;
+            std::lock_guard<std::mutex> lock(mutex_);
+            sockets_.push_back(fd);
+            connections_.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+
+    void serve(int fd) {
+        std::string buffer;
+        char chunk[4096];
+        while (true) {
+            size_t end = buffer.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                ssize_t got = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (got <= 0) break;
+                buffer.append(chunk, static_cast<size_t>(got));
+                continue;
+            }
+            Request request = parse(buffer.substr(0, end));
+            buffer.erase(0, end + 4);  // GET requests carry no body
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                requests_.push_back(request);
+            }
+            std::string raw = handler_(request);
+            if (::send(fd, raw.data(), raw.size(), MSG_NOSIGNAL) < 0) break;
+            if (raw.find("\r\nConnection: close\r\n") != std::string::npos) break;
+        }
+        ::shutdown(fd, SHUT_RDWR);  // closed by the destructor, so the descriptor is not reused meanwhile
+    }
+
+    static Request parse(const std::string& head) {
+        Request request;
+        size_t lineEnd = head.find("\r\n");
+        std::string requestLine = head.substr(0, lineEnd);
+        size_t first = requestLine.find(' ');
+        size_t second = requestLine.find(' ', first + 1);
+        request.path = requestLine.substr(first + 1, second - first - 1);
+        while (lineEnd != std::string::npos) {
+            size_t start = lineEnd + 2;
+            lineEnd = head.find("\r\n", start);
+            std::string line = head.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(" \t"));
+            request.headers[name] = value;
+        }
+        return request;
+    }
+
+    Handler handler_;
+    int listener_ = -1;
+    int port_ = 0;
+    std::thread acceptor_;
+    mutable std::mutex mutex_;
+    std::vector<int> sockets_;
+    std::vector<std::thread> connections_;
+    std::vector<Request> requests_;
+};
+#endif
@@ -1,23 +1,67 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
 #include "types.h"
 #include "config_loader.h"
 #include "cache_utils.h"
+#include "quran_data.h"
 #include "recitation_utils.h"
 #include "localization_utils.h"
 #include "subtitle_builder.h"
 #include "timing_parser.h"
 #include "text/text_layout.h"
 #include "audio/custom_audio_processor.h"
+#include "audio/mp3_index.h"
+#include "audio/media_duration.h"
+#include "audio/duration_manifest.h"
 #include "video_generator.h"
 #include "metadata_writer.h"
+#include "render_cache.h"
+#include "clip_library.h"
+#include "background_plate.h"
+#include "background_video_manager.h"
+#include "subtitle_sprites.h"
+#include "verse_clips.h"
+#include "render/blend_kernels.h"
+#include "render/sprite_compositor.h"
+#include "render/libav_engine.h"
+#include "render/render_plan.h"
+#include "command_line.h"
+#include "batch_runner.h"
+#include "progress.h"
+#include "parallel_for.h"
+#include "SystemProcessExecutor.h"
+#include "resource_governor.h"
+#include "render/chunk_planner.h"
+#include "data/verse_keys.h"
+#include "data/verse_text_index.h"
+#include "data/verse_pack.h"
+#include "net/download_manager.h"
 #include "MockApiClient.h"
 #include "MockProcessExecutor.h"
+#include "LoopbackHttpServer.h"
+#include "CacheFixture.h"
+#include <map>
 #include <memory>
+#include <set>
+#include <sstream>
+#include <vector>
 #include <nlohmann/json.hpp>
 
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/frame.h>
+}
+
 namespace fs = std::filesystem;
 using nlohmann::json;
 
@@ -38,6 +82,51 @@ fs::path getProjectRoot() {
     return root;
 }
 
+// A render of 1:1 with silent audio into the temp directory, for tests of
+// the commands VideoGenerator builds. The output and audio are removed when
+// it goes out of scope.
+struct RenderFixture {
+    CLIOptions opts;
+    AppConfig cfg{};
+    std::vector<VerseData> verses = {makeSampleVerse()};
+    std::string dummyAudioPath;
+
+    explicit RenderFixture(const std::string& name) {
+        opts.surah = 1;
+        opts.from = 1;
+        opts.to = 1;
+        opts.output = (fs::temp_directory_path() / (name + ".mp4")).string();
+        cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+        dummyAudioPath = (fs::temp_directory_path() / (name + "_audio.wav")).string();
+        std::ofstream dummyAudio(dummyAudioPath, std::ios::binary);
+        // Write a minimal WAV header for a silent audio file
+        dummyAudio.write("RIFF", 4);
+        dummyAudio.write("\x24\x00\x00\x00", 4); // ChunkSize
+        dummyAudio.write("WAVE", 4);
+        dummyAudio.write("fmt ", 4);
+        dummyAudio.write("\x10\x00\x00\x00", 4); // Subchunk1Size
+        dummyAudio.write("\x01\x00", 2);       // AudioFormat
+        dummyAudio.write("\x01\x00", 2);       // NumChannels
+        dummyAudio.write("\x44\xAC\x00\x00", 4); // SampleRate
+        dummyAudio.write("\x88\x58\x01\x00", 4); // ByteRate
+        dummyAudio.write("\x02\x00", 2);       // BlockAlign
+        dummyAudio.write("\x10\x00", 2);       // BitsPerSample
+        dummyAudio.write("data", 4);
+        dummyAudio.write("\x00\x00\x00\x00", 4); // Subchunk2Size
+        dummyAudio.close();
+        verses[0].localAudioPath = dummyAudioPath;
+    }
+
+    ~RenderFixture() {
+        std::error_code ec;
+        fs::remove(opts.output, ec);
+        fs::remove(dummyAudioPath, ec);
+    }
+
+    RenderFixture(const RenderFixture&) = delete;
+    RenderFixture& operator=(const RenderFixture&) = delete;
+};
+
 void testConfigLoader() {
     CLIOptions opts;
     AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
@@ -110,6 +199,23 @@ void testSubtitleBuilder() {
     std::vector<VerseData> verses = {makeSampleVerse()};
     std::string assPath = SubtitleBuilder::buildAssFile(cfg, opts, verses, cfg.introDuration, cfg.pauseAfterIntroDuration);
     assert(fs::exists(assPath));
+
+    // Soft translations burn in only the Arabic and move the rest to text tracks
+    opts.softTranslations = {cfg.translationId};
+    auto burned = SubtitleBuilder::buildCues(cfg, opts, verses, cfg.introDuration, cfg.pauseAfterIntroDuration);
+    assert(burned.size() == 1);
+    assert(burned[0].text.find("\\rTranslation") == std::string::npos);
+    auto textCues = SubtitleBuilder::buildTranslationCues(cfg, opts, verses, cfg.introDuration, cfg.pauseAfterIntroDuration,
+                                                          cfg.translationId);
+    assert(textCues.size() == 2);
+    assert(textCues[1].start == burned[0].start && textCues[1].end == burned[0].end);
+    std::string vtt = SubtitleBuilder::webVttDocument(textCues);
+    assert(vtt.rfind("WEBVTT\n", 0) == 0);
+    assert(vtt.find(" --> ") != std::string::npos);
+    assert(vtt.find("\nIn the name of Allah\n") != std::string::npos);
+    assert(SubtitleBuilder::textTrackPath("out/render.mp4", 1) == fs::path("out/render.1.en.vtt"));
+    opts.burnArabic = false;
+    assert(SubtitleBuilder::buildCues(cfg, opts, verses, cfg.introDuration, cfg.pauseAfterIntroDuration).empty());
 }
 
 void testTextLayoutEngine() {
@@ -130,6 +236,1092 @@ void testTextLayoutEngine() {
     assert(layout.wrappedTranslation.find("\\N") != std::string::npos);
 }
 
+void testChunkPlanner() {
+    std::vector<double> boundaries;
+    for (int i = 0; i < 40; ++i) boundaries.push_back(3.5 + i * 7.3);
+    double total = 3.5 + 40 * 7.3;
+    double frame = 1.0 / 30.0;
+    auto chunks = Render::planChunks(boundaries, total, 4, frame);
+    assert(chunks.size() == 4);
+    assert(chunks.front().startSeconds == 0.0);
+    assert(chunks.back().endSeconds == total);
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        double cut = chunks[i].startSeconds;
+        assert(cut == chunks[i - 1].endSeconds);
+        double frames = cut / frame;
+        assert(std::abs(frames - std::round(frames)) < 1e-6);
+        bool onBoundary = false;
+        for (double b : boundaries) {
+            if (std::abs(b - cut) <= frame / 2) onBoundary = true;
+        }
+        assert(onBoundary);
+    }
+
+    // Too short to split: a single chunk covering everything
+    auto single = Render::planChunks({1.0}, 3.0, 8, frame);
+    assert(single.size() == 1);
+    assert(single[0].endSeconds == 3.0);
+}
+
+void testFontPool() {
+    CLIOptions opts;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    TextLayout::FontPool pool;
+    auto first = pool.get(cfg.arabicFont.file, 48);
+    auto again = pool.get(cfg.arabicFont.file, 48);
+    auto larger = pool.get(cfg.arabicFont.file, 64);
+    assert(first == again);
+    assert(first != larger);
+    assert(pool.size() == 2);
+    double width = first->measure("بِسْمِ اللّٰهِ");
+    assert(width > 0.0);
+    assert(larger->measure("بِسْمِ اللّٰهِ") > width);
+}
+
+void testWrapMatchesExactShaping() {
+    CLIOptions opts;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    std::ifstream file(cfg.quranWordByWordPath);
+    assert(file.is_open());
+    json words;
+    file >> words;
+
+    // Rebuild every verse the way LiveApiClient does: words in order, space separated
+    std::map<std::pair<int, int>, std::map<int, std::string>> verseWords;
+    for (auto it = words.begin(); it != words.end(); ++it) {
+        int surah = 0, ayah = 0, word = 0;
+        if (std::sscanf(it.key().c_str(), "%d:%d:%d", &surah, &ayah, &word) != 3) continue;
+        verseWords[{surah, ayah}][word] = it.value().value("text", "");
+    }
+    assert(verseWords.size() == 6236);
+
+    TextLayout::Engine memoized(cfg);
+    TextLayout::Engine exact(cfg);
+    exact.setExactMeasurement(true);
+    for (const auto& [key, parts] : verseWords) {
+        VerseData verse = makeSampleVerse();
+        verse.verseKey = std::to_string(key.first) + ":" + std::to_string(key.second);
+        verse.text.clear();
+        for (const auto& part : parts) verse.text += part.second + " ";
+        verse.translation = CacheUtils::getTranslationText(cfg.translationId, verse.verseKey);
+        verse.durationInSeconds = 5.0;
+        auto fast = memoized.layoutVerse(verse);
+        auto reference = exact.layoutVerse(verse);
+        assert(fast.wrappedArabic == reference.wrappedArabic);
+        assert(fast.wrappedTranslation == reference.wrappedTranslation);
+    }
+}
+
+void testWrapNearBoundary() {
+    CLIOptions opts;
+    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
+    cfg.enableTextGrowth = false;
+    cfg.textHorizontalPadding = 0.0;
+    cfg.arabicMaxWidthFraction = 1.0;
+    cfg.translationMaxWidthFraction = 1.0;
+
+    VerseData verse = makeSampleVerse();
+    verse.verseKey = "2:255";
+    verse.text = "ٱللَّهُ لَآ إِلَٰهَ إِلَّا هُوَ ٱلْحَىُّ ٱلْقَيُّومُ ۚ لَا تَأْخُذُهُۥ سِنَةٌ وَلَا نَوْمٌ ۚ لَّهُۥ مَا فِى "
+                 "ٱلسَّمَٰوَٰتِ وَمَا فِى ٱلْأَرْضِ ۗ مَن ذَا ٱلَّذِى يَشْفَعُ عِندَهُۥٓ إِلَّا بِإِذْنِهِۦ ۚ يَعْلَمُ مَا "
+                 "بَيْنَ أَيْدِيهِمْ وَمَا خَلْفَهُمْ ۖ وَلَا يُحِيطُونَ بِشَىْءٍ مِّنْ عِلْمِهِۦٓ إِلَّا بِمَا شَآءَ ۚ وَسِعَ "
+                 "كُرْسِيُّهُ ٱلسَّمَٰوَٰتِ وَٱلْأَرْضَ ۖ وَلَا يَـُٔودُهُۥ حِفْظُهُمَا ۚ وَهُوَ ٱلْعَلِىُّ ٱلْعَظِيمُ";
+    verse.translation = "Allah - there is no deity except Him, the Ever-Living, the Sustainer of existence. Neither "
+                        "drowsiness overtakes Him nor sleep. To Him belongs whatever is in the heavens and whatever "
+                        "is on the earth. Who is it that can intercede with Him except by His permission? He knows "
+                        "what is presently before them and what will be after them, and they encompass not a thing "
+                        "of His knowledge except for what He wills.";
+
+    auto words = [](const std::string& line) {
+        std::istringstream iss(line);
+        std::vector<std::string> out;
+        for (std::string word; iss >> word;) out.push_back(word);
+        return out;
+    };
+    auto firstLine = [](const std::string& wrapped) { return wrapped.substr(0, wrapped.find("\\N")); };
+
+    // Put the wrap width within a few pixels of where each prefix of the
+    // line ends: the memoized wrap must break exactly where shaping does,
+    // and the first line is the longest prefix that fits.
+    TextLayout::Engine probe(cfg);
+    auto sizes = probe.layoutVerse(verse);
+    struct Case {
+        std::string text;
+        std::shared_ptr<TextLayout::Font> font;
+        bool arabic;
+    };
+    std::vector<Case> cases = {
+        {verse.text, TextLayout::FontPool::shared()->get(cfg.arabicFont.file, sizes.baseArabicSize), true},
+        {verse.translation, TextLayout::FontPool::shared()->get(cfg.translationFont.file, sizes.baseTranslationSize), false},
+    };
+    for (const auto& c : cases) {
+        auto all = words(c.text);
+        std::vector<double> prefixWidths;
+        std::string prefix;
+        for (const auto& word : all) {
+            prefix += (prefix.empty() ? "" : " ") + word;
+            prefixWidths.push_back(c.font->measure(prefix));
+        }
+        for (size_t k = 1; k < all.size(); k += 3) {
+            for (int delta = -2; delta <= 2; ++delta) {
+                int width = static_cast<int>(prefixWidths[k]) + delta;
+                if (width < 50 || width >= prefixWidths.back()) continue;
+                AppConfig sized = cfg;
+                sized.width = width;
+                TextLayout::Engine memoized(sized);
+                TextLayout::Engine exact(sized);
+                exact.setExactMeasurement(true);
+                auto fast = memoized.layoutVerse(verse);
+                auto reference = exact.layoutVerse(verse);
+                const std::string& wrapped = c.arabic ? fast.wrappedArabic : fast.wrappedTranslation;
+                assert(wrapped == (c.arabic ? reference.wrappedArabic : reference.wrappedTranslation));
+
+                size_t fitting = 0;
+                while (fitting < prefixWidths.size() && prefixWidths[fitting] <= width) ++fitting;
+                assert(words(firstLine(wrapped)).size() == std::max<size_t>(fitting, 1));
+            }
+        }
+    }
+}
+
+void testVerseTextIndex() {
+    assert(Data::verseOrdinal(1, 1) == 0);
+    assert(Data::verseOrdinal(2, 1) == 7);
+    assert(Data::verseOrdinal(114, 6) == Data::kTotalVerses - 1);
+    assert(Data::verseOrdinal(1, 8) == -1);
+    assert(Data::verseOrdinal("2:255") == Data::verseOrdinal(2, 255));
+    assert(Data::verseOrdinal("2:255:3") == Data::verseOrdinal(2, 255));
+    assert(Data::verseOrdinal("bad") == -1);
+
+    fs::path source = fs::temp_directory_path() / "qvm_words_fixture.json";
+    fs::path indexPath = fs::temp_directory_path() / "qvm_words_fixture.bin";
+    {
+        std::ofstream out(source);
+        out << R"({"1:1:2": {"text": "b"}, "1:1:1": {"text": "a"}, "1:1:10": {"text": "c"},)"
+            << R"( "1:2:1": {"text": "d"}, "114:6:1": {"text": "e"}})";
+    }
+    Data::VerseTextIndex::build(source, indexPath);
+    assert(Data::VerseTextIndex::isCurrent(indexPath, source));
+
+    Data::VerseTextIndex index(indexPath);
+    assert(index.wordCount() == 5);
+    auto words = index.words(1, 1);
+    assert(words.size() == 3 && words[0] == "a" && words[1] == "b" && words[2] == "c");
+    assert(index.verseText(1, 1) == "a b c ");
+    assert(index.verseText(114, 6) == "e ");
+    assert(index.verseText(1, 3).empty());
+    assert(index.verseText(200, 1).empty());
+
+    {
+        std::ofstream out(source, std::ios::app);
+        out << "\n";
+    }
+    assert(!Data::VerseTextIndex::isCurrent(indexPath, source));
+    assert(!index.builtFrom(source));
+    fs::remove(source);
+    fs::remove(indexPath);
+}
+
+void testVersePack() {
+    fs::path source = fs::temp_directory_path() / "qvm_pack_fixture.json";
+    fs::path packPath = fs::temp_directory_path() / "qvm_pack_fixture.bin";
+    {
+        std::ofstream out(source);
+        out << R"({"1:1": {"audio_url": "https://a/1.mp3", "duration": 6.5},)"
+            << R"( "2:255": {"audio_url": "https://a/2.mp3", "duration": null}, "note": "ignored"})";
+    }
+    const std::vector<std::string> fields = {"audio_url", "duration"};
+    Data::VersePack::build(source, fields, packPath);
+    assert(Data::VersePack::isCurrent(packPath, source, fields));
+    assert(!Data::VersePack::isCurrent(packPath, source, {"t"}));
+
+    Data::VersePack pack(packPath);
+    assert(pack.fieldIndex("duration") == 1);
+    assert(pack.fieldIndex("t") == -1);
+    assert(pack.contains("1:1") && pack.contains("2:255"));
+    assert(!pack.contains("1:2") && !pack.contains("note"));
+    assert(pack.value("1:1", "audio_url") == "https://a/1.mp3");
+    assert(pack.value("1:1", "duration") == "6.5");
+    assert(pack.value("2:255", "duration").empty());
+    assert(pack.value("1:2", "audio_url").empty());
+    fs::remove(source);
+    fs::remove(packPath);
+}
+
+void testDownloadHostKey() {
+    assert(Net::DownloadManager::hostKey("HTTPS://Cdn.Example.com:8443/a/b.mp3?x=1") == "https://cdn.example.com:8443");
+    assert(Net::DownloadManager::hostKey("https://example.com") == "https://example.com");
+    assert(Net::DownloadManager::hostKey("https://example.com?q=1") == "https://example.com");
+    assert(Net::DownloadManager::hostKey("https://a.example.com/x") != Net::DownloadManager::hostKey("https://b.example.com/x"));
+}
+
+#ifndef _WIN32
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void testDownloadScheduling() {
+    CacheFixture fixture("download");
+    const fs::path& dir = fixture.dir();
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    LoopbackHttpServer server([&](const LoopbackHttpServer::Request& request) {
+        if (request.path == "/block") released.wait();
+        return LoopbackHttpServer::response(200, "body of " + request.path);
+    });
+    Net::DownloadManager manager({1, 1});
+
+    // The one worker is busy; queued work then runs by priority, then in order
+    auto blocking = manager.enqueue(server.url("/block"), dir / "block");
+    assert(server.waitForRequests(1));
+    std::vector<std::shared_future<bool>> queued = {
+        manager.enqueue(server.url("/low"), dir / "low", Net::Priority::Low),
+        manager.enqueue(server.url("/normal"), dir / "normal", Net::Priority::Normal),
+        manager.enqueue(server.url("/high"), dir / "high", Net::Priority::High),
+        manager.enqueue(server.url("/high-later"), dir / "high-later", Net::Priority::High),
+        // Same destination as a queued transfer: shared, and pulled forward
+        manager.enqueue(server.url("/low"), dir / "low", Net::Priority::High),
+    };
+    release.set_value();
+    assert(blocking.get());
+    for (auto& future : queued) assert(future.get());
+
+    std::vector<std::string> order;
+    for (const auto& request : server.requests()) order.push_back(request.path);
+    assert((order == std::vector<std::string>{"/block", "/low", "/high", "/high-later", "/normal"}));
+    assert(readFile(dir / "low") == "body of /low");
+    assert(!fs::exists(dir / "low.part"));
+
+    // Requests for a destination already in flight share its transfer
+    fs::remove_all(dir);
+    std::promise<void> releaseAgain;
+    released = releaseAgain.get_future().share();
+    size_t before = server.requests().size();
+    auto first = manager.enqueue(server.url("/block"), dir / "shared");
+    assert(server.waitForRequests(before + 1));
+    auto second = manager.enqueue(server.url("/block"), dir / "shared");
+    releaseAgain.set_value();
+    assert(first.get() && second.get());
+    assert(server.requests().size() == before + 1);
+}
+
+void testDownloadResume() {
+    CacheFixture fixture("partial");
+    const fs::path& dir = fixture.dir();
+    const std::string full = "0123456789";
+    std::string etag = "\"v1\"";
+    bool dropFirst = true;
+    LoopbackHttpServer server([&](const LoopbackHttpServer::Request& request) {
+        std::vector<std::string> headers = {"ETag: " + etag, "Accept-Ranges: bytes"};
+        auto range = request.headers.find("range");
+        if (range != request.headers.end() && request.headers.at("if-range") == etag) {
+            size_t from = std::stoul(range->second.substr(6));
+            headers.push_back("Content-Range: bytes " + std::to_string(from) + "-9/10");
+            return LoopbackHttpServer::response(206, full.substr(from), headers);
+        }
+        if (dropFirst) {
+            // The connection drops after four of the ten announced bytes
+            dropFirst = false;
+            headers.push_back("Connection: close");
+            std::string raw = LoopbackHttpServer::response(200, full, headers);
+            return raw.substr(0, raw.size() - 6);
+        }
+        return LoopbackHttpServer::response(200, full, headers);
+    });
+    Net::DownloadManager manager({1, 1});
+    fs::path destination = dir / "surah.mp3";
+    fs::path part = dir / "surah.mp3.part";
+
+    // An interrupted transfer never shows up at the final path
+    assert(!manager.download(server.url("/surah.mp3"), destination, Net::Priority::Normal, 1));
+    assert(!fs::exists(destination));
+    assert(readFile(part) == "0123");
+
+    // The retry asks only for the missing bytes, guarded by the validator
+    assert(manager.download(server.url("/surah.mp3"), destination, Net::Priority::Normal, 1));
+    assert(readFile(destination) == full);
+    assert(!fs::exists(part) && !fs::exists(dir / "surah.mp3.part.meta"));
+    auto requests = server.requests();
+    assert(requests.size() == 2);
+    assert(requests[1].headers.at("range") == "bytes=4-" && requests[1].headers.at("if-range") == etag);
+
+    // A changed resource answers the resume with the whole new body
+    fs::remove(destination);
+    std::ofstream(part, std::ios::binary) << "0123";
+    std::ofstream(dir / "surah.mp3.part.meta") << "\"v0\"\n10\n";
+    assert(manager.download(server.url("/surah.mp3"), destination, Net::Priority::Normal, 1));
+    assert(readFile(destination) == full);
+
+    // A part file that was complete but never renamed is moved into place
+    fs::remove(destination);
+    std::ofstream(part, std::ios::binary) << full;
+    std::ofstream(dir / "surah.mp3.part.meta") << etag << "\n10\n";
+    size_t before = server.requests().size();
+    assert(manager.download(server.url("/surah.mp3"), destination, Net::Priority::Normal, 1));
+    assert(readFile(destination) == full && server.requests().size() == before);
+}
+
+void testDownloadRestartsMismatchedResume() {
+    CacheFixture fixture("resume");
+    const fs::path& dir = fixture.dir();
+    const std::string full = "0123456789";
+    LoopbackHttpServer server([&](const LoopbackHttpServer::Request& request) {
+        std::vector<std::string> headers = {"ETag: \"v1\"", "Accept-Ranges: bytes"};
+        if (request.headers.count("range")) {
+            // Answers some other range than the one asked for
+            headers.push_back("Content-Range: bytes 5-9/10");
+            return LoopbackHttpServer::response(206, full.substr(5), headers);
+        }
+        return LoopbackHttpServer::response(200, full, headers);
+    });
+    Net::DownloadManager manager({1, 1});
+
+    fs::path destination = dir / "verse.mp3";
+    std::ofstream(dir / "verse.mp3.part", std::ios::binary) << "012";
+    std::ofstream(dir / "verse.mp3.part.meta") << "\"v1\"\n10\n";
+    assert(manager.download(server.url("/verse.mp3"), destination, Net::Priority::Normal, 1));
+    assert(readFile(destination) == full);
+    assert(!fs::exists(dir / "verse.mp3.part") && !fs::exists(dir / "verse.mp3.part.meta"));
+
+    auto requests = server.requests();
+    assert(requests.size() == 2);
+    assert(requests[0].headers.at("range") == "bytes=3-");
+    assert(requests[1].headers.count("range") == 0);
+}
+#endif
+
+void testMp3SeekIndex() {
+    // MPEG-1 Layer III, 128 kbps, 44.1 kHz: frames of 417 or 418 bytes
+    const double averageFrame = 144.0 * 128000 / 44100;
+    auto frameHeader = [](bool padded) {
+        return std::string{'\xFF', '\xFB', padded ? '\x92' : '\x90', '\x64'};
+    };
+    std::string file = "ID3";
+    file += std::string("\x04\x00\x00\x00\x00\x00\x0A", 7) + std::string(10, '\0');
+    std::string info = frameHeader(false) + std::string(32, '\0') + "Info" + std::string("\x00\x00\x00\x0F", 4);
+    info += std::string(112, '\0') + "LAME3.100" + std::string(12, '\0') + std::string("\x24\x00\x00", 3);
+    info.resize(417, '\0');
+    file += info;
+    std::vector<size_t> offsets;
+    for (int k = 0; k < 200; ++k) {
+        bool padded = static_cast<long>(std::floor((k + 1) * averageFrame)) - static_cast<long>(std::floor(k * averageFrame)) == 418;
+        offsets.push_back(file.size());
+        std::string frame = frameHeader(padded);
+        frame.resize(padded ? 418 : 417, static_cast<char>(k % 100));
+        file += frame;
+    }
+
+    auto index = Audio::buildMp3SeekIndex(file);
+    assert(index);
+    assert(index->audioStart == static_cast<std::int64_t>(offsets[0]));
+    assert(index->sampleRate == 44100 && index->samplesPerFrame == 1152);
+    assert(index->skipSamples == 576 + 529);
+    for (int k : {0, 1, 50, 199}) {
+        assert(std::llabs(index->frameOffset(k) - static_cast<std::int64_t>(offsets[k])) <= 1);
+    }
+    assert(index->frameAt(index->frameStartSeconds(120) + 0.001) == 120);
+    assert(Audio::findMp3FrameSync(file, offsets[40] - 3, *index) == offsets[40]);
+
+    auto roundTrip = Audio::Mp3SeekIndex::fromJson(index->toJson());
+    assert(roundTrip && roundTrip->frameOffset(77) == index->frameOffset(77));
+
+    // A Xing (VBR) tag means frame positions cannot be computed
+    std::string vbr = file;
+    vbr.replace(offsets[0] - 417 + 36, 4, "Xing");
+    assert(!Audio::buildMp3SeekIndex(vbr));
+}
+
+void testMediaDurations() {
+    auto bigEndian = [](std::uint64_t value, int bytes) {
+        std::string out;
+        for (int i = bytes - 1; i >= 0; --i) out += static_cast<char>((value >> (8 * i)) & 0xFF);
+        return out;
+    };
+
+    // MP3 with a Xing frame count: 1000 frames of 1152 samples at 44.1 kHz
+    std::string mp3 = std::string("\xFF\xFB\x90\x64", 4) + std::string(32, '\0') + "Xing" + bigEndian(1, 4) + bigEndian(1000, 4);
+    mp3.resize(417, '\0');
+    for (int k = 0; k < 3; ++k) {
+        std::string frame("\xFF\xFB\x90\x64", 4);
+        frame.resize(417, '\x55');
+        mp3 += frame;
+    }
+    auto fromTag = Audio::mp3DurationFromHead(mp3, mp3.size());
+    assert(fromTag && std::fabs(*fromTag - 1000 * 1152 / 44100.0) < 1e-9);
+
+    // Without a tag the duration is estimated from the bitrate
+    std::string cbr = mp3.substr(417);
+    auto estimated = Audio::mp3DurationFromHead(cbr, 417 * 1000);
+    assert(estimated && std::fabs(*estimated - 417 * 1000 * 8 / 128000.0) < 1e-9);
+
+    // MP4 whose moov follows mdat: mvhd v0 with timescale 600 and 7.5 s
+    std::string mvhd = bigEndian(0, 4) + bigEndian(0, 4) + bigEndian(0, 4) + bigEndian(600, 4) + bigEndian(4500, 4);
+    mvhd += std::string(80, '\0');
+    mvhd = bigEndian(8 + mvhd.size(), 4) + "mvhd" + mvhd;
+    std::string mp4 = bigEndian(16, 4) + "ftypisom" + bigEndian(0, 4);
+    mp4 += bigEndian(24, 4) + "mdat" + std::string(16, '\x11');
+    mp4 += bigEndian(8 + 16 + mvhd.size(), 4) + "moov" + bigEndian(16, 4) + "udta" + std::string(8, '\0') + mvhd;
+
+    CacheFixture fixture("duration");
+    const fs::path& dir = fixture.dir();
+    fs::path media = dir / "cache" / "media";
+    fs::create_directories(media);
+    fs::path mp3Path = media / "clip.mp3";
+    fs::path mp4Path = media / "clip.mp4";
+    fs::path scratchPath = dir / "scratch.mp4";  // in the temp dir, outside the cache root
+    std::ofstream(mp3Path, std::ios::binary) << mp3;
+    std::ofstream(mp4Path, std::ios::binary) << mp4;
+    std::ofstream(scratchPath, std::ios::binary) << mp4;
+    auto recordedFiles = [](const fs::path& manifestFile) {
+        std::set<std::string> names;
+        std::ifstream in(manifestFile);
+        json manifest = json::parse(in);
+        for (const auto& [key, entry] : manifest["entries"].items()) names.insert(fs::path(key).filename().string());
+        return names;
+    };
+
+    auto mp4Seconds = Audio::headerDuration(mp4Path);
+    assert(mp4Seconds && std::fabs(*mp4Seconds - 7.5) < 1e-9);
+    assert(Audio::headerDuration(mp3Path));
+
+    fs::path manifestPath = dir / "durations.json";
+    {
+        Audio::DurationManifest manifest(manifestPath);
+        auto seconds = manifest.durations({mp3Path, mp4Path, dir / "missing.mp3", scratchPath}, 2);
+        assert(std::fabs(seconds[0] - *fromTag) < 1e-9);
+        assert(std::fabs(seconds[1] - 7.5) < 1e-9);
+        assert(seconds[2] == 0.0);
+        assert(std::fabs(seconds[3] - 7.5) < 1e-9);
+    }
+    // Per-run temp files are probed but not recorded
+    assert((recordedFiles(manifestPath) == std::set<std::string>{"clip.mp3", "clip.mp4"}));
+
+    // Entries are served from disk and dropped once the file changes
+    Audio::DurationManifest reloaded(manifestPath);
+    assert(std::fabs(reloaded.duration(mp4Path) - 7.5) < 1e-9);
+    std::ofstream(mp3Path, std::ios::binary) << cbr;
+    assert(std::fabs(reloaded.duration(mp3Path) - cbr.size() * 8 / 128000.0) < 1e-9);
+
+    // Deleted files leave the manifest on the next flush
+    fs::remove(mp4Path);
+    reloaded.flush();
+    assert((recordedFiles(manifestPath) == std::set<std::string>{"clip.mp3"}));
+}
+
+void testRenderCache() {
+    CacheFixture fixture("render_cache");
+    const fs::path& dir = fixture.dir();
+    fs::create_directories(dir / "out");
+
+    CLIOptions opts;
+    opts.surah = 1;
+    opts.from = 1;
+    opts.to = 1;
+    opts.output = (dir / "out" / "render.mp4").string();
+    AppConfig cfg = CacheFixture::config(opts);
+    std::vector<VerseData> verses = {makeSampleVerse()};
+    verses[0].localAudioPath = (dir / "verse.mp3").string();
+    std::ofstream(verses[0].localAudioPath, std::ios::binary) << "first take";
+
+    std::string fingerprint = RenderCache::fingerprint(RenderCache::describeInputs(opts, cfg, verses, nullptr));
+    assert(fingerprint.size() == 64);
+    assert(RenderCache::fingerprint(RenderCache::describeInputs(opts, cfg, verses, nullptr)) == fingerprint);
+
+    AppConfig tweaked = cfg;
+    tweaked.crf += 1;
+    assert(RenderCache::fingerprint(RenderCache::describeInputs(opts, tweaked, verses, nullptr)) != fingerprint);
+
+    // Soft translations change the picture and add a sidecar per track
+    CLIOptions soft = opts;
+    soft.softTranslations = {cfg.translationId};
+    assert(RenderCache::fingerprint(RenderCache::describeInputs(soft, cfg, verses, nullptr)) != fingerprint);
+    assert(RenderCache::outputsFor(soft).textTracks.size() == 1);
+
+    // The output path is not an input, but the audio content is
+    CLIOptions renamed = opts;
+    renamed.output = (dir / "elsewhere.mp4").string();
+    assert(RenderCache::fingerprint(RenderCache::describeInputs(renamed, cfg, verses, nullptr)) == fingerprint);
+    std::ofstream(verses[0].localAudioPath, std::ios::binary) << "second, longer take";
+    assert(RenderCache::fingerprint(RenderCache::describeInputs(opts, cfg, verses, nullptr)) != fingerprint);
+
+    CLIOptions clipped = opts;
+    clipped.clipLibrary = true;
+    assert(RenderCache::fingerprint(RenderCache::describeInputs(clipped, cfg, verses, nullptr)) != fingerprint);
+
+    // The intro card is written from the localization tables
+    fs::path previousDataRoot = CacheUtils::getDataRoot();
+    fs::create_directories(dir / "data" / "misc");
+    CacheUtils::setDataRoot(dir / "data");
+    std::ofstream(dir / "data" / "misc" / "numbers.json") << R"({"en": {"1": "1"}})";
+    std::string localized = RenderCache::fingerprint(RenderCache::describeInputs(opts, cfg, verses, nullptr));
+    std::ofstream(dir / "data" / "misc" / "numbers.json") << R"({"en": {"1": "one"}})";
+    assert(RenderCache::fingerprint(RenderCache::describeInputs(opts, cfg, verses, nullptr)) != localized);
+    CacheUtils::setDataRoot(previousDataRoot);
+
+    auto outputs = RenderCache::outputsFor(opts);
+    assert(outputs.thumbnail == dir / "out" / "thumbnail.jpeg");
+    assert(!RenderCache::restore(fingerprint, outputs));
+    std::ofstream(outputs.video, std::ios::binary) << "rendered video";
+    std::ofstream(outputs.thumbnail, std::ios::binary) << "thumbnail";
+    std::ofstream(outputs.metadata) << "{}";
+    RenderCache::store(fingerprint, outputs);
+    assert(fs::exists(RenderCache::entryDirectory(fingerprint) / "metadata.json"));
+
+    fs::remove(outputs.video);
+    fs::remove(outputs.thumbnail);
+    assert(RenderCache::restore(fingerprint, outputs));
+    std::ifstream restored(outputs.video, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(restored)), std::istreambuf_iterator<char>());
+    assert(contents == "rendered video");
+    assert(fs::exists(outputs.thumbnail));
+
+    // Re-rendering over a restored output must not touch the stored copy
+    RenderCache::detachOutputs(outputs);
+    std::ofstream(outputs.video, std::ios::binary) << "different render";
+    assert(fs::file_size(RenderCache::entryDirectory(fingerprint) / "video.mp4") == contents.size());
+}
+
+void testClipLibraryKeys() {
+    CacheFixture fixture("clip_library");
+
+    CLIOptions opts;
+    opts.surah = 1;
+    opts.from = 1;
+    opts.to = 2;
+    AppConfig cfg = CacheFixture::config(opts);
+    cfg.recitationMode = RecitationMode::GAPLESS;
+    cfg.fps = 30;
+
+    auto verseAt = [](int ayah, int fromMs, int toMs) {
+        VerseData verse = makeSampleVerse();
+        verse.verseKey = "1:" + std::to_string(ayah);
+        verse.timestampFromMs = fromMs;
+        verse.timestampToMs = toMs;
+        verse.durationInSeconds = (toMs - fromMs) / 1000.0;
+        return verse;
+    };
+    std::vector<VerseData> first = {verseAt(1, 0, 1510), verseAt(2, 1510, 3000)};
+    CLIOptions later = opts;
+    later.from = 2;
+    later.to = 3;
+    std::vector<VerseData> second = {verseAt(2, 1510, 3000), verseAt(3, 3000, 4200)};
+
+    auto a = ClipLibrary::planClips(opts, cfg, first, 2.0);
+    auto b = ClipLibrary::planClips(later, cfg, second, 2.0);
+    bool hasIntro = cfg.introDuration + cfg.pauseAfterIntroDuration > 0.0;
+    size_t offset = hasIntro ? 1 : 0;
+    assert(a.size() == offset + 2 && b.size() == offset + 2);
+
+    // The shared verse maps to the same clip in both ranges; the intro card does not
+    assert(a[offset + 1].key == b[offset].key);
+    assert(a[offset + 1].path == b[offset].path);
+    assert(a[offset].key != b[offset + 1].key);
+    if (hasIntro) assert(a[0].key != b[0].key && a[0].verseIndex == -1);
+
+    // Each clip is rounded on its own, and the background follows the surah timeline
+    assert(a[offset].frameCount == 45 && a[offset + 1].frameCount == 45);
+    assert(std::abs(a[offset + 1].backgroundSeekSeconds - 1.51) < 1e-9);
+    assert(std::abs(b[offset + 1].backgroundSeekSeconds - 1.0) < 1e-9);
+
+    AppConfig restyled = cfg;
+    restyled.overlayColor = "black@0.5";
+    assert(ClipLibrary::planClips(opts, restyled, first, 2.0)[offset].key != a[offset].key);
+    assert(!ClipLibrary::isStored(a[offset]));
+
+    // Over a long range the recitation, pinned to the clip grid, ends with the
+    // last clip; a verse shorter than a frame keeps a clip and its slot
+    std::vector<VerseData> many;
+    int fromMs = 0;
+    for (int ayah = 1; ayah <= 200; ++ayah) {
+        int lengthMs = ayah == 7 ? 10 : 1017 + (ayah * 37) % 1000;
+        many.push_back(verseAt(ayah, fromMs, fromMs + lengthMs));
+        fromMs += lengthMs;
+    }
+    auto clips = ClipLibrary::planClips(opts, cfg, many, 2.0);
+    assert(clips.size() == offset + many.size());
+    auto timeline = ClipLibrary::clipTimeline(clips, many, 30.0);
+    double audioSeconds = ClipLibrary::clipLeadIn(clips, 30.0);
+    long long frames = 0;
+    for (size_t i = 0; i < clips.size(); ++i) {
+        frames += clips[i].frameCount;
+        if (clips[i].verseIndex < 0) continue;
+        assert(clips[i].verseIndex == static_cast<int>(i - offset));
+        const double slot = timeline[clips[i].verseIndex].durationInSeconds;
+        assert(clips[i].frameCount >= 1);
+        assert(std::abs(slot - many[clips[i].verseIndex].durationInSeconds) <= 1.0 / 30.0);
+        audioSeconds += slot;
+        // Each verse's recitation ends on the frame its clip ends on
+        assert(std::abs(audioSeconds - frames / 30.0) < 1e-6);
+    }
+    assert(timeline[6].durationInSeconds > 0.0);
+}
+
+void testBatchJobArguments() {
+    auto job = nlohmann::json::parse(R"({
+        "id": "baqarah-opening", "surah": 2, "from": 1, "to": 5, "reciter": 7,
+        "no-growth": true, "progress": false, "o": "out/opening.mp4", "args": ["--crf", "20"],
+        "extra-output": "1080x1920@24=out/short.mp4,1080x1080=out/square.mp4"
+    })");
+    std::vector<std::string> args = {"qvm", "--no-cache", "--crf=18"};
+    for (const auto& arg : BatchRunner::jobArguments(job)) args.push_back(arg);
+    assert(std::find(args.begin(), args.end(), "--progress=false") != args.end());
+
+    std::vector<const char*> argv;
+    for (const auto& arg : args) argv.push_back(arg.c_str());
+    auto parser = CommandLine::buildParser();
+    auto parsed = parser.parse(static_cast<int>(argv.size()), argv.data());
+    CLIOptions options = CommandLine::toOptions(parsed);
+    assert(options.surah == 2 && options.from == 1 && options.to == 5);
+    assert(options.reciterId == 7);
+    assert(options.output == "out/opening.mp4");
+    assert(!options.enableTextGrowth);
+    assert(!options.emitProgress);
+    assert(options.noCache);          // batch-wide flag
+    assert(options.customCRF == 20);  // the job's own value wins
+    assert(options.extraOutputs.size() == 2);
+    assert(options.extraOutputs[0].width == 1080 && options.extraOutputs[0].height == 1920);
+    assert(options.extraOutputs[0].fps == 24 && options.extraOutputs[0].path == "out/short.mp4");
+    assert(options.extraOutputs[1].fps == 0 && options.extraOutputs[1].path == "out/square.mp4");
+    assert(options.softTranslations.empty() && options.burnArabic);
+    for (const char* spec : {"1080x1920", "1080x=a.mp4", "1080x1920@=a.mp4", "1081x1920=a.mp4", "1080x1920x3=a.mp4"}) {
+        bool malformed = false;
+        try {
+            CommandLine::parseOutputProfile(spec);
+        } catch (const std::invalid_argument&) {
+            malformed = true;
+        }
+        assert(malformed);
+    }
+
+    bool rejected = false;
+    try {
+        BatchRunner::jobArguments(nlohmann::json::array({"--surah", "2"}));
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    // Without its own output a job renders into a directory named after it
+    auto unnamed = BatchRunner::parseJob(nlohmann::json::parse(R"({"id": "fatiha", "surah": 1, "from": 1, "to": 7})"),
+                                         {}, "line-1");
+    assert(unnamed.id == "fatiha");
+    assert(fs::path(unnamed.options.output).parent_path().filename() == "fatiha");
+}
+
+void testProgressEvents() {
+    assert(Progress::format("encoding", "running", 37.5, 12.4, -1.0, "Encoding in progress") ==
+           R"(PROGRESS {"stage":"encoding","status":"running","percent":37.50,"elapsedSeconds":12.40,"message":"Encoding in progress"})");
+    assert(Progress::format("subtitles", "completed") == R"(PROGRESS {"stage":"subtitles","status":"completed"})");
+
+    std::vector<std::string> lines;
+    Progress::Sink sink = [&lines](const std::string& line) { lines.push_back(line); };
+#if !defined(_WIN32)
+    // ffmpeg's -progress output, parsed from a stand-in command
+    SystemProcessExecutor executor(sink);
+    executor.executeWithProgress("printf 'out_time_ms=1000000\\nprogress=continue\\nout_time_ms=4000000\\nprogress=end\\n'", 4.0);
+    assert(lines.size() == 3);
+    assert(lines[1].find("\"percent\":25.00") != std::string::npos);
+    assert(lines[2].find("\"status\":\"completed\"") != std::string::npos);
+
+    // A raised cancel flag stops the command instead of waiting for it
+    auto cancel = std::make_shared<std::atomic<bool>>(true);
+    SystemProcessExecutor cancelled(sink, cancel);
+    bool threw = false;
+    try {
+        cancelled.execute("sleep 5");
+    } catch (const Render::Cancelled&) {
+        threw = true;
+    }
+    assert(threw);
+
+#if defined(__linux__)
+    // A command sees no descriptor of a concurrent job (its pipe would not
+    // reach EOF while this one runs): it reports its open descriptors as
+    // out_time_ms, read back as percent of a 100 s encode
+    auto openDescriptors = []() {
+        std::string last;
+        SystemProcessExecutor probe([&last](const std::string& line) { last = line; });
+        probe.executeWithProgress("printf 'out_time_ms=%d000000\\nprogress=end\\n' $(ls /proc/self/fd | wc -l)", 100.0);
+        size_t percent = last.find("\"percent\":");
+        return last.substr(percent, last.find(',', percent) - percent);
+    };
+    const std::string alone = openDescriptors();
+    auto stopLong = std::make_shared<std::atomic<bool>>(false);
+    SystemProcessExecutor longJob([](const std::string&) {}, stopLong);
+    auto longDone = std::async(std::launch::async, [&]() {
+        try {
+            longJob.execute("sleep 5");
+        } catch (const Render::Cancelled&) {
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    assert(openDescriptors() == alone);
+    *stopLong = true;
+    longDone.get();
+#endif
+#else
+    Progress::emit(sink, "encoding", "running");
+    assert(lines.size() == 1);
+#endif
+}
+
+void testParallelForEach() {
+    // Every item runs once, and progress counts up one call at a time
+    std::vector<int> hits(100, 0);
+    std::vector<size_t> reported;
+    Parallel::forEach(hits.size(), 4, [&](size_t i) { ++hits[i]; },
+                      [&](size_t finished) { reported.push_back(finished); });
+    assert(std::all_of(hits.begin(), hits.end(), [](int hit) { return hit == 1; }));
+    assert(reported.size() == hits.size() && reported.back() == hits.size());
+    assert(std::is_sorted(reported.begin(), reported.end()));
+
+    // The first failure stops the items not yet started and is rethrown
+    size_t started = 0;
+    bool threw = false;
+    try {
+        Parallel::forEach(1000, 1, [&](size_t i) {
+            ++started;
+            if (i == 3) throw std::runtime_error("item 3");
+        });
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()) == "item 3";
+    }
+    assert(threw && started == 4);
+    threw = false;
+    try {
+        Parallel::forEach(hits.size(), 4, [](size_t i) {
+            if (i % 10 == 0) throw std::runtime_error("item " + std::to_string(i));
+        });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // Per-thread state is made once on each worker
+    std::atomic<int> made{0};
+    std::atomic<size_t> done{0};
+    Parallel::forEachWithState(50, 3, [&]() -> Parallel::Work {
+        ++made;
+        return [&](size_t) { ++done; };
+    });
+    assert(made <= 3 && done == 50);
+    Parallel::forEach(0, 4, [](size_t) { assert(false); });
+}
+
+void testResourceGovernor() {
+    assert((Resources::parseCpuList("0-3,8,10-11") == std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    assert(Resources::parseCpuList("").empty());
+    assert(Resources::parseCpuMax("max 100000") == 0.0);
+    assert(Resources::parseCpuMax("250000 100000") == 2.5);
+
+    Resources::HostInfo host;
+    host.logicalCpus = 8;
+    host.allowedCpus = {0, 1, 2, 3, 4, 5, 6, 7};
+    host.numaNodes = {{0, {0, 1, 2, 3}}, {1, {4, 5, 6, 7}}};
+    host.physicalMemoryBytes = 16ull << 30;
+    host.cgroupMemoryLimitBytes = 8ull << 30;
+    assert(host.usableCpus() == 8);
+    assert(host.usableMemoryBytes() == (8ull << 30));
+
+    // Two pinned renders get one NUMA node each
+    Resources::Governor::Settings settings;
+    settings.concurrentRenders = 2;
+    settings.pinCores = true;
+    ResourceBudget first = Resources::Governor::budgetFor(host, settings, 0);
+    ResourceBudget second = Resources::Governor::budgetFor(host, settings, 1);
+    assert(first.cpus == 4 && first.encoderThreads == 4 && first.filterThreads == 2);
+    assert((first.coreSet == std::vector<int>{0, 1, 2, 3}) && first.numaNode == 0);
+    assert((second.coreSet == std::vector<int>{4, 5, 6, 7}) && second.numaNode == 1);
+    assert(first.memoryBytes == (4ull << 30));
+
+    // The kernel's node numbers are reported, not positions in the list
+    Resources::HostInfo sparse = host;
+    sparse.numaNodes = {{0, {0, 1, 2, 3}}, {2, {4, 5, 6, 7}}};
+    assert(Resources::Governor::budgetFor(sparse, settings, 1).numaNode == 2);
+    sparse.numaNodes = {{-1, sparse.allowedCpus}};
+    assert(Resources::Governor::budgetFor(sparse, settings, 1).numaNode == -1);
+
+    // A cgroup quota caps the cores, and leftovers go to the first renders
+    host.cgroupCpuQuota = 6.5;
+    settings.concurrentRenders = 3;
+    settings.pinCores = false;
+    assert(Resources::Governor::budgetFor(host, settings, 0).cpus == 3);
+    assert(Resources::Governor::budgetFor(host, settings, 2).cpus == 2);
+    assert(Resources::Governor::budgetFor(host, settings, 2).coreSet.empty());
+
+    ResourceBudget budget;
+    budget.memoryBytes = 1ull << 30;
+    assert(Resources::parallelEncodes(budget, 1920, 1080) == 3);
+    budget.memoryBytes = 0;
+    assert(Resources::parallelEncodes(budget, 1920, 1080) > 64);
+
+    // Concurrent leases take distinct slots, released slots are reused
+    Resources::Governor governor;
+    settings = {0, 2, false};
+    governor.configure(settings);
+    int slot0 = Resources::Governor::budgetFor(governor.host(), settings, 0).cpus;
+    int slot1 = Resources::Governor::budgetFor(governor.host(), settings, 1).cpus;
+    {
+        auto a = governor.acquire();
+        auto b = governor.acquire();
+        assert(a.budget().cpus == slot0 && b.budget().cpus == slot1);
+    }
+    auto again = governor.acquire();
+    assert(again.budget().cpus == slot0);
+}
+
+void testBackgroundPlateKeys() {
+    CacheFixture fixture("background_plate");
+    const fs::path& dir = fixture.dir();
+
+    AppConfig cfg{};
+    cfg.assetBgVideo = (dir / "background.mp4").string();
+    cfg.width = 1280;
+    cfg.height = 720;
+    cfg.fps = 30;
+    cfg.pixelFormat = "yuv420p";
+    cfg.overlayColor = "black@0.3";
+    std::ofstream(cfg.assetBgVideo, std::ios::binary) << "first cut";
+
+    assert(BackgroundPlate::overlayFilter(cfg) == ",drawbox=x=0:y=0:w=iw:h=ih:color=black@0.3:t=fill");
+    std::string key = BackgroundPlate::plateKey(cfg);
+    assert(key.size() == 64 && BackgroundPlate::plateKey(cfg) == key);
+    assert(BackgroundPlate::platePath(key) == dir / "cache" / "plates" / key.substr(0, 2) / (key + ".mp4"));
+
+    // Everything baked into the plate is part of its key
+    auto keyWith = [&](auto change) {
+        AppConfig changed = cfg;
+        change(changed);
+        return BackgroundPlate::plateKey(changed);
+    };
+    assert(keyWith([](AppConfig& c) { c.width = 1920; }) != key);
+    assert(keyWith([](AppConfig& c) { c.fps = 60; }) != key);
+    assert(keyWith([](AppConfig& c) { c.pixelFormat = "yuv420p10le"; }) != key);
+    assert(keyWith([](AppConfig& c) { c.overlayColor = "black@0.5"; }) != key);
+    // ...but a transparent overlay draws nothing, whatever its colour
+    assert(keyWith([](AppConfig& c) { c.overlayColor = "black@0"; }) == keyWith([](AppConfig& c) { c.overlayColor = "white@0.0"; }));
+    assert(keyWith([](AppConfig& c) { c.overlayColor = "white@0.0"; }) != key);
+
+    std::ofstream(cfg.assetBgVideo, std::ios::binary) << "second, longer cut";
+    assert(BackgroundPlate::plateKey(cfg) != key);
+
+    bool threw = false;
+    try {
+        keyWith([&](AppConfig& c) { c.assetBgVideo = (dir / "missing.mp4").string(); });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void testBackgroundPrefetch() {
+    CacheFixture fixture("background_prefetch");
+    const fs::path& dir = fixture.dir();
+
+    // The walk reaches every uncached video once, in order; cached videos
+    // advance it by their length and unreadable ones are skipped
+    std::ofstream(dir / "themes.json") << "{}";
+    VideoSelector::Selector selector((dir / "themes.json").string());
+    std::vector<VideoSelector::VerseRangeSegment> ranges = {
+        {1, 5, {"t"}, 0.0, 0.5, "A"},
+        {6, 9, {"t"}, 0.5, 1.0, "B"},
+    };
+    VideoSelector::SelectionState state;
+    state.rangePlaylists["A"] = {{"t", "a1"}, {"t", "a2"}};
+    state.rangePlaylists["B"] = {{"t", "b1"}, {"t", "a1"}, {"t", "b0"}, {"t", "b2"}};
+    std::map<std::string, double> cached = {{"a2", 6.0}, {"b0", 0.0}};
+    auto cachedDuration = [&](const std::string& key) {
+        auto it = cached.find(key);
+        return it == cached.end() ? -1.0 : it->second;
+    };
+    auto planned = BackgroundVideo::planDownloads(selector, ranges, {{"A", 20.0}, {"B", 40.0}}, 40.0, state,
+                                                  cachedDuration, 5.0);
+    assert((planned == std::vector<std::string>{"a1", "b1", "b2"}));
+    assert(state.rangePlaylistIndices.empty());  // the walk ran on a copy
+
+    // A failed download is reported and leaves nothing in the cache
+    AppConfig cfg{};
+    CLIOptions opts;
+    BackgroundVideo::Manager manager(cfg, opts);
+    auto failed = manager.prefetchVideos({"t/a.mp4", "t/b.mp4"}, [](const std::string& key, const fs::path& destination) {
+        std::ofstream(destination, std::ios::binary) << "partial";
+        if (key == "t/b.mp4") throw std::runtime_error("connection reset");
+    });
+    assert((failed == std::vector<std::string>{"t/b.mp4"}));
+    fs::path backgrounds = dir / "cache" / "backgrounds";
+    assert(fs::exists(backgrounds / "t_a.mp4"));
+    for (const auto& entry : fs::directory_iterator(backgrounds)) {
+        assert(entry.path().filename().string().rfind("t_b.mp4", 0) != 0);
+    }
+    manager.cleanup();
+}
+
+void testSubtitleSprites() {
+    CacheFixture fixture("subtitle_sprites");
+    const fs::path& dir = fixture.dir();
+
+    CLIOptions opts;
+    opts.surah = 1;
+    opts.from = 1;
+    opts.to = 1;
+    AppConfig cfg = CacheFixture::config(opts);
+    VerseData verse = makeSampleVerse();
+    verse.durationInSeconds = 2.0;
+    auto cues = SubtitleBuilder::buildCues(cfg, opts, {verse}, cfg.introDuration, cfg.pauseAfterIntroDuration);
+    assert(cues.size() == 3);
+
+    // The script keeps its animation; the sprite text is the still final frame
+    const auto& cue = cues.back();
+    assert(SubtitleBuilder::dialogueLine(cue).rfind("Dialogue: 0,", 0) == 0);
+    assert(cue.text.find("\\fad(") != std::string::npos);
+    assert(cue.staticText.find("\\fad(") == std::string::npos && cue.staticText.find("\\t(") == std::string::npos);
+    assert(cue.fadeInSeconds > 0.0 && cue.anchorX == cfg.width / 2);
+    assert(std::abs(SubtitleBuilder::scriptTime(4.239) - 4.23) < 1e-9);
+
+    std::string key = SubtitleSprites::spriteKey(cfg, cue.staticText);
+    assert(key == SubtitleSprites::spriteKey(cfg, cue.staticText));
+    assert(key != SubtitleSprites::spriteKey(cfg, cues.front().staticText));
+    assert(SubtitleSprites::spritePath(key).extension() == ".sprite");
+
+    Render::SpriteCue timing;
+    timing.start = 10.0;
+    timing.end = 14.0;
+    timing.fadeInSeconds = 1.0;
+    timing.fadeOutSeconds = 1.0;
+    timing.growthFactor = 1.5;
+    assert(Render::cueOpacity(timing, 9.9) == 0.0 && Render::cueOpacity(timing, 14.0) == 0.0);
+    assert(std::abs(Render::cueOpacity(timing, 10.5) - 0.5) < 1e-9 && Render::cueOpacity(timing, 12.0) == 1.0);
+    assert(std::abs(Render::cueScale(timing, 10.0) - 1.0 / 1.5) < 1e-9 && Render::cueScale(timing, 14.0) == 1.0);
+
+    // An opaque white 2x2 sprite on a black limited-range yuv420p frame
+    Render::Sprite sprite;
+    sprite.x = 2;
+    sprite.y = 2;
+    sprite.width = 2;
+    sprite.height = 2;
+    sprite.rgba.assign(16, 255);
+    Render::saveSprite(sprite, dir / "white.sprite");
+    Render::Sprite loaded = Render::loadSprite(dir / "white.sprite");
+    assert(loaded.x == 2 && loaded.width == 2 && loaded.rgba == sprite.rgba);
+
+    AVFrame* frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = 8;
+    frame->height = 8;
+    assert(av_frame_get_buffer(frame, 0) == 0);
+    auto fill = [&]() {
+        for (int y = 0; y < 8; ++y) std::fill_n(frame->data[0] + y * frame->linesize[0], 8, 16);
+        for (int p = 1; p < 3; ++p) {
+            for (int y = 0; y < 4; ++y) std::fill_n(frame->data[p] + y * frame->linesize[p], 4, 128);
+        }
+    };
+    fill();
+    auto stamp = Render::SpriteCompositor::makeStamp(loaded, 1.0, 0.0, 0.0, *frame);
+    Render::SpriteCompositor::blendStamp(stamp, 1.0, frame);
+    assert(frame->data[0][2 * frame->linesize[0] + 2] == 235 && frame->data[0][3 * frame->linesize[0] + 3] == 235);
+    assert(frame->data[0][1 * frame->linesize[0] + 1] == 16 && frame->data[0][4 * frame->linesize[0] + 4] == 16);
+    assert(frame->data[1][frame->linesize[1] + 1] == 128);
+    fill();
+    Render::SpriteCompositor::blendStamp(stamp, 0.5, frame);
+    int half = frame->data[0][2 * frame->linesize[0] + 2];
+    assert(half >= 125 && half <= 127);
+
+    // Growth scales the sprite around the cue's anchor
+    auto grown = Render::SpriteCompositor::makeStamp(loaded, 0.5, 2.0, 2.0, *frame);
+    assert(grown.x == 2 && grown.y == 2 && grown.width == 1 && grown.height == 1);
+    av_frame_free(&frame);
+
+    // Every blend kernel the CPU has gives the scalar result, tails included
+    std::vector<std::uint16_t> values(67);
+    std::vector<std::uint8_t> alphas(67), background(67);
+    for (size_t i = 0; i < values.size(); ++i) {
+        alphas[i] = static_cast<std::uint8_t>((i * 37) % 256);
+        values[i] = static_cast<std::uint16_t>(alphas[i] * ((i * 11) % 256) / 255);
+        background[i] = static_cast<std::uint8_t>((i * 73 + 5) % 256);
+    }
+    for (unsigned level : {0u, 1u, 128u, 255u}) {
+        std::vector<std::uint8_t> expected = background;
+        Render::blendRow8(Render::BlendKernel::Scalar, expected.data(), values.data(), alphas.data(), 67, level);
+        for (auto kernel : Render::supportedBlendKernels()) {
+            for (int count : {67, 16, 7}) {
+                std::vector<std::uint8_t> row = background;
+                Render::blendRow8(kernel, row.data(), values.data(), alphas.data(), count, level);
+                assert(std::equal(row.begin(), row.begin() + count, expected.begin()));
+                assert(std::equal(row.begin() + count, row.end(), background.begin() + count));
+            }
+        }
+    }
+}
+
+void testVerseClips() {
+    CacheFixture fixture("verse_clips");
+    CLIOptions opts;
+    opts.surah = 1;
+    opts.from = 1;
+    opts.to = 3;
+    AppConfig cfg = CacheFixture::config(opts);
+    cfg.fps = 30;
+    cfg.introDuration = 2.0;
+    cfg.pauseAfterIntroDuration = 0.5;
+    std::vector<VerseData> verses(3, makeSampleVerse());
+    verses[1].verseKey = "1:2";
+    verses[1].durationInSeconds = 0.01;  // shorter than a frame: no clip of its own
+    verses[2].verseKey = "1:3";
+    verses[2].durationInSeconds = 2.0;
+
+    auto clips = VerseClips::planClips(cfg, verses, 6.01);
+    assert(clips.size() == 3);
+    assert(clips[0].verseKey.empty() && clips[0].file == "intro.mp4");
+    assert(clips[1].file == "1_1.mp4" && std::abs(clips[1].startSeconds - 2.5) < 1e-9);
+    assert(std::abs(clips[1].endSeconds - 4.0) < 1e-9);
+    assert(clips[2].file == "1_3.mp4" && std::abs(clips[2].startSeconds - 4.0) < 1e-9);
+    assert(std::abs(clips[2].endSeconds - 6.0) < 1e-9);
+    assert(VerseClips::cutTimes(clips).size() == 2);
+
+    std::string target = VerseClips::teeTarget("out/render.mp4", "out/clips", clips);
+    assert(target.rfind("[f=mp4:movflags=+faststart]out/render.mp4|[f=segment:", 0) == 0);
+    assert(target.find("segment_times=2.500000,4.000000]out/clips/.segment-%03d.mp4") != std::string::npos);
+    // Characters the tee muxer splits on are escaped in both paths
+    target = VerseClips::teeTarget("out/a|b [1].mp4", "out/c:d", clips);
+    assert(target.rfind("[f=mp4:movflags=+faststart]out/a\\|b \\[1\\].mp4|[f=segment:", 0) == 0);
+    assert(target.find("]out/c\\:d/.segment-%03d.mp4") != std::string::npos);
+
+    // The same cuts are the chapters, in milliseconds
+    std::string chapters = VerseClips::chapterMetadata(clips);
+    assert(chapters.rfind(";FFMETADATA1\n", 0) == 0);
+    assert(chapters.find("START=0\nEND=2500\ntitle=Intro\n") != std::string::npos);
+    assert(chapters.find("START=4000\nEND=6000\ntitle=1:3\n") != std::string::npos);
+
+    // Segments are renamed after their verses and listed in the manifest
+    const fs::path& dir = fixture.dir();
+    for (const char* name : {".segment-000.mp4", ".segment-001.mp4", ".segment-002.mp4"}) {
+        std::ofstream(dir / name, std::ios::binary) << "clip";
+    }
+    opts.output = "out/render.mp4";
+    VerseClips::finalize(dir, opts, clips);
+    assert(fs::exists(dir / "intro.mp4") && fs::exists(dir / "1_1.mp4") && fs::exists(dir / "1_3.mp4"));
+    std::ifstream in(dir / "manifest.json");
+    json manifest = json::parse(in);
+    assert(manifest["clips"].size() == 3);
+    assert(manifest["clips"][2]["verse"] == "1:3");
+    assert(manifest["video"] == "render.mp4");
+
+    // The clips come out of the same encode through a tee of the segment muxer
+    RenderFixture render("test_video_clips");
+    render.opts.verseClipsDir = (dir / "render_clips").string();
+    auto clipsExecutor = std::make_shared<MockProcessExecutor>();
+    VideoGenerator::generateVideo(render.opts, render.cfg, render.verses, clipsExecutor);
+    const auto& clipsCommands = clipsExecutor->getCommands();
+    assert(clipsCommands.size() == 1);
+    assert(clipsCommands[0].find("-force_key_frames ") != std::string::npos);
+    assert(clipsCommands[0].find("-flags +global_header") != std::string::npos);
+    assert(clipsCommands[0].find("-f tee ") != std::string::npos);
+    assert(clipsCommands[0].find("[f=segment:") != std::string::npos);
+    assert(clipsCommands[0].find("-movflags") == std::string::npos);
+    assert(clipsCommands[0].find("-map_chapters ") == std::string::npos);
+}
+
 void testCustomAudioPlan() {
     CLIOptions opts;
     opts.customAudioPath = "custom.mp3";
@@ -167,6 +1359,102 @@ void testCustomAudioPlan() {
     assert(plan.mainEndMs == 82000);
 }
 
+void testBuildCommand() {
+    // Looped background and a concat list of recitations, filtered and encoded
+    Render::RenderPlan looped;
+    looped.inputs.push_back({"bg.mp4", "", {}, true, -1.0, -1.0, 0.0});
+    looped.inputs.push_back({"list.txt", "concat", {{"safe", "0"}}, false, -1.0, -1.0, 1.5});
+    looped.filterComplex = "[0:v]scale=64:48[v]";
+    Render::OutputSpec encoded;
+    encoded.path = "out.mp4";
+    encoded.maps = {"[v]", "1:a"};
+    encoded.durationSeconds = 10.0;
+    encoded.encoder.preset = "veryfast";
+    encoded.encoder.crf = 23;
+    encoded.encoder.closedGop = true;
+    encoded.encoder.keyframeTimes = {1.5, 3.0};
+    looped.outputs.push_back(encoded);
+    assert(Render::buildCommand(looped) ==
+           "ffmpeg -y -stream_loop -1 -i \"bg.mp4\" -itsoffset 1.5 -f concat -safe 0 -i \"list.txt\" "
+           "-filter_complex \"[0:v]scale=64:48[v]\" -map \"[v]\" -map 1:a -t 10 -c:v libx264 -preset veryfast "
+           "-crf 23 -flags +cgop -force_key_frames 1.500000,3.000000 -c:a aac -b:a 128k -pix_fmt yuv420p "
+           "-movflags +faststart \"out.mp4\"");
+
+    // Stream copy of joined chunks next to lavfi silence, through the tee muxer
+    Render::RenderPlan copied;
+    copied.emitProgress = true;
+    copied.filterThreads = 2;
+    copied.inputs.push_back({"chunks.txt", "concat", {{"safe", "0"}}, false, -1.0, -1.0, 0.0});
+    copied.inputs.push_back({"anullsrc=r=44100:cl=stereo", "lavfi", {}, false, -1.0, 3.0, 0.0});
+    Render::OutputSpec teed;
+    teed.path = "[f=mp4]a.mp4|[f=segment]b_%03d.mp4";
+    teed.format = "tee";
+    teed.maps = {"0:v", "1:a"};
+    teed.fastStart = false;
+    teed.encoder.videoCodec = "copy";
+    teed.encoder.audioCodec = "copy";
+    teed.encoder.globalHeader = true;  // ignored when copying
+    copied.outputs.push_back(teed);
+    Render::OutputSpec silent = teed;
+    silent.path = "silent.mp4";
+    silent.format.clear();
+    silent.maps = {"0:v"};
+    silent.encoder.audioCodec.clear();
+    copied.outputs.push_back(silent);
+    assert(Render::buildCommand(copied) ==
+           "ffmpeg -progress pipe:1 -nostats -loglevel warning -y -filter_complex_threads 2 "
+           "-f concat -safe 0 -i \"chunks.txt\" -f lavfi -t 3 -i anullsrc=r=44100:cl=stereo "
+           "-map 0:v -map 1:a -c:v copy -c:a copy -f tee \"[f=mp4]a.mp4|[f=segment]b_%03d.mp4\" "
+           "-map 0:v -c:v copy -an \"silent.mp4\"");
+}
+
+void testLibavCopyWithFilteredAudio() {
+    CacheFixture fixture("libav_copy");
+    const fs::path& dir = fixture.dir();
+    std::string video = (dir / "video.mp4").string();
+    std::string output = (dir / "joined.mp4").string();
+
+    Render::RenderPlan encode;
+    encode.inputs.push_back({"testsrc=size=64x48:rate=10", "lavfi", {}, false, -1.0, 2.0, 0.0});
+    encode.filterComplex = "[0:v]null[v]";
+    Render::OutputSpec encoded;
+    encoded.path = video;
+    encoded.maps = {"[v]"};
+    encoded.encoder.videoCodec = "mpeg4";
+    encoded.encoder.audioCodec.clear();
+    encode.outputs.push_back(encoded);
+    Render::LibavEngine().run(encode);
+
+    // A copied video next to a filtered audio track, as in the chunk join
+    Render::RenderPlan join;
+    join.inputs.push_back({video, "", {}, false, -1.0, -1.0, 0.0});
+    join.inputs.push_back({"sine=frequency=440", "lavfi", {}, false, -1.0, 2.0, 0.0});
+    join.filterComplex = "[1:a]volume=0.5[a]";
+    Render::OutputSpec joined;
+    joined.path = output;
+    joined.maps = {"0:v", "[a]"};
+    joined.durationSeconds = 2.0;
+    joined.encoder.videoCodec = "copy";
+    joined.encoder.audioCodec = "aac";
+    join.outputs.push_back(joined);
+    Render::LibavEngine().run(join);
+
+    AVFormatContext* ctx = nullptr;
+    assert(avformat_open_input(&ctx, output.c_str(), nullptr, nullptr) == 0);
+    assert(avformat_find_stream_info(ctx, nullptr) >= 0);
+    assert(ctx->nb_streams == 2);
+    // Copied packets are interleaved with the encoded ones, not appended after them
+    AVPacket* packet = av_packet_alloc();
+    std::set<int> early;
+    for (int i = 0; i < 20 && av_read_frame(ctx, packet) >= 0; ++i) {
+        early.insert(packet->stream_index);
+        av_packet_unref(packet);
+    }
+    assert(early.size() == 2);
+    av_packet_free(&packet);
+    avformat_close_input(&ctx);
+}
+
 void testApi() {
     CLIOptions opts;
     opts.surah = 1;
@@ -195,31 +1483,10 @@ void testMetadataWriter() {
 }
 
 void testVideoGenerator() {
-    CLIOptions opts;
-    opts.surah = 1;
-    opts.from = 1;
-    opts.to = 1;
-    opts.output = (fs::temp_directory_path() / "test_video.mp4").string();
-    AppConfig cfg = loadConfig((getProjectRoot() / "config.json").string(), opts);
-    std::vector<VerseData> verses = {makeSampleVerse()};
-    std::string dummyAudioPath = (fs::temp_directory_path() / "dummy.wav").string();
-    std::ofstream dummyAudio(dummyAudioPath, std::ios::binary);
-    // Write a minimal WAV header for a silent audio file
-    dummyAudio.write("RIFF", 4);
-    dummyAudio.write("\x24\x00\x00\x00", 4); // ChunkSize
-    dummyAudio.write("WAVE", 4);
-    dummyAudio.write("fmt ", 4);
-    dummyAudio.write("\x10\x00\x00\x00", 4); // Subchunk1Size
-    dummyAudio.write("\x01\x00", 2);       // AudioFormat
-    dummyAudio.write("\x01\x00", 2);       // NumChannels
-    dummyAudio.write("\x44\xAC\x00\x00", 4); // SampleRate
-    dummyAudio.write("\x88\x58\x01\x00", 4); // ByteRate
-    dummyAudio.write("\x02\x00", 2);       // BlockAlign
-    dummyAudio.write("\x10\x00", 2);       // BitsPerSample
-    dummyAudio.write("data", 4);
-    dummyAudio.write("\x00\x00\x00\x00", 4); // Subchunk2Size
-    dummyAudio.close();
-    verses[0].localAudioPath = dummyAudioPath;
+    RenderFixture render("test_video");
+    const CLIOptions& opts = render.opts;
+    const AppConfig& cfg = render.cfg;
+    const std::vector<VerseData>& verses = render.verses;
 
     auto mockProcessExecutor = std::make_shared<MockProcessExecutor>();
     VideoGenerator::generateVideo(opts, cfg, verses, mockProcessExecutor);
@@ -232,9 +1499,110 @@ void testVideoGenerator() {
     assert(commands[1].find("ffmpeg") != std::string::npos);
     std::string thumbPath = (fs::path(opts.output).parent_path() / "thumbnail.jpeg").string();
     assert(commands[1].find(thumbPath) != std::string::npos);
+    // Every verse starts a GOP and a chapter
+    assert(commands[0].find("-force_key_frames ") != std::string::npos);
+    assert(commands[0].find("-f ffmetadata ") != std::string::npos);
+    assert(commands[0].find("-map_chapters ") != std::string::npos);
+}
+
+void testVariableFrameRate() {
+    // Repeated frames are dropped in the graph and their timestamps kept
+    RenderFixture render("test_video_vfr");
+    render.opts.variableFrameRate = true;
+    auto vfrExecutor = std::make_shared<MockProcessExecutor>();
+    VideoGenerator::generateVideo(render.opts, render.cfg, render.verses, vfrExecutor);
+    const auto& vfrCommands = vfrExecutor->getCommands();
+    assert(vfrCommands.size() == 1);
+    assert(vfrCommands[0].find("mpdecimate=hi=0:lo=0:frac=0:max=") != std::string::npos);
+    assert(vfrCommands[0].find("-fps_mode vfr") != std::string::npos);
+}
+
+void testExtraOutputs() {
+    // Extra outputs branch off the same background decode and audio mix
+    RenderFixture render("test_video_multi");
+    std::string shortPath = (fs::temp_directory_path() / "test_video_short.mp4").string();
+    render.opts.extraOutputs = {CommandLine::parseOutputProfile("1080x1920@24=" + shortPath)};
+    auto multiExecutor = std::make_shared<MockProcessExecutor>();
+    VideoGenerator::generateVideo(render.opts, render.cfg, render.verses, multiExecutor);
+    const auto& multiCommands = multiExecutor->getCommands();
+    assert(multiCommands.size() == 1);
+    assert(multiCommands[0].find("split=2[layer0][layer1]") != std::string::npos);
+    assert(multiCommands[0].find("asplit=2[audio0][audio1]") != std::string::npos);
+    assert(multiCommands[0].find("fps=24,scale=1080:1920:force_original_aspect_ratio=increase,crop=1080:1920") != std::string::npos);
+    assert(multiCommands[0].find(shortPath) != std::string::npos);
+    fs::remove(shortPath);
+}
+
+void testSoftTranslations() {
+    // Soft translations are muxed into each output by one stream copy
+    RenderFixture render("test_video_soft");
+    const AppConfig& cfg = render.cfg;
+    render.opts.softTranslations = {cfg.translationId};
+    auto softExecutor = std::make_shared<MockProcessExecutor>();
+    VideoGenerator::generateVideo(render.opts, cfg, render.verses, softExecutor);
+    const auto& softCommands = softExecutor->getCommands();
+    fs::path trackPath = SubtitleBuilder::textTrackPath(render.opts.output, cfg.translationId);
+    assert(fs::exists(trackPath));
+    assert(softCommands.size() == 2);
+    assert(softCommands[1].find("-map 1:s") != std::string::npos);
+    assert(softCommands[1].find("-c:v copy") != std::string::npos);
+    assert(softCommands[1].find("-c:s mov_text") != std::string::npos);
+    assert(softCommands[1].find("-metadata:s:s:0 language=" + QuranData::getTranslationTrackLanguage(cfg.translationId)) != std::string::npos);
+    fs::remove(trackPath);
+}
+
+void testPipelinedFetch() {
+    RenderFixture render("test_video_pipelined");
+    const CLIOptions& opts = render.opts;
+    const AppConfig& cfg = render.cfg;
+    const std::vector<VerseData>& verses = render.verses;
+
+    // Pipelined: the video track is encoded before the fetched audio is
+    // awaited, then the recitation is muxed in its planned slots
+    std::promise<std::vector<VerseData>> fetched;
+    fetched.set_value(verses);
+    auto pipeExecutor = std::make_shared<MockProcessExecutor>();
+    assert(VideoGenerator::supportsPendingAudio(opts, cfg));
+    assert(VideoGenerator::generateVideo(opts, cfg, verses, pipeExecutor, nullptr, fetched.get_future().share()));
+    const auto& pipeCommands = pipeExecutor->getCommands();
+    assert(pipeCommands.size() == 2);
+    assert(pipeCommands[0].find("-map \"[v]\"") != std::string::npos);
+    assert(pipeCommands[0].find("-c:a") == std::string::npos);
+    assert(pipeCommands[1].find("-c:v copy") != std::string::npos);
+    assert(pipeCommands[1].find("aresample=async=1") != std::string::npos);
+
+    // Audio off the planned timeline by more than a frame is encoded again on its own
+    std::vector<VerseData> longer = verses;
+    longer[0].durationInSeconds += 1.0;
+    std::promise<std::vector<VerseData>> mismatched;
+    mismatched.set_value(longer);
+    auto retimeExecutor = std::make_shared<MockProcessExecutor>();
+    assert(VideoGenerator::generateVideo(opts, cfg, verses, retimeExecutor, nullptr, mismatched.get_future().share()));
+    const auto& retimeCommands = retimeExecutor->getCommands();
+    assert(retimeCommands.size() == 2);
+    assert(retimeCommands[1].find("aresample") == std::string::npos);
+    assert(retimeCommands[1].find("-c:a aac") != std::string::npos);
 
-    fs::remove(opts.output);
-    fs::remove(dummyAudioPath);
+    // A failed mux still removes the chunk directory
+    struct FailingMux : MockProcessExecutor {
+        void executeWithProgress(const std::string& command, double totalDurationSeconds) override {
+            if (command.find("-c:v copy") != std::string::npos) throw std::runtime_error("mux failed");
+            MockProcessExecutor::executeWithProgress(command, totalDurationSeconds);
+        }
+    };
+    auto chunkDirs = []() {
+        std::set<fs::path> dirs;
+        for (const auto& entry : fs::directory_iterator(fs::temp_directory_path())) {
+            if (entry.path().filename().string().rfind("qvm_chunks_", 0) == 0) dirs.insert(entry.path());
+        }
+        return dirs;
+    };
+    auto chunkDirsBefore = chunkDirs();
+    std::promise<std::vector<VerseData>> fetchedAgain;
+    fetchedAgain.set_value(verses);
+    assert(!VideoGenerator::generateVideo(opts, cfg, verses, std::make_shared<FailingMux>(), nullptr,
+                                          fetchedAgain.get_future().share()));
+    assert(chunkDirs() == chunkDirsBefore);
 }
 
 void testGenerateBackendMetadata() {
@@ -275,6 +1643,10 @@ int main() {
     testApi();
     testMetadataWriter();
     testVideoGenerator();
+    testVariableFrameRate();
+    testExtraOutputs();
+    testSoftTranslations();
+    testPipelinedFetch();
     testConfigLoader();
     testCacheUtils();
     testLocalization();
@@ -282,7 +1654,33 @@ int main() {
     testTimingParser();
     testSubtitleBuilder();
     testTextLayoutEngine();
+    testFontPool();
+    testWrapMatchesExactShaping();
+    testWrapNearBoundary();
+    testVerseTextIndex();
+    testVersePack();
+    testDownloadHostKey();
+#ifndef _WIN32
+    testDownloadScheduling();
+    testDownloadRestartsMismatchedResume();
+    testDownloadResume();
+#endif
+    testMp3SeekIndex();
+    testMediaDurations();
+    testRenderCache();
+    testClipLibraryKeys();
+    testBatchJobArguments();
+    testProgressEvents();
+    testParallelForEach();
+    testResourceGovernor();
+    testBackgroundPlateKeys();
+    testBackgroundPrefetch();
+    testSubtitleSprites();
+    testVerseClips();
+    testBuildCommand();
+    testLibavCopyWithFilteredAudio();
     testCustomAudioPlan();
+    testChunkPlanner();
     testGenerateBackendMetadata();
     std::cout << "All unit tests passed.\n";
     return 0;